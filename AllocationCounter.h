@@ -0,0 +1,25 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstdint>
+
+// Counts heap allocations made through operator new in every thread. Build
+// with GRAVITY_COUNT_ALLOCATIONS defined (CMake option
+// GRAVITY_COUNT_ALLOCATIONS) to replace the global operator new/delete with
+// counting versions; otherwise enabled() is false and count() stays 0.
+//
+// The frame and step loops compare count() before and after once they are
+// warmed up: in steady state they should not touch the heap at all.
+namespace AllocationCounter {
+
+#ifdef GRAVITY_COUNT_ALLOCATIONS
+constexpr bool enabled = true;
+#else
+constexpr bool enabled = false;
+#endif
+
+uint64_t count();  // Allocations since start-up
+
+} // namespace AllocationCounter
+
+#endif // ALLOCATION_COUNTER_H
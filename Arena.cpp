@@ -0,0 +1,67 @@
+#include "Arena.h"
+#include <algorithm>
+#include <new>
+
+Arena::Arena(size_t initialBlockSize) : current(0), offset(0), blockSize(std::max<size_t>(initialBlockSize, 64)) {}
+
+Arena::~Arena() {
+    for (Block& block : blocks) {
+        ::operator delete(block.data);
+    }
+}
+
+Arena& Arena::local() {
+    thread_local Arena arena;
+    return arena;
+}
+
+void* Arena::allocate(size_t bytes, size_t alignment) {
+    if (blocks.empty()) {
+        addBlock(bytes + alignment);
+    }
+    for (;;) {
+        Block& block = blocks[current];
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+        size_t start = ((base + offset + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base;
+        if (start + bytes <= block.size) {
+            offset = start + bytes;
+            return block.data + start;
+        }
+        // Move on to the next block, adding one when none is left
+        if (current + 1 == blocks.size()) {
+            addBlock(bytes + alignment);
+        }
+        current++;
+        offset = 0;
+    }
+}
+
+void Arena::rewind(Marker marker) {
+    current = marker.block;
+    offset = marker.offset;
+    if (current == 0 && offset == 0 && blocks.size() > 1) {
+        // Empty again: trade the blocks for one that holds everything
+        size_t total = capacity();
+        for (Block& block : blocks) {
+            ::operator delete(block.data);
+        }
+        blocks.clear();
+        addBlock(total);
+    }
+}
+
+size_t Arena::capacity() const {
+    size_t total = 0;
+    for (const Block& block : blocks) {
+        total += block.size;
+    }
+    return total;
+}
+
+void Arena::addBlock(size_t minimumBytes) {
+    // Grow geometrically so a warming-up arena needs few blocks
+    size_t size = std::max(blockSize, minimumBytes);
+    blockSize = std::max(blockSize, size) * 2;
+    char* data = static_cast<char*>(::operator new(size));
+    blocks.push_back(Block{data, size});
+}
@@ -0,0 +1,125 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for transient data: per-step scratch in the physics
+// kernels and per-frame data in the viewer.
+//
+// Allocation advances an offset inside the current block; nothing is freed
+// individually. An ArenaScope rewinds the arena to where it was when the
+// scope opened, so every function that needs scratch opens its own scope and
+// nesting works. When a scope brings the arena back to empty after it had to
+// grow into several blocks, they are replaced by a single block of the
+// combined size: after warm-up, each thread's arena satisfies every request
+// from one block without touching the heap.
+//
+// Arena::local() is the calling thread's arena. Only the owning thread may
+// allocate from it; pool workers inside a parallelFor may read and write the
+// memory it handed out, as with any other buffer.
+class Arena {
+public:
+    struct Marker {
+        size_t block;
+        size_t offset;
+    };
+
+    explicit Arena(size_t initialBlockSize = 1 << 16);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    static Arena& local();
+
+    void* allocate(size_t bytes, size_t alignment);
+
+    // Uninitialized storage for `count` objects; only for types that need no
+    // destructor, since the arena never runs one
+    template <typename T>
+    T* allocate(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena memory is released without destructors");
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    template <typename T>
+    T* allocateFilled(size_t count, const T& value) {
+        T* values = allocate<T>(count);
+        for (size_t i = 0; i < count; i++) {
+            new (values + i) T(value);
+        }
+        return values;
+    }
+
+    Marker mark() const { return Marker{current, offset}; }
+    void rewind(Marker marker);
+
+    size_t capacity() const;
+    size_t blockCount() const { return blocks.size(); }
+
+private:
+    struct Block {
+        char* data;
+        size_t size;
+    };
+
+    void addBlock(size_t minimumBytes);
+
+    std::vector<Block> blocks;
+    size_t current;  // Block being filled
+    size_t offset;   // Bytes used in the current block
+    size_t blockSize;
+};
+
+// Rewinds an arena on destruction. Declare it before the containers that use
+// the arena so they are destroyed first.
+class ArenaScope {
+public:
+    explicit ArenaScope(Arena& arena = Arena::local()) : arena(arena), marker(arena.mark()) {}
+    ~ArenaScope() { arena.rewind(marker); }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+    template <typename T>
+    T* allocate(size_t count) { return arena.allocate<T>(count); }
+
+    template <typename T>
+    T* allocateFilled(size_t count, const T& value) { return arena.allocateFilled(count, value); }
+
+    Arena& arena;
+
+private:
+    Arena::Marker marker;
+};
+
+// Standard allocator on top of an arena, for containers that grow while a
+// scope is open. Deallocation is a no-op; the scope reclaims everything.
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator(Arena& arena = Arena::local()) : arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) { return static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+    Arena* arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif // ARENA_H
@@ -0,0 +1,236 @@
+#include "BarnesHutTree.h"
+#include <algorithm>
+#include <cmath>
+
+BarnesHutTree::BarnesHutTree() : posX(nullptr), posY(nullptr), masses(nullptr) {}
+
+void BarnesHutTree::build(const double* x, const double* y, const double* mass, size_t count) {
+    posX = x;
+    posY = y;
+    masses = mass;
+    nodeList.clear();
+    indices.resize(count);
+    if (count == 0) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        indices[i] = static_cast<uint32_t>(i);
+    }
+
+    // Square root cell enclosing every body
+    double minX = x[0], maxX = x[0], minY = y[0], maxY = y[0];
+    for (size_t i = 1; i < count; i++) {
+        minX = std::min(minX, x[i]);
+        maxX = std::max(maxX, x[i]);
+        minY = std::min(minY, y[i]);
+        maxY = std::max(maxY, y[i]);
+    }
+    double halfSize = 0.5 * std::max(maxX - minX, maxY - minY);
+    halfSize = halfSize > 0.0 ? halfSize * 1.0001 : 1.0;
+
+    Node root;
+    root.centerX = 0.5 * (minX + maxX);
+    root.centerY = 0.5 * (minY + maxY);
+    root.halfSize = halfSize;
+    root.mass = 0.0;
+    root.comX = root.centerX;
+    root.comY = root.centerY;
+    root.firstChild = -1;
+    root.begin = 0;
+    root.count = static_cast<uint32_t>(count);
+
+    nodeList.reserve(2 * count / leafCapacity + 16);
+    nodeList.push_back(root);
+    subdivide(0, 0);
+    computeMoments(0);
+}
+
+void BarnesHutTree::subdivide(uint32_t nodeIndex, int depth) {
+    // Copy what we need; nodeList may reallocate while children are appended
+    Node node = nodeList[nodeIndex];
+    if (node.count <= leafCapacity || depth >= maxDepth) {
+        return;
+    }
+
+    // Partition the index range into the four quadrants: [SW, SE, NW, NE]
+    uint32_t* first = indices.data() + node.begin;
+    uint32_t* last = first + node.count;
+    const double* xs = posX;
+    const double* ys = posY;
+    double cx = node.centerX, cy = node.centerY;
+    uint32_t* northStart = std::partition(first, last, [ys, cy](uint32_t i) { return ys[i] < cy; });
+    uint32_t* southEast = std::partition(first, northStart, [xs, cx](uint32_t i) { return xs[i] < cx; });
+    uint32_t* northEast = std::partition(northStart, last, [xs, cx](uint32_t i) { return xs[i] < cx; });
+
+    uint32_t bounds[5] = {
+        node.begin,
+        static_cast<uint32_t>(southEast - indices.data()),
+        static_cast<uint32_t>(northStart - indices.data()),
+        static_cast<uint32_t>(northEast - indices.data()),
+        node.begin + node.count
+    };
+
+    int32_t firstChild = static_cast<int32_t>(nodeList.size());
+    nodeList[nodeIndex].firstChild = firstChild;
+    double quarter = 0.5 * node.halfSize;
+    for (int q = 0; q < 4; q++) {
+        Node child;
+        child.centerX = cx + ((q & 1) ? quarter : -quarter);
+        child.centerY = cy + ((q & 2) ? quarter : -quarter);
+        child.halfSize = quarter;
+        child.mass = 0.0;
+        child.comX = child.centerX;
+        child.comY = child.centerY;
+        child.firstChild = -1;
+        child.begin = bounds[q];
+        child.count = bounds[q + 1] - bounds[q];
+        nodeList.push_back(child);
+    }
+    for (int q = 0; q < 4; q++) {
+        subdivide(firstChild + q, depth + 1);
+    }
+}
+
+void BarnesHutTree::computeMoments(uint32_t nodeIndex) {
+    Node& node = nodeList[nodeIndex];
+    double m = 0.0, mx = 0.0, my = 0.0;
+    if (node.firstChild < 0) {
+        for (uint32_t k = node.begin; k < node.begin + node.count; k++) {
+            uint32_t i = indices[k];
+            m += masses[i];
+            mx += masses[i] * posX[i];
+            my += masses[i] * posY[i];
+        }
+    } else {
+        for (int q = 0; q < 4; q++) {
+            uint32_t childIndex = node.firstChild + q;
+            computeMoments(childIndex);
+            const Node& child = nodeList[childIndex];
+            m += child.mass;
+            mx += child.mass * child.comX;
+            my += child.mass * child.comY;
+        }
+    }
+    Node& updated = nodeList[nodeIndex];
+    updated.mass = m;
+    if (m > 0.0) {
+        updated.comX = mx / m;
+        updated.comY = my / m;
+    }
+}
+
+template <typename LeafVisitor, typename NodeVisitor>
+void BarnesHutTree::walk(double px, double py, double theta, LeafVisitor&& leaf, NodeVisitor&& far) const {
+    if (nodeList.empty()) {
+        return;
+    }
+    double theta2 = theta * theta;
+    uint32_t stack[4 * maxDepth + 4];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodeList[stack[--top]];
+        if (node.mass == 0.0) {
+            continue;
+        }
+        if (node.firstChild < 0) {
+            leaf(node);
+            continue;
+        }
+        double dx = node.comX - px;
+        double dy = node.comY - py;
+        double dist2 = dx * dx + dy * dy;
+        double size = 2.0 * node.halfSize;
+        // Never approximate a cell that contains the evaluation point
+        bool inside = std::fabs(px - node.centerX) <= node.halfSize && std::fabs(py - node.centerY) <= node.halfSize;
+        if (!inside && size * size < theta2 * dist2) {
+            far(node, dx, dy, dist2);
+        } else {
+            for (int q = 0; q < 4; q++) {
+                stack[top++] = node.firstChild + q;
+            }
+        }
+    }
+}
+
+void BarnesHutTree::accelerationAt(size_t index, double theta, double softening2, double& ax, double& ay) const {
+    double px = posX[index], py = posY[index];
+    double sumX = 0.0, sumY = 0.0;
+    walk(px, py, theta,
+        [&](const Node& node) {
+            for (uint32_t k = node.begin; k < node.begin + node.count; k++) {
+                uint32_t j = indices[k];
+                if (j == index) {
+                    continue;
+                }
+                double dx = posX[j] - px;
+                double dy = posY[j] - py;
+                double r2 = dx * dx + dy * dy + softening2;
+                if (r2 <= 0.0) {
+                    continue;
+                }
+                double invR3 = 1.0 / (r2 * std::sqrt(r2));
+                sumX += masses[j] * dx * invR3;
+                sumY += masses[j] * dy * invR3;
+            }
+        },
+        [&](const Node& node, double dx, double dy, double dist2) {
+            double r2 = dist2 + softening2;
+            double invR3 = 1.0 / (r2 * std::sqrt(r2));
+            sumX += node.mass * dx * invR3;
+            sumY += node.mass * dy * invR3;
+        });
+    ax = sumX;
+    ay = sumY;
+}
+
+void BarnesHutTree::accelerationAtPoint(double px, double py, double theta, double softening2, double& ax, double& ay) const {
+    double sumX = 0.0, sumY = 0.0;
+    walk(px, py, theta,
+        [&](const Node& node) {
+            for (uint32_t k = node.begin; k < node.begin + node.count; k++) {
+                uint32_t j = indices[k];
+                double dx = posX[j] - px;
+                double dy = posY[j] - py;
+                double r2 = dx * dx + dy * dy + softening2;
+                if (r2 <= 0.0) {
+                    continue;
+                }
+                double invR3 = 1.0 / (r2 * std::sqrt(r2));
+                sumX += masses[j] * dx * invR3;
+                sumY += masses[j] * dy * invR3;
+            }
+        },
+        [&](const Node& node, double dx, double dy, double dist2) {
+            double r2 = dist2 + softening2;
+            double invR3 = 1.0 / (r2 * std::sqrt(r2));
+            sumX += node.mass * dx * invR3;
+            sumY += node.mass * dy * invR3;
+        });
+    ax = sumX;
+    ay = sumY;
+}
+
+double BarnesHutTree::potentialAt(size_t index, double theta, double softening2) const {
+    double px = posX[index], py = posY[index];
+    double potential = 0.0;
+    walk(px, py, theta,
+        [&](const Node& node) {
+            for (uint32_t k = node.begin; k < node.begin + node.count; k++) {
+                uint32_t j = indices[k];
+                if (j == index) {
+                    continue;
+                }
+                double dx = posX[j] - px;
+                double dy = posY[j] - py;
+                double r2 = dx * dx + dy * dy + softening2;
+                if (r2 > 0.0) {
+                    potential -= masses[j] / std::sqrt(r2);
+                }
+            }
+        },
+        [&](const Node& node, double, double, double dist2) {
+            potential -= node.mass / std::sqrt(dist2 + softening2);
+        });
+    return potential;
+}
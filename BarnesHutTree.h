@@ -0,0 +1,57 @@
+#ifndef BARNES_HUT_TREE_H
+#define BARNES_HUT_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Barnes-Hut quadtree over a set of point masses in the plane.
+//
+// build() sorts body indices into a flat node array; each internal node keeps
+// the monopole (total mass and center of mass) of everything below it. Far
+// away nodes whose size/distance ratio is below the opening angle theta are
+// treated as a single mass, giving O(N log N) force and potential evaluation.
+class BarnesHutTree {
+public:
+    struct Node {
+        double centerX, centerY;  // Geometric center of the square cell
+        double halfSize;
+        double mass;
+        double comX, comY;        // Center of mass
+        int32_t firstChild;       // Index of the first of four children, -1 for leaves
+        uint32_t begin, count;    // Range in the sorted body index array
+    };
+
+    static constexpr uint32_t leafCapacity = 8;
+    static constexpr int maxDepth = 48;
+
+    BarnesHutTree();
+
+    void build(const double* x, const double* y, const double* mass, size_t count);
+
+    // Acceleration (without the G factor) and potential (without G, negative)
+    // at body `index`, excluding its own contribution.
+    void accelerationAt(size_t index, double theta, double softening2, double& ax, double& ay) const;
+    double potentialAt(size_t index, double theta, double softening2) const;
+
+    // Field at an arbitrary point (for particles that are not part of the tree)
+    void accelerationAtPoint(double px, double py, double theta, double softening2, double& ax, double& ay) const;
+
+    const std::vector<Node>& nodes() const { return nodeList; }
+    const std::vector<uint32_t>& sortedIndices() const { return indices; }
+    bool empty() const { return nodeList.empty(); }
+
+private:
+    void subdivide(uint32_t nodeIndex, int depth);
+    void computeMoments(uint32_t nodeIndex);
+    template <typename LeafVisitor, typename NodeVisitor>
+    void walk(double px, double py, double theta, LeafVisitor&& leaf, NodeVisitor&& far) const;
+
+    std::vector<Node> nodeList;
+    std::vector<uint32_t> indices;
+    const double* posX;
+    const double* posY;
+    const double* masses;
+};
+
+#endif // BARNES_HUT_TREE_H
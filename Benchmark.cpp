@@ -0,0 +1,244 @@
+#include "Benchmark.h"
+#include "Scenarios.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <sys/resource.h>
+
+double FrameTimes::percentile(double fraction) const {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::vector<double> sorted = samples;
+    size_t rank = static_cast<size_t>(std::ceil(std::clamp(fraction, 0.0, 1.0) * sorted.size()));
+    size_t index = rank == 0 ? 0 : rank - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+    return sorted[index] * 1000.0;
+}
+
+namespace {
+
+using Force = PhysicsEngine::ForceMethod;
+
+// Value of `"key": ...` on a line written by writeJsonObject
+std::string field(const std::string& line, const std::string& key) {
+    std::string marker = "\"" + key + "\": ";
+    size_t start = line.find(marker);
+    if (start == std::string::npos) {
+        throw std::runtime_error("Benchmark result without " + key + ": " + line);
+    }
+    start += marker.size();
+    if (line[start] == '"') {
+        size_t end = line.find('"', start + 1);
+        return line.substr(start + 1, end - start - 1);
+    }
+    size_t end = line.find_first_of(",}", start);
+    return line.substr(start, end - start);
+}
+
+} // namespace
+
+namespace Benchmark {
+
+const std::vector<BenchmarkCase>& cases() {
+    // Ordered from small to large, so the process-wide peak RSS of a run
+    // that goes through them in order tracks the current case
+    static const std::vector<BenchmarkCase> all = {
+        {"two-body", "sun-earth", 0, 20000, 0.001, 0.0, Force::Automatic},
+        {"solar", "solar", 0, 20000, 0.01, 0.0, Force::Automatic},
+        {"cloud-4k-direct", "cloud", 4096, 50, 0.001, 0.01, Force::Direct},
+        {"cloud-4k-direct-mixed", "cloud", 4096, 50, 0.001, 0.01, Force::Direct, false, PhysicsEngine::Precision::Mixed},
+        {"disk-20k", "disk", 20000, 200, 0.001, 0.01, Force::Automatic},
+        {"disk-20k-deterministic", "disk", 20000, 200, 0.001, 0.01, Force::Automatic, true},
+        {"belt-100k", "belt", 100000, 500, 0.01, 0.0, Force::Automatic},
+        {"cloud-200k", "cloud", 200000, 20, 0.001, 0.01, Force::Tree},
+        {"disk-1m-pm", "disk", 1000000, 10, 0.001, 0.01, Force::ParticleMesh},
+        {"disk-1m-pm-deterministic", "disk", 1000000, 10, 0.001, 0.01, Force::ParticleMesh, true},
+        {"disk-1m", "disk", 1000000, 10, 0.001, 0.01, Force::Tree},
+    };
+    return all;
+}
+
+const BenchmarkCase* find(const std::string& name) {
+    for (const BenchmarkCase& benchmark : cases()) {
+        if (benchmark.name == name) {
+            return &benchmark;
+        }
+    }
+    return nullptr;
+}
+
+void prepare(const BenchmarkCase& benchmark, PhysicsEngine& engine) {
+    if (!Scenarios::load(benchmark.scenario, benchmark.bodies, 1, engine.bodies(), &engine.particles)) {
+        throw std::runtime_error("Benchmark " + benchmark.name + " uses unknown scenario " + benchmark.scenario);
+    }
+    engine.settings.softening = benchmark.softening;
+    engine.settings.forceMethod = benchmark.force;
+    engine.settings.deterministic = benchmark.deterministic;
+    engine.settings.precision = benchmark.precision;
+    engine.initialize();
+}
+
+BenchmarkResult runHeadless(const BenchmarkCase& benchmark) {
+    PhysicsEngine engine;
+    prepare(benchmark, engine);
+    for (unsigned s = 0; s < warmupSteps; s++) {
+        engine.step(benchmark.dt);
+    }
+
+    FrameTimes frames;
+    frames.reserve(benchmark.steps);
+    HardwareCounters::reset();
+    auto start = std::chrono::steady_clock::now();
+    auto last = start;
+    for (unsigned s = 0; s < benchmark.steps; s++) {
+        engine.step(benchmark.dt);
+        auto now = std::chrono::steady_clock::now();
+        frames.record(std::chrono::duration<double>(now - last).count());
+        last = now;
+    }
+
+    BenchmarkResult result;
+    result.name = benchmark.name;
+    result.mode = "headless";
+    result.bodies = engine.bodies().size();
+    result.particles = engine.particles.size();
+    summarize(frames, std::chrono::duration<double>(last - start).count(), result);
+    collectCounters(result);
+    return result;
+}
+
+void summarize(const FrameTimes& frames, double seconds, BenchmarkResult& result) {
+    result.steps = static_cast<unsigned>(frames.size());
+    result.seconds = seconds;
+    result.stepsPerSecond = seconds > 0.0 ? frames.size() / seconds : 0.0;
+    result.p50 = frames.percentile(0.50);
+    result.p95 = frames.percentile(0.95);
+    result.p99 = frames.percentile(0.99);
+    result.peakResidentBytes = peakResidentBytes();
+}
+
+void collectCounters(BenchmarkResult& result) {
+    result.counters.clear();
+    if (!HardwareCounters::enabled()) {
+        return;
+    }
+    unsigned threads = HardwareCounters::threadCount();
+    for (size_t p = 0; p < HardwareCounters::phaseCount; p++) {
+        HardwareCounters::Phase phase = static_cast<HardwareCounters::Phase>(p);
+        for (unsigned thread = 0; thread < threads; thread++) {
+            HardwareCounters::Counts counts = HardwareCounters::total(phase, thread);
+            if (!counts.empty()) {
+                result.counters.push_back({HardwareCounters::name(phase), thread, counts});
+            }
+        }
+    }
+}
+
+HardwareCounters::Counts counterTotal(const BenchmarkResult& result, const std::string& phase) {
+    HardwareCounters::Counts total;
+    for (const CounterSample& sample : result.counters) {
+        if (sample.phase == phase) {
+            total.add(sample.counts);
+        }
+    }
+    return total;
+}
+
+size_t peakResidentBytes() {
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);  // Bytes on macOS
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;  // Kilobytes on Linux
+#endif
+}
+
+void writeJsonObject(std::ostream& out, const BenchmarkResult& result) {
+    out << std::setprecision(6)
+        << "{\"name\": \"" << result.name << "\", \"mode\": \"" << result.mode
+        << "\", \"bodies\": " << result.bodies << ", \"particles\": " << result.particles
+        << ", \"steps\": " << result.steps << ", \"seconds\": " << result.seconds
+        << ", \"steps_per_second\": " << result.stepsPerSecond
+        << ", \"frame_ms_p50\": " << result.p50 << ", \"frame_ms_p95\": " << result.p95
+        << ", \"frame_ms_p99\": " << result.p99 << ", \"peak_rss_bytes\": " << result.peakResidentBytes;
+    if (!result.counters.empty()) {
+        // Unavailable events are null
+        out << ", \"counters\": [";
+        for (size_t i = 0; i < result.counters.size(); i++) {
+            const CounterSample& sample = result.counters[i];
+            out << (i > 0 ? ", " : "") << "{\"phase\": \"" << sample.phase << "\", \"thread\": " << sample.thread;
+            for (size_t e = 0; e < HardwareCounters::eventCount; e++) {
+                out << ", \"" << HardwareCounters::name(static_cast<HardwareCounters::Event>(e)) << "\": ";
+                if (sample.counts.value[e] >= 0) {
+                    out << sample.counts.value[e];
+                } else {
+                    out << "null";
+                }
+            }
+            out << "}";
+        }
+        out << "]";
+    }
+    out << "}";
+}
+
+void writeJson(std::ostream& out, const std::vector<BenchmarkResult>& results) {
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        out << "  ";
+        writeJsonObject(out, results[i]);
+        out << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+    out << "]" << std::endl;
+}
+
+std::vector<BenchmarkResult> readJson(std::istream& in) {
+    std::vector<BenchmarkResult> results;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t open = line.find('{');
+        if (open == std::string::npos) {
+            if (line.find_first_not_of(" \t\r[]") != std::string::npos) {
+                throw std::runtime_error("Unexpected line in benchmark results: " + line);
+            }
+            continue;
+        }
+        BenchmarkResult result;
+        result.name = field(line, "name");
+        result.mode = field(line, "mode");
+        result.bodies = std::stoull(field(line, "bodies"));
+        result.particles = std::stoull(field(line, "particles"));
+        result.steps = static_cast<unsigned>(std::stoul(field(line, "steps")));
+        result.seconds = std::stod(field(line, "seconds"));
+        result.stepsPerSecond = std::stod(field(line, "steps_per_second"));
+        result.p50 = std::stod(field(line, "frame_ms_p50"));
+        result.p95 = std::stod(field(line, "frame_ms_p95"));
+        result.p99 = std::stod(field(line, "frame_ms_p99"));
+        result.peakResidentBytes = std::stoull(field(line, "peak_rss_bytes"));
+        size_t counters = line.find("\"counters\": [");
+        for (size_t open = line.find('{', counters); counters != std::string::npos && open != std::string::npos;
+             open = line.find('{', open + 1)) {
+            std::string entry = line.substr(open, line.find('}', open) - open + 1);
+            CounterSample sample;
+            sample.phase = field(entry, "phase");
+            sample.thread = static_cast<unsigned>(std::stoul(field(entry, "thread")));
+            for (size_t e = 0; e < HardwareCounters::eventCount; e++) {
+                std::string value = field(entry, HardwareCounters::name(static_cast<HardwareCounters::Event>(e)));
+                sample.counts.value[e] = value == "null" ? -1 : std::stoll(value);
+            }
+            result.counters.push_back(sample);
+        }
+        results.push_back(result);
+    }
+    return results;
+}
+
+} // namespace Benchmark
@@ -0,0 +1,98 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "HardwareCounters.h"
+#include "PhysicsEngine.h"
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// Canonical whole-pipeline scenarios, shared by gravity_bench (headless) and
+// the viewer's offscreen --benchmark mode so both report the same cases.
+struct BenchmarkCase {
+    std::string name;
+    std::string scenario;  // Scenarios name
+    size_t bodies;         // Count passed to the scenario
+    unsigned steps;        // Timed frames; one step per frame
+    double dt;
+    double softening;
+    PhysicsEngine::ForceMethod force;
+    bool deterministic = false;  // PhysicsEngine::Settings::deterministic, to price reproducibility
+    PhysicsEngine::Precision precision = PhysicsEngine::Precision::Double;
+};
+
+// Hardware counts of one phase on one thread over the timed frames
+struct CounterSample {
+    std::string phase;  // HardwareCounters::name()
+    unsigned thread = 0;
+    HardwareCounters::Counts counts;
+};
+
+struct BenchmarkResult {
+    std::string name;
+    std::string mode;  // "headless" or "render"
+    size_t bodies = 0;
+    size_t particles = 0;
+    unsigned steps = 0;
+    double seconds = 0.0;
+    double stepsPerSecond = 0.0;
+    double p50 = 0.0, p95 = 0.0, p99 = 0.0;  // Frame times in milliseconds
+    size_t peakResidentBytes = 0;
+    std::vector<CounterSample> counters;  // Empty unless hardware counters were enabled
+};
+
+// Durations of individual frames, summarized as percentiles
+class FrameTimes {
+public:
+    void reserve(size_t count) { samples.reserve(count); }
+    void record(double seconds) { samples.push_back(seconds); }
+    size_t size() const { return samples.size(); }
+
+    // Nearest-rank percentile in milliseconds; 0 when nothing was recorded
+    double percentile(double fraction) const;
+
+private:
+    std::vector<double> samples;
+};
+
+namespace Benchmark {
+
+// Untimed steps before measuring, so first-touch allocation and tree setup
+// do not land in the percentiles
+const unsigned warmupSteps = 2;
+
+const std::vector<BenchmarkCase>& cases();
+const BenchmarkCase* find(const std::string& name);
+
+// Loads the case's scenario into a fresh engine and applies its settings
+void prepare(const BenchmarkCase& benchmark, PhysicsEngine& engine);
+
+// Steps the case in-process with no rendering
+BenchmarkResult runHeadless(const BenchmarkCase& benchmark);
+
+// Fills in steps/s and percentiles from measured frames
+void summarize(const FrameTimes& frames, double seconds, BenchmarkResult& result);
+
+// Copies the hardware counts gathered since the last HardwareCounters::reset()
+// into the result, per phase and thread; does nothing while counting is off
+void collectCounters(BenchmarkResult& result);
+
+// Counts of one phase summed over threads
+HardwareCounters::Counts counterTotal(const BenchmarkResult& result, const std::string& phase);
+
+// Largest resident set of this process so far
+size_t peakResidentBytes();
+
+// One object per line inside a JSON array, so results can be concatenated
+// and read back by readJson without a JSON library
+void writeJson(std::ostream& out, const std::vector<BenchmarkResult>& results);
+void writeJsonObject(std::ostream& out, const BenchmarkResult& result);
+
+// Reads files written by writeJson. Throws std::runtime_error on lines it
+// does not recognize.
+std::vector<BenchmarkResult> readJson(std::istream& in);
+
+} // namespace Benchmark
+
+#endif // BENCHMARK_H
@@ -0,0 +1,125 @@
+#include "BodyRenderer.h"
+#include <cstddef>
+#include <iostream>
+
+BodyRenderer::BodyRenderer() : VAO(0), meshVBO(0), EBO(0), instanceVBO(0), indexCount(0), instanceCapacity(0) {
+    initializeBuffers();
+}
+
+BodyRenderer::~BodyRenderer() {
+    cleanup();
+}
+
+void BodyRenderer::initializeBuffers() {
+    // Generate vertices for a sphere using triangles
+    std::vector<float> vertices;
+    const int latitudeBands = 30;
+    const int longitudeBands = 30;
+    const float PI = 3.14159265359f;
+
+    for (int lat = 0; lat <= latitudeBands; lat++) {
+        float theta = lat * PI / latitudeBands;
+        float sinTheta = sin(theta);
+        float cosTheta = cos(theta);
+
+        for (int lon = 0; lon <= longitudeBands; lon++) {
+            float phi = lon * 2 * PI / longitudeBands;
+            vertices.push_back(cos(phi) * sinTheta * meshRadius);
+            vertices.push_back(cosTheta * meshRadius);
+            vertices.push_back(sin(phi) * sinTheta * meshRadius);
+        }
+    }
+
+    std::vector<unsigned int> indices;
+    for (int lat = 0; lat < latitudeBands; lat++) {
+        for (int lon = 0; lon < longitudeBands; lon++) {
+            int first = (lat * (longitudeBands + 1)) + lon;
+            int second = first + longitudeBands + 1;
+            indices.push_back(first);
+            indices.push_back(second);
+            indices.push_back(first + 1);
+
+            indices.push_back(second);
+            indices.push_back(second + 1);
+            indices.push_back(first + 1);
+        }
+    }
+    indexCount = static_cast<GLsizei>(indices.size());
+
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+
+    // Shared sphere mesh
+    glGenBuffers(1, &meshVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, meshVBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glGenBuffers(1, &EBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+    // Packed per-instance position, scale and palette index, advanced once
+    // per instance; positions arrive normalized to [0, 1], the rest as integers
+    glGenBuffers(1, &instanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(BodyInstance), (void*)offsetof(BodyInstance, x));
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glVertexAttribIPointer(2, 1, GL_UNSIGNED_SHORT, sizeof(BodyInstance), (void*)offsetof(BodyInstance, scale));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glVertexAttribIPointer(3, 1, GL_UNSIGNED_BYTE, sizeof(BodyInstance), (void*)offsetof(BodyInstance, palette));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    std::cout << "Body renderer initialized with a " << vertices.size() / 3 << " vertex, "
+              << indexCount << " index sphere mesh" << std::endl;
+}
+
+void BodyRenderer::draw(const Shader& shader, InstanceStream& stream) {
+    const std::vector<BodyInstance>& instances = stream.instances();
+    if (instances.empty()) {
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    size_t bytes = instances.size() * sizeof(BodyInstance);
+    if (instances.size() > instanceCapacity) {
+        // Grow geometrically so a slowly growing visible set does not change the size every frame
+        instanceCapacity = instances.size() + instances.size() / 2;
+    }
+    // Orphan the old storage so the driver does not wait for the previous frame's draw
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(BodyInstance), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, instances.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    shader.use();
+    stream.bind(shader);
+    glBindVertexArray(VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, static_cast<GLsizei>(instances.size()));
+    glBindVertexArray(0);
+}
+
+void BodyRenderer::cleanup() {
+    if (VAO != 0) {
+        glDeleteVertexArrays(1, &VAO);
+        VAO = 0;
+    }
+    if (meshVBO != 0) {
+        glDeleteBuffers(1, &meshVBO);
+        meshVBO = 0;
+    }
+    if (EBO != 0) {
+        glDeleteBuffers(1, &EBO);
+        EBO = 0;
+    }
+    if (instanceVBO != 0) {
+        glDeleteBuffers(1, &instanceVBO);
+        instanceVBO = 0;
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef BODY_RENDERER_H
+#define BODY_RENDERER_H
+
+#include "InstanceStream.h"
+#include "Shader.h"
+#include <glad/glad.h>
+#include <vector>
+
+// Draws every visible body with one instanced draw call. All bodies share a
+// single sphere mesh; only the packed instance list is uploaded per frame,
+// so the cost follows the number of visible bodies.
+class BodyRenderer {
+public:
+    BodyRenderer();
+    ~BodyRenderer();
+
+    BodyRenderer(const BodyRenderer&) = delete;
+    BodyRenderer& operator=(const BodyRenderer&) = delete;
+
+    // Draws the stream's instances with `shader`
+    void draw(const Shader& shader, InstanceStream& stream);
+
+    static constexpr float meshRadius = 0.5f;  // Radius of the shared sphere mesh
+
+private:
+    void initializeBuffers();
+    void cleanup();
+
+    GLuint VAO, meshVBO, EBO, instanceVBO;
+    GLsizei indexCount;
+    size_t instanceCapacity;  // Instances the instance buffer can hold without reallocating
+};
+
+#endif // BODY_RENDERER_H
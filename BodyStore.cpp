@@ -0,0 +1,162 @@
+#include "BodyStore.h"
+#include "Arena.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+BodyStore::BodyId BodyStore::addBody(double px, double py, double pvx, double pvy, double m, double r, uint32_t c) {
+    BodyId bodyId = static_cast<BodyId>(indexById.size());
+    indexById.push_back(static_cast<uint32_t>(x.size()));
+
+    x.push_back(px);
+    y.push_back(py);
+    vx.push_back(pvx);
+    vy.push_back(pvy);
+    ax.push_back(0.0);
+    ay.push_back(0.0);
+    mass.push_back(m);
+    radius.push_back(r);
+    color.push_back(c);
+    id.push_back(bodyId);
+    return bodyId;
+}
+
+void BodyStore::addBodyWithId(BodyId bodyId, double px, double py, double pvx, double pvy, double m, double r,
+                              uint32_t c) {
+    if (bodyId >= indexById.size()) {
+        indexById.resize(static_cast<size_t>(bodyId) + 1, invalidIndex);
+    } else if (indexById[bodyId] != invalidIndex) {
+        throw std::runtime_error("Body id " + std::to_string(bodyId) + " is already in use");
+    }
+    indexById[bodyId] = static_cast<uint32_t>(x.size());
+
+    x.push_back(px);
+    y.push_back(py);
+    vx.push_back(pvx);
+    vy.push_back(pvy);
+    ax.push_back(0.0);
+    ay.push_back(0.0);
+    mass.push_back(m);
+    radius.push_back(r);
+    color.push_back(c);
+    id.push_back(bodyId);
+}
+
+void BodyStore::removeBodies(const BodyId* bodyIds, size_t count) {
+    ArenaScope scratch;
+    uint8_t* removed = scratch.allocateFilled<uint8_t>(size(), 0);
+    size_t removedCount = 0;
+    for (size_t k = 0; k < count; k++) {
+        uint32_t index = indexOf(bodyIds[k]);
+        if (index != invalidIndex && !removed[index]) {
+            removed[index] = 1;
+            indexById[bodyIds[k]] = invalidIndex;
+            removedCount++;
+        }
+    }
+    if (removedCount == 0) {
+        return;
+    }
+
+    compact(x, removed);
+    compact(y, removed);
+    compact(vx, removed);
+    compact(vy, removed);
+    compact(ax, removed);
+    compact(ay, removed);
+    compact(mass, removed);
+    compact(radius, removed);
+    compact(color, removed);
+    compact(id, removed);
+
+    // Survivors after the first removed slot moved down; refresh their indices
+    for (size_t i = 0; i < id.size(); i++) {
+        indexById[id[i]] = static_cast<uint32_t>(i);
+    }
+}
+
+void BodyStore::removeBody(BodyId bodyId) {
+    removeBodies(&bodyId, 1);
+}
+
+template <typename T>
+void BodyStore::compact(std::vector<T>& values, const uint8_t* removed) {
+    size_t write = 0;
+    for (size_t read = 0; read < values.size(); read++) {
+        if (!removed[read]) {
+            values[write++] = values[read];
+        }
+    }
+    values.resize(write);
+}
+
+void BodyStore::reorder(const std::vector<uint32_t>& order) {
+    permute(x, order);
+    permute(y, order);
+    permute(vx, order);
+    permute(vy, order);
+    permute(ax, order);
+    permute(ay, order);
+    permute(mass, order);
+    permute(radius, order);
+    permute(color, order);
+    permute(id, order);
+
+    for (size_t i = 0; i < id.size(); i++) {
+        indexById[id[i]] = static_cast<uint32_t>(i);
+    }
+}
+
+template <typename T>
+void BodyStore::permute(std::vector<T>& values, const std::vector<uint32_t>& order) {
+    ArenaScope scratch;
+    T* original = scratch.allocate<T>(values.size());
+    std::copy(values.begin(), values.end(), original);
+    for (size_t i = 0; i < order.size(); i++) {
+        values[i] = original[order[i]];
+    }
+}
+
+void BodyStore::reserve(size_t count) {
+    x.reserve(count);
+    y.reserve(count);
+    vx.reserve(count);
+    vy.reserve(count);
+    ax.reserve(count);
+    ay.reserve(count);
+    mass.reserve(count);
+    radius.reserve(count);
+    color.reserve(count);
+    id.reserve(count);
+}
+
+void BodyStore::clear() {
+    x.clear();
+    y.clear();
+    vx.clear();
+    vy.clear();
+    ax.clear();
+    ay.clear();
+    mass.clear();
+    radius.clear();
+    color.clear();
+    id.clear();
+    indexById.clear();
+}
+
+uint32_t BodyStore::indexOf(BodyId bodyId) const {
+    return bodyId < indexById.size() ? indexById[bodyId] : invalidIndex;
+}
+
+uint32_t BodyStore::packColor(float r, float g, float b) {
+    auto channel = [](float value) {
+        return static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+    };
+    return (channel(r) << 24) | (channel(g) << 16) | (channel(b) << 8);
+}
+
+void BodyStore::unpackColor(uint32_t packed, float& r, float& g, float& b) {
+    r = ((packed >> 24) & 0xff) / 255.0f;
+    g = ((packed >> 16) & 0xff) / 255.0f;
+    b = ((packed >> 8) & 0xff) / 255.0f;
+}
@@ -0,0 +1,67 @@
+#ifndef BODY_STORE_H
+#define BODY_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Structure-of-arrays storage for the massive bodies of a simulation.
+//
+// Each attribute lives in its own contiguous array so the force and reduction
+// kernels stream through exactly the data they need. Every body also gets a
+// stable id at insertion; indices may change as the store is reorganized, so
+// code outside the physics kernels should hold on to ids, not indices.
+class BodyStore {
+public:
+    using BodyId = uint32_t;
+    static constexpr uint32_t invalidIndex = UINT32_MAX;
+
+    // Positions, velocities and accelerations in simulation units
+    std::vector<double> x, y;
+    std::vector<double> vx, vy;
+    std::vector<double> ax, ay;
+    std::vector<double> mass;
+    std::vector<double> radius;
+    std::vector<uint32_t> color;  // Packed 0xRRGGBB00, see packColor
+    std::vector<BodyId> id;       // Id of the body stored at each index
+
+    BodyId addBody(double x, double y, double vx, double vy, double mass, double radius, uint32_t color);
+
+    // Adds a body under an id chosen elsewhere, for stores that mirror the
+    // ids of another store (decoded snapshots). Throws if the id is in use;
+    // ids skipped over stay unused.
+    void addBodyWithId(BodyId bodyId, double x, double y, double vx, double vy, double mass, double radius,
+                       uint32_t color);
+
+    // Removes bodies by id. The remaining bodies keep their relative order and
+    // their ids; only their indices shift. Unknown or already removed ids are ignored.
+    void removeBodies(const BodyId* bodyIds, size_t count);
+    void removeBodies(const std::vector<BodyId>& bodyIds) { removeBodies(bodyIds.data(), bodyIds.size()); }
+    void removeBody(BodyId bodyId);
+
+    // Rearranges the bodies so that the body at old index order[i] moves to
+    // index i; `order` must be a permutation of [0, size()). Ids are kept.
+    void reorder(const std::vector<uint32_t>& order);
+    void reserve(size_t count);
+    void clear();
+
+    size_t size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+
+    // Current index of a body, or invalidIndex once it has been removed
+    uint32_t indexOf(BodyId bodyId) const;
+    bool contains(BodyId bodyId) const { return indexOf(bodyId) != invalidIndex; }
+
+    static uint32_t packColor(float r, float g, float b);
+    static void unpackColor(uint32_t color, float& r, float& g, float& b);
+
+private:
+    template <typename T>
+    static void compact(std::vector<T>& values, const uint8_t* removed);
+    template <typename T>
+    static void permute(std::vector<T>& values, const std::vector<uint32_t>& order);
+
+    std::vector<uint32_t> indexById;  // Indexed by id; never shrinks so ids are never reused
+};
+
+#endif // BODY_STORE_H
@@ -0,0 +1,326 @@
+#include "CollisionSystem.h"
+#include "Arena.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int maxCellsPerAxis = 4;       // Larger boxes go on the oversized list
+const size_t boxGrain = 16384;
+const size_t bucketGrain = 1024;
+
+uint32_t hashCell(int64_t cx, int64_t cy) {
+    uint64_t h = static_cast<uint64_t>(cx) * 0x9E3779B97F4A7C15ull ^ static_cast<uint64_t>(cy) * 0xC2B2AE3D27D4EB4Full;
+    h ^= h >> 29;
+    return static_cast<uint32_t>(h);
+}
+
+uint32_t nextPowerOfTwo(size_t value) {
+    uint32_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+} // namespace
+
+CollisionSystem::CollisionSystem()
+    : enabled(true), cellSize(1.0), bucketMask(0), candidateCount(0), mergedTotal(0) {}
+
+size_t CollisionSystem::detect(const BodyStore& store, double dt) {
+    contacts.clear();
+    candidateCount = 0;
+    if (!enabled || store.size() < 2) {
+        return 0;
+    }
+
+    PROFILE_SCOPE("physics.collisions");
+    computeBoxes(store, dt);
+    if (cellSize <= 0.0) {
+        return 0;  // Point masses never touch
+    }
+    buildGrid();
+    findContacts(store, dt);
+    return contacts.size();
+}
+
+void CollisionSystem::computeBoxes(const BodyStore& store, double dt) {
+    const size_t n = store.size();
+    boxes.resize(n);
+
+    const double* x = store.x.data();
+    const double* y = store.y.data();
+    const double* vx = store.vx.data();
+    const double* vy = store.vy.data();
+    const double* r = store.radius.data();
+    Box* out = boxes.data();
+
+    // Box around the sphere at the start (x - v dt) and the end (x) of the step
+    ThreadPool& pool = ThreadPool::instance();
+    ArenaScope scratch;
+    double* extentSums = scratch.allocateFilled(pool.threadCount(), 0.0);
+    pool.parallelFor(n, boxGrain, [&](size_t begin, size_t end, unsigned thread) {
+        double sum = 0.0;
+        for (size_t i = begin; i < end; i++) {
+            double x0 = x[i] - vx[i] * dt;
+            double y0 = y[i] - vy[i] * dt;
+            Box& box = out[i];
+            box.minX = std::min(x0, x[i]) - r[i];
+            box.maxX = std::max(x0, x[i]) + r[i];
+            box.minY = std::min(y0, y[i]) - r[i];
+            box.maxY = std::max(y0, y[i]) + r[i];
+            sum += std::max(box.maxX - box.minX, box.maxY - box.minY);
+        }
+        extentSums[thread] += sum;
+    });
+
+    double totalExtent = 0.0;
+    for (unsigned t = 0; t < pool.threadCount(); t++) {
+        totalExtent += extentSums[t];
+    }
+    // Cells twice the mean box size keep the typical body in at most four cells
+    cellSize = 2.0 * totalExtent / n;
+}
+
+void CollisionSystem::buildGrid() {
+    const size_t n = boxes.size();
+    const double invCell = 1.0 / cellSize;
+
+    entries.clear();
+    oversized.clear();
+    for (size_t i = 0; i < n; i++) {
+        const Box& box = boxes[i];
+        int64_t x0 = static_cast<int64_t>(std::floor(box.minX * invCell));
+        int64_t x1 = static_cast<int64_t>(std::floor(box.maxX * invCell));
+        int64_t y0 = static_cast<int64_t>(std::floor(box.minY * invCell));
+        int64_t y1 = static_cast<int64_t>(std::floor(box.maxY * invCell));
+        if (x1 - x0 >= maxCellsPerAxis || y1 - y0 >= maxCellsPerAxis) {
+            oversized.push_back(static_cast<uint32_t>(i));
+            continue;
+        }
+        for (int64_t cy = y0; cy <= y1; cy++) {
+            for (int64_t cx = x0; cx <= x1; cx++) {
+                entries.push_back(CellEntry{cx, cy, static_cast<uint32_t>(i)});
+            }
+        }
+    }
+
+    // Counting sort of the entries by hash bucket
+    uint32_t bucketCount = nextPowerOfTwo(std::max<size_t>(2 * entries.size(), 16));
+    bucketMask = bucketCount - 1;
+    bucketStart.assign(bucketCount + 1, 0);
+    entryBucket.resize(entries.size());
+    for (size_t e = 0; e < entries.size(); e++) {
+        uint32_t bucket = hashCell(entries[e].cellX, entries[e].cellY) & bucketMask;
+        entryBucket[e] = bucket;
+        bucketStart[bucket + 1]++;
+    }
+    for (uint32_t b = 0; b < bucketCount; b++) {
+        bucketStart[b + 1] += bucketStart[b];
+    }
+    sortedEntries.resize(entries.size());
+    for (size_t e = 0; e < entries.size(); e++) {
+        sortedEntries[bucketStart[entryBucket[e]]++] = entries[e];
+    }
+    // The scatter advanced each start to the next bucket's start; shift back
+    for (uint32_t b = bucketCount; b > 0; b--) {
+        bucketStart[b] = bucketStart[b - 1];
+    }
+    bucketStart[0] = 0;
+}
+
+void CollisionSystem::findContacts(const BodyStore& store, double dt) {
+    ThreadPool& pool = ThreadPool::instance();
+    threadContacts.resize(pool.threadCount());
+    for (auto& list : threadContacts) {
+        list.clear();
+    }
+    ArenaScope scratch;
+    size_t* threadCandidates = scratch.allocateFilled<size_t>(pool.threadCount(), 0);
+    const double invCell = 1.0 / cellSize;
+
+    auto overlap = [this](uint32_t i, uint32_t j) {
+        const Box& a = boxes[i];
+        const Box& b = boxes[j];
+        return a.minX <= b.maxX && b.minX <= a.maxX && a.minY <= b.maxY && b.minY <= a.maxY;
+    };
+
+    // Pairs sharing a cell. A pair that shares several cells is only reported
+    // by the cell holding the lower corner of the two boxes' intersection.
+    uint32_t bucketCount = bucketMask + 1;
+    pool.parallelFor(bucketCount, bucketGrain, [&](size_t begin, size_t end, unsigned thread) {
+        auto& found = threadContacts[thread];
+        size_t candidates = 0;
+        for (size_t b = begin; b < end; b++) {
+            for (uint32_t p = bucketStart[b]; p < bucketStart[b + 1]; p++) {
+                const CellEntry& first = sortedEntries[p];
+                for (uint32_t q = p + 1; q < bucketStart[b + 1]; q++) {
+                    const CellEntry& second = sortedEntries[q];
+                    if (first.cellX != second.cellX || first.cellY != second.cellY) {
+                        continue;  // Different cells that happen to share a bucket
+                    }
+                    uint32_t i = first.body, j = second.body;
+                    if (!overlap(i, j)) {
+                        continue;
+                    }
+                    double cornerX = std::max(boxes[i].minX, boxes[j].minX);
+                    double cornerY = std::max(boxes[i].minY, boxes[j].minY);
+                    if (static_cast<int64_t>(std::floor(cornerX * invCell)) != first.cellX ||
+                        static_cast<int64_t>(std::floor(cornerY * invCell)) != first.cellY) {
+                        continue;
+                    }
+                    candidates++;
+                    if (sweptSpheresTouch(store, i, j, dt)) {
+                        found.emplace_back(std::min(i, j), std::max(i, j));
+                    }
+                }
+            }
+        }
+        threadCandidates[thread] += candidates;
+    });
+
+    // Oversized bodies against everything (each unordered pair once)
+    if (!oversized.empty()) {
+        uint8_t* isOversized = scratch.allocateFilled<uint8_t>(boxes.size(), 0);
+        for (uint32_t big : oversized) {
+            isOversized[big] = 1;
+        }
+        pool.parallelFor(boxes.size(), boxGrain, [&](size_t begin, size_t end, unsigned thread) {
+            auto& found = threadContacts[thread];
+            size_t candidates = 0;
+            for (size_t k = begin; k < end; k++) {
+                uint32_t j = static_cast<uint32_t>(k);
+                for (uint32_t big : oversized) {
+                    if (j == big || (isOversized[j] && j < big) || !overlap(big, j)) {
+                        continue;
+                    }
+                    candidates++;
+                    if (sweptSpheresTouch(store, big, j, dt)) {
+                        found.emplace_back(std::min(big, j), std::max(big, j));
+                    }
+                }
+            }
+            threadCandidates[thread] += candidates;
+        });
+    }
+
+    for (size_t t = 0; t < threadContacts.size(); t++) {
+        contacts.insert(contacts.end(), threadContacts[t].begin(), threadContacts[t].end());
+        candidateCount += threadCandidates[t];
+    }
+    // Thread scheduling decides the gather order; sort so merges are reproducible
+    std::sort(contacts.begin(), contacts.end());
+}
+
+bool CollisionSystem::sweptSpheresTouch(const BodyStore& store, uint32_t i, uint32_t j, double dt) const {
+    // Relative motion over the step: p(t) = p0 + v t for t in [0, dt]
+    double vx = store.vx[j] - store.vx[i];
+    double vy = store.vy[j] - store.vy[i];
+    double px = (store.x[j] - store.x[i]) - vx * dt;
+    double py = (store.y[j] - store.y[i]) - vy * dt;
+    double reach = store.radius[i] + store.radius[j];
+
+    double c = px * px + py * py - reach * reach;
+    if (c <= 0.0) {
+        return true;  // Already touching at the start of the step
+    }
+    double a = vx * vx + vy * vy;
+    double b = 2.0 * (px * vx + py * vy);
+    if (a <= 0.0 || b >= 0.0) {
+        return false;  // Not approaching
+    }
+    double discriminant = b * b - 4.0 * a * c;
+    if (discriminant < 0.0) {
+        return false;
+    }
+    double tContact = (-b - std::sqrt(discriminant)) / (2.0 * a);
+    return tContact <= dt;
+}
+
+uint32_t CollisionSystem::findRoot(uint32_t i) {
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+size_t CollisionSystem::merge(BodyStore& store) {
+    if (contacts.empty()) {
+        return 0;
+    }
+    PROFILE_SCOPE("physics.collisions");
+
+    // Group touching bodies; chains (A touches B touches C) become one group
+    const size_t n = store.size();
+    parent.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        parent[i] = static_cast<uint32_t>(i);
+    }
+    ArenaScope scratch;
+    ArenaVector<uint32_t> members(scratch.arena);
+    for (const auto& contact : contacts) {
+        uint32_t a = findRoot(contact.first);
+        uint32_t b = findRoot(contact.second);
+        if (a != b) {
+            parent[std::max(a, b)] = std::min(a, b);
+        }
+        members.push_back(contact.first);
+        members.push_back(contact.second);
+    }
+    std::sort(members.begin(), members.end());
+    members.erase(std::unique(members.begin(), members.end()), members.end());
+    std::sort(members.begin(), members.end(), [this](uint32_t a, uint32_t b) {
+        uint32_t ra = findRoot(a), rb = findRoot(b);
+        return ra != rb ? ra < rb : a < b;
+    });
+
+    ArenaVector<BodyStore::BodyId> absorbed(scratch.arena);
+    for (size_t start = 0; start < members.size();) {
+        uint32_t root = findRoot(members[start]);
+        size_t end = start;
+        while (end < members.size() && findRoot(members[end]) == root) {
+            end++;
+        }
+
+        // Most massive member survives and keeps its id and color
+        uint32_t survivor = members[start];
+        double totalMass = 0.0, momentumX = 0.0, momentumY = 0.0, weightedX = 0.0, weightedY = 0.0, volume = 0.0;
+        for (size_t k = start; k < end; k++) {
+            uint32_t i = members[k];
+            double m = store.mass[i];
+            totalMass += m;
+            momentumX += m * store.vx[i];
+            momentumY += m * store.vy[i];
+            weightedX += m * store.x[i];
+            weightedY += m * store.y[i];
+            volume += store.radius[i] * store.radius[i] * store.radius[i];
+            if (m > store.mass[survivor]) {
+                survivor = i;
+            }
+        }
+        if (totalMass > 0.0) {
+            store.x[survivor] = weightedX / totalMass;
+            store.y[survivor] = weightedY / totalMass;
+            store.vx[survivor] = momentumX / totalMass;
+            store.vy[survivor] = momentumY / totalMass;
+        }
+        store.mass[survivor] = totalMass;
+        store.radius[survivor] = std::cbrt(volume);  // Merged body keeps the combined volume
+
+        for (size_t k = start; k < end; k++) {
+            if (members[k] != survivor) {
+                absorbed.push_back(store.id[members[k]]);
+            }
+        }
+        start = end;
+    }
+
+    store.removeBodies(absorbed.data(), absorbed.size());
+    contacts.clear();
+    mergedTotal += absorbed.size();
+    return absorbed.size();
+}
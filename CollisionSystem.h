@@ -0,0 +1,71 @@
+#ifndef COLLISION_SYSTEM_H
+#define COLLISION_SYSTEM_H
+
+#include "BodyStore.h"
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Finds bodies whose spheres touch during a step and merges them.
+//
+// Broadphase: every body's swept bounding box (start to end of the step,
+// padded by its radius) is inserted into the cells of a uniform grid that it
+// overlaps. Cells are addressed through a hash table that is rebuilt each step
+// with a counting sort, so the cost is O(N) regardless of how spread out the
+// bodies are. Bodies much larger than a cell go on a short list that is tested
+// against everything instead of being inserted into many cells.
+//
+// Narrowphase: candidate pairs are tested as spheres moving linearly over the
+// step. Touching pairs are grouped with union-find and each group merges
+// inelastically into its most massive member, conserving mass and momentum.
+class CollisionSystem {
+public:
+    CollisionSystem();
+
+    bool enabled;
+
+    // Detects contacts over a step of length dt that has just been drifted, so
+    // positions are at the end of the step. Returns the number of contacts.
+    size_t detect(const BodyStore& store, double dt);
+
+    // Merges the groups found by the last detect() and removes the absorbed
+    // bodies from the store. Returns the number of bodies removed.
+    size_t merge(BodyStore& store);
+
+    size_t candidatePairs() const { return candidateCount; }
+    size_t contactCount() const { return contacts.size(); }
+    unsigned long long totalMerged() const { return mergedTotal; }
+
+private:
+    struct Box {
+        double minX, minY, maxX, maxY;
+    };
+    struct CellEntry {
+        int64_t cellX, cellY;
+        uint32_t body;
+    };
+
+    void computeBoxes(const BodyStore& store, double dt);
+    void buildGrid();
+    void findContacts(const BodyStore& store, double dt);
+    bool sweptSpheresTouch(const BodyStore& store, uint32_t i, uint32_t j, double dt) const;
+    uint32_t findRoot(uint32_t i);
+
+    std::vector<Box> boxes;
+    std::vector<uint32_t> oversized;     // Bodies tested against all others
+    std::vector<CellEntry> entries;      // One per (body, overlapped cell)
+    std::vector<CellEntry> sortedEntries;
+    std::vector<uint32_t> bucketStart;   // Counting sort offsets, size buckets + 1
+    std::vector<uint32_t> entryBucket;
+    double cellSize;
+    uint32_t bucketMask;
+
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> threadContacts;
+    std::vector<std::pair<uint32_t, uint32_t>> contacts;  // Store indices
+    std::vector<uint32_t> parent;                         // Union-find over store indices
+    size_t candidateCount;
+    unsigned long long mergedTotal;
+};
+
+#endif // COLLISION_SYSTEM_H
@@ -0,0 +1,32 @@
+#ifndef COMPENSATED_SUM_H
+#define COMPENSATED_SUM_H
+
+#include <cmath>
+
+// Running sum that carries the rounding error of every addition along
+// (Neumaier's variant of Kahan summation), so adding many terms of mixed
+// magnitude loses no more than a couple of ulps of the result. It still
+// depends on the order of the terms; callers that need reproducible sums
+// must feed them in a fixed order.
+class CompensatedSum {
+public:
+    CompensatedSum() : sum(0.0), compensation(0.0) {}
+
+    void add(double value) {
+        double total = sum + value;
+        if (std::fabs(sum) >= std::fabs(value)) {
+            compensation += (sum - total) + value;
+        } else {
+            compensation += (value - total) + sum;
+        }
+        sum = total;
+    }
+
+    double value() const { return sum + compensation; }
+
+private:
+    double sum;
+    double compensation;
+};
+
+#endif // COMPENSATED_SUM_H
@@ -0,0 +1,191 @@
+#include "ConservationMonitor.h"
+#include "Arena.h"
+#include "CompensatedSum.h"
+#include "PhysicsEngine.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const size_t reductionGrain = 8192;
+const size_t potentialGrain = 64;
+const int lanes = 4;  // Independent accumulators so the reductions vectorize
+
+// Partial sums of one thread or chunk, padded to a cache line to avoid false sharing
+struct alignas(64) PartialSums {
+    double kinetic = 0.0;
+    double momentumX = 0.0, momentumY = 0.0;
+    double momentumScale = 0.0;
+    double angularMomentum = 0.0;
+    double angularMomentumScale = 0.0;
+    double potential = 0.0;
+};
+
+// Fast passes keep one partial per thread. Deterministic ones keep one per
+// fixed chunk of bodies, so every partial covers the same bodies and they
+// are combined in the same order whatever the thread count.
+size_t partialCount(bool deterministic, size_t count, size_t grain) {
+    return deterministic ? ThreadPool::chunkCount(count, grain) : ThreadPool::instance().threadCount();
+}
+
+template <typename Body>
+void forEachPartial(bool deterministic, size_t count, size_t grain, const Body& body) {
+    ThreadPool& pool = ThreadPool::instance();
+    if (deterministic) {
+        pool.parallelForChunks(count, grain, [&](size_t chunk, size_t begin, size_t end) { body(begin, end, chunk); });
+    } else {
+        pool.parallelFor(count, grain, [&](size_t begin, size_t end, unsigned thread) { body(begin, end, thread); });
+    }
+}
+
+} // namespace
+
+ConservationMonitor::ConservationMonitor(unsigned interval) : interval(std::max(1u, interval)) {}
+
+ConservationSample ConservationMonitor::measure(PhysicsEngine& engine) const {
+    const BodyStore& store = engine.bodies();
+    const size_t n = store.size();
+    const double* x = store.x.data();
+    const double* y = store.y.data();
+    const double* vx = store.vx.data();
+    const double* vy = store.vy.data();
+    const double* m = store.mass.data();
+
+    const bool deterministic = engine.settings.deterministic;
+    ArenaScope scratch;
+    const size_t motionCount = partialCount(deterministic, n, reductionGrain);
+    const size_t potentialCount = partialCount(deterministic, n, potentialGrain);
+    PartialSums* motion = scratch.allocateFilled(motionCount, PartialSums{});
+    PartialSums* potential = scratch.allocateFilled(potentialCount, PartialSums{});
+
+    // Kinetic energy, linear and angular momentum in one pass
+    forEachPartial(deterministic, n, reductionGrain, [&](size_t begin, size_t end, size_t slot) {
+        double kin[lanes] = {}, px[lanes] = {}, py[lanes] = {}, pScale[lanes] = {}, lz[lanes] = {}, lScale[lanes] = {};
+        size_t i = begin;
+        for (; i + lanes <= end; i += lanes) {
+            for (int k = 0; k < lanes; k++) {
+                size_t j = i + k;
+                double v2 = vx[j] * vx[j] + vy[j] * vy[j];
+                double speed = std::sqrt(v2);
+                kin[k] += m[j] * v2;
+                px[k] += m[j] * vx[j];
+                py[k] += m[j] * vy[j];
+                pScale[k] += m[j] * speed;
+                lz[k] += m[j] * (x[j] * vy[j] - y[j] * vx[j]);
+                lScale[k] += m[j] * speed * std::sqrt(x[j] * x[j] + y[j] * y[j]);
+            }
+        }
+        for (; i < end; i++) {
+            double v2 = vx[i] * vx[i] + vy[i] * vy[i];
+            double speed = std::sqrt(v2);
+            kin[0] += m[i] * v2;
+            px[0] += m[i] * vx[i];
+            py[0] += m[i] * vy[i];
+            pScale[0] += m[i] * speed;
+            lz[0] += m[i] * (x[i] * vy[i] - y[i] * vx[i]);
+            lScale[0] += m[i] * speed * std::sqrt(x[i] * x[i] + y[i] * y[i]);
+        }
+        PartialSums& out = motion[slot];
+        for (int k = 0; k < lanes; k++) {
+            out.kinetic += 0.5 * kin[k];
+            out.momentumX += px[k];
+            out.momentumY += py[k];
+            out.momentumScale += pScale[k];
+            out.angularMomentum += lz[k];
+            out.angularMomentumScale += lScale[k];
+        }
+    });
+
+    // Potential energy W = 1/2 sum_i m_i phi_i
+    const double G = engine.settings.gravitationalConstant;
+    const double eps2 = engine.settings.softening * engine.settings.softening;
+    // The exact sum is quadratic; large systems are measured on the tree
+    // whatever their force method
+    if (engine.usesTree() || n > engine.settings.treeThreshold) {
+        engine.ensureTree();
+        const BarnesHutTree& tree = engine.tree();
+        const double theta = engine.settings.theta;
+        forEachPartial(deterministic, n, potentialGrain, [&](size_t begin, size_t end, size_t slot) {
+            double sum = 0.0;
+            for (size_t i = begin; i < end; i++) {
+                sum += m[i] * tree.potentialAt(i, theta, eps2);
+            }
+            potential[slot].potential += 0.5 * G * sum;
+        });
+    } else {
+        forEachPartial(deterministic, n, potentialGrain, [&](size_t begin, size_t end, size_t slot) {
+            double sum = 0.0;
+            for (size_t i = begin; i < end; i++) {
+                double phi = 0.0;
+                for (size_t j = i + 1; j < n; j++) {
+                    double dx = x[j] - x[i];
+                    double dy = y[j] - y[i];
+                    double r2 = dx * dx + dy * dy + eps2;
+                    phi -= r2 > 0.0 ? m[j] / std::sqrt(r2) : 0.0;
+                }
+                sum += m[i] * phi;
+            }
+            potential[slot].potential += G * sum;
+        });
+    }
+
+    // Compensated, so thousands of chunk partials add up no worse than a few threads' worth
+    CompensatedSum kinetic, momentumX, momentumY, momentumScale, angularMomentum, angularMomentumScale, potentialSum;
+    for (size_t p = 0; p < motionCount; p++) {
+        const PartialSums& partial = motion[p];
+        kinetic.add(partial.kinetic);
+        momentumX.add(partial.momentumX);
+        momentumY.add(partial.momentumY);
+        momentumScale.add(partial.momentumScale);
+        angularMomentum.add(partial.angularMomentum);
+        angularMomentumScale.add(partial.angularMomentumScale);
+    }
+    for (size_t p = 0; p < potentialCount; p++) {
+        potentialSum.add(potential[p].potential);
+    }
+    ConservationSample sample;
+    sample.kinetic = kinetic.value();
+    sample.momentumX = momentumX.value();
+    sample.momentumY = momentumY.value();
+    sample.momentumScale = momentumScale.value();
+    sample.angularMomentum = angularMomentum.value();
+    sample.angularMomentumScale = angularMomentumScale.value();
+    sample.potential = potentialSum.value();
+    sample.energy = sample.kinetic + sample.potential;
+    sample.virialRatio = sample.potential != 0.0 ? 2.0 * sample.kinetic / std::fabs(sample.potential) : 0.0;
+    sample.time = engine.time();
+    return sample;
+}
+
+void ConservationMonitor::setReference(const ConservationSample& sample) {
+    referenceSample = sample;
+    latestSample = sample;
+}
+
+void ConservationMonitor::rebase(const ConservationSample& before, const ConservationSample& after) {
+    referenceSample.kinetic += after.kinetic - before.kinetic;
+    referenceSample.potential += after.potential - before.potential;
+    referenceSample.energy += after.energy - before.energy;
+    referenceSample.momentumX += after.momentumX - before.momentumX;
+    referenceSample.momentumY += after.momentumY - before.momentumY;
+    referenceSample.angularMomentum += after.angularMomentum - before.angularMomentum;
+}
+
+double ConservationMonitor::momentumDrift() const {
+    double dx = latestSample.momentumX - referenceSample.momentumX;
+    double dy = latestSample.momentumY - referenceSample.momentumY;
+    double scale = std::max(referenceSample.momentumScale, latestSample.momentumScale);
+    return scale > 0.0 ? std::sqrt(dx * dx + dy * dy) / scale : 0.0;
+}
+
+double ConservationMonitor::relativeEnergyChange(const ConservationSample& from, const ConservationSample& to) {
+    double scale = std::fabs(from.energy);
+    return scale > 0.0 ? std::fabs(to.energy - from.energy) / scale : 0.0;
+}
+
+double ConservationMonitor::relativeAngularMomentumChange(const ConservationSample& from, const ConservationSample& to) {
+    // Normalized by sum m|r||v| rather than |L|, which vanishes for systems without net spin
+    double scale = std::max(from.angularMomentumScale, to.angularMomentumScale);
+    return scale > 0.0 ? std::fabs(to.angularMomentum - from.angularMomentum) / scale : 0.0;
+}
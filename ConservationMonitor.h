@@ -0,0 +1,54 @@
+#ifndef CONSERVATION_MONITOR_H
+#define CONSERVATION_MONITOR_H
+
+class PhysicsEngine;
+
+// Conserved quantities of the whole system at one instant
+struct ConservationSample {
+    double time = 0.0;
+    double kinetic = 0.0;
+    double potential = 0.0;
+    double energy = 0.0;
+    double momentumX = 0.0, momentumY = 0.0;
+    double momentumScale = 0.0;  // Sum of m|v|, used to normalize momentum drift
+    double angularMomentum = 0.0;
+    double angularMomentumScale = 0.0;  // Sum of m|r||v|, used to normalize angular momentum drift
+    double virialRatio = 0.0;    // 2K/|W|, 1 for a relaxed system
+};
+
+// Periodically measures energy, linear and angular momentum and the virial
+// ratio. The kinetic and momentum sums are single parallel passes over the
+// body arrays; the potential is the exact pair sum for small systems and the
+// Barnes-Hut estimate for large ones.
+class ConservationMonitor {
+public:
+    explicit ConservationMonitor(unsigned interval = 16);
+
+    unsigned interval;  // Steps between measurements
+
+    ConservationSample measure(PhysicsEngine& engine) const;
+
+    void setReference(const ConservationSample& sample);
+
+    // Shifts the reference by a change the integrator did not cause (bodies
+    // merging inelastically), so drift keeps measuring integration error only.
+    void rebase(const ConservationSample& before, const ConservationSample& after);
+    void record(const ConservationSample& sample) { latestSample = sample; }
+
+    const ConservationSample& reference() const { return referenceSample; }
+    const ConservationSample& latest() const { return latestSample; }
+
+    // Drifts of the latest sample relative to the reference
+    double energyDrift() const { return relativeEnergyChange(referenceSample, latestSample); }
+    double momentumDrift() const;
+    double angularMomentumDrift() const { return relativeAngularMomentumChange(referenceSample, latestSample); }
+
+    static double relativeEnergyChange(const ConservationSample& from, const ConservationSample& to);
+    static double relativeAngularMomentumChange(const ConservationSample& from, const ConservationSample& to);
+
+private:
+    ConservationSample referenceSample;
+    ConservationSample latestSample;
+};
+
+#endif // CONSERVATION_MONITOR_H
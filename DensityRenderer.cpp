@@ -0,0 +1,135 @@
+#include "DensityRenderer.h"
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+
+DensityRenderer::DensityRenderer()
+    : splatRadius(4.0f), softening(1.0f), saturation(1000.0f), splatVAO(0), instanceVBO(0), instanceCapacity(0),
+      screenVAO(0), framebuffer(0), densityTexture(0), targetWidth(0), targetHeight(0) {
+    initializeBuffers();
+}
+
+DensityRenderer::~DensityRenderer() {
+    cleanup();
+}
+
+void DensityRenderer::initializeBuffers() {
+    // Splats read the same packed instance list as BodyRenderer, one point
+    // per instance; the mesh scale is not used
+    glGenVertexArrays(1, &splatVAO);
+    glBindVertexArray(splatVAO);
+    glGenBuffers(1, &instanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glVertexAttribPointer(0, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(BodyInstance), (void*)offsetof(BodyInstance, x));
+    glEnableVertexAttribArray(0);
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_BYTE, sizeof(BodyInstance), (void*)offsetof(BodyInstance, palette));
+    glEnableVertexAttribArray(1);
+
+    // A core profile still needs a vertex array bound to draw without attributes
+    glGenVertexArrays(1, &screenVAO);
+
+    glGenFramebuffers(1, &framebuffer);
+    glGenTextures(1, &densityTexture);
+    glBindTexture(GL_TEXTURE_2D, densityTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void DensityRenderer::resizeTarget(int width, int height) {
+    if (width == targetWidth && height == targetHeight) {
+        return;
+    }
+    // 32-bit floats so the faint tails of the kernels still register in dense cores
+    glBindTexture(GL_TEXTURE_2D, densityTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, densityTexture, 0);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        throw std::runtime_error("Density framebuffer is incomplete");
+    }
+    targetWidth = width;
+    targetHeight = height;
+    std::cout << "Density target resized to " << width << "x" << height << std::endl;
+}
+
+void DensityRenderer::draw(const Shader& splatShader, const Shader& toneMapShader, InstanceStream& stream, int width,
+                           int height) {
+    const std::vector<BodyInstance>& instances = stream.instances();
+    if (width <= 0 || height <= 0) {
+        return;  // Minimized
+    }
+    resizeTarget(width, height);
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    if (instances.size() > instanceCapacity) {
+        // Grow geometrically so a slowly growing visible set does not change the size every frame
+        instanceCapacity = instances.size() + instances.size() / 2;
+    }
+    // Orphan the old storage so the driver does not wait for the previous frame's draw
+    glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(BodyInstance), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(BodyInstance), instances.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Accumulate: plain additive blending into the cleared float target
+    const GLfloat empty[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glClearBufferfv(GL_COLOR, 0, empty);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    glBlendFunc(GL_ONE, GL_ONE);
+    if (!instances.empty()) {
+        splatShader.use();
+        splatShader.setFloat("pointSize", 2.0f * splatRadius);
+        stream.bind(splatShader);
+        glBindVertexArray(splatVAO);
+        glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(instances.size()));
+    }
+    glDisable(GL_PROGRAM_POINT_SIZE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Resolve: tone-map every pixel over the scene drawn so far
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    toneMapShader.use();
+    toneMapShader.setFloat("softening", softening);
+    toneMapShader.setFloat("saturation", saturation);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, densityTexture);
+    glBindVertexArray(screenVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void DensityRenderer::cleanup() {
+    if (splatVAO != 0) {
+        glDeleteVertexArrays(1, &splatVAO);
+        splatVAO = 0;
+    }
+    if (instanceVBO != 0) {
+        glDeleteBuffers(1, &instanceVBO);
+        instanceVBO = 0;
+    }
+    if (screenVAO != 0) {
+        glDeleteVertexArrays(1, &screenVAO);
+        screenVAO = 0;
+    }
+    if (framebuffer != 0) {
+        glDeleteFramebuffers(1, &framebuffer);
+        framebuffer = 0;
+    }
+    if (densityTexture != 0) {
+        glDeleteTextures(1, &densityTexture);
+        densityTexture = 0;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef DENSITY_RENDERER_H
+#define DENSITY_RENDERER_H
+
+#include "BodyRenderer.h"
+#include "Shader.h"
+#include <glad/glad.h>
+#include <vector>
+
+// Draws bodies and test particles as a continuous density field instead of
+// spheres, for systems too large for individual spheres to mean anything.
+//
+// Every instance becomes one point sprite with a Gaussian profile, added into
+// an offscreen floating-point target the size of the framebuffer: RGB
+// accumulates weight * color and A the weight alone, so a lone particle peaks
+// at 1. A second pass maps the accumulated density through an asinh curve,
+// linear in faint regions and logarithmic in dense cores, and blends it over
+// whatever is already on screen. Both passes are single draw calls without
+// per-body state; the cost follows the number of visible instances and the
+// pixels their sprites cover.
+class DensityRenderer {
+public:
+    DensityRenderer();
+    ~DensityRenderer();
+
+    DensityRenderer(const DensityRenderer&) = delete;
+    DensityRenderer& operator=(const DensityRenderer&) = delete;
+
+    float splatRadius;  // Kernel radius in framebuffer pixels
+    float softening;    // Density where the transfer curve turns from linear to logarithmic
+    float saturation;   // Density drawn at full brightness
+
+    // Splats the stream's instances with `splatShader` and tone-maps the
+    // result onto the bound framebuffer, which must be width x height, with
+    // `toneMapShader`. Throws std::runtime_error when the offscreen target
+    // cannot be created.
+    void draw(const Shader& splatShader, const Shader& toneMapShader, InstanceStream& stream, int width, int height);
+
+private:
+    void initializeBuffers();
+    void resizeTarget(int width, int height);  // Reallocates the density texture on a size change
+    void cleanup();
+
+    GLuint splatVAO, instanceVBO;
+    size_t instanceCapacity;  // Instances the instance buffer can hold without reallocating
+    GLuint screenVAO;         // Empty; the tone-mapping triangle is generated from gl_VertexID
+    GLuint framebuffer, densityTexture;
+    int targetWidth, targetHeight;
+};
+
+#endif // DENSITY_RENDERER_H
@@ -0,0 +1,704 @@
+#include "DistributedEngine.h"
+#include "BarnesHutTree.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+enum Command : uint32_t {
+    CommandStep = 1,
+    CommandSetCuts = 2,
+    CommandGather = 3,
+    CommandShutdown = 4
+};
+
+struct BodyRecord {
+    uint32_t id;
+    uint32_t color;
+    double x, y, vx, vy, ax, ay, mass, radius;
+};
+
+struct MassPoint {
+    double x, y, mass;
+};
+
+struct DomainBox {
+    uint32_t occupied;
+    double minX, minY, maxX, maxY;
+};
+
+template <typename T>
+void append(std::vector<char>& bytes, const T& value) {
+    const char* raw = reinterpret_cast<const char*>(&value);
+    bytes.insert(bytes.end(), raw, raw + sizeof(T));
+}
+
+template <typename T>
+void appendArray(std::vector<char>& bytes, const std::vector<T>& values) {
+    append(bytes, static_cast<uint64_t>(values.size()));
+    const char* raw = reinterpret_cast<const char*>(values.data());
+    bytes.insert(bytes.end(), raw, raw + values.size() * sizeof(T));
+}
+
+class MessageReader {
+public:
+    explicit MessageReader(const std::vector<char>& message) : bytes(message), offset(0) {}
+
+    template <typename T>
+    T read() {
+        if (offset + sizeof(T) > bytes.size()) {
+            throw std::runtime_error("Truncated domain message");
+        }
+        T value;
+        std::memcpy(&value, bytes.data() + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+
+    template <typename T>
+    void readArray(std::vector<T>& values) {
+        uint64_t count = read<uint64_t>();
+        if (offset + count * sizeof(T) > bytes.size()) {
+            throw std::runtime_error("Truncated domain message");
+        }
+        values.resize(static_cast<size_t>(count));
+        std::memcpy(values.data(), bytes.data() + offset, count * sizeof(T));
+        offset += count * sizeof(T);
+    }
+
+private:
+    const std::vector<char>& bytes;
+    size_t offset;
+};
+
+// Length-prefixed message over one ring, blocking
+void sendMessage(SharedMemoryRing& ring, const std::vector<char>& message) {
+    uint64_t length = message.size();
+    ring.write(&length, sizeof(length));
+    ring.write(message.data(), message.size());
+}
+
+// All-to-all exchange of one message per peer. Sends and receives are
+// interleaved without blocking, so large messages in both directions cannot
+// deadlock on full rings.
+void exchangeMessages(std::vector<SharedMemoryRing>& rings, unsigned workers, unsigned rank,
+                      const std::vector<std::vector<char>>& outgoing, std::vector<std::vector<char>>& incoming) {
+    struct Transfer {
+        uint64_t length = 0;
+        size_t headerBytes = 0;
+        size_t payloadBytes = 0;
+    };
+    std::vector<Transfer> sends(workers), receives(workers);
+    incoming.assign(workers, std::vector<char>());
+    unsigned pending = 2 * (workers - 1);
+    for (unsigned peer = 0; peer < workers; peer++) {
+        sends[peer].length = outgoing[peer].size();
+    }
+
+    PollBackoff backoff;
+    while (pending > 0) {
+        bool progressed = false;
+        for (unsigned peer = 0; peer < workers; peer++) {
+            if (peer == rank) {
+                continue;
+            }
+
+            Transfer& send = sends[peer];
+            SharedMemoryRing& out = rings[rank * workers + peer];
+            if (send.headerBytes < sizeof(uint64_t)) {
+                size_t written = out.tryWrite(reinterpret_cast<const char*>(&send.length) + send.headerBytes,
+                                              sizeof(uint64_t) - send.headerBytes);
+                send.headerBytes += written;
+                progressed |= written > 0;
+                if (send.headerBytes == sizeof(uint64_t) && send.length == 0) {
+                    pending--;
+                }
+            } else if (send.payloadBytes < send.length) {
+                size_t written = out.tryWrite(outgoing[peer].data() + send.payloadBytes, send.length - send.payloadBytes);
+                send.payloadBytes += written;
+                progressed |= written > 0;
+                if (send.payloadBytes == send.length) {
+                    pending--;
+                }
+            }
+
+            Transfer& receive = receives[peer];
+            SharedMemoryRing& in = rings[peer * workers + rank];
+            if (receive.headerBytes < sizeof(uint64_t)) {
+                size_t read = in.tryRead(reinterpret_cast<char*>(&receive.length) + receive.headerBytes,
+                                         sizeof(uint64_t) - receive.headerBytes);
+                receive.headerBytes += read;
+                progressed |= read > 0;
+                if (receive.headerBytes == sizeof(uint64_t)) {
+                    incoming[peer].resize(static_cast<size_t>(receive.length));
+                    if (receive.length == 0) {
+                        pending--;
+                    }
+                }
+            } else if (receive.payloadBytes < receive.length) {
+                size_t read = in.tryRead(incoming[peer].data() + receive.payloadBytes, receive.length - receive.payloadBytes);
+                receive.payloadBytes += read;
+                progressed |= read > 0;
+                if (receive.payloadBytes == receive.length) {
+                    pending--;
+                }
+            }
+        }
+        if (progressed) {
+            backoff.reset();
+        } else {
+            backoff.wait();
+        }
+    }
+}
+
+// Squared distance from a point to an axis-aligned box (0 inside)
+double distanceToBox2(double px, double py, const DomainBox& box) {
+    double dx = std::max(0.0, std::max(box.minX - px, px - box.maxX));
+    double dy = std::max(0.0, std::max(box.minY - py, py - box.maxY));
+    return dx * dx + dy * dy;
+}
+
+// One worker process: owns the bodies of a single domain
+class DomainWorker {
+public:
+    DomainWorker(unsigned rank, unsigned workers, const DistributedEngine::Settings& settings,
+                 std::vector<SharedMemoryRing>& peerRings, SharedMemoryRing& commands, SharedMemoryRing& replies,
+                 const DomainDecomposition& decomposition, const std::vector<BodyRecord>& initialBodies)
+        : rank(rank), workers(workers), settings(settings), peerRings(peerRings), commands(commands), replies(replies),
+          decomposition(decomposition), bodies(initialBodies), pool(threadCount(settings, workers)), outgoing(workers),
+          forceSeconds(0.0), migratedOut(0), importedCount(0), parentId(getppid()) {}
+
+    void run() {
+        computeForces();
+        std::vector<char> message;
+        while (true) {
+            receiveCommand(message);
+            MessageReader reader(message);
+            uint32_t command = reader.read<uint32_t>();
+            std::vector<char> reply;
+            if (command == CommandStep) {
+                uint32_t count = reader.read<uint32_t>();
+                double dt = reader.read<double>();
+                for (uint32_t s = 0; s < count; s++) {
+                    step(dt);
+                }
+                append(reply, static_cast<uint64_t>(bodies.size()));
+                append(reply, static_cast<uint64_t>(importedCount));
+                append(reply, static_cast<uint64_t>(migratedOut));
+                append(reply, forceSeconds);
+                forceSeconds = 0.0;
+                migratedOut = 0;
+            } else if (command == CommandSetCuts) {
+                std::vector<DomainDecomposition::Cut> cuts;
+                reader.readArray(cuts);
+                decomposition.setCuts(cuts, workers);
+                append(reply, uint32_t(1));
+            } else if (command == CommandGather) {
+                appendArray(reply, bodies);
+            } else {
+                return;
+            }
+            sendMessage(replies, reply);
+        }
+    }
+
+private:
+    static unsigned threadCount(const DistributedEngine::Settings& settings, unsigned workers) {
+        if (settings.threadsPerWorker > 0) {
+            return settings.threadsPerWorker;
+        }
+        return std::max(1u, std::thread::hardware_concurrency() / workers);
+    }
+
+    void receiveCommand(std::vector<char>& message) {
+        uint64_t length = 0;
+        size_t received = 0;
+        PollBackoff backoff;
+        while (received < sizeof(length)) {
+            size_t read = commands.tryRead(reinterpret_cast<char*>(&length) + received, sizeof(length) - received);
+            received += read;
+            if (read == 0) {
+                if (getppid() != parentId) {
+                    _exit(1);  // Coordinator is gone
+                }
+                backoff.wait();
+            } else {
+                backoff.reset();
+            }
+        }
+        message.resize(static_cast<size_t>(length));
+        commands.read(message.data(), message.size());
+    }
+
+    void step(double dt) {
+        kick(0.5 * dt);
+        drift(dt);
+        migrate();
+        computeForces();
+        kick(0.5 * dt);
+    }
+
+    void kick(double dt) {
+        for (BodyRecord& body : bodies) {
+            body.vx += body.ax * dt;
+            body.vy += body.ay * dt;
+        }
+    }
+
+    void drift(double dt) {
+        for (BodyRecord& body : bodies) {
+            body.x += body.vx * dt;
+            body.y += body.vy * dt;
+        }
+    }
+
+    // Hands bodies that left this domain to their new owners
+    void migrate() {
+        std::vector<std::vector<BodyRecord>> leaving(workers);
+        size_t kept = 0;
+        for (size_t i = 0; i < bodies.size(); i++) {
+            unsigned owner = decomposition.domainOf(bodies[i].x, bodies[i].y);
+            if (owner == rank) {
+                bodies[kept++] = bodies[i];
+            } else {
+                leaving[owner].push_back(bodies[i]);
+            }
+        }
+        migratedOut += bodies.size() - kept;
+        bodies.resize(kept);
+
+        for (unsigned peer = 0; peer < workers; peer++) {
+            outgoing[peer].clear();
+            appendArray(outgoing[peer], leaving[peer]);
+        }
+        exchangeMessages(peerRings, workers, rank, outgoing, incoming);
+        std::vector<BodyRecord> arrived;
+        for (unsigned peer = 0; peer < workers; peer++) {
+            if (peer == rank) {
+                continue;
+            }
+            MessageReader reader(incoming[peer]);
+            reader.readArray(arrived);
+            bodies.insert(bodies.end(), arrived.begin(), arrived.end());
+        }
+    }
+
+    void computeForces() {
+        // Share bounding boxes so each side knows how much of its tree the other needs
+        auto start = std::chrono::steady_clock::now();
+        DomainBox ownBox = {0, 0.0, 0.0, 0.0, 0.0};
+        size_t count = bodies.size();
+        localX.resize(count);
+        localY.resize(count);
+        localMass.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            localX[i] = bodies[i].x;
+            localY[i] = bodies[i].y;
+            localMass[i] = bodies[i].mass;
+        }
+        if (count > 0) {
+            ownBox.occupied = 1;
+            ownBox.minX = ownBox.maxX = localX[0];
+            ownBox.minY = ownBox.maxY = localY[0];
+            for (size_t i = 1; i < count; i++) {
+                ownBox.minX = std::min(ownBox.minX, localX[i]);
+                ownBox.maxX = std::max(ownBox.maxX, localX[i]);
+                ownBox.minY = std::min(ownBox.minY, localY[i]);
+                ownBox.maxY = std::max(ownBox.maxY, localY[i]);
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (unsigned peer = 0; peer < workers; peer++) {
+            outgoing[peer].clear();
+            append(outgoing[peer], ownBox);
+        }
+        exchangeMessages(peerRings, workers, rank, outgoing, incoming);
+        std::vector<DomainBox> peerBoxes(workers);
+        for (unsigned peer = 0; peer < workers; peer++) {
+            if (peer != rank) {
+                peerBoxes[peer] = MessageReader(incoming[peer]).read<DomainBox>();
+            }
+        }
+
+        // Export the locally essential tree to every occupied peer
+        start = std::chrono::steady_clock::now();
+        localTree.build(localX.data(), localY.data(), localMass.data(), count);
+        std::vector<MassPoint> exported;
+        for (unsigned peer = 0; peer < workers; peer++) {
+            outgoing[peer].clear();
+            exported.clear();
+            if (peer != rank && peerBoxes[peer].occupied) {
+                exportEssential(peerBoxes[peer], exported);
+            }
+            appendArray(outgoing[peer], exported);
+        }
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        exchangeMessages(peerRings, workers, rank, outgoing, incoming);
+
+        // Local bodies first, imported particles after them
+        start = std::chrono::steady_clock::now();
+        std::vector<MassPoint> imported;
+        for (unsigned peer = 0; peer < workers; peer++) {
+            if (peer == rank) {
+                continue;
+            }
+            MessageReader(incoming[peer]).readArray(imported);
+            for (const MassPoint& point : imported) {
+                localX.push_back(point.x);
+                localY.push_back(point.y);
+                localMass.push_back(point.mass);
+            }
+        }
+        importedCount = localX.size() - count;
+        forceTree.build(localX.data(), localY.data(), localMass.data(), localX.size());
+
+        double g = settings.gravitationalConstant;
+        double theta = settings.theta;
+        double softening2 = settings.softening * settings.softening;
+        pool.parallelFor(count, 64, [&](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++) {
+                double ax, ay;
+                forceTree.accelerationAt(i, theta, softening2, ax, ay);
+                bodies[i].ax = g * ax;
+                bodies[i].ay = g * ay;
+            }
+        });
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        forceSeconds += seconds;
+    }
+
+    // Cells far enough from `box` go out as one monopole, the rest as bodies
+    void exportEssential(const DomainBox& box, std::vector<MassPoint>& exported) const {
+        const std::vector<BarnesHutTree::Node>& nodes = localTree.nodes();
+        const std::vector<uint32_t>& order = localTree.sortedIndices();
+        if (nodes.empty()) {
+            return;
+        }
+        double theta2 = settings.theta * settings.theta;
+        std::vector<uint32_t> stack(1, 0);
+        while (!stack.empty()) {
+            const BarnesHutTree::Node& node = nodes[stack.back()];
+            stack.pop_back();
+            if (node.mass == 0.0) {
+                continue;
+            }
+            double size = 2.0 * node.halfSize;
+            double dist2 = distanceToBox2(node.comX, node.comY, box);
+            if (size * size < theta2 * dist2) {
+                exported.push_back({node.comX, node.comY, node.mass});
+            } else if (node.firstChild < 0) {
+                for (uint32_t k = node.begin; k < node.begin + node.count; k++) {
+                    uint32_t i = order[k];
+                    exported.push_back({localX[i], localY[i], localMass[i]});
+                }
+            } else {
+                for (int q = 0; q < 4; q++) {
+                    stack.push_back(node.firstChild + q);
+                }
+            }
+        }
+    }
+
+    unsigned rank;
+    unsigned workers;
+    DistributedEngine::Settings settings;
+    std::vector<SharedMemoryRing>& peerRings;
+    SharedMemoryRing& commands;
+    SharedMemoryRing& replies;
+    DomainDecomposition decomposition;
+    std::vector<BodyRecord> bodies;
+    ThreadPool pool;
+
+    std::vector<double> localX, localY, localMass;
+    BarnesHutTree localTree;  // Local bodies only, for exporting
+    BarnesHutTree forceTree;  // Local plus imported particles
+    std::vector<std::vector<char>> outgoing;
+    std::vector<std::vector<char>> incoming;
+
+    double forceSeconds;
+    size_t migratedOut;
+    size_t importedCount;
+    pid_t parentId;
+};
+
+} // namespace
+
+DistributedEngine::DistributedEngine()
+    : metrics(nullptr), workerCount(0), stepsSinceRebalance(0), rebalances(0), simulationTime(0.0), steps(0) {}
+
+DistributedEngine::~DistributedEngine() {
+    try {
+        stop();
+    } catch (const std::exception& e) {
+        std::cerr << "Error stopping domain workers: " << e.what() << std::endl;
+        killWorkers();
+    }
+}
+
+void DistributedEngine::start(const BodyStore& initial) {
+    if (running()) {
+        throw std::runtime_error("Distributed engine is already running");
+    }
+    workerCount = std::max(1u, settings.workers);
+    simulationTime = 0.0;
+    steps = 0;
+    stepsSinceRebalance = 0;
+    rebalances = 0;
+    stats.assign(workerCount, DomainStats());
+    accumulatedSeconds.assign(workerCount, 0.0);
+
+    decomposition.build(initial.x.data(), initial.y.data(), nullptr, initial.size(), workerCount);
+    std::vector<std::vector<BodyRecord>> partitions(workerCount);
+    for (size_t i = 0; i < initial.size(); i++) {
+        BodyRecord record = {initial.id[i], initial.color[i], initial.x[i], initial.y[i], initial.vx[i], initial.vy[i],
+                             0.0, 0.0, initial.mass[i], initial.radius[i]};
+        partitions[decomposition.domainOf(record.x, record.y)].push_back(record);
+    }
+
+    // Rings are mapped before forking so every worker inherits them; the
+    // names are removed right away so nothing is left behind on a crash
+    std::string prefix = "/gravity-" + std::to_string(getpid()) + "-";
+    unsigned ringIndex = 0;
+    peerRings.clear();
+    commandRings.clear();
+    replyRings.clear();
+    for (unsigned i = 0; i < workerCount * workerCount; i++) {
+        peerRings.push_back(SharedMemoryRing::create(prefix + std::to_string(ringIndex++), settings.ringCapacity));
+        peerRings.back().unlink();
+    }
+    for (unsigned i = 0; i < workerCount; i++) {
+        commandRings.push_back(SharedMemoryRing::create(prefix + std::to_string(ringIndex++), 1 << 16));
+        commandRings.back().unlink();
+        replyRings.push_back(SharedMemoryRing::create(prefix + std::to_string(ringIndex++), settings.ringCapacity));
+        replyRings.back().unlink();
+    }
+
+    std::cout << "Starting " << workerCount << " domain workers for " << initial.size() << " bodies" << std::endl;
+    std::cout.flush();
+    for (unsigned rank = 0; rank < workerCount; rank++) {
+        pid_t child = fork();
+        if (child < 0) {
+            killWorkers();
+            throw std::runtime_error(std::string("fork failed: ") + std::strerror(errno));
+        }
+        if (child == 0) {
+            int status = 0;
+            try {
+                DomainWorker worker(rank, workerCount, settings, peerRings, commandRings[rank], replyRings[rank],
+                                    decomposition, partitions[rank]);
+                worker.run();
+            } catch (const std::exception& e) {
+                std::cerr << "Domain worker " << rank << " failed: " << e.what() << std::endl;
+                status = 1;
+            }
+            _exit(status);  // Skip the parent's atexit handlers and destructors
+        }
+        workerIds.push_back(child);
+    }
+}
+
+void DistributedEngine::step(unsigned count, double dt) {
+    if (!running()) {
+        throw std::runtime_error("Distributed engine is not running");
+    }
+    while (count > 0) {
+        unsigned batch = std::min(count, std::max(1u, settings.rebalanceInterval - stepsSinceRebalance));
+        runSteps(batch, dt);
+        count -= batch;
+        if (stepsSinceRebalance >= settings.rebalanceInterval) {
+            double slowest = 0.0, total = 0.0;
+            for (double seconds : accumulatedSeconds) {
+                slowest = std::max(slowest, seconds);
+                total += seconds;
+            }
+            double mean = total / workerCount;
+            if (workerCount > 1 && mean > 0.0 && slowest > settings.imbalanceTolerance * mean) {
+                rebalance();
+            }
+            accumulatedSeconds.assign(workerCount, 0.0);
+            stepsSinceRebalance = 0;
+        }
+    }
+}
+
+void DistributedEngine::runSteps(unsigned count, double dt) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<char> command;
+    append(command, uint32_t(CommandStep));
+    append(command, uint32_t(count));
+    append(command, dt);
+    for (unsigned rank = 0; rank < workerCount; rank++) {
+        sendCommand(rank, command);
+    }
+    std::vector<char> reply;
+    for (unsigned rank = 0; rank < workerCount; rank++) {
+        receiveReply(rank, reply);
+        MessageReader reader(reply);
+        DomainStats& domain = stats[rank];
+        domain.bodies = static_cast<size_t>(reader.read<uint64_t>());
+        domain.importedParticles = static_cast<size_t>(reader.read<uint64_t>());
+        domain.migratedOut = static_cast<size_t>(reader.read<uint64_t>());
+        domain.forceSeconds = reader.read<double>();
+        accumulatedSeconds[rank] += domain.forceSeconds;
+    }
+    simulationTime += count * dt;
+    steps += count;
+    stepsSinceRebalance += count;
+
+    if (metrics) {
+        // Domains work in parallel: the slowest one is the batch's force time
+        size_t bodies = 0;
+        double slowest = 0.0;
+        for (const DomainStats& domain : stats) {
+            bodies += domain.bodies;
+            slowest = std::max(slowest, domain.forceSeconds);
+        }
+        size_t queued = 0;
+        for (const std::vector<SharedMemoryRing>* rings : {&peerRings, &commandRings, &replyRings}) {
+            for (const SharedMemoryRing& ring : *rings) {
+                queued += ring.readable();
+            }
+        }
+        metrics->recordSteps(count, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        metrics->addPhaseTime(EngineMetrics::Forces, slowest);
+        metrics->setBodies(bodies, 0);
+        metrics->setSimulationTime(simulationTime);
+        metrics->setQueuedBytes(queued);
+    }
+}
+
+// Recomputes the cuts with every body weighted by its domain's measured cost
+void DistributedEngine::rebalance() {
+    std::vector<double> x, y, weight;
+    std::vector<char> command;
+    append(command, uint32_t(CommandGather));
+    for (unsigned rank = 0; rank < workerCount; rank++) {
+        sendCommand(rank, command);
+    }
+    std::vector<char> reply;
+    std::vector<BodyRecord> records;
+    for (unsigned rank = 0; rank < workerCount; rank++) {
+        receiveReply(rank, reply);
+        MessageReader(reply).readArray(records);
+        double costPerBody = records.empty() ? 0.0 : accumulatedSeconds[rank] / records.size();
+        for (const BodyRecord& record : records) {
+            x.push_back(record.x);
+            y.push_back(record.y);
+            weight.push_back(costPerBody);
+        }
+    }
+    decomposition.build(x.data(), y.data(), weight.data(), x.size(), workerCount);
+
+    // Bodies move to their new owners during the next step's migration
+    command.clear();
+    append(command, uint32_t(CommandSetCuts));
+    appendArray(command, decomposition.cuts());
+    for (unsigned rank = 0; rank < workerCount; rank++) {
+        sendCommand(rank, command);
+    }
+    for (unsigned rank = 0; rank < workerCount; rank++) {
+        receiveReply(rank, reply);
+    }
+    rebalances++;
+}
+
+void DistributedEngine::gather(BodyStore& out) {
+    if (!running()) {
+        throw std::runtime_error("Distributed engine is not running");
+    }
+    std::vector<char> command;
+    append(command, uint32_t(CommandGather));
+    for (unsigned rank = 0; rank < workerCount; rank++) {
+        sendCommand(rank, command);
+    }
+    std::vector<BodyRecord> all, records;
+    std::vector<char> reply;
+    for (unsigned rank = 0; rank < workerCount; rank++) {
+        receiveReply(rank, reply);
+        MessageReader(reply).readArray(records);
+        all.insert(all.end(), records.begin(), records.end());
+    }
+    std::sort(all.begin(), all.end(), [](const BodyRecord& a, const BodyRecord& b) { return a.id < b.id; });
+
+    out.clear();
+    out.reserve(all.size());
+    for (const BodyRecord& record : all) {
+        out.addBody(record.x, record.y, record.vx, record.vy, record.mass, record.radius, record.color);
+        out.ax.back() = record.ax;
+        out.ay.back() = record.ay;
+    }
+}
+
+void DistributedEngine::stop() {
+    if (!running()) {
+        return;
+    }
+    std::vector<char> command;
+    append(command, uint32_t(CommandShutdown));
+    for (unsigned rank = 0; rank < workerCount; rank++) {
+        sendCommand(rank, command);
+    }
+    for (pid_t worker : workerIds) {
+        waitpid(worker, nullptr, 0);
+    }
+    workerIds.clear();
+    peerRings.clear();
+    commandRings.clear();
+    replyRings.clear();
+}
+
+void DistributedEngine::sendCommand(unsigned worker, const std::vector<char>& message) {
+    sendMessage(commandRings[worker], message);
+}
+
+void DistributedEngine::receiveReply(unsigned worker, std::vector<char>& message) {
+    SharedMemoryRing& ring = replyRings[worker];
+    uint64_t length = 0;
+    size_t received = 0;
+    PollBackoff backoff;
+    unsigned idlePolls = 0;
+    while (received < sizeof(length)) {
+        size_t read = ring.tryRead(reinterpret_cast<char*>(&length) + received, sizeof(length) - received);
+        received += read;
+        if (read > 0) {
+            backoff.reset();
+            continue;
+        }
+        // A worker that died would otherwise leave us waiting forever
+        if (++idlePolls % 1024 == 0) {
+            checkWorkers();
+        }
+        backoff.wait();
+    }
+    message.resize(static_cast<size_t>(length));
+    ring.read(message.data(), message.size());
+}
+
+void DistributedEngine::checkWorkers() {
+    for (pid_t worker : workerIds) {
+        int status = 0;
+        if (waitpid(worker, &status, WNOHANG) == worker) {
+            killWorkers();
+            throw std::runtime_error("Domain worker " + std::to_string(worker) + " exited unexpectedly");
+        }
+    }
+}
+
+void DistributedEngine::killWorkers() {
+    for (pid_t worker : workerIds) {
+        kill(worker, SIGKILL);
+        waitpid(worker, nullptr, 0);
+    }
+    workerIds.clear();
+}
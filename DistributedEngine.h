@@ -0,0 +1,93 @@
+#ifndef DISTRIBUTED_ENGINE_H
+#define DISTRIBUTED_ENGINE_H
+
+#include "BodyStore.h"
+#include "DomainDecomposition.h"
+#include "Metrics.h"
+#include "SharedMemoryRing.h"
+#include <cstdint>
+#include <sys/types.h>
+#include <vector>
+
+// Runs one N-body simulation across several worker processes on one machine.
+//
+// The plane is split into domains by orthogonal recursive bisection and each
+// forked worker owns the bodies of one domain. Workers talk through POSIX
+// shared-memory rings: after every drift they hand bodies that left their
+// domain to the new owner, swap bounding boxes, and send each peer the
+// "locally essential" part of their Barnes-Hut tree - single monopoles for
+// cells that are far from the peer's box, exact bodies for cells close to it.
+// Forces are then evaluated on a tree over local plus imported particles.
+// The coordinator (the calling process) only issues commands, collects
+// per-domain force timings, and moves the cuts when the slowest domain gets
+// too far ahead of the mean.
+//
+// Steps are fixed-size kick-drift-kick; collisions and the adaptive timestep
+// of PhysicsEngine are not available here.
+class DistributedEngine {
+public:
+    struct Settings {
+        unsigned workers = 2;
+        double gravitationalConstant = 1.0;
+        double softening = 0.0;
+        double theta = 0.5;
+        unsigned rebalanceInterval = 32;   // Steps between load-balance checks
+        double imbalanceTolerance = 1.15;  // Rebalance when slowest/mean force time exceeds this
+        unsigned threadsPerWorker = 0;     // 0 = hardware threads / workers
+        size_t ringCapacity = 1 << 20;     // Bytes per ring
+    };
+
+    struct DomainStats {
+        size_t bodies = 0;
+        size_t importedParticles = 0;  // Bodies and cell monopoles received from peers
+        size_t migratedOut = 0;        // Bodies handed to other domains since the last report
+        double forceSeconds = 0.0;     // Local work time since the last report
+    };
+
+    DistributedEngine();
+    ~DistributedEngine();
+
+    DistributedEngine(const DistributedEngine&) = delete;
+    DistributedEngine& operator=(const DistributedEngine&) = delete;
+
+    Settings settings;
+    EngineMetrics* metrics;  // Live counters to publish into after every batch, or null
+
+    // Decomposes `initial`, forks the workers and computes initial forces
+    void start(const BodyStore& initial);
+    void step(unsigned count, double dt);
+    void stop();
+
+    // Collects every body into `out`, in id order of the initial store
+    void gather(BodyStore& out);
+
+    bool running() const { return !workerIds.empty(); }
+    const std::vector<DomainStats>& domainStats() const { return stats; }
+    unsigned rebalanceCount() const { return rebalances; }
+    double time() const { return simulationTime; }
+    uint64_t stepCount() const { return steps; }
+
+private:
+    void runSteps(unsigned count, double dt);
+    void rebalance();
+    void sendCommand(unsigned worker, const std::vector<char>& message);
+    void receiveReply(unsigned worker, std::vector<char>& message);
+    void checkWorkers();
+    void killWorkers();
+
+    std::vector<SharedMemoryRing> peerRings;     // [from * workers + to]
+    std::vector<SharedMemoryRing> commandRings;  // Coordinator to worker
+    std::vector<SharedMemoryRing> replyRings;    // Worker to coordinator
+    std::vector<pid_t> workerIds;
+    DomainDecomposition decomposition;
+    std::vector<DomainStats> stats;
+    std::vector<double> accumulatedSeconds;      // Per domain since the last rebalance
+
+    unsigned workerCount;
+    unsigned stepsSinceRebalance;
+    unsigned rebalances;
+    double simulationTime;
+    uint64_t steps;
+};
+
+#endif // DISTRIBUTED_ENGINE_H
@@ -0,0 +1,100 @@
+#include "DomainDecomposition.h"
+#include <algorithm>
+
+DomainDecomposition::DomainDecomposition() : domains(1), posX(nullptr), posY(nullptr), weights(nullptr) {
+    cutList.push_back({-1, 0.0, -1, -1, 0});
+}
+
+void DomainDecomposition::build(const double* x, const double* y, const double* weight, size_t count, unsigned domainCount) {
+    posX = x;
+    posY = y;
+    weights = weight;
+    domains = std::max(1u, domainCount);
+    cutList.clear();
+
+    std::vector<uint32_t> order(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = static_cast<uint32_t>(i);
+    }
+    split(order, 0, count, 0, domains);
+}
+
+int32_t DomainDecomposition::split(std::vector<uint32_t>& order, size_t begin, size_t end, unsigned firstDomain, unsigned count) {
+    int32_t cutIndex = static_cast<int32_t>(cutList.size());
+    cutList.push_back({-1, 0.0, -1, -1, static_cast<int32_t>(firstDomain)});
+    if (count == 1) {
+        return cutIndex;
+    }
+
+    // Cut across the longer side of the bounding box
+    int32_t axis = 0;
+    if (end > begin) {
+        double minX = posX[order[begin]], maxX = minX;
+        double minY = posY[order[begin]], maxY = minY;
+        for (size_t k = begin + 1; k < end; k++) {
+            uint32_t i = order[k];
+            minX = std::min(minX, posX[i]);
+            maxX = std::max(maxX, posX[i]);
+            minY = std::min(minY, posY[i]);
+            maxY = std::max(maxY, posY[i]);
+        }
+        axis = (maxY - minY > maxX - minX) ? 1 : 0;
+    }
+    const double* coordinate = axis == 0 ? posX : posY;
+
+    unsigned leftCount = count / 2;
+    double totalWeight = 0.0;
+    for (size_t k = begin; k < end; k++) {
+        totalWeight += weights ? weights[order[k]] : 1.0;
+    }
+    double targetWeight = totalWeight * leftCount / count;
+
+    // Weighted median along the axis
+    std::sort(order.begin() + begin, order.begin() + end,
+              [coordinate](uint32_t a, uint32_t b) { return coordinate[a] < coordinate[b]; });
+    size_t middle = begin;
+    double accumulated = 0.0;
+    while (middle < end && accumulated + (weights ? weights[order[middle]] : 1.0) <= targetWeight) {
+        accumulated += weights ? weights[order[middle]] : 1.0;
+        middle++;
+    }
+    // Bodies on the cut line all go right; advance past ties so the cut is exact
+    double position = 0.0;
+    if (end == begin) {
+        position = 0.0;
+    } else if (middle == end) {
+        position = coordinate[order[end - 1]] + 1.0;
+    } else if (middle == begin) {
+        position = coordinate[order[begin]];
+    } else {
+        position = 0.5 * (coordinate[order[middle - 1]] + coordinate[order[middle]]);
+        while (middle > begin && coordinate[order[middle - 1]] >= position) {
+            middle--;
+        }
+    }
+
+    int32_t left = split(order, begin, middle, firstDomain, leftCount);
+    int32_t right = split(order, middle, end, firstDomain + leftCount, count - leftCount);
+    Cut& cut = cutList[cutIndex];
+    cut.axis = axis;
+    cut.position = position;
+    cut.left = left;
+    cut.right = right;
+    cut.domain = -1;
+    return cutIndex;
+}
+
+unsigned DomainDecomposition::domainOf(double x, double y) const {
+    int32_t index = 0;
+    while (cutList[index].axis >= 0) {
+        const Cut& cut = cutList[index];
+        double coordinate = cut.axis == 0 ? x : y;
+        index = coordinate < cut.position ? cut.left : cut.right;
+    }
+    return static_cast<unsigned>(cutList[index].domain);
+}
+
+void DomainDecomposition::setCuts(const std::vector<Cut>& cuts, unsigned domainCount) {
+    cutList = cuts;
+    domains = domainCount;
+}
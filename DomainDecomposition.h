@@ -0,0 +1,45 @@
+#ifndef DOMAIN_DECOMPOSITION_H
+#define DOMAIN_DECOMPOSITION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Orthogonal recursive bisection of the plane into a fixed number of domains.
+//
+// Each cut splits a set of bodies along the longer extent of its bounding box
+// at the weighted median, so that both halves carry work in proportion to the
+// number of domains assigned to them. Weights are typically the measured force
+// cost per body of the domain the body currently lives in, which moves cuts
+// away from expensive (dense) regions on the next rebalance. The cut tree
+// partitions the whole plane, so every position has exactly one owner.
+class DomainDecomposition {
+public:
+    struct Cut {
+        int32_t axis;      // 0 = x, 1 = y, -1 for a leaf
+        double position;   // Bodies with coordinate < position go left
+        int32_t left, right;
+        int32_t domain;    // Owning domain for leaves
+    };
+
+    DomainDecomposition();
+
+    void build(const double* x, const double* y, const double* weight, size_t count, unsigned domainCount);
+
+    unsigned domainCount() const { return domains; }
+    unsigned domainOf(double x, double y) const;
+
+    const std::vector<Cut>& cuts() const { return cutList; }
+    void setCuts(const std::vector<Cut>& cuts, unsigned domainCount);
+
+private:
+    int32_t split(std::vector<uint32_t>& order, size_t begin, size_t end, unsigned firstDomain, unsigned count);
+
+    std::vector<Cut> cutList;
+    unsigned domains;
+    const double* posX;
+    const double* posY;
+    const double* weights;
+};
+
+#endif // DOMAIN_DECOMPOSITION_H
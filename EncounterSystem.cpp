@@ -0,0 +1,212 @@
+#include "EncounterSystem.h"
+#include "Arena.h"
+#include "KeplerSolver.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const size_t searchGrain = 1024;
+
+int32_t cellCoordinate(double position, double cellSize) {
+    double cell = std::floor(position / cellSize);
+    if (!std::isfinite(cell)) {
+        return 0;
+    }
+    return static_cast<int32_t>(std::clamp(cell, -2147483647.0, 2147483647.0));
+}
+
+uint64_t cellKey(int64_t cx, int64_t cy) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(cx)) << 32) | static_cast<uint32_t>(cy);
+}
+
+} // namespace
+
+EncounterSystem::EncounterSystem()
+    : enabled(true), dynamicalSteps(32.0), releaseFactor(1.5), candidateCount(0), failures(0) {}
+
+bool EncounterSystem::update(const BodyStore& store, double G, double stepScale) {
+    // Swapping keeps both buffers' capacity from step to step
+    previousPairs.swap(encounterPairs);
+    encounterPairs.clear();
+    const std::vector<Pair>& previous = previousPairs;
+    if (enabled && store.size() >= 2 && stepScale > 0.0 && G > 0.0) {
+        PROFILE_SCOPE("physics.encounters");
+        findCandidates(store, G, stepScale, previous);
+
+        // Tightest pairs first; each body joins at most one pair
+        std::sort(candidates.begin(), candidates.end(), [&](const Candidate& a, const Candidate& b) {
+            if (a.score != b.score) {
+                return a.score < b.score;
+            }
+            return a.first != b.first ? store.id[a.first] < store.id[b.first] : store.id[a.second] < store.id[b.second];
+        });
+        paired.assign(store.size(), 0);
+        for (const Candidate& candidate : candidates) {
+            if (paired[candidate.first] || paired[candidate.second]) {
+                continue;
+            }
+            paired[candidate.first] = paired[candidate.second] = 1;
+            BodyStore::BodyId a = store.id[candidate.first];
+            BodyStore::BodyId b = store.id[candidate.second];
+            encounterPairs.push_back({std::min(a, b), std::max(a, b)});
+        }
+        std::sort(encounterPairs.begin(), encounterPairs.end(),
+                  [](const Pair& a, const Pair& b) { return a.first < b.first; });
+    }
+    return encounterPairs != previous;
+}
+
+void EncounterSystem::findCandidates(const BodyStore& store, double G, double dt, const std::vector<Pair>& previous) {
+    const size_t n = store.size();
+    const double* x = store.x.data();
+    const double* y = store.y.data();
+    const double* vx = store.vx.data();
+    const double* vy = store.vy.data();
+    const double* m = store.mass.data();
+
+    // The widest separation that can qualify: the heaviest possible pair at the
+    // threshold, plus how far two bodies can close in on each other in a step
+    double maxMass = 0.0, maxSpeed2 = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        maxMass = std::max(maxMass, m[i]);
+        maxSpeed2 = std::max(maxSpeed2, vx[i] * vx[i] + vy[i] * vy[i]);
+    }
+    const double threshold = dynamicalSteps * dt;
+    const double reach = std::cbrt(G * 2.0 * maxMass * threshold * threshold * releaseFactor * releaseFactor) +
+                         2.0 * std::sqrt(maxSpeed2) * dt;
+    candidates.clear();
+    candidateCount = 0;
+    if (!(reach > 0.0) || !std::isfinite(reach)) {
+        return;
+    }
+
+    cells.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        cells[i] = {cellKey(cellCoordinate(x[i], reach), cellCoordinate(y[i], reach)), static_cast<uint32_t>(i)};
+    }
+    std::sort(cells.begin(), cells.end());
+
+    // Current partner of every body, so existing pairs get the looser release threshold
+    ArenaScope scratch;
+    uint32_t* partner = scratch.allocateFilled(n, BodyStore::invalidIndex);
+    for (const Pair& pair : previous) {
+        uint32_t a = store.indexOf(pair.first), b = store.indexOf(pair.second);
+        if (a != BodyStore::invalidIndex && b != BodyStore::invalidIndex) {
+            partner[std::min(a, b)] = std::max(a, b);
+        }
+    }
+
+    ThreadPool& pool = ThreadPool::instance();
+    threadCandidates.resize(pool.threadCount());
+    for (auto& list : threadCandidates) {
+        list.clear();
+    }
+    size_t* threadTested = scratch.allocateFilled<size_t>(pool.threadCount(), 0);
+    pool.parallelFor(n, searchGrain, [&](size_t begin, size_t end, unsigned thread) {
+        std::vector<Candidate>& found = threadCandidates[thread];
+        size_t tested = 0;
+        for (size_t i = begin; i < end; i++) {
+            int64_t cx = cellCoordinate(x[i], reach);
+            int64_t cy = cellCoordinate(y[i], reach);
+            for (int64_t ox = -1; ox <= 1; ox++) {
+                for (int64_t oy = -1; oy <= 1; oy++) {
+                    uint64_t key = cellKey(cx + ox, cy + oy);
+                    auto it = std::lower_bound(cells.begin(), cells.end(), CellEntry{key, 0});
+                    for (; it != cells.end() && it->cell == key; ++it) {
+                        size_t j = it->body;
+                        if (j <= i) {
+                            continue;
+                        }
+                        tested++;
+                        double pairMass = m[i] + m[j];
+                        if (!(pairMass > 0.0)) {
+                            continue;
+                        }
+
+                        // Closest approach of the straight-line relative motion during the step
+                        double dx = x[j] - x[i], dy = y[j] - y[i];
+                        double dvx = vx[j] - vx[i], dvy = vy[j] - vy[i];
+                        double v2 = dvx * dvx + dvy * dvy;
+                        double t = v2 > 0.0 ? std::clamp(-(dx * dvx + dy * dvy) / v2, 0.0, dt) : 0.0;
+                        double cx2 = dx + dvx * t, cy2 = dy + dvy * t;
+                        double r = std::sqrt(cx2 * cx2 + cy2 * cy2);
+                        double score = std::sqrt(r * r * r / (G * pairMass)) / threshold;
+
+                        bool existing = partner[i] == j;
+                        if (score < (existing ? releaseFactor : 1.0)) {
+                            found.push_back({score, static_cast<uint32_t>(i), static_cast<uint32_t>(j)});
+                        }
+                    }
+                }
+            }
+        }
+        threadTested[thread] += tested;
+    });
+    for (unsigned t = 0; t < pool.threadCount(); t++) {
+        candidates.insert(candidates.end(), threadCandidates[t].begin(), threadCandidates[t].end());
+        candidateCount += threadTested[t];
+    }
+}
+
+void EncounterSystem::removePairForces(BodyStore& store, double G) {
+    encounterPairs.erase(std::remove_if(encounterPairs.begin(), encounterPairs.end(),
+                                        [&](const Pair& pair) { return !store.contains(pair.first) || !store.contains(pair.second); }),
+                         encounterPairs.end());
+
+    for (const Pair& pair : encounterPairs) {
+        uint32_t i = store.indexOf(pair.first), j = store.indexOf(pair.second);
+        double dx = store.x[j] - store.x[i];
+        double dy = store.y[j] - store.y[i];
+        double r2 = dx * dx + dy * dy;
+        if (!(r2 > 0.0)) {
+            continue;
+        }
+        double invR3 = G / (r2 * std::sqrt(r2));
+        store.ax[i] -= store.mass[j] * invR3 * dx;
+        store.ay[i] -= store.mass[j] * invR3 * dy;
+        store.ax[j] += store.mass[i] * invR3 * dx;
+        store.ay[j] += store.mass[i] * invR3 * dy;
+    }
+}
+
+void EncounterSystem::beginDrift(const BodyStore& store, double G, double dt) {
+    endStates.clear();
+    for (const Pair& pair : encounterPairs) {
+        uint32_t i = store.indexOf(pair.first), j = store.indexOf(pair.second);
+        if (i == BodyStore::invalidIndex || j == BodyStore::invalidIndex) {
+            continue;
+        }
+        double mi = store.mass[i], mj = store.mass[j];
+        double total = mi + mj;
+
+        // Center of mass moves uniformly, the relative coordinate follows the Kepler orbit
+        double cmx = (mi * store.x[i] + mj * store.x[j]) / total + (mi * store.vx[i] + mj * store.vx[j]) / total * dt;
+        double cmy = (mi * store.y[i] + mj * store.y[j]) / total + (mi * store.vy[i] + mj * store.vy[j]) / total * dt;
+        double cmvx = (mi * store.vx[i] + mj * store.vx[j]) / total;
+        double cmvy = (mi * store.vy[i] + mj * store.vy[j]) / total;
+        double rx = store.x[j] - store.x[i], ry = store.y[j] - store.y[i];
+        double rvx = store.vx[j] - store.vx[i], rvy = store.vy[j] - store.vy[i];
+        if (!KeplerSolver::drift(G * total, rx, ry, rvx, rvy, dt)) {
+            rx += rvx * dt;
+            ry += rvy * dt;
+            failures++;
+        }
+
+        double wi = mj / total, wj = mi / total;
+        endStates.push_back({i, cmx - wi * rx, cmy - wi * ry, cmvx - wi * rvx, cmvy - wi * rvy});
+        endStates.push_back({j, cmx + wj * rx, cmy + wj * ry, cmvx + wj * rvx, cmvy + wj * rvy});
+    }
+}
+
+void EncounterSystem::endDrift(BodyStore& store) {
+    for (const EndState& state : endStates) {
+        store.x[state.index] = state.x;
+        store.y[state.index] = state.y;
+        store.vx[state.index] = state.vx;
+        store.vy[state.index] = state.vy;
+    }
+    endStates.clear();
+}
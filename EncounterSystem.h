@@ -0,0 +1,94 @@
+#ifndef ENCOUNTER_SYSTEM_H
+#define ENCOUNTER_SYSTEM_H
+
+#include "BodyStore.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Regularizes close encounters so a tight pair does not force a tiny global
+// step on everyone else.
+//
+// Before each step, bodies are binned in a uniform grid and every
+// neighbouring pair is checked: if the two-body dynamical time
+// sqrt(r^3 / G(m1 + m2)), evaluated at the closest approach of their linear
+// motion over a step, is shorter than `dynamicalSteps` steps, the pair is an
+// encounter. Each body joins at most one pair (the tightest).
+//
+// The engine then splits the Hamiltonian differently for those pairs. Their
+// mutual attraction is removed from the kicks, and the drift moves them along
+// their exact two-body orbit (a universal-variable Kepler step of the relative
+// coordinate, with the pair's center of mass moving uniformly) instead of in
+// a straight line. The Kepler step has no singularity and no accuracy limit
+// from the step length, so close approaches and hard binaries cost
+// nothing extra. The rest of the system still acts on the pair through the
+// kicks. For a fixed pair set this is a symplectic Strang splitting.
+//
+// Only unsoftened forces are regularized: a softened pair does not follow a
+// Kepler orbit, and softening already keeps its force finite.
+class EncounterSystem {
+public:
+    struct Pair {
+        BodyStore::BodyId first, second;
+        bool operator==(const Pair& other) const { return first == other.first && second == other.second; }
+    };
+
+    EncounterSystem();
+
+    bool enabled;
+    double dynamicalSteps;  // Pairs whose dynamical time is below this many steps are regularized
+    double releaseFactor;   // Existing pairs are kept until their dynamical time exceeds this much more
+
+    // Picks the pairs from the current state for steps of up to `stepScale`.
+    // Returns true if the set differs from the previous one, in which case the
+    // stored accelerations no longer match the splitting.
+    bool update(const BodyStore& store, double gravitationalConstant, double stepScale);
+    void clear() { encounterPairs.clear(); }
+
+    // Subtracts each pair's mutual attraction from the stored accelerations.
+    // Pairs whose bodies no longer exist (merged) are dropped first.
+    void removePairForces(BodyStore& store, double gravitationalConstant);
+
+    // Two-body drift of every pair: beginDrift computes the end states from
+    // the state before the engine's straight-line drift, endDrift writes them
+    // over the straight-line result.
+    void beginDrift(const BodyStore& store, double gravitationalConstant, double dt);
+    void endDrift(BodyStore& store);
+
+    bool active() const { return !encounterPairs.empty(); }
+    const std::vector<Pair>& pairs() const { return encounterPairs; }
+    void setPairs(const std::vector<Pair>& pairs) { encounterPairs = pairs; }
+    size_t candidatePairs() const { return candidateCount; }
+    unsigned long long keplerFailures() const { return failures; }
+
+private:
+    struct Candidate {
+        double score;  // Dynamical time over the threshold; below 1 (or releaseFactor) qualifies
+        uint32_t first, second;
+    };
+    struct CellEntry {
+        uint64_t cell;
+        uint32_t body;
+        bool operator<(const CellEntry& other) const {
+            return cell != other.cell ? cell < other.cell : body < other.body;
+        }
+    };
+    struct EndState {
+        uint32_t index;
+        double x, y, vx, vy;
+    };
+
+    void findCandidates(const BodyStore& store, double gravitationalConstant, double stepScale, const std::vector<Pair>& previous);
+
+    std::vector<Pair> encounterPairs;  // Sorted by first id
+    std::vector<Pair> previousPairs;   // Last step's pairs, while the new ones are chosen
+    std::vector<CellEntry> cells;
+    std::vector<std::vector<Candidate>> threadCandidates;
+    std::vector<Candidate> candidates;
+    std::vector<uint8_t> paired;
+    std::vector<EndState> endStates;
+    size_t candidateCount;
+    unsigned long long failures;
+};
+
+#endif // ENCOUNTER_SYSTEM_H
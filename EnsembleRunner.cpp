@@ -0,0 +1,325 @@
+#include "EnsembleRunner.h"
+#include "Profiler.h"
+#include "Scenarios.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+const unsigned lanes = EnsembleRunner::lanes;
+
+// `lanes` systems with identical body counts, body-major and lane-minor
+class EnsembleBatch {
+public:
+    EnsembleBatch(const EnsembleSpec& spec, size_t firstMember, size_t memberCount);
+
+    void run(EnsembleMemberSummary* summaries);
+
+private:
+    void perturb(size_t member, unsigned lane);
+    void computeAccelerations();
+    void kick(double dt);
+    void drift(double dt);
+    void measure(double energy[lanes], double angularMomentum[lanes]);
+
+    const EnsembleSpec& spec;
+    size_t bodies;
+    size_t memberCount;
+    std::vector<double> x, y, vx, vy, ax, ay, mass;
+    double minSeparation2[lanes];
+    double maxRadius[lanes];
+};
+
+EnsembleBatch::EnsembleBatch(const EnsembleSpec& ensembleSpec, size_t firstMember, size_t count)
+    : spec(ensembleSpec), bodies(ensembleSpec.base.size()), memberCount(count) {
+    const BodyStore& base = spec.base;
+    size_t size = bodies * lanes;
+    x.resize(size);
+    y.resize(size);
+    vx.resize(size);
+    vy.resize(size);
+    ax.assign(size, 0.0);
+    ay.assign(size, 0.0);
+    mass.resize(size);
+
+    // Unused lanes of the last batch repeat its first member and are not reported
+    for (unsigned lane = 0; lane < lanes; lane++) {
+        for (size_t b = 0; b < bodies; b++) {
+            size_t k = b * lanes + lane;
+            x[k] = base.x[b];
+            y[k] = base.y[b];
+            vx[k] = base.vx[b];
+            vy[k] = base.vy[b];
+            mass[k] = base.mass[b];
+        }
+        perturb(firstMember + std::min<size_t>(lane, memberCount - 1), lane);
+        minSeparation2[lane] = std::numeric_limits<double>::infinity();
+        maxRadius[lane] = 0.0;
+    }
+}
+
+void EnsembleBatch::perturb(size_t member, unsigned lane) {
+    std::seed_seq seeds{spec.seed, static_cast<unsigned>(member), static_cast<unsigned>(member >> 32)};
+    std::mt19937_64 random(seeds);
+    for (const EnsembleSpec::Perturbation& p : spec.perturbations) {
+        std::uniform_real_distribution<double> offset(-p.spread, p.spread);
+        double delta = offset(random);
+        size_t k = static_cast<size_t>(p.body) * lanes + lane;
+        double* field = nullptr;
+        switch (p.field) {
+        case EnsembleSpec::Field::X: field = &x[k]; break;
+        case EnsembleSpec::Field::Y: field = &y[k]; break;
+        case EnsembleSpec::Field::VX: field = &vx[k]; break;
+        case EnsembleSpec::Field::VY: field = &vy[k]; break;
+        case EnsembleSpec::Field::Mass: field = &mass[k]; break;
+        }
+        *field = p.relative ? *field * (1.0 + delta) : *field + delta;
+    }
+}
+
+// Pairwise sum with both halves of each interaction applied at once. Every
+// innermost loop runs over lanes with no dependence between them.
+void EnsembleBatch::computeAccelerations() {
+    const double G = spec.gravitationalConstant;
+    const double eps2 = spec.softening * spec.softening;
+    std::fill(ax.begin(), ax.end(), 0.0);
+    std::fill(ay.begin(), ay.end(), 0.0);
+
+    for (size_t i = 0; i < bodies; i++) {
+        const double* xi = &x[i * lanes];
+        const double* yi = &y[i * lanes];
+        const double* mi = &mass[i * lanes];
+        double* axi = &ax[i * lanes];
+        double* ayi = &ay[i * lanes];
+        for (size_t j = i + 1; j < bodies; j++) {
+            const double* xj = &x[j * lanes];
+            const double* yj = &y[j * lanes];
+            const double* mj = &mass[j * lanes];
+            double* axj = &ax[j * lanes];
+            double* ayj = &ay[j * lanes];
+            for (unsigned l = 0; l < lanes; l++) {
+                double dx = xj[l] - xi[l];
+                double dy = yj[l] - yi[l];
+                double r2 = dx * dx + dy * dy;
+                minSeparation2[l] = std::min(minSeparation2[l], r2);
+                r2 += eps2;
+                double invR3 = G / (r2 * std::sqrt(r2));
+                axi[l] += mj[l] * invR3 * dx;
+                ayi[l] += mj[l] * invR3 * dy;
+                axj[l] -= mi[l] * invR3 * dx;
+                ayj[l] -= mi[l] * invR3 * dy;
+            }
+        }
+    }
+}
+
+void EnsembleBatch::kick(double dt) {
+    for (size_t k = 0; k < vx.size(); k++) {
+        vx[k] += ax[k] * dt;
+        vy[k] += ay[k] * dt;
+    }
+}
+
+void EnsembleBatch::drift(double dt) {
+    for (size_t k = 0; k < x.size(); k++) {
+        x[k] += vx[k] * dt;
+        y[k] += vy[k] * dt;
+    }
+}
+
+void EnsembleBatch::measure(double energy[lanes], double angularMomentum[lanes]) {
+    const double G = spec.gravitationalConstant;
+    const double eps2 = spec.softening * spec.softening;
+    double totalMass[lanes], centerX[lanes], centerY[lanes];
+    for (unsigned l = 0; l < lanes; l++) {
+        energy[l] = angularMomentum[l] = totalMass[l] = centerX[l] = centerY[l] = 0.0;
+    }
+
+    for (size_t i = 0; i < bodies; i++) {
+        for (unsigned l = 0; l < lanes; l++) {
+            size_t k = i * lanes + l;
+            energy[l] += 0.5 * mass[k] * (vx[k] * vx[k] + vy[k] * vy[k]);
+            angularMomentum[l] += mass[k] * (x[k] * vy[k] - y[k] * vx[k]);
+            totalMass[l] += mass[k];
+            centerX[l] += mass[k] * x[k];
+            centerY[l] += mass[k] * y[k];
+        }
+        for (size_t j = i + 1; j < bodies; j++) {
+            for (unsigned l = 0; l < lanes; l++) {
+                size_t a = i * lanes + l, b = j * lanes + l;
+                double dx = x[b] - x[a], dy = y[b] - y[a];
+                energy[l] -= G * mass[a] * mass[b] / std::sqrt(dx * dx + dy * dy + eps2);
+            }
+        }
+    }
+
+    for (unsigned l = 0; l < lanes; l++) {
+        double cx = totalMass[l] > 0.0 ? centerX[l] / totalMass[l] : 0.0;
+        double cy = totalMass[l] > 0.0 ? centerY[l] / totalMass[l] : 0.0;
+        for (size_t i = 0; i < bodies; i++) {
+            size_t k = i * lanes + l;
+            maxRadius[l] = std::max(maxRadius[l], std::hypot(x[k] - cx, y[k] - cy));
+        }
+    }
+}
+
+void EnsembleBatch::run(EnsembleMemberSummary* summaries) {
+    double initialEnergy[lanes], initialAngularMomentum[lanes], energy[lanes], angularMomentum[lanes];
+    double maxEnergyError[lanes] = {};
+    measure(initialEnergy, initialAngularMomentum);
+
+    const double dt = spec.dt;
+    const unsigned interval = std::max(1u, spec.sampleInterval);
+    computeAccelerations();
+    for (unsigned step = 1; step <= spec.steps; step++) {
+        kick(0.5 * dt);
+        drift(dt);
+        computeAccelerations();
+        kick(0.5 * dt);
+        if (step % interval == 0 || step == spec.steps) {
+            measure(energy, angularMomentum);
+            for (unsigned l = 0; l < lanes; l++) {
+                double scale = std::fabs(initialEnergy[l]);
+                double error = scale > 0.0 ? std::fabs(energy[l] - initialEnergy[l]) / scale : 0.0;
+                maxEnergyError[l] = std::max(maxEnergyError[l], error);
+            }
+        }
+    }
+    if (spec.steps == 0) {
+        measure(energy, angularMomentum);
+    }
+
+    for (size_t l = 0; l < memberCount; l++) {
+        EnsembleMemberSummary& summary = summaries[l];
+        double energyScale = std::fabs(initialEnergy[l]);
+        summary.energyError = energyScale > 0.0 ? (energy[l] - initialEnergy[l]) / energyScale : 0.0;
+        summary.maxEnergyError = maxEnergyError[l];
+        double scale = std::fabs(initialAngularMomentum[l]);
+        summary.angularMomentumError = scale > 0.0 ? (angularMomentum[l] - initialAngularMomentum[l]) / scale : 0.0;
+        summary.minSeparation = std::sqrt(minSeparation2[l]);
+        summary.maxRadius = maxRadius[l];
+    }
+}
+
+EnsembleSpec::Field parseField(const std::string& name) {
+    if (name == "x") return EnsembleSpec::Field::X;
+    if (name == "y") return EnsembleSpec::Field::Y;
+    if (name == "vx") return EnsembleSpec::Field::VX;
+    if (name == "vy") return EnsembleSpec::Field::VY;
+    if (name == "mass") return EnsembleSpec::Field::Mass;
+    throw std::runtime_error("Unknown perturbation field " + name);
+}
+
+} // namespace
+
+EnsembleSpec EnsembleSpec::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Failed to open ensemble spec " + path);
+    }
+
+    EnsembleSpec spec;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string directive;
+        if (!(words >> directive)) {
+            continue;
+        }
+
+        bool ok = true;
+        if (directive == "scenario") {
+            std::string name;
+            size_t count = 0;
+            ok = static_cast<bool>(words >> name);
+            words >> count;
+            if (ok && !Scenarios::load(name, count, spec.seed, spec.base)) {
+                throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": unknown scenario " + name);
+            }
+        } else if (directive == "body") {
+            double bx, by, bvx, bvy, bm;
+            ok = static_cast<bool>(words >> bx >> by >> bvx >> bvy >> bm);
+            if (ok) {
+                spec.base.addBody(bx, by, bvx, bvy, bm, 0.0, 0);
+            }
+        } else if (directive == "members") {
+            ok = static_cast<bool>(words >> spec.members);
+        } else if (directive == "steps") {
+            ok = static_cast<bool>(words >> spec.steps);
+        } else if (directive == "dt") {
+            ok = static_cast<bool>(words >> spec.dt);
+        } else if (directive == "softening") {
+            ok = static_cast<bool>(words >> spec.softening);
+        } else if (directive == "seed") {
+            ok = static_cast<bool>(words >> spec.seed);
+        } else if (directive == "sample") {
+            ok = static_cast<bool>(words >> spec.sampleInterval);
+        } else if (directive == "perturb") {
+            Perturbation p;
+            std::string field, mode;
+            ok = static_cast<bool>(words >> p.body >> field >> mode >> p.spread) && (mode == "absolute" || mode == "relative");
+            if (ok) {
+                p.field = parseField(field);
+                p.relative = mode == "relative";
+                spec.perturbations.push_back(p);
+            }
+        } else {
+            throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": unknown directive " + directive);
+        }
+        if (!ok) {
+            throw std::runtime_error(path + ":" + std::to_string(lineNumber) + ": malformed " + directive + " line");
+        }
+    }
+
+    if (spec.base.empty()) {
+        throw std::runtime_error(path + ": no bodies");
+    }
+    for (const Perturbation& p : spec.perturbations) {
+        if (p.body >= spec.base.size()) {
+            throw std::runtime_error(path + ": perturbation of body " + std::to_string(p.body) + " out of range");
+        }
+    }
+    return spec;
+}
+
+EnsembleRunner::EnsembleRunner(const EnsembleSpec& ensembleSpec) : spec(ensembleSpec), elapsed(0.0) {}
+
+void EnsembleRunner::run() {
+    PROFILE_SCOPE("ensemble.run");
+    results.assign(spec.members, EnsembleMemberSummary());
+    size_t batchCount = (spec.members + lanes - 1) / lanes;
+
+    auto start = std::chrono::steady_clock::now();
+    ThreadPool::instance().parallelFor(batchCount, 1, [&](size_t begin, size_t end, unsigned) {
+        for (size_t batch = begin; batch < end; batch++) {
+            size_t first = batch * lanes;
+            EnsembleBatch systems(spec, first, std::min<size_t>(lanes, spec.members - first));
+            systems.run(&results[first]);
+        }
+    });
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double EnsembleRunner::systemStepsPerSecond() const {
+    return elapsed > 0.0 ? static_cast<double>(spec.members) * spec.steps / elapsed : 0.0;
+}
+
+void EnsembleRunner::writeCsv(std::ostream& out) const {
+    out << "member,energy_error,max_energy_error,angular_momentum_error,min_separation,max_radius\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const EnsembleMemberSummary& s = results[i];
+        out << i << ',' << s.energyError << ',' << s.maxEnergyError << ',' << s.angularMomentumError << ','
+            << s.minSeparation << ',' << s.maxRadius << '\n';
+    }
+}
@@ -0,0 +1,41 @@
+#include "FloatTiles.h"
+#include "SpaceFillingCurve.h"
+#include <algorithm>
+
+void FloatTiles::update(const double* x, const double* y, const double* masses, size_t count) {
+    SpaceFillingCurve::sortedOrder(x, y, count, index);
+    size_t tiles = (count + tileSize - 1) / tileSize;
+    originX.resize(tiles);
+    originY.resize(tiles);
+    offsetX.resize(count);
+    offsetY.resize(count);
+    mass.resize(count);
+    position.resize(count);
+
+    for (size_t tile = 0; tile < tiles; tile++) {
+        size_t begin = tileBegin(tile), end = tileEnd(tile);
+
+        // Center of the tile's bounding box, so offsets stay as small as the tile
+        double minX = x[index[begin]], maxX = minX;
+        double minY = y[index[begin]], maxY = minY;
+        for (size_t k = begin + 1; k < end; k++) {
+            uint32_t i = index[k];
+            minX = std::min(minX, x[i]);
+            maxX = std::max(maxX, x[i]);
+            minY = std::min(minY, y[i]);
+            maxY = std::max(maxY, y[i]);
+        }
+        double centerX = 0.5 * (minX + maxX);
+        double centerY = 0.5 * (minY + maxY);
+        originX[tile] = centerX;
+        originY[tile] = centerY;
+
+        for (size_t k = begin; k < end; k++) {
+            uint32_t i = index[k];
+            offsetX[k] = static_cast<float>(x[i] - centerX);
+            offsetY[k] = static_cast<float>(y[i] - centerY);
+            mass[k] = static_cast<float>(masses[i]);
+            position[i] = static_cast<uint32_t>(k);
+        }
+    }
+}
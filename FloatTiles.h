@@ -0,0 +1,44 @@
+#ifndef FLOAT_TILES_H
+#define FLOAT_TILES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Body positions as single-precision offsets from double-precision tile
+// origins, for force kernels that run on float lanes.
+//
+// Plain float coordinates lose the difference between two nearby bodies once
+// both sit far from the origin. Here the bodies are grouped along the Hilbert
+// curve into tiles of `tileSize` neighbours; each tile keeps its center in
+// double and its bodies only the small offsets from it. A kernel evaluating
+// the field at (px, py) takes the tile center minus the target point in
+// double, rounds that once to float and adds the offsets, so separations come
+// out accurate relative to their own size rather than to the coordinates.
+// The float origin effectively moves with every target point.
+class FloatTiles {
+public:
+    static constexpr size_t tileSize = 256;
+
+    // Regroups the bodies and recomputes every offset; call whenever the
+    // positions have changed
+    void update(const double* x, const double* y, const double* mass, size_t count);
+
+    size_t size() const { return index.size(); }
+    size_t tileCount() const { return originX.size(); }
+    size_t tileBegin(size_t tile) const { return tile * tileSize; }
+    size_t tileEnd(size_t tile) const { return tile + 1 < originX.size() ? (tile + 1) * tileSize : index.size(); }
+
+    // Per tile
+    std::vector<double> originX, originY;
+
+    // Per body, in tile order
+    std::vector<float> offsetX, offsetY;
+    std::vector<float> mass;
+    std::vector<uint32_t> index;  // Index of the body in the arrays passed to update()
+
+    // Per body, in the order passed to update()
+    std::vector<uint32_t> position;  // Tile-order position, so kernels can skip a body's own term
+};
+
+#endif // FLOAT_TILES_H
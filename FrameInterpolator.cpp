@@ -0,0 +1,85 @@
+#include "FrameInterpolator.h"
+#include <algorithm>
+#include <cmath>
+
+FrameInterpolator::FrameInterpolator()
+    : particleReorders(0), particlesValid(false), blend(1.0), maxBodyMove(0.0), maxParticleMove(0.0),
+      moveStale(false) {}
+
+void FrameInterpolator::capture(const PhysicsEngine& engine) {
+    const BodyStore& store = engine.bodies();
+    BodyStore::BodyId maxId = 0;
+    for (BodyStore::BodyId bodyId : store.id) {
+        maxId = std::max(maxId, bodyId);
+    }
+    size_t idCount = store.empty() ? 0 : static_cast<size_t>(maxId) + 1;
+    previousX.resize(idCount);
+    previousY.resize(idCount);
+    previousMass.resize(idCount);
+    captured.assign(idCount, 0);
+    for (size_t i = 0; i < store.size(); i++) {
+        BodyStore::BodyId bodyId = store.id[i];
+        previousX[bodyId] = store.x[i];
+        previousY[bodyId] = store.y[i];
+        previousMass[bodyId] = store.mass[i];
+        captured[bodyId] = 1;
+    }
+
+    particleX = engine.particles.x;
+    particleY = engine.particles.y;
+    particleReorders = engine.reordering.reorderCount();
+    moveStale = true;
+}
+
+void FrameInterpolator::update(const PhysicsEngine& engine, double alpha) {
+    blend = std::clamp(alpha, 0.0, 1.0);
+    particlesValid = particleX.size() == engine.particles.size() && particleReorders == engine.reordering.reorderCount();
+
+    // Once per capture: how far the bodies and particles that are blended
+    // moved in between
+    if (moveStale) {
+        const BodyStore& store = engine.bodies();
+        double maxMove = 0.0;
+        for (size_t i = 0; i < store.size(); i++) {
+            BodyStore::BodyId bodyId = store.id[i];
+            if (bodyId >= captured.size() || !captured[bodyId] || previousMass[bodyId] != store.mass[i]) {
+                continue;
+            }
+            maxMove = std::max(maxMove, std::max(std::fabs(store.x[i] - previousX[bodyId]),
+                                                 std::fabs(store.y[i] - previousY[bodyId])));
+        }
+        maxBodyMove = maxMove;
+
+        const TestParticles& particles = engine.particles;
+        maxMove = 0.0;
+        if (particlesValid) {
+            for (size_t i = 0; i < particles.size(); i++) {
+                maxMove = std::max(maxMove, std::max(std::fabs(particles.x[i] - particleX[i]),
+                                                     std::fabs(particles.y[i] - particleY[i])));
+            }
+        }
+        maxParticleMove = maxMove;
+        moveStale = false;
+    }
+}
+
+void FrameInterpolator::bodyPosition(const BodyStore& store, uint32_t index, double& x, double& y) const {
+    x = store.x[index];
+    y = store.y[index];
+    BodyStore::BodyId bodyId = store.id[index];
+    if (bodyId >= captured.size() || !captured[bodyId] || previousMass[bodyId] != store.mass[index]) {
+        return;
+    }
+    x = previousX[bodyId] + (x - previousX[bodyId]) * blend;
+    y = previousY[bodyId] + (y - previousY[bodyId]) * blend;
+}
+
+void FrameInterpolator::particlePosition(const TestParticles& particles, size_t index, double& x, double& y) const {
+    x = particles.x[index];
+    y = particles.y[index];
+    if (!particlesValid) {
+        return;
+    }
+    x = particleX[index] + (x - particleX[index]) * blend;
+    y = particleY[index] + (y - particleY[index]) * blend;
+}
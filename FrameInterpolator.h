@@ -0,0 +1,49 @@
+#ifndef FRAME_INTERPOLATOR_H
+#define FRAME_INTERPOLATOR_H
+
+#include "PhysicsEngine.h"
+#include <cstdint>
+#include <vector>
+
+// Positions for rendering between the last two simulation ticks.
+//
+// capture() records the state at the start of the engine's last tick;
+// positions handed out afterwards blend from there to the engine's current
+// state by the clock's interpolation factor. Bodies are matched by id, so
+// merges and reordering in between are harmless: a body without a recorded
+// position (or a merge product whose recorded position is stale) is simply
+// drawn where it is. Test particles have no ids and are only interpolated
+// while their order is unchanged.
+class FrameInterpolator {
+public:
+    FrameInterpolator();
+
+    void capture(const PhysicsEngine& engine);
+
+    // Sets the blend factor for the coming frame (0 = captured state,
+    // 1 = current state) and checks what can still be interpolated
+    void update(const PhysicsEngine& engine, double alpha);
+
+    void bodyPosition(const BodyStore& store, uint32_t index, double& x, double& y) const;
+    void particlePosition(const TestParticles& particles, size_t index, double& x, double& y) const;
+
+    // Largest distance along either axis between a body's (particle's)
+    // blended position and its current one this frame, for padding spatial
+    // queries built on current positions
+    double maxBodyOffset() const { return (1.0 - blend) * maxBodyMove; }
+    double maxParticleOffset() const { return particlesValid ? (1.0 - blend) * maxParticleMove : 0.0; }
+
+private:
+    std::vector<double> previousX, previousY;  // Indexed by body id
+    std::vector<double> previousMass;          // Detects bodies that grew by merging
+    std::vector<uint8_t> captured;             // Whether an id has a recorded position
+    std::vector<double> particleX, particleY;
+    unsigned long long particleReorders;       // Engine reorder count at capture
+    bool particlesValid;
+    double blend;
+    double maxBodyMove;      // Largest per-axis move of a body since capture
+    double maxParticleMove;  // Same for the test particles, while they can be blended
+    bool moveStale;          // Captured but not yet compared with the engine
+};
+
+#endif // FRAME_INTERPOLATOR_H
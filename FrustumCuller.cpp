@@ -0,0 +1,323 @@
+#include "FrustumCuller.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+FrustumCuller::FrustumCuller()
+    : radiusScale(0.5f), particleRadius(0.03f), particleColor{0.6f, 0.55f, 0.5f}, interpolation(nullptr), maxSphereRadius(0.0),
+      radiusStoreSize(SIZE_MAX), visibleCount(0), testedCount(0) {
+    for (auto& plane : planes) {
+        plane[0] = plane[1] = plane[2] = 0.0;
+        plane[3] = 1.0;  // Everything visible until a matrix is set
+    }
+}
+
+void FrustumCuller::setViewProjection(const glm::mat4& m) {
+    // Gribb-Hartmann plane extraction; glm is column-major, so row i is m[c][i]
+    for (int p = 0; p < 6; p++) {
+        int row = p / 2;
+        double sign = (p % 2 == 0) ? 1.0 : -1.0;  // left/bottom/near add, right/top/far subtract
+        double plane[4];
+        for (int c = 0; c < 4; c++) {
+            plane[c] = static_cast<double>(m[c][3]) + sign * static_cast<double>(m[c][row]);
+        }
+        double length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length <= 0.0) {
+            length = 1.0;
+        }
+        for (int c = 0; c < 4; c++) {
+            planes[p][c] = plane[c] / length;
+        }
+    }
+}
+
+void FrustumCuller::cull(const PhysicsEngine& engine, VisibleSet& visible, const FrameInterpolator* interpolator) {
+    PROFILE_SCOPE("render.cull");
+    interpolation = interpolator;
+    visible.bodies.clear();
+    visible.particles.clear();
+    visibleCount = 0;
+    testedCount = 0;
+
+    const BodyStore& store = engine.bodies();
+    updateMaxRadius(store);
+    if (engine.treeIsCurrent() && !engine.tree().empty()) {
+        cullTree(store, engine.tree(), visible.bodies);
+    } else if (store.size() >= gridThreshold) {
+        if (!bodyGrid.current(store.x.data(), store.size(), engine.time(), engine.stepCount())) {
+            bodyGrid.build(store.x.data(), store.y.data(), store.size());
+            bodyGrid.time = engine.time();
+            bodyGrid.steps = engine.stepCount();
+        }
+        const double sphereScale = radiusScale * BodyRenderer::meshRadius;
+        auto test = [&](uint32_t i) {
+            double x, y;
+            bodyPosition(store, i, x, y);
+            return sphereVisible(x, y, store.radius[i] * sphereScale);
+        };
+        cullGrid(bodyGrid, maxSphereRadius, interpolation ? interpolation->maxBodyOffset() : 0.0, test, visible.bodies);
+    } else {
+        cullLinear(store, visible.bodies);
+    }
+    cullParticles(engine, visible.particles);
+    visibleCount = visible.size();
+}
+
+void FrustumCuller::storeReplaced() {
+    radiusStoreSize = SIZE_MAX;
+    bodyGrid.positions = nullptr;
+    particleGrid.positions = nullptr;
+}
+
+void FrustumCuller::updateMaxRadius(const BodyStore& store) {
+    // Within a run radii only change when bodies merge, which always changes
+    // the body count; a replaced store comes through storeReplaced()
+    if (store.size() == radiusStoreSize) {
+        return;
+    }
+    double maxRadius = 0.0;
+    for (double r : store.radius) {
+        maxRadius = std::max(maxRadius, r);
+    }
+    maxSphereRadius = maxRadius * radiusScale * BodyRenderer::meshRadius;
+    radiusStoreSize = store.size();
+}
+
+bool FrustumCuller::sphereVisible(double x, double y, double radius) const {
+    for (const auto& plane : planes) {
+        if (plane[0] * x + plane[1] * y + plane[3] < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+FrustumCuller::Containment FrustumCuller::classifyBox(double minX, double minY, double maxX, double maxY, double halfDepth) const {
+    Containment result = Containment::Inside;
+    for (const auto& plane : planes) {
+        // Corners furthest along and against the plane normal
+        double farX = plane[0] >= 0.0 ? maxX : minX;
+        double farY = plane[1] >= 0.0 ? maxY : minY;
+        double farZ = plane[2] >= 0.0 ? halfDepth : -halfDepth;
+        double nearX = plane[0] >= 0.0 ? minX : maxX;
+        double nearY = plane[1] >= 0.0 ? minY : maxY;
+        double nearZ = -farZ;
+        if (plane[0] * farX + plane[1] * farY + plane[2] * farZ + plane[3] < 0.0) {
+            return Containment::Outside;
+        }
+        if (plane[0] * nearX + plane[1] * nearY + plane[2] * nearZ + plane[3] < 0.0) {
+            result = Containment::Intersecting;
+        }
+    }
+    return result;
+}
+
+void FrustumCuller::bodyPosition(const BodyStore& store, uint32_t index, double& x, double& y) const {
+    if (interpolation) {
+        interpolation->bodyPosition(store, index, x, y);
+    } else {
+        x = store.x[index];
+        y = store.y[index];
+    }
+}
+
+void FrustumCuller::cullLinear(const BodyStore& store, std::vector<uint32_t>& visible) {
+    const double sphereScale = radiusScale * BodyRenderer::meshRadius;
+    for (size_t i = 0; i < store.size(); i++) {
+        double x, y;
+        bodyPosition(store, static_cast<uint32_t>(i), x, y);
+        if (sphereVisible(x, y, store.radius[i] * sphereScale)) {
+            visible.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    testedCount = store.size();
+}
+
+void FrustumCuller::cullParticles(const PhysicsEngine& engine, std::vector<uint32_t>& visible) {
+    const TestParticles& particles = engine.particles;
+    const double sphereRadius = particleRadius * BodyRenderer::meshRadius;
+    auto test = [&](uint32_t i) {
+        double x = particles.x[i], y = particles.y[i];
+        if (interpolation) {
+            interpolation->particlePosition(particles, i, x, y);
+        }
+        return sphereVisible(x, y, sphereRadius);
+    };
+    if (particles.size() >= gridThreshold) {
+        if (!particleGrid.current(particles.x.data(), particles.size(), engine.time(), engine.stepCount())) {
+            particleGrid.build(particles.x.data(), particles.y.data(), particles.size());
+            particleGrid.time = engine.time();
+            particleGrid.steps = engine.stepCount();
+        }
+        cullGrid(particleGrid, sphereRadius, interpolation ? interpolation->maxParticleOffset() : 0.0, test, visible);
+        return;
+    }
+    for (size_t i = 0; i < particles.size(); i++) {
+        if (test(static_cast<uint32_t>(i))) {
+            visible.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    testedCount += particles.size();
+}
+
+void FrustumCuller::CullGrid::build(const double* x, const double* y, size_t n) {
+    PROFILE_SCOPE("render.cull_grid");
+    double minX = std::numeric_limits<double>::infinity(), minY = minX;
+    double maxX = -minX, maxY = -minX;
+    for (size_t i = 0; i < n; i++) {
+        minX = std::min(minX, x[i]);
+        maxX = std::max(maxX, x[i]);
+        minY = std::min(minY, y[i]);
+        maxY = std::max(maxY, y[i]);
+    }
+    if (!(minX <= maxX && minY <= maxY)) {
+        minX = maxX = minY = maxY = 0.0;
+    }
+
+    // About eight objects per cell, in cells as square as the box allows
+    const double cellTarget = std::max(1.0, static_cast<double>(n) / 8.0);
+    const double width = maxX - minX, height = maxY - minY;
+    cellSize = std::sqrt(width * height / cellTarget);
+    if (!(cellSize > 0.0)) {
+        cellSize = std::max(width, height) / cellTarget;
+    }
+    if (!(cellSize > 0.0)) {
+        cellSize = 1.0;  // Everything at one point
+    }
+    const double maxCellsPerSide = 65535.0;  // For long, thin boxes
+    cellSize = std::max(cellSize, std::max(width, height) / (maxCellsPerSide - 1.0));
+    cellsX = static_cast<uint32_t>(std::floor(width / cellSize) + 1.0);
+    cellsY = static_cast<uint32_t>(std::floor(height / cellSize) + 1.0);
+    originX = minX;
+    originY = minY;
+
+    // Counting sort by cell; out-of-box (non-finite) positions land in cell 0
+    const size_t cellCount = static_cast<size_t>(cellsX) * cellsY;
+    cellStart.assign(cellCount + 1, 0);
+    itemCell.resize(n);
+    items.resize(n);
+    const double toCell = 1.0 / cellSize;
+    for (size_t i = 0; i < n; i++) {
+        double fx = (x[i] - originX) * toCell;
+        double fy = (y[i] - originY) * toCell;
+        uint32_t cx = fx >= 0.0 ? static_cast<uint32_t>(std::min(fx, cellsX - 1.0)) : 0;
+        uint32_t cy = fy >= 0.0 ? static_cast<uint32_t>(std::min(fy, cellsY - 1.0)) : 0;
+        itemCell[i] = cy * cellsX + cx;
+        cellStart[itemCell[i] + 1]++;
+    }
+    for (size_t c = 0; c < cellCount; c++) {
+        cellStart[c + 1] += cellStart[c];
+    }
+    for (size_t i = 0; i < n; i++) {
+        items[cellStart[itemCell[i]]++] = static_cast<uint32_t>(i);
+    }
+    for (size_t c = cellCount; c > 0; c--) {
+        cellStart[c] = cellStart[c - 1];
+    }
+    cellStart[0] = 0;
+
+    positions = x;
+    count = n;
+}
+
+template <typename Visible>
+void FrustumCuller::cullGrid(const CullGrid& grid, double pad, double offset, const Visible& test,
+                             std::vector<uint32_t>& visible) {
+    // Blocks of cells, halved along their longer side while they straddle a
+    // plane; cells store current positions, which blended ones trail by up
+    // to `offset`
+    struct Block {
+        uint32_t x0, y0, x1, y1;
+    };
+    Block stack[64];
+    int top = 0;
+    stack[top++] = {0, 0, grid.cellsX, grid.cellsY};
+    const double boxPad = pad + offset;
+    while (top > 0) {
+        Block block = stack[--top];
+        Containment containment = classifyBox(
+            grid.originX + block.x0 * grid.cellSize - boxPad, grid.originY + block.y0 * grid.cellSize - boxPad,
+            grid.originX + block.x1 * grid.cellSize + boxPad, grid.originY + block.y1 * grid.cellSize + boxPad, pad);
+        if (containment == Containment::Outside) {
+            continue;
+        }
+        if (containment == Containment::Inside) {
+            // Rows of a block are contiguous in the sorted items
+            for (uint32_t row = block.y0; row < block.y1; row++) {
+                size_t rowStart = static_cast<size_t>(row) * grid.cellsX;
+                visible.insert(visible.end(), grid.items.begin() + grid.cellStart[rowStart + block.x0],
+                               grid.items.begin() + grid.cellStart[rowStart + block.x1]);
+            }
+            continue;
+        }
+        if (block.x1 - block.x0 == 1 && block.y1 - block.y0 == 1) {
+            size_t cell = static_cast<size_t>(block.y0) * grid.cellsX + block.x0;
+            for (uint32_t k = grid.cellStart[cell]; k < grid.cellStart[cell + 1]; k++) {
+                uint32_t i = grid.items[k];
+                if (test(i)) {
+                    visible.push_back(i);
+                }
+            }
+            testedCount += grid.cellStart[cell + 1] - grid.cellStart[cell];
+            continue;
+        }
+        if (block.x1 - block.x0 >= block.y1 - block.y0) {
+            uint32_t middle = (block.x0 + block.x1) / 2;
+            stack[top++] = {middle, block.y0, block.x1, block.y1};
+            stack[top++] = {block.x0, block.y0, middle, block.y1};
+        } else {
+            uint32_t middle = (block.y0 + block.y1) / 2;
+            stack[top++] = {block.x0, middle, block.x1, block.y1};
+            stack[top++] = {block.x0, block.y0, block.x1, middle};
+        }
+    }
+}
+
+void FrustumCuller::cullTree(const BodyStore& store, const BarnesHutTree& tree, std::vector<uint32_t>& visible) {
+    const std::vector<BarnesHutTree::Node>& nodes = tree.nodes();
+    const std::vector<uint32_t>& indices = tree.sortedIndices();
+    const double sphereScale = radiusScale * BodyRenderer::meshRadius;
+    // The tree holds current positions; blended ones can trail them by up to
+    // the interpolator's offset
+    const double pad = maxSphereRadius;
+    const double offset = interpolation ? interpolation->maxBodyOffset() : 0.0;
+    const double boxPad = pad + offset;
+
+    uint32_t stack[4 * BarnesHutTree::maxDepth + 4];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const BarnesHutTree::Node& node = nodes[stack[--top]];
+        if (node.count == 0) {
+            continue;
+        }
+        // Cell bounds grown by the largest body and the blending offset so
+        // every sphere in it is enclosed where it is drawn
+        Containment containment =
+            classifyBox(node.centerX - node.halfSize - boxPad, node.centerY - node.halfSize - boxPad,
+                        node.centerX + node.halfSize + boxPad, node.centerY + node.halfSize + boxPad, pad);
+        if (containment == Containment::Outside) {
+            continue;
+        }
+        if (containment == Containment::Inside) {
+            visible.insert(visible.end(), indices.begin() + node.begin, indices.begin() + node.begin + node.count);
+            continue;
+        }
+        if (node.firstChild >= 0) {
+            for (int q = 0; q < 4; q++) {
+                stack[top++] = node.firstChild + q;
+            }
+            continue;
+        }
+        for (uint32_t k = node.begin; k < node.begin + node.count; k++) {
+            uint32_t i = indices[k];
+            double x, y;
+            bodyPosition(store, i, x, y);
+            if (sphereVisible(x, y, store.radius[i] * sphereScale)) {
+                visible.push_back(i);
+            }
+        }
+        testedCount += node.count;
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include "BodyRenderer.h"
+#include "FrameInterpolator.h"
+#include "PhysicsEngine.h"
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Indices of the bodies and test particles that intersect the view, refilled
+// by every FrustumCuller::cull(); InstanceStream packs them for drawing
+struct VisibleSet {
+    std::vector<uint32_t> bodies;     // Into the body store
+    std::vector<uint32_t> particles;  // Into the test particles
+
+    size_t size() const { return bodies.size() + particles.size(); }
+};
+
+// Selects the bodies whose bounding spheres intersect the view frustum.
+//
+// The six planes are extracted from the combined projection * view matrix, so
+// the test follows zoom, pan and rotation from updateCameraMatrices. When the
+// physics engine has a current Barnes-Hut tree, the tree doubles as the
+// spatial index: cells fully outside the frustum are skipped, cells fully
+// inside are emitted without per-body tests, and only cells on the boundary
+// are examined body by body. Large sets without a tree (particle-mesh and
+// direct-sum runs, client mode, and test particles always) are binned into a
+// uniform grid that is searched the same way; it is rebuilt only when the
+// positions have changed, so frames between physics ticks cost what is in
+// view. Small sets are tested linearly. Test particles are drawn as small
+// spheres of a single color. The scale and color settings here are applied
+// when the visible set is packed.
+class FrustumCuller {
+public:
+    FrustumCuller();
+
+    float radiusScale;  // World-space mesh scale per unit of body radius
+    float particleRadius;
+    float particleColor[3];
+
+    void setViewProjection(const glm::mat4& viewProjection);
+
+    // Replaces `visible` with the indices of all visible bodies and test
+    // particles, tested at the interpolator's blended positions when there
+    // is an interpolator, as they are drawn
+    void cull(const PhysicsEngine& engine, VisibleSet& visible, const FrameInterpolator* interpolator = nullptr);
+
+    // The bodies and particles were replaced, as by a snapshot: radii may
+    // have changed at the same count, and the culling grids are stale
+    void storeReplaced();
+
+    size_t lastVisibleCount() const { return visibleCount; }
+    size_t lastTestedCount() const { return testedCount; }
+
+    static constexpr size_t gridThreshold = 4096;  // Fewer objects are tested linearly
+
+private:
+    enum class Containment { Outside, Intersecting, Inside };
+
+    // Indices binned by cell in row-major order over the bounding box of
+    // the positions at the last build
+    struct CullGrid {
+        double originX = 0.0, originY = 0.0;
+        double cellSize = 1.0;
+        uint32_t cellsX = 0, cellsY = 0;
+        std::vector<uint32_t> cellStart;  // cellsX * cellsY + 1 offsets into items
+        std::vector<uint32_t> items;
+        std::vector<uint32_t> itemCell;   // Scratch for the counting sort
+
+        // Positions the grid was built from; any change means a rebuild
+        const double* positions = nullptr;
+        size_t count = 0;
+        double time = -1.0;
+        uint64_t steps = 0;
+
+        bool current(const double* x, size_t n, double t, uint64_t s) const {
+            return positions == x && count == n && time == t && steps == s;
+        }
+        void build(const double* x, const double* y, size_t n);
+    };
+
+    Containment classifyBox(double minX, double minY, double maxX, double maxY, double halfDepth) const;
+    bool sphereVisible(double x, double y, double radius) const;
+    void cullLinear(const BodyStore& store, std::vector<uint32_t>& visible);
+    void cullTree(const BodyStore& store, const BarnesHutTree& tree, std::vector<uint32_t>& visible);
+    void cullParticles(const PhysicsEngine& engine, std::vector<uint32_t>& visible);
+    template <typename Visible>
+    void cullGrid(const CullGrid& grid, double pad, double offset, const Visible& test, std::vector<uint32_t>& visible);
+    void bodyPosition(const BodyStore& store, uint32_t index, double& x, double& y) const;
+    void updateMaxRadius(const BodyStore& store);
+
+    double planes[6][4];  // Normalized (nx, ny, nz, d); inside when n.p + d >= 0
+    CullGrid bodyGrid, particleGrid;
+    const FrameInterpolator* interpolation;  // For the cull() in progress
+    double maxSphereRadius;
+    size_t radiusStoreSize;  // Store size when maxSphereRadius was computed; SIZE_MAX = stale
+    size_t visibleCount;
+    size_t testedCount;
+};
+
+#endif // FRUSTUM_CULLER_H
@@ -0,0 +1,124 @@
+#include "GpuProfiler.h"
+
+#ifdef GRAVITY_PROFILING
+
+#include <iostream>
+
+namespace {
+
+const int framesInFlight = 4;         // Frames of latency before results are read
+const int maxPassesPerFrame = 16;
+const int clockResyncInterval = 600;  // Frames between GPU/CPU clock re-alignment
+
+struct PassQuery {
+    const char* name;
+    GLuint startQuery;
+    GLuint endQuery;
+};
+
+struct FrameQueries {
+    PassQuery passes[maxPassesPerFrame];
+    int passCount = 0;
+};
+
+struct GpuProfilerState {
+    bool initialized = false;
+    FrameQueries frames[framesInFlight];
+    int frameIndex = 0;
+    int openPass = -1;
+    int64_t gpuToCpuOffsetNs = 0;
+};
+
+GpuProfilerState state;
+
+void syncClocks() {
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    state.gpuToCpuOffsetNs = static_cast<int64_t>(Profiler::now()) - gpuNow;
+}
+
+} // namespace
+
+void GpuProfiler::initialize() {
+    if (state.initialized) {
+        return;
+    }
+    for (FrameQueries& frame : state.frames) {
+        for (PassQuery& pass : frame.passes) {
+            glGenQueries(1, &pass.startQuery);
+            glGenQueries(1, &pass.endQuery);
+        }
+        frame.passCount = 0;
+    }
+    syncClocks();
+    state.initialized = true;
+    std::cout << "GPU profiler initialized with " << framesInFlight << " frames of query latency" << std::endl;
+}
+
+void GpuProfiler::shutdown() {
+    if (!state.initialized) {
+        return;
+    }
+    for (FrameQueries& frame : state.frames) {
+        for (PassQuery& pass : frame.passes) {
+            glDeleteQueries(1, &pass.startQuery);
+            glDeleteQueries(1, &pass.endQuery);
+        }
+    }
+    state.initialized = false;
+}
+
+void GpuProfiler::beginFrame() {
+    if (!state.initialized) {
+        return;
+    }
+    if (state.frameIndex % clockResyncInterval == 0) {
+        syncClocks();
+    }
+
+    // Reuse the oldest slot; its queries were issued framesInFlight frames ago
+    state.frameIndex++;
+    FrameQueries& frame = state.frames[state.frameIndex % framesInFlight];
+    for (int i = 0; i < frame.passCount; i++) {
+        const PassQuery& pass = frame.passes[i];
+        GLint available = 0;
+        glGetQueryObjectiv(pass.endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            continue;  // Drop the sample rather than stall the pipeline
+        }
+        GLuint64 startNs = 0, endNs = 0;
+        glGetQueryObjectui64v(pass.startQuery, GL_QUERY_RESULT, &startNs);
+        glGetQueryObjectui64v(pass.endQuery, GL_QUERY_RESULT, &endNs);
+        Profiler::recordOnTrack(Profiler::gpuTrackId, pass.name,
+                                static_cast<uint64_t>(startNs + state.gpuToCpuOffsetNs),
+                                static_cast<uint64_t>(endNs + state.gpuToCpuOffsetNs));
+    }
+    frame.passCount = 0;
+    state.openPass = -1;
+}
+
+void GpuProfiler::begin(const char* name) {
+    if (!state.initialized) {
+        return;
+    }
+    FrameQueries& frame = state.frames[state.frameIndex % framesInFlight];
+    if (frame.passCount >= maxPassesPerFrame) {
+        state.openPass = -1;
+        return;
+    }
+    state.openPass = frame.passCount++;
+    PassQuery& pass = frame.passes[state.openPass];
+    pass.name = name;
+    glQueryCounter(pass.startQuery, GL_TIMESTAMP);
+}
+
+void GpuProfiler::end() {
+    if (!state.initialized || state.openPass < 0) {
+        return;
+    }
+    FrameQueries& frame = state.frames[state.frameIndex % framesInFlight];
+    glQueryCounter(frame.passes[state.openPass].endQuery, GL_TIMESTAMP);
+    state.openPass = -1;
+}
+
+#endif // GRAVITY_PROFILING
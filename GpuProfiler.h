@@ -0,0 +1,46 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include "Profiler.h"
+
+// GPU pass timing with GL timestamp queries. Results are read back a few frames
+// late so the CPU never waits on the GPU, and are converted to the CPU clock so
+// they appear on their own "GPU" track in the same Chrome trace.
+
+#ifdef GRAVITY_PROFILING
+
+#include <glad/glad.h>
+
+class GpuProfiler {
+public:
+    static void initialize();  // Requires a current GL context
+    static void shutdown();
+    static void beginFrame();  // Collects finished queries from earlier frames
+    static void begin(const char* name);
+    static void end();
+};
+
+class GpuScopedTimer {
+public:
+    explicit GpuScopedTimer(const char* name) { GpuProfiler::begin(name); }
+    ~GpuScopedTimer() { GpuProfiler::end(); }
+
+    GpuScopedTimer(const GpuScopedTimer&) = delete;
+    GpuScopedTimer& operator=(const GpuScopedTimer&) = delete;
+};
+
+#define PROFILE_GPU_INIT() GpuProfiler::initialize()
+#define PROFILE_GPU_SHUTDOWN() GpuProfiler::shutdown()
+#define PROFILE_GPU_FRAME() GpuProfiler::beginFrame()
+#define PROFILE_GPU_SCOPE(name) GpuScopedTimer PROFILE_CONCAT(gpuProfileScope_, __LINE__)(name)
+
+#else
+
+#define PROFILE_GPU_INIT() ((void)0)
+#define PROFILE_GPU_SHUTDOWN() ((void)0)
+#define PROFILE_GPU_FRAME() ((void)0)
+#define PROFILE_GPU_SCOPE(name) ((void)0)
+
+#endif // GRAVITY_PROFILING
+
+#endif // GPU_PROFILER_H
@@ -0,0 +1,418 @@
+#include "HardwareCounters.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+std::atomic<bool> HardwareCounters::active(false);
+
+namespace {
+
+using Phase = HardwareCounters::Phase;
+using Event = HardwareCounters::Event;
+using Counts = HardwareCounters::Counts;
+constexpr size_t phaseCount = HardwareCounters::phaseCount;
+constexpr size_t eventCount = HardwareCounters::eventCount;
+
+// One thread's counter group. The leader counts cycles; position[] is where
+// each event sits in a group read, -1 when it is not counted.
+struct Slot {
+    bool running = false;
+    long tid = 0;
+    int fds[eventCount] = {-1, -1, -1, -1, -1};
+    int position[eventCount] = {-1, -1, -1, -1, -1};
+    int members = 0;
+    double last[eventCount] = {};              // Reading at the last phase boundary
+    double totals[phaseCount][eventCount] = {};
+};
+
+struct State {
+    std::mutex mutex;
+    std::vector<Slot> slots;
+    std::string failure;
+    bool opened = false;
+    int phase = -1;  // Phase being counted, -1 between phases
+};
+
+State& state() {
+    static State instance;
+    return instance;
+}
+
+#ifdef __linux__
+
+long currentThreadId() {
+    return syscall(SYS_gettid);
+}
+
+bool isIntel() {
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned a, b, c, d;
+    if (__get_cpuid(0, &a, &b, &c, &d)) {
+        return b == 0x756e6547 && d == 0x49656e69 && c == 0x6c65746e;  // "GenuineIntel"
+    }
+#endif
+    return false;
+}
+
+// Fills in type and config for `event`; false when this CPU has no such event
+bool configure(Event event, perf_event_attr& attr) {
+    attr.type = PERF_TYPE_HARDWARE;
+    switch (event) {
+        case Event::Cycles:
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            return true;
+        case Event::Instructions:
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            return true;
+        case Event::CacheMisses:
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            return true;
+        case Event::BranchMisses:
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            return true;
+        case Event::VectorOps:
+            // FP_ARITH_INST_RETIRED, every packed width (128, 256 and 512 bits)
+            if (!isIntel()) {
+                return false;
+            }
+            attr.type = PERF_TYPE_RAW;
+            attr.config = 0xfcc7;
+            return true;
+    }
+    return false;
+}
+
+std::string describeFailure(int error) {
+    switch (error) {
+        case ENOENT:
+        case ENODEV:
+        case EOPNOTSUPP:
+            return "no hardware counters on this CPU (or in this virtual machine)";
+        case EACCES:
+        case EPERM:
+            return "perf_event_open is not permitted, see /proc/sys/kernel/perf_event_paranoid";
+        case ENOSYS:
+            return "this kernel has no perf_event_open";
+        default:
+            return std::string("perf_event_open failed: ") + std::strerror(error);
+    }
+}
+
+// Current counts of a slot's group, scaled for multiplexing
+bool readSlot(const Slot& slot, double* values) {
+    uint64_t buffer[3 + eventCount];
+    ssize_t expected = static_cast<ssize_t>((3 + slot.members) * sizeof(uint64_t));
+    if (read(slot.fds[0], buffer, sizeof(buffer)) < expected) {
+        return false;
+    }
+    uint64_t enabled = buffer[1], running = buffer[2];
+    double scale = running > 0 ? static_cast<double>(enabled) / running : 0.0;
+    for (size_t e = 0; e < eventCount; e++) {
+        if (slot.position[e] >= 0) {
+            values[e] = static_cast<double>(buffer[3 + slot.position[e]]) * scale;
+        }
+    }
+    return true;
+}
+
+void closeSlot(Slot& slot) {
+    for (int& fd : slot.fds) {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+}
+
+// Opens the group for the slot's thread. Returns 0 or the errno of the leader.
+int openSlot(Slot& slot) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    slot.members = 0;
+    for (size_t e = 0; e < eventCount; e++) {
+        slot.position[e] = -1;
+        if (!configure(static_cast<Event>(e), attr)) {
+            continue;
+        }
+        int leader = e == 0 ? -1 : slot.fds[0];
+        int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, slot.tid, -1, leader, 0));
+        if (fd < 0) {
+            if (e == 0) {
+                return errno;
+            }
+            continue;  // The group counts without this event
+        }
+        slot.fds[e] = fd;
+        slot.position[e] = slot.members++;
+    }
+    readSlot(slot, slot.last);
+    return 0;
+}
+
+// Reads every running thread and credits what happened since the last
+// boundary to the current phase
+void sample(State& s) {
+    for (Slot& slot : s.slots) {
+        if (!slot.running || slot.fds[0] < 0) {
+            continue;
+        }
+        double now[eventCount];
+        std::copy(slot.last, slot.last + eventCount, now);
+        if (!readSlot(slot, now)) {
+            continue;
+        }
+        if (s.phase >= 0) {
+            for (size_t e = 0; e < eventCount; e++) {
+                slot.totals[s.phase][e] += now[e] - slot.last[e];
+            }
+        }
+        std::copy(now, now + eventCount, slot.last);
+    }
+}
+
+#endif // __linux__
+
+Counts slotTotal(const Slot& slot, Phase phase) {
+    Counts counts;
+    for (size_t e = 0; e < eventCount; e++) {
+        if (slot.position[e] >= 0) {
+            counts.value[e] = std::llround(slot.totals[static_cast<size_t>(phase)][e]);
+        }
+    }
+    return counts;
+}
+
+// Right-aligned ratio, or "-" when it is missing
+void writeRatio(std::ostream& out, int width, bool known, double value) {
+    if (known) {
+        out << std::setw(width) << value;
+    } else {
+        out << std::setw(width) << "-";
+    }
+}
+
+void writeRow(std::ostream& out, const char* phase, const char* thread, const Counts& counts) {
+    out << std::left << std::setw(11) << phase << std::setw(8) << thread << std::right;
+    for (Event event : {Event::Cycles, Event::Instructions}) {
+        if (counts.has(event)) {
+            out << std::setw(14) << counts[event];
+        } else {
+            out << std::setw(14) << "-";
+        }
+    }
+    out << std::fixed << std::setprecision(2);
+    writeRatio(out, 7, counts.has(Event::Cycles) && counts.has(Event::Instructions), counts.instructionsPerCycle());
+    writeRatio(out, 14, counts.has(Event::CacheMisses), counts.perKiloInstruction(Event::CacheMisses));
+    writeRatio(out, 15, counts.has(Event::BranchMisses), counts.perKiloInstruction(Event::BranchMisses));
+    writeRatio(out, 14, counts.has(Event::VectorOps), counts.perKiloInstruction(Event::VectorOps));
+    out << std::defaultfloat << std::setprecision(6) << "\n";
+}
+
+} // namespace
+
+void HardwareCounters::Counts::add(const Counts& other) {
+    for (size_t e = 0; e < eventCount; e++) {
+        if (other.value[e] >= 0) {
+            value[e] = std::max<int64_t>(value[e], 0) + other.value[e];
+        }
+    }
+}
+
+double HardwareCounters::Counts::instructionsPerCycle() const {
+    int64_t cycles = (*this)[Event::Cycles];
+    return cycles > 0 && has(Event::Instructions) ? static_cast<double>((*this)[Event::Instructions]) / cycles : 0.0;
+}
+
+double HardwareCounters::Counts::perKiloInstruction(Event event) const {
+    int64_t instructions = (*this)[Event::Instructions];
+    return instructions > 0 && has(event) ? 1000.0 * (*this)[event] / instructions : 0.0;
+}
+
+bool HardwareCounters::enable() {
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (s.opened) {
+        return true;
+    }
+#ifdef __linux__
+    if (s.slots.empty()) {
+        s.slots.resize(1);
+    }
+    Slot& caller = s.slots[0];
+    caller.tid = currentThreadId();
+    caller.running = true;
+    int error = openSlot(caller);
+    if (error != 0) {
+        s.failure = describeFailure(error);
+        return false;
+    }
+    for (size_t i = 1; i < s.slots.size(); i++) {
+        if (s.slots[i].running) {
+            openSlot(s.slots[i]);
+        }
+    }
+    s.opened = true;
+    active.store(true, std::memory_order_relaxed);
+    return true;
+#else
+    s.failure = "hardware counters are only supported on Linux";
+    return false;
+#endif
+}
+
+const std::string& HardwareCounters::reason() {
+    return state().failure;
+}
+
+void HardwareCounters::registerThread(unsigned thread) {
+#ifdef __linux__
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (s.slots.size() <= thread) {
+        s.slots.resize(thread + 1);
+    }
+    Slot& slot = s.slots[thread];
+    closeSlot(slot);
+    slot.tid = currentThreadId();
+    slot.running = true;
+    if (s.opened) {
+        openSlot(slot);
+    }
+#else
+    (void)thread;
+#endif
+}
+
+void HardwareCounters::unregisterThread(unsigned thread) {
+#ifdef __linux__
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (thread < s.slots.size()) {
+        // Count what the thread did up to now before its group goes away
+        sample(s);
+        closeSlot(s.slots[thread]);
+        s.slots[thread].running = false;
+    }
+#else
+    (void)thread;
+#endif
+}
+
+void HardwareCounters::reset() {
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    for (Slot& slot : s.slots) {
+        for (auto& phase : slot.totals) {
+            std::fill(phase, phase + eventCount, 0.0);
+        }
+    }
+}
+
+unsigned HardwareCounters::threadCount() {
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return static_cast<unsigned>(s.slots.size());
+}
+
+HardwareCounters::Counts HardwareCounters::total(Phase phase) {
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    Counts counts;
+    for (const Slot& slot : s.slots) {
+        counts.add(slotTotal(slot, phase));
+    }
+    return counts;
+}
+
+HardwareCounters::Counts HardwareCounters::total(Phase phase, unsigned thread) {
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    return thread < s.slots.size() ? slotTotal(s.slots[thread], phase) : Counts();
+}
+
+const char* HardwareCounters::name(Phase phase) {
+    switch (phase) {
+        case Phase::Force: return "force";
+        case Phase::Integrate: return "integrate";
+        case Phase::Tree: return "tree";
+        case Phase::GridWarp: return "grid_warp";
+        case Phase::Upload: return "upload";
+    }
+    return "unknown";
+}
+
+const char* HardwareCounters::name(Event event) {
+    switch (event) {
+        case Event::Cycles: return "cycles";
+        case Event::Instructions: return "instructions";
+        case Event::CacheMisses: return "cache_misses";
+        case Event::BranchMisses: return "branch_misses";
+        case Event::VectorOps: return "vector_ops";
+    }
+    return "unknown";
+}
+
+int HardwareCounters::enter(Phase phase) {
+#ifdef __linux__
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    sample(s);
+    int previous = s.phase;
+    s.phase = static_cast<int>(phase);
+    return previous;
+#else
+    (void)phase;
+    return -1;
+#endif
+}
+
+void HardwareCounters::leave(int previous) {
+#ifdef __linux__
+    State& s = state();
+    std::lock_guard<std::mutex> lock(s.mutex);
+    sample(s);
+    s.phase = previous;
+#else
+    (void)previous;
+#endif
+}
+
+void HardwareCounters::writeReport(std::ostream& out) {
+    out << "Phase      Thread          Cycles  Instructions    IPC  Cache miss/ki  Branch miss/ki  Vector op/ki\n";
+    unsigned threads = threadCount();
+    for (size_t p = 0; p < phaseCount; p++) {
+        Phase phase = static_cast<Phase>(p);
+        Counts counts = total(phase);
+        if (counts.empty()) {
+            continue;
+        }
+        writeRow(out, name(phase), "all", counts);
+        for (unsigned thread = 0; thread < threads && threads > 1; thread++) {
+            Counts threadCounts = total(phase, thread);
+            if (!threadCounts.empty()) {
+                writeRow(out, "", std::to_string(thread).c_str(), threadCounts);
+            }
+        }
+    }
+    out.flush();
+}
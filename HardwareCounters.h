@@ -0,0 +1,100 @@
+#ifndef HARDWARE_COUNTERS_H
+#define HARDWARE_COUNTERS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+// Hardware performance counters (Linux perf_event_open) per simulation phase
+// and thread, to tell whether a phase is bound by arithmetic, memory or
+// branches where wall-clock timings only say that it is slow.
+//
+// Every pool thread, and the thread that called enable(), gets one counter
+// group: cycles, instructions, last-level cache misses, branch misses and
+// packed floating-point instructions. Phases are marked with CounterScope on
+// the thread that drives the engine. At each phase boundary that thread
+// reads every group, so the work the pool does on behalf of a phase is
+// credited to that phase and to the thread that did it. Nested phases are
+// exclusive: a tree build inside the force phase counts only as tree. Two
+// engines stepping at the same time share the phases between them.
+//
+// Counting stays off until enable(); until then a phase costs one relaxed
+// load. enable() fails, and reason() says why, on other platforms, in virtual
+// machines without a PMU and where perf_event_paranoid forbids it. Events the
+// CPU cannot count read as unavailable; vector ops are only counted on Intel.
+// Counts are scaled up when the kernel has to multiplex the groups.
+class HardwareCounters {
+public:
+    enum class Phase { Force, Integrate, Tree, GridWarp, Upload };
+    enum class Event { Cycles, Instructions, CacheMisses, BranchMisses, VectorOps };
+    static constexpr size_t phaseCount = 5;
+    static constexpr size_t eventCount = 5;
+
+    // Event counts; negative where the event could not be counted
+    struct Counts {
+        int64_t value[eventCount] = {-1, -1, -1, -1, -1};
+
+        int64_t operator[](Event event) const { return value[static_cast<size_t>(event)]; }
+        bool has(Event event) const { return (*this)[event] >= 0; }
+        bool empty() const { return !has(Event::Cycles) || (*this)[Event::Cycles] == 0; }
+        void add(const Counts& other);
+
+        // Derived ratios; 0 when a count they need is missing
+        double instructionsPerCycle() const;
+        double perKiloInstruction(Event event) const;
+    };
+
+    // Opens the counters for the calling thread and every pool thread.
+    // Returns false when they are unavailable.
+    static bool enable();
+    static bool enabled() { return active.load(std::memory_order_relaxed); }
+    static const std::string& reason();  // Why enable() failed
+
+    // Pool threads register under their thread index while they run; index
+    // 0 belongs to the thread that called enable()
+    static void registerThread(unsigned thread);
+    static void unregisterThread(unsigned thread);
+
+    static void reset();  // Zeroes the counts gathered so far
+
+    // Threads seen so far, including pool threads that have since stopped
+    static unsigned threadCount();
+    static Counts total(Phase phase);
+    static Counts total(Phase phase, unsigned thread);
+
+    static const char* name(Phase phase);
+    static const char* name(Event event);
+
+    // Totals and ratios per phase, followed by the per-thread counts
+    static void writeReport(std::ostream& out);
+
+    // Used by CounterScope; enter() returns the enclosing phase for leave()
+    static int enter(Phase phase);
+    static void leave(int previous);
+
+private:
+    static std::atomic<bool> active;
+};
+
+// Credits the counts in its lifetime to `phase`
+class CounterScope {
+public:
+    explicit CounterScope(HardwareCounters::Phase phase)
+        : previous(HardwareCounters::enabled() ? HardwareCounters::enter(phase) : notCounting) {}
+    ~CounterScope() {
+        if (previous != notCounting) {
+            HardwareCounters::leave(previous);
+        }
+    }
+
+    CounterScope(const CounterScope&) = delete;
+    CounterScope& operator=(const CounterScope&) = delete;
+
+private:
+    static constexpr int notCounting = -2;  // -1 is "no enclosing phase"
+    int previous;
+};
+
+#endif // HARDWARE_COUNTERS_H
@@ -0,0 +1,237 @@
+#include "InstanceStream.h"
+#include "FrameInterpolator.h"
+#include "FrustumCuller.h"
+#include "Profiler.h"
+#include "Shader.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+const size_t packGrain = 8192;  // Instances per packing task
+
+// Position of the k-th visible instance: bodies first, then test particles
+struct InstancePositions {
+    const BodyStore& store;
+    const TestParticles& particles;
+    const VisibleSet& visible;
+    const FrameInterpolator* interpolator;
+
+    void operator()(size_t k, double& x, double& y) const {
+        size_t bodies = visible.bodies.size();
+        if (k < bodies) {
+            uint32_t i = visible.bodies[k];
+            if (interpolator) {
+                interpolator->bodyPosition(store, i, x, y);
+            } else {
+                x = store.x[i];
+                y = store.y[i];
+            }
+        } else {
+            uint32_t i = visible.particles[k - bodies];
+            if (interpolator) {
+                interpolator->particlePosition(particles, i, x, y);
+            } else {
+                x = particles.x[i];
+                y = particles.y[i];
+            }
+        }
+    }
+};
+
+uint16_t quantize(double fraction) {
+    return static_cast<uint16_t>(std::clamp(fraction * 65535.0 + 0.5, 0.0, 65535.0));
+}
+
+} // namespace
+
+InstanceStream::InstanceStream()
+    : origin{0.0f, 0.0f}, extent{1.0f, 1.0f}, paletteTexels{}, paletteTexture(0), paletteChanged(true) {
+    paletteColors.reserve(paletteSize);
+    glGenTextures(1, &paletteTexture);
+    glBindTexture(GL_TEXTURE_2D, paletteTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, static_cast<GLsizei>(paletteSize), 1, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                 paletteTexels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+InstanceStream::~InstanceStream() {
+    if (paletteTexture != 0) {
+        glDeleteTextures(1, &paletteTexture);
+        paletteTexture = 0;
+    }
+}
+
+uint16_t InstanceStream::encodeScale(float scale) {
+    // Dropping the low 12 bits of a positive float leaves exponent * 2048 +
+    // mantissa, a piecewise-linear log2; the bias puts 2^-16 at zero
+    uint32_t bits;
+    std::memcpy(&bits, &scale, sizeof(bits));
+    int32_t code = static_cast<int32_t>(((bits & 0x7fffffffu) + 0x800u) >> 12) - (127 - 16) * 2048;
+    return static_cast<uint16_t>(std::clamp<int32_t>(code, 0, 65535));
+}
+
+void InstanceStream::pack(const PhysicsEngine& engine, const VisibleSet& visible, const FrustumCuller& culler,
+                          const FrameInterpolator* interpolator) {
+    PROFILE_SCOPE("render.pack");
+    const BodyStore& store = engine.bodies();
+    const size_t bodies = visible.bodies.size();
+    const size_t count = visible.size();
+    packed.resize(count);
+    if (count == 0) {
+        return;
+    }
+
+    const uint32_t particleColor =
+        BodyStore::packColor(culler.particleColor[0], culler.particleColor[1], culler.particleColor[2]);
+    if (paletteIndex.find(particleColor) == paletteIndex.end()) {
+        addColor(particleColor);
+    }
+
+    const InstancePositions position{store, engine.particles, visible, interpolator};
+    ThreadPool& pool = ThreadPool::instance();
+
+    // Bounding box of everything in view, from per-chunk partials
+    chunkBounds.resize(4 * ThreadPool::chunkCount(count, packGrain));
+    double* partial = chunkBounds.data();
+    pool.parallelForChunks(count, packGrain, [&, partial](size_t chunk, size_t begin, size_t end) {
+        double minX = std::numeric_limits<double>::infinity(), minY = minX;
+        double maxX = -minX, maxY = -minX;
+        for (size_t k = begin; k < end; k++) {
+            double x, y;
+            position(k, x, y);
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+        }
+        partial[4 * chunk + 0] = minX;
+        partial[4 * chunk + 1] = minY;
+        partial[4 * chunk + 2] = maxX;
+        partial[4 * chunk + 3] = maxY;
+    });
+    double minX = partial[0], minY = partial[1], maxX = partial[2], maxY = partial[3];
+    for (size_t c = 4; c < chunkBounds.size(); c += 4) {
+        minX = std::min(minX, partial[c + 0]);
+        minY = std::min(minY, partial[c + 1]);
+        maxX = std::max(maxX, partial[c + 2]);
+        maxY = std::max(maxY, partial[c + 3]);
+    }
+    // Quantize against the box the shader will see, in float
+    origin[0] = static_cast<float>(minX);
+    origin[1] = static_cast<float>(minY);
+    extent[0] = std::max(static_cast<float>(maxX - origin[0]), std::numeric_limits<float>::min());
+    extent[1] = std::max(static_cast<float>(maxY - origin[1]), std::numeric_limits<float>::min());
+    const double originX = origin[0], originY = origin[1];
+    const double toUnitX = 1.0 / extent[0], toUnitY = 1.0 / extent[1];
+
+    const float radiusScale = culler.radiusScale;
+    const uint16_t particleScale = encodeScale(culler.particleRadius);
+    const uint8_t particlePalette = paletteIndex.find(particleColor)->second;
+    BodyInstance* out = packed.data();
+    std::atomic<bool> missingColor{false};
+    auto packChunk = [&, out](size_t begin, size_t end, unsigned) {
+        // Neighbours in memory mostly share a color, so the palette lookup is
+        // only repeated when it changes
+        uint32_t lastColor = ~0u;
+        uint8_t lastPalette = 0;
+        for (size_t k = begin; k < end; k++) {
+            double x, y;
+            position(k, x, y);
+            BodyInstance& instance = out[k];
+            instance.x = quantize((x - originX) * toUnitX);
+            instance.y = quantize((y - originY) * toUnitY);
+            instance.reserved = 0;
+            if (k < bodies) {
+                uint32_t i = visible.bodies[k];
+                instance.scale = encodeScale(static_cast<float>(store.radius[i]) * radiusScale);
+                if (store.color[i] != lastColor) {
+                    lastColor = store.color[i];
+                    auto entry = paletteIndex.find(lastColor);
+                    if (entry == paletteIndex.end()) {
+                        missingColor.store(true, std::memory_order_relaxed);
+                        lastPalette = 0;
+                    } else {
+                        lastPalette = entry->second;
+                    }
+                }
+                instance.palette = lastPalette;
+            } else {
+                instance.scale = particleScale;
+                instance.palette = particlePalette;
+            }
+        }
+    };
+    pool.parallelFor(count, packGrain, packChunk);
+
+    // A visible body has a color the palette has not seen: add the visible
+    // colors and pack again. This only happens when new colors come into
+    // view, so the palette costs nothing per frame beyond the visible set.
+    if (missingColor.load(std::memory_order_relaxed)) {
+        updatePalette(store.color, visible.bodies);
+        pool.parallelFor(count, packGrain, packChunk);
+    }
+}
+
+void InstanceStream::bind(const Shader& shader) {
+    glActiveTexture(GL_TEXTURE0 + paletteUnit);
+    glBindTexture(GL_TEXTURE_2D, paletteTexture);
+    if (paletteChanged) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, static_cast<GLsizei>(paletteSize), 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                        paletteTexels);
+        paletteChanged = false;
+    }
+    glActiveTexture(GL_TEXTURE0);
+    shader.setVec4("bounds", origin[0], origin[1], extent[0], extent[1]);
+    shader.setInt("palette", paletteUnit);
+}
+
+void InstanceStream::updatePalette(const std::vector<uint32_t>& colors, const std::vector<uint32_t>& bodies) {
+    // Runs of one color are common, so each run costs a single comparison
+    uint32_t last = ~0u;
+    for (uint32_t i : bodies) {
+        uint32_t color = colors[i];
+        if (color != last) {
+            last = color;
+            if (paletteIndex.find(color) == paletteIndex.end()) {
+                addColor(color);
+            }
+        }
+    }
+}
+
+void InstanceStream::addColor(uint32_t color) {
+    auto channel = [](uint32_t packedColor, int shift) { return static_cast<int>((packedColor >> shift) & 0xff); };
+    if (paletteColors.size() < paletteSize) {
+        size_t index = paletteColors.size();
+        paletteColors.push_back(color);
+        paletteTexels[4 * index + 0] = static_cast<uint8_t>(channel(color, 24));
+        paletteTexels[4 * index + 1] = static_cast<uint8_t>(channel(color, 16));
+        paletteTexels[4 * index + 2] = static_cast<uint8_t>(channel(color, 8));
+        paletteTexels[4 * index + 3] = 255;
+        paletteIndex[color] = static_cast<uint8_t>(index);
+        paletteChanged = true;
+        return;
+    }
+
+    // Full: share the closest entry
+    size_t nearest = 0;
+    int nearestDistance = std::numeric_limits<int>::max();
+    for (size_t index = 0; index < paletteColors.size(); index++) {
+        int distance = 0;
+        for (int shift : {24, 16, 8}) {
+            int difference = channel(color, shift) - channel(paletteColors[index], shift);
+            distance += difference * difference;
+        }
+        if (distance < nearestDistance) {
+            nearestDistance = distance;
+            nearest = index;
+        }
+    }
+    paletteIndex[color] = static_cast<uint8_t>(nearest);
+}
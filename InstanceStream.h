@@ -0,0 +1,76 @@
+#ifndef INSTANCE_STREAM_H
+#define INSTANCE_STREAM_H
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class FrameInterpolator;
+class FrustumCuller;
+class PhysicsEngine;
+class Shader;
+struct VisibleSet;
+
+// One visible body or test particle as uploaded for drawing: 8 bytes where
+// floats for position, scale and color took 24. Decoded in the vertex shaders.
+struct BodyInstance {
+    uint16_t x, y;     // Position across the stream's bounds, 0 to 65535
+    uint16_t scale;    // Mesh scale, see InstanceStream::encodeScale
+    uint8_t palette;   // Color, as an index into the stream's palette
+    uint8_t reserved;  // Zero; keeps instances 4-byte aligned
+};
+
+// Packs the visible set into BodyInstance records for BodyRenderer and
+// DensityRenderer, and keeps the color palette their shaders read.
+//
+// Positions are quantized to 16 bits across the bounding box of the instances
+// in view, which is finer than a pixel at any zoom. Scales keep 5 bits of
+// octave and 11 of mantissa, within 0.03%. Colors go through a palette of
+// up to 256 entries that grows as new colors come into view; past that, new
+// colors share the nearest entry. Packing runs in fixed chunks on the thread
+// pool and only touches the visible instances.
+class InstanceStream {
+public:
+    InstanceStream();
+    ~InstanceStream();
+
+    InstanceStream(const InstanceStream&) = delete;
+    InstanceStream& operator=(const InstanceStream&) = delete;
+
+    // Packs `visible` with the culler's scales and particle color, at the
+    // interpolator's blended positions when there is one
+    void pack(const PhysicsEngine& engine, const VisibleSet& visible, const FrustumCuller& culler,
+              const FrameInterpolator* interpolator);
+
+    const std::vector<BodyInstance>& instances() const { return packed; }
+
+    // Sets the `bounds` and `palette` uniforms of a shader that decodes
+    // instances, and binds the palette texture to paletteUnit
+    void bind(const Shader& shader);
+
+    // A float's exponent (16 octaves either side of 1) and top 11 mantissa
+    // bits, rounded; scales outside the range clamp to its ends
+    static uint16_t encodeScale(float scale);
+
+    static constexpr int paletteUnit = 1;
+    static constexpr size_t paletteSize = 256;
+
+private:
+    // Adds the colors of `bodies` that are not in the palette yet
+    void updatePalette(const std::vector<uint32_t>& colors, const std::vector<uint32_t>& bodies);
+    void addColor(uint32_t color);
+
+    std::vector<BodyInstance> packed;
+    std::vector<double> chunkBounds;  // Min and max per packing chunk
+    float origin[2], extent[2];       // Quantization box of the last pack
+
+    std::vector<uint32_t> paletteColors;  // Packed 0xRRGGBB00, see BodyStore::packColor
+    std::unordered_map<uint32_t, uint8_t> paletteIndex;
+    uint8_t paletteTexels[paletteSize * 4];
+    GLuint paletteTexture;
+    bool paletteChanged;
+};
+
+#endif // INSTANCE_STREAM_H
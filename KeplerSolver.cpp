@@ -0,0 +1,166 @@
+#include "KeplerSolver.h"
+#include <cmath>
+
+namespace {
+const double pi = 3.14159265358979323846;
+const int maxIterations = 64;
+}
+
+void KeplerSolver::stumpff(double z, double& c0, double& c1, double& c2, double& c3) {
+    if (std::fabs(z) < 1e-2) {
+        // Series; the closed forms cancel catastrophically near z = 0
+        c3 = (1.0 - z / 20.0 * (1.0 - z / 42.0 * (1.0 - z / 72.0 * (1.0 - z / 110.0)))) / 6.0;
+        c2 = (1.0 - z / 12.0 * (1.0 - z / 30.0 * (1.0 - z / 56.0 * (1.0 - z / 90.0)))) / 2.0;
+        c1 = 1.0 - z * c3;
+        c0 = 1.0 - z * c2;
+    } else if (z > 0.0) {
+        double root = std::sqrt(z);
+        c0 = std::cos(root);
+        c1 = std::sin(root) / root;
+        c2 = (1.0 - c0) / z;
+        c3 = (1.0 - c1) / z;
+    } else {
+        double root = std::sqrt(-z);
+        c0 = std::cosh(root);
+        c1 = std::sinh(root) / root;
+        c2 = (1.0 - c0) / z;
+        c3 = (1.0 - c1) / z;
+    }
+}
+
+bool KeplerSolver::solve(double mu, double r0, double eta, double beta, double dt, double& s,
+                         double& g1, double& g2, double& g3, double& r) {
+    // Laguerre-Conway iteration; converges from poor starting guesses where
+    // plain Newton can cycle on eccentric orbits
+    const double n = 5.0;
+    for (int iteration = 0; iteration < maxIterations; iteration++) {
+        double c0, c1, c2, c3;
+        stumpff(beta * s * s, c0, c1, c2, c3);
+        double g0 = c0;
+        g1 = s * c1;
+        g2 = s * s * c2;
+        g3 = s * s * s * c3;
+
+        double f = r0 * g1 + eta * g2 + mu * g3 - dt;
+        r = r0 * g0 + eta * g1 + mu * g2;                 // f'(s)
+        double secondDerivative = eta * g0 + (mu - beta * r0) * g1;
+
+        double discriminant = std::fabs((n - 1.0) * (n - 1.0) * r * r - n * (n - 1.0) * f * secondDerivative);
+        double denominator = r + (r >= 0.0 ? 1.0 : -1.0) * std::sqrt(discriminant);
+        if (denominator == 0.0 || !std::isfinite(denominator)) {
+            return false;
+        }
+        double step = n * f / denominator;
+        s -= step;
+        if (std::fabs(step) <= 1e-15 * std::fabs(s) || std::fabs(f) <= 1e-15 * std::fabs(dt)) {
+            stumpff(beta * s * s, c0, c1, c2, c3);
+            g1 = s * c1;
+            g2 = s * s * c2;
+            g3 = s * s * s * c3;
+            r = r0 * c0 + eta * g1 + mu * g2;
+            return std::isfinite(r) && r > 0.0;
+        }
+    }
+    return false;
+}
+
+// Safeguarded Newton on a bracket. The time of flight grows monotonically
+// with s (its derivative is r > 0), so a sign change is always found by
+// doubling; this is slower than Laguerre-Conway but cannot fail, and is
+// only needed for near-radial hyperbolic passages through pericenter.
+bool KeplerSolver::solveBracketed(double mu, double r0, double eta, double beta, double dt, double& s,
+                                  double& g1, double& g2, double& g3, double& r) {
+    auto timeOfFlight = [&](double value, double& derivative) {
+        double c0, c1, c2, c3;
+        stumpff(beta * value * value, c0, c1, c2, c3);
+        g1 = value * c1;
+        g2 = value * value * c2;
+        g3 = value * value * value * c3;
+        derivative = r0 * c0 + eta * g1 + mu * g2;
+        return r0 * g1 + eta * g2 + mu * g3 - dt;
+    };
+
+    double direction = dt >= 0.0 ? 1.0 : -1.0;
+    double inner = 0.0;
+    double outer = direction * std::fabs(dt) / r0;
+    double derivative;
+    for (int doubling = 0; direction * timeOfFlight(outer, derivative) < 0.0; doubling++) {
+        if (doubling == 200) {
+            return false;
+        }
+        inner = outer;
+        outer *= 2.0;
+    }
+
+    s = 0.5 * (inner + outer);
+    for (int iteration = 0; iteration < 4 * maxIterations; iteration++) {
+        double f = timeOfFlight(s, derivative);
+        if (direction * f < 0.0) {
+            inner = s;
+        } else {
+            outer = s;
+        }
+        double next = s - f / derivative;
+        if (!std::isfinite(next) || (next - inner) * (next - outer) > 0.0) {
+            next = 0.5 * (inner + outer);  // Newton left the bracket; bisect instead
+        }
+        // Looser than Laguerre-Conway: near pericenter the terms of f are
+        // much larger than dt and round-off keeps f from getting closer
+        if (std::fabs(next - s) <= 1e-15 * std::fabs(s) || std::fabs(f) <= 1e-14 * std::fabs(dt) ||
+            std::fabs(outer - inner) <= 1e-14 * std::fabs(s)) {
+            s = next;
+            timeOfFlight(s, r);
+            return std::isfinite(r) && r > 0.0;
+        }
+        s = next;
+    }
+    return false;
+}
+
+bool KeplerSolver::drift(double mu, double& x, double& y, double& vx, double& vy, double dt) {
+    double r0 = std::sqrt(x * x + y * y);
+    if (r0 == 0.0 || mu <= 0.0) {
+        return false;
+    }
+    double v2 = vx * vx + vy * vy;
+    double eta = x * vx + y * vy;
+    double beta = 2.0 * mu / r0 - v2;
+
+    // Whole periods of a bound orbit change nothing; dropping them keeps s small
+    if (beta > 0.0) {
+        double period = 2.0 * pi * mu / (beta * std::sqrt(beta));
+        if (std::fabs(dt) > period) {
+            dt = std::fmod(dt, period);
+        }
+    }
+
+    // Initial guess: s ~ dt / r0 for short steps, the mean-motion estimate otherwise
+    double s = dt / r0;
+    if (beta > 0.0 && std::fabs(dt) > 0.1 * r0 * r0 / std::sqrt(mu * r0)) {
+        s = dt * beta / mu;
+    }
+
+    double g1, g2, g3, r;
+    if (!solve(mu, r0, eta, beta, dt, s, g1, g2, g3, r)) {
+        // Retry from the short-step guess before giving up
+        s = dt / r0;
+        if (!solve(mu, r0, eta, beta, dt, s, g1, g2, g3, r) && !solveBracketed(mu, r0, eta, beta, dt, s, g1, g2, g3, r)) {
+            return false;
+        }
+    }
+
+    double f = 1.0 - mu * g2 / r0;
+    double g = dt - mu * g3;
+    double fDot = -mu * g1 / (r0 * r);
+    double gDot = 1.0 - mu * g2 / r;
+
+    double newX = f * x + g * vx;
+    double newY = f * y + g * vy;
+    double newVx = fDot * x + gDot * vx;
+    double newVy = fDot * y + gDot * vy;
+    x = newX;
+    y = newY;
+    vx = newVx;
+    vy = newVy;
+    return true;
+}
@@ -0,0 +1,28 @@
+#ifndef KEPLER_SOLVER_H
+#define KEPLER_SOLVER_H
+
+// Analytic two-body propagation in universal variables.
+//
+// drift() advances a body relative to a point mass with gravitational
+// parameter mu = G * M by solving the universal Kepler equation for the
+// universal anomaly s,
+//     r0 G1(s) + (r0 . v0) G2(s) + mu G3(s) = dt,   G_k(s) = s^k c_k(beta s^2),
+// with the Stumpff functions c_k and beta = 2 mu / r0 - v0^2, then applying
+// the f and g functions. The same code handles elliptic, parabolic and
+// hyperbolic orbits and is exact up to round-off for any step length.
+class KeplerSolver {
+public:
+    // Returns false (leaving the state untouched) if the solver did not converge
+    static bool drift(double mu, double& x, double& y, double& vx, double& vy, double dt);
+
+    // Stumpff functions c0..c3 of z
+    static void stumpff(double z, double& c0, double& c1, double& c2, double& c3);
+
+private:
+    static bool solve(double mu, double r0, double eta, double beta, double dt, double& s,
+                      double& g1, double& g2, double& g3, double& r);
+    static bool solveBracketed(double mu, double r0, double eta, double beta, double dt, double& s,
+                               double& g1, double& g2, double& g3, double& r);
+};
+
+#endif // KEPLER_SOLVER_H
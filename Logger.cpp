@@ -0,0 +1,243 @@
+#include "Logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct LogRecord {
+    static constexpr size_t textCapacity = 1000;  // Fits shader info logs
+
+    uint64_t timeNs;
+    uint32_t length;
+    LogLevel level;
+    char text[textCapacity];
+};
+
+namespace {
+
+const auto sinkInterval = std::chrono::milliseconds(10);
+
+// Single-producer single-consumer ring. The owning thread fills the slot at
+// `head` and publishes it with a release store; the sink reads up to `head`
+// and hands slots back by advancing `tail`.
+struct LogRing {
+    static constexpr size_t capacity = 256;  // Power of two
+    static constexpr size_t mask = capacity - 1;
+
+    std::unique_ptr<LogRecord[]> records;
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> tail;
+    std::atomic<uint64_t> dropped;
+
+    LogRing() : records(new LogRecord[capacity]), head(0), tail(0), dropped(0) {}
+};
+
+// Owns every ring ever created (rings outlive their threads so late records
+// are still written) and the sink thread. The registry mutex is taken only
+// when a thread logs for the first time and by the sink.
+class Sink {
+public:
+    ~Sink() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        if (worker.joinable()) {
+            worker.join();
+        }
+        drain();
+    }
+
+    LogRing* addRing() {
+        std::lock_guard<std::mutex> lock(mutex);
+        rings.emplace_back(new LogRing());
+        if (!worker.joinable()) {
+            running = true;
+            worker = std::thread([this] { loop(); });
+        }
+        return rings.back().get();
+    }
+
+    void drain() {
+        std::lock_guard<std::mutex> drainLock(drainMutex);
+        std::vector<LogRing*> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (const std::unique_ptr<LogRing>& ring : rings) {
+                snapshot.push_back(ring.get());
+            }
+        }
+
+        // Merge the rings by timestamp so lines from different threads keep
+        // their order
+        pending.clear();
+        std::vector<uint64_t> heads(snapshot.size());
+        uint64_t droppedNow = 0;
+        for (size_t r = 0; r < snapshot.size(); r++) {
+            LogRing* ring = snapshot[r];
+            heads[r] = ring->head.load(std::memory_order_acquire);
+            for (uint64_t i = ring->tail.load(std::memory_order_relaxed); i < heads[r]; i++) {
+                const LogRecord& record = ring->records[i & LogRing::mask];
+                pending.push_back({record.timeNs, &record});
+            }
+            droppedNow += ring->dropped.exchange(0, std::memory_order_relaxed);
+        }
+        std::stable_sort(pending.begin(), pending.end(),
+                         [](const Pending& a, const Pending& b) { return a.timeNs < b.timeNs; });
+
+        bool wroteOut = false, wroteErr = false;
+        for (const Pending& entry : pending) {
+            const LogRecord& record = *entry.record;
+            bool isError = record.level >= LogLevel::Warning;
+            FILE* stream = isError ? stderr : stdout;
+            std::fwrite(record.text, 1, record.length, stream);
+            std::fputc('\n', stream);
+            (isError ? wroteErr : wroteOut) = true;
+        }
+        if (droppedNow > 0) {
+            std::fprintf(stderr, "Logger: dropped %llu records, ring full\n", static_cast<unsigned long long>(droppedNow));
+            droppedTotal.fetch_add(droppedNow, std::memory_order_relaxed);
+            wroteErr = true;
+        }
+        if (wroteOut) {
+            std::fflush(stdout);
+        }
+        if (wroteErr) {
+            std::fflush(stderr);
+        }
+
+        for (size_t r = 0; r < snapshot.size(); r++) {
+            snapshot[r]->tail.store(heads[r], std::memory_order_release);
+        }
+    }
+
+    uint64_t dropped() const { return droppedTotal.load(std::memory_order_relaxed); }
+
+    size_t queued() {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t total = 0;
+        for (const std::unique_ptr<LogRing>& ring : rings) {
+            total += ring->head.load(std::memory_order_acquire) - ring->tail.load(std::memory_order_acquire);
+        }
+        return total;
+    }
+
+private:
+    struct Pending {
+        uint64_t timeNs;
+        const LogRecord* record;
+    };
+
+    void loop() {
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!running) {
+                    return;
+                }
+            }
+            drain();
+            std::this_thread::sleep_for(sinkInterval);
+        }
+    }
+
+    std::mutex mutex;       // Guards rings, worker and running
+    std::mutex drainMutex;  // One consumer at a time
+    std::vector<std::unique_ptr<LogRing>> rings;
+    std::vector<Pending> pending;
+    std::thread worker;
+    bool running = false;
+    std::atomic<uint64_t> droppedTotal{0};
+};
+
+Sink& sink() {
+    static Sink instance;
+    return instance;
+}
+
+LogRing* threadRing() {
+    thread_local LogRing* ring = sink().addRing();
+    return ring;
+}
+
+int levelFromEnvironment() {
+    const char* value = std::getenv("GRAVITY_LOG");
+    if (!value) {
+        return static_cast<int>(LogLevel::Info);
+    }
+    const char* names[] = {"debug", "info", "warning", "error", "off"};
+    for (int level = 0; level < 5; level++) {
+        if (std::strcmp(value, names[level]) == 0) {
+            return level;
+        }
+    }
+    std::fprintf(stderr, "Unknown GRAVITY_LOG level '%s', using info\n", value);
+    return static_cast<int>(LogLevel::Info);
+}
+
+} // namespace
+
+std::atomic<int> Logger::runtimeLevel{levelFromEnvironment()};
+
+void Logger::flush() {
+    sink().drain();
+}
+
+uint64_t Logger::droppedCount() {
+    return sink().dropped();
+}
+
+size_t Logger::queuedCount() {
+    return sink().queued();
+}
+
+uint64_t Logger::nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+bool LogRateLimit::admit() {
+    uint64_t now = Logger::nowNs();
+    uint64_t start = windowStart.load(std::memory_order_relaxed);
+    if (now - start >= windowNs && windowStart.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+        count.store(0, std::memory_order_relaxed);
+    }
+    if (count.fetch_add(1, std::memory_order_relaxed) < burst) {
+        return true;
+    }
+    suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+LogRecordWriter::LogRecordWriter(LogLevel level, uint32_t suppressed)
+    : record(nullptr), suppressed(suppressed), out(&buffer) {
+    LogRing* ring = threadRing();
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= LogRing::capacity) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        out.setstate(std::ios::badbit);
+        return;
+    }
+    record = &ring->records[head & LogRing::mask];
+    record->timeNs = Logger::nowNs();
+    record->level = level;
+    buffer.reset(record->text, LogRecord::textCapacity);
+}
+
+LogRecordWriter::~LogRecordWriter() {
+    if (!record) {
+        return;
+    }
+    if (suppressed > 0) {
+        out << " (" << suppressed << " similar messages suppressed)";
+    }
+    record->length = static_cast<uint32_t>(buffer.size());
+    LogRing* ring = threadRing();
+    ring->head.store(ring->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
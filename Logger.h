@@ -0,0 +1,120 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+// Leveled, asynchronous logging for code on the frame path.
+//
+// LOG_INFO("Loaded " << count << " bodies") formats the message into a
+// fixed-size record in the calling thread's ring buffer; a background sink
+// thread drains all rings every few milliseconds and writes the records with
+// one buffered write per batch (info and debug to stdout, warnings and
+// errors to stderr). Producers never take a lock, allocate or make a system
+// call after a thread's first message, and drop records rather than wait
+// when their ring is full.
+//
+// Levels are checked twice: statements below GRAVITY_LOG_MIN_LEVEL (CMake
+// option GRAVITY_LOG_LEVEL) are compiled out, and statements below the
+// runtime level (Logger::setLevel, or the GRAVITY_LOG environment variable:
+// debug, info, warning, error, off) cost one relaxed atomic load. Each call
+// site passes at most `LogRateLimit::burst` messages per window; the rest are
+// counted and reported with the next message that gets through.
+//
+// The sink thread does not survive fork(). Processes that fork should not
+// log before forking, or only from the child.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+
+struct LogRecord;
+
+enum class LogLevel : int { Debug = 0, Info = 1, Warning = 2, Error = 3, Off = 4 };
+
+#ifndef GRAVITY_LOG_MIN_LEVEL
+#define GRAVITY_LOG_MIN_LEVEL 0
+#endif
+
+class Logger {
+public:
+    static bool enabled(LogLevel level) {
+        return static_cast<int>(level) >= runtimeLevel.load(std::memory_order_relaxed);
+    }
+    static void setLevel(LogLevel level) { runtimeLevel.store(static_cast<int>(level), std::memory_order_relaxed); }
+    static LogLevel level() { return static_cast<LogLevel>(runtimeLevel.load(std::memory_order_relaxed)); }
+
+    // Blocks until everything logged so far has been written
+    static void flush();
+
+    // Records dropped because a thread's ring was full
+    static uint64_t droppedCount();
+
+    // Records written but not yet picked up by the sink thread
+    static size_t queuedCount();
+
+    static uint64_t nowNs();  // Steady clock, as stamped on records
+
+private:
+    friend class LogRecordWriter;
+    static std::atomic<int> runtimeLevel;
+};
+
+// Per-call-site limiter: `burst` messages per `windowNs`
+class LogRateLimit {
+public:
+    static constexpr uint32_t burst = 5;
+    static constexpr uint64_t windowNs = 5000000000ull;
+
+    bool admit();
+    uint32_t takeSuppressed() { return suppressed.exchange(0, std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> windowStart{0};
+    std::atomic<uint32_t> count{0};
+    std::atomic<uint32_t> suppressed{0};
+};
+
+// Formats one message in place in the calling thread's ring and publishes it
+// on destruction. Messages longer than a record are truncated.
+class LogRecordWriter {
+public:
+    LogRecordWriter(LogLevel level, uint32_t suppressed);
+    ~LogRecordWriter();
+
+    std::ostream& stream() { return out; }
+
+    LogRecordWriter(const LogRecordWriter&) = delete;
+    LogRecordWriter& operator=(const LogRecordWriter&) = delete;
+
+private:
+    // Writes straight into the record's text; stops (and fails the stream)
+    // when the record is full
+    class FixedBuffer : public std::streambuf {
+    public:
+        void reset(char* begin, size_t capacity) { setp(begin, begin + capacity); }
+        size_t size() const { return static_cast<size_t>(pptr() - pbase()); }
+    };
+
+    LogRecord* record;
+    uint32_t suppressed;
+    FixedBuffer buffer;
+    std::ostream out;
+};
+
+#define GRAVITY_LOG(level, message)                                                      \
+    do {                                                                                 \
+        if (static_cast<int>(level) >= GRAVITY_LOG_MIN_LEVEL && Logger::enabled(level)) { \
+            static LogRateLimit logRateLimit;                                            \
+            if (logRateLimit.admit()) {                                                  \
+                LogRecordWriter logWriter(level, logRateLimit.takeSuppressed());         \
+                logWriter.stream() << message;                                           \
+            }                                                                            \
+        }                                                                                \
+    } while (0)
+
+#define LOG_DEBUG(message) GRAVITY_LOG(LogLevel::Debug, message)
+#define LOG_INFO(message) GRAVITY_LOG(LogLevel::Info, message)
+#define LOG_WARNING(message) GRAVITY_LOG(LogLevel::Warning, message)
+#define LOG_ERROR(message) GRAVITY_LOG(LogLevel::Error, message)
+
+#endif // LOGGER_H
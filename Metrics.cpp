@@ -0,0 +1,126 @@
+#include "Metrics.h"
+#include "Benchmark.h"
+#include "Logger.h"
+#include <cmath>
+#include <cstdio>
+#include <unistd.h>
+
+namespace {
+
+const double rateWindowSeconds = 1.0;  // Stepping time per steps-per-second sample
+
+// Prometheus spells the special values NaN, +Inf and -Inf
+void writeValue(std::ostream& out, double value) {
+    if (std::isnan(value)) {
+        out << "NaN";
+    } else if (std::isinf(value)) {
+        out << (value > 0.0 ? "+Inf" : "-Inf");
+    } else {
+        out.precision(15);  // Byte and step counts print exactly
+        out << value;
+    }
+}
+
+void writeHeader(std::ostream& out, const char* name, const char* type, const char* help) {
+    out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n';
+}
+
+void writeMetric(std::ostream& out, const char* name, const char* type, const char* help, double value) {
+    writeHeader(out, name, type, help);
+    out << name << ' ';
+    writeValue(out, value);
+    out << '\n';
+}
+
+// Current resident set size; 0 where /proc is not available
+size_t residentBytes() {
+    size_t bytes = 0;
+    if (FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        unsigned long totalPages = 0, residentPages = 0;
+        if (std::fscanf(statm, "%lu %lu", &totalPages, &residentPages) == 2) {
+            bytes = static_cast<size_t>(residentPages) * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        }
+        std::fclose(statm);
+    }
+    return bytes;
+}
+
+} // namespace
+
+const char* EngineMetrics::phaseName(Phase phase) {
+    switch (phase) {
+        case Reorder: return "reorder";
+        case Encounters: return "encounters";
+        case Forces: return "forces";
+        case Integration: return "integration";
+        case Collisions: return "collisions";
+        default: return "unknown";
+    }
+}
+
+EngineMetrics::EngineMetrics()
+    : steps(0), rejectedSteps(0), stepSeconds(0.0), stepsPerSecond(0.0), bodies(0), particles(0), simulationTime(0.0),
+      energyDrift(std::nan("")), queuedBytes(0), windowSteps(0), windowSeconds(0.0) {
+    for (std::atomic<double>& seconds : phaseSeconds) {
+        seconds.store(0.0, std::memory_order_relaxed);
+    }
+}
+
+void EngineMetrics::recordSteps(uint64_t count, double seconds) {
+    steps.store(steps.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+    add(stepSeconds, seconds);
+    windowSteps += count;
+    windowSeconds += seconds;
+    if (windowSeconds >= rateWindowSeconds) {
+        stepsPerSecond.store(windowSteps / windowSeconds, std::memory_order_relaxed);
+        windowSteps = 0;
+        windowSeconds = 0.0;
+    }
+}
+
+void EngineMetrics::setBodies(size_t bodyCount, size_t particleCount) {
+    bodies.store(bodyCount, std::memory_order_relaxed);
+    particles.store(particleCount, std::memory_order_relaxed);
+}
+
+void EngineMetrics::writePrometheus(std::ostream& out) const {
+    writeMetric(out, "gravity_steps_total", "counter",
+                "Steps computed, including rejected ones; accepted steps are this minus gravity_rejected_steps_total",
+                static_cast<double>(steps.load(std::memory_order_relaxed)));
+    writeMetric(out, "gravity_rejected_steps_total", "counter",
+                "Steps rolled back because their interval exceeded the energy error budget",
+                static_cast<double>(rejectedSteps.load(std::memory_order_relaxed)));
+    writeMetric(out, "gravity_step_seconds_total", "counter", "Wall time spent stepping",
+                stepSeconds.load(std::memory_order_relaxed));
+    writeMetric(out, "gravity_steps_per_second", "gauge", "Step rate over the last second of stepping",
+                stepsPerSecond.load(std::memory_order_relaxed));
+
+    writeHeader(out, "gravity_step_phase_seconds_total", "counter", "Wall time spent in each phase of a step");
+    for (int phase = 0; phase < phaseCount; phase++) {
+        out << "gravity_step_phase_seconds_total{phase=\"" << phaseName(static_cast<Phase>(phase)) << "\"} ";
+        writeValue(out, phaseSeconds[phase].load(std::memory_order_relaxed));
+        out << '\n';
+    }
+
+    writeMetric(out, "gravity_bodies", "gauge", "Massive bodies in the simulation",
+                static_cast<double>(bodies.load(std::memory_order_relaxed)));
+    writeMetric(out, "gravity_test_particles", "gauge", "Massless test particles in the simulation",
+                static_cast<double>(particles.load(std::memory_order_relaxed)));
+    writeMetric(out, "gravity_simulation_time", "gauge", "Simulated time in simulation units",
+                simulationTime.load(std::memory_order_relaxed));
+    writeMetric(out, "gravity_energy_drift", "gauge",
+                "Relative energy change since the start at the last measurement; NaN before one", energyDrift.load(std::memory_order_relaxed));
+    writeMetric(out, "gravity_ring_queued_bytes", "gauge", "Unread bytes in the inter-process rings",
+                static_cast<double>(queuedBytes.load(std::memory_order_relaxed)));
+}
+
+void writeProcessMetrics(std::ostream& out) {
+    writeMetric(out, "gravity_resident_memory_bytes", "gauge", "Resident set size",
+                static_cast<double>(residentBytes()));
+    writeMetric(out, "gravity_peak_resident_memory_bytes", "gauge", "Peak resident set size",
+                static_cast<double>(Benchmark::peakResidentBytes()));
+    writeMetric(out, "gravity_log_queued_records", "gauge", "Log records waiting for the sink thread",
+                static_cast<double>(Logger::queuedCount()));
+    writeMetric(out, "gravity_log_dropped_records_total", "counter", "Log records dropped because a ring was full",
+                static_cast<double>(Logger::droppedCount()));
+}
@@ -0,0 +1,67 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Live performance counters of one engine, for the metrics endpoint.
+//
+// An engine publishes into the block attached to it (PhysicsEngine::metrics,
+// DistributedEngine::metrics); without one it skips the extra clock reads.
+// Every value has a single writer, the thread stepping that engine, so
+// updates are relaxed loads and stores rather than read-modify-writes and
+// never contend with anything. Readers, normally the metrics server thread,
+// may load them at any time; a scrape sees each value on its own, not a
+// consistent snapshot of all of them.
+class EngineMetrics {
+public:
+    enum Phase { Reorder, Encounters, Forces, Integration, Collisions, phaseCount };
+    static const char* phaseName(Phase phase);
+
+    EngineMetrics();
+
+    EngineMetrics(const EngineMetrics&) = delete;
+    EngineMetrics& operator=(const EngineMetrics&) = delete;
+
+    // Writer side: only the thread that steps the engine
+    void recordSteps(uint64_t count, double seconds);
+    // Steps already recorded that the timestep controller rolled back
+    void recordRejectedSteps(uint64_t count) {
+        rejectedSteps.store(rejectedSteps.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+    }
+    void addPhaseTime(Phase phase, double seconds) { add(phaseSeconds[phase], seconds); }
+    void setBodies(size_t bodies, size_t particles);
+    void setSimulationTime(double time) { simulationTime.store(time, std::memory_order_relaxed); }
+    void setEnergyDrift(double drift) { energyDrift.store(drift, std::memory_order_relaxed); }
+    void setQueuedBytes(size_t bytes) { queuedBytes.store(bytes, std::memory_order_relaxed); }
+
+    // Reader side: any thread. Prometheus text exposition format.
+    void writePrometheus(std::ostream& out) const;
+
+private:
+    static void add(std::atomic<double>& value, double amount) {
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> steps;  // Including rejected ones
+    std::atomic<uint64_t> rejectedSteps;
+    std::atomic<double> stepSeconds;
+    std::atomic<double> stepsPerSecond;  // Over the last full rate window
+    std::atomic<double> phaseSeconds[phaseCount];
+    std::atomic<uint64_t> bodies;
+    std::atomic<uint64_t> particles;
+    std::atomic<double> simulationTime;
+    std::atomic<double> energyDrift;
+    std::atomic<uint64_t> queuedBytes;  // Unread bytes in inter-process rings
+
+    // Writer-private accumulation for stepsPerSecond
+    uint64_t windowSteps;
+    double windowSeconds;
+};
+
+// Process-wide values sampled when scraped: memory use and the logger queue
+void writeProcessMetrics(std::ostream& out);
+
+#endif // METRICS_H
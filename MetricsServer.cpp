@@ -0,0 +1,150 @@
+#include "MetricsServer.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+const int pollIntervalMs = 200;     // How quickly stop() is noticed
+const size_t maxRequestBytes = 8192;
+
+#ifdef MSG_NOSIGNAL
+const int sendFlags = MSG_NOSIGNAL;  // A scraper hanging up must not kill the run
+#else
+const int sendFlags = 0;             // macOS: SO_NOSIGPIPE is set on the socket instead
+#endif
+
+void sendAll(int socket, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(socket, data.data() + sent, data.size() - sent, sendFlags);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return;
+        }
+        sent += static_cast<size_t>(n);
+    }
+}
+
+std::string response(const char* status, const char* contentType, const std::string& body) {
+    std::ostringstream out;
+    out << "HTTP/1.1 " << status << "\r\n"
+        << "Content-Type: " << contentType << "\r\n"
+        << "Content-Length: " << body.size() << "\r\n"
+        << "Connection: close\r\n\r\n"
+        << body;
+    return out.str();
+}
+
+} // namespace
+
+MetricsServer::MetricsServer(const EngineMetrics& metrics)
+    : metrics(metrics), listener(-1), boundPort(0), running(false) {}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+void MetricsServer::start(uint16_t port) {
+    if (running) {
+        return;
+    }
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw std::runtime_error(std::string("Metrics server: socket failed: ") + std::strerror(errno));
+    }
+    int yes = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, 8) != 0) {
+        std::string error = std::strerror(errno);
+        close(listener);
+        listener = -1;
+        throw std::runtime_error("Metrics server: cannot listen on port " + std::to_string(port) + ": " + error);
+    }
+    socklen_t length = sizeof(address);
+    getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+    boundPort = ntohs(address.sin_port);
+
+    running = true;
+    worker = std::thread([this] { serve(); });
+}
+
+void MetricsServer::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    worker.join();
+    close(listener);
+    listener = -1;
+}
+
+void MetricsServer::serve() {
+    while (running) {
+        pollfd entry{listener, POLLIN, 0};
+        if (poll(&entry, 1, pollIntervalMs) <= 0) {
+            continue;
+        }
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        respond(client);
+        close(client);
+    }
+}
+
+void MetricsServer::respond(int client) {
+    // A slow or silent client must not stall the server for long
+    timeval timeout{1, 0};
+    setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+    int yes = 1;
+    setsockopt(client, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+#endif
+
+    // Only the request line matters; read until the end of the headers
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < maxRequestBytes) {
+        ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        request.append(buffer, static_cast<size_t>(n));
+    }
+
+    std::istringstream line(request.substr(0, request.find("\r\n")));
+    std::string method, target;
+    line >> method >> target;
+    if (method != "GET") {
+        sendAll(client, response("405 Method Not Allowed", "text/plain", "Only GET is supported\n"));
+        return;
+    }
+    if (target != "/metrics") {
+        sendAll(client, response("404 Not Found", "text/plain", "Metrics are served at /metrics\n"));
+        return;
+    }
+    std::ostringstream body;
+    metrics.writePrometheus(body);
+    writeProcessMetrics(body);
+    sendAll(client, response("200 OK", "text/plain; version=0.0.4; charset=utf-8", body.str()));
+}
@@ -0,0 +1,42 @@
+#ifndef METRICS_SERVER_H
+#define METRICS_SERVER_H
+
+#include "Metrics.h"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// Minimal HTTP endpoint for Prometheus: answers GET /metrics with the engine
+// and process metrics in the text exposition format, from its own thread.
+//
+// The listener binds to the loopback interface only and serves one
+// connection at a time; a scrape is a few kilobytes, so nothing more is
+// needed to watch a run. Start it after forking any worker processes - the
+// server thread, like every thread, stays behind in the parent.
+class MetricsServer {
+public:
+    explicit MetricsServer(const EngineMetrics& metrics);
+    ~MetricsServer();
+
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+
+    // Binds 127.0.0.1:port (0 picks a free port) and starts serving. Throws
+    // std::runtime_error when the port cannot be bound.
+    void start(uint16_t port);
+    void stop();
+
+    uint16_t port() const { return boundPort; }
+
+private:
+    void serve();
+    void respond(int client);
+
+    const EngineMetrics& metrics;
+    int listener;
+    uint16_t boundPort;
+    std::atomic<bool> running;
+    std::thread worker;
+};
+
+#endif // METRICS_SERVER_H
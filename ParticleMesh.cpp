@@ -0,0 +1,481 @@
+#include "ParticleMesh.h"
+#include "Arena.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+const double sqrtPi = 1.7724538509055160273;
+const int marginCells = 5;        // Free cells around the bodies for stencils and snapping
+const size_t bodyGrain = 256;     // Bodies per task in the interpolation and short-range loops
+const size_t rowGrain = 8;        // Grid rows per task in the transforms and the row-ordered deposit
+
+using Complex = std::complex<double>;
+
+// In-place iterative radix-2 FFT of length n (a power of two). The inverse
+// transform is unnormalized.
+void fft(Complex* data, size_t n, const Complex* twiddles, bool inverse) {
+    for (size_t i = 1, j = 0; i < n; i++) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(data[i], data[j]);
+        }
+    }
+    for (size_t length = 2; length <= n; length <<= 1) {
+        size_t half = length >> 1;
+        size_t stride = n / length;
+        for (size_t start = 0; start < n; start += length) {
+            for (size_t k = 0; k < half; k++) {
+                Complex w = twiddles[k * stride];
+                if (inverse) {
+                    w = std::conj(w);
+                }
+                Complex u = data[start + k];
+                Complex v = data[start + k + half] * w;
+                data[start + k] = u + v;
+                data[start + k + half] = u - v;
+            }
+        }
+    }
+}
+
+// Row-major n x n transform: rows, then columns through a gathered copy
+void fft2d(std::vector<Complex>& grid, size_t n, bool inverse) {
+    ArenaScope scratch;
+    Complex* twiddles = scratch.allocate<Complex>(n / 2);
+    for (size_t k = 0; k < n / 2; k++) {
+        twiddles[k] = std::polar(1.0, -2.0 * pi * k / n);
+    }
+    ThreadPool& pool = ThreadPool::instance();
+    pool.parallelFor(n, rowGrain, [&](size_t begin, size_t end, unsigned) {
+        for (size_t row = begin; row < end; row++) {
+            fft(grid.data() + row * n, n, twiddles, inverse);
+        }
+    });
+    pool.parallelFor(n, rowGrain, [&](size_t begin, size_t end, unsigned) {
+        ArenaScope columnScratch;  // This worker's own arena
+        Complex* column = columnScratch.allocate<Complex>(n);
+        for (size_t c = begin; c < end; c++) {
+            for (size_t r = 0; r < n; r++) {
+                column[r] = grid[r * n + c];
+            }
+            fft(column, n, twiddles, inverse);
+            for (size_t r = 0; r < n; r++) {
+                grid[r * n + c] = column[r];
+            }
+        }
+    });
+}
+
+} // namespace
+
+ParticleMesh::ParticleMesh()
+    : gridSize(256), assignment(Assignment::TriangularShapedCloud), shortRangeCorrection(false), splitScale(1.25),
+      cutoffScale(4.5), deterministic(false), posX(nullptr), posY(nullptr), masses(nullptr), bodyCount(0), softening2(0.0), cell(1.0),
+      gridOriginX(0.0), gridOriginY(0.0), totalMass(0.0), centerX(0.0), centerY(0.0), kernelCell(0.0),
+      kernelGridSize(0), kernelSplit(false), kernelSplitScale(0.0), listCell(1.0), listOriginX(0.0), listOriginY(0.0),
+      listWidth(0), listHeight(0) {}
+
+void ParticleMesh::build(const double* x, const double* y, const double* mass, size_t count, double softening) {
+    PROFILE_SCOPE("physics.mesh");
+    posX = x;
+    posY = y;
+    masses = mass;
+    bodyCount = count;
+    softening2 = softening * softening;
+    if (count == 0) {
+        return;
+    }
+    chooseGeometry();
+    deposit();
+    prepareKernel();
+    solve();
+    differentiate();
+    if (shortRangeCorrection) {
+        buildCellList();
+    }
+}
+
+// Square grid over the bodies with a power-of-two cell size, so the kernel
+// transform can be reused for as long as the system's extent stays within
+// the same factor of two
+void ParticleMesh::chooseGeometry() {
+    unsigned size = 16;
+    while (size < gridSize) {
+        size <<= 1;
+    }
+    gridSize = size;
+
+    double minX = posX[0], maxX = posX[0], minY = posY[0], maxY = posY[0];
+    double m = 0.0, mx = 0.0, my = 0.0;
+    for (size_t i = 0; i < bodyCount; i++) {
+        minX = std::min(minX, posX[i]);
+        maxX = std::max(maxX, posX[i]);
+        minY = std::min(minY, posY[i]);
+        maxY = std::max(maxY, posY[i]);
+        m += masses[i];
+        mx += masses[i] * posX[i];
+        my += masses[i] * posY[i];
+    }
+    totalMass = m;
+    centerX = m > 0.0 ? mx / m : 0.5 * (minX + maxX);
+    centerY = m > 0.0 ? my / m : 0.5 * (minY + maxY);
+
+    double extent = std::max(maxX - minX, maxY - minY);
+    if (extent <= 0.0) {
+        extent = 1.0;
+    }
+    int usable = static_cast<int>(gridSize) - 2 * marginCells;
+    cell = std::exp2(std::ceil(std::log2(extent / usable)));
+    double half = 0.5 * gridSize * cell;
+    gridOriginX = std::floor(0.5 * (minX + maxX) / cell) * cell - half;
+    gridOriginY = std::floor(0.5 * (minY + maxY) / cell) * cell - half;
+}
+
+int ParticleMesh::stencil(double position, double origin, double weights[3]) const {
+    double u = (position - origin) / cell - 0.5;  // In units of cells, relative to cell centers
+    if (assignment == Assignment::CloudInCell) {
+        double base = std::floor(u);
+        double f = u - base;
+        weights[0] = 1.0 - f;
+        weights[1] = f;
+        weights[2] = 0.0;
+        return static_cast<int>(base);
+    }
+    double nearest = std::floor(u + 0.5);
+    double d = u - nearest;
+    weights[0] = 0.5 * (0.5 - d) * (0.5 - d);
+    weights[1] = 0.75 - d * d;
+    weights[2] = 0.5 * (0.5 + d) * (0.5 + d);
+    return static_cast<int>(nearest) - 1;
+}
+
+void ParticleMesh::deposit() {
+    if (deterministic) {
+        depositByRows();
+        return;
+    }
+    const size_t n = gridSize;
+    ThreadPool& pool = ThreadPool::instance();
+    // Per-thread grids are kept between steps; only the threads that take
+    // part in this step clear and fill theirs
+    depositPartials.resize(pool.threadCount());
+    depositUsed.assign(pool.threadCount(), 0);
+    pool.parallelFor(bodyCount, 4096, [&](size_t begin, size_t end, unsigned thread) {
+        std::vector<double>& grid = depositPartials[thread];
+        if (!depositUsed[thread]) {
+            grid.assign(n * n, 0.0);
+            depositUsed[thread] = 1;
+        }
+        for (size_t i = begin; i < end; i++) {
+            double wx[3], wy[3];
+            int bx = stencil(posX[i], gridOriginX, wx);
+            int by = stencil(posY[i], gridOriginY, wy);
+            for (int a = 0; a < 3; a++) {
+                double* row = grid.data() + static_cast<size_t>(by + a) * n;
+                for (int b = 0; b < 3; b++) {
+                    row[bx + b] += masses[i] * wy[a] * wx[b];
+                }
+            }
+        }
+    });
+
+    density.assign(n * n, 0.0);
+    for (size_t t = 0; t < depositPartials.size(); t++) {
+        if (!depositUsed[t]) {
+            continue;
+        }
+        const std::vector<double>& grid = depositPartials[t];
+        for (size_t k = 0; k < n * n; k++) {
+            density[k] += grid[k];
+        }
+    }
+}
+
+// The per-thread grids above are summed in an order that depends on which
+// thread took which bodies. Here the bodies are instead bucketed by the
+// first row of their stencil and strips of rows are filled in parallel, each
+// writing only its own rows: every cell receives its contributions in the
+// same order (by stencil row, then by body index) however the strips are
+// spread over threads, and no per-thread grids are needed.
+void ParticleMesh::depositByRows() {
+    const size_t n = gridSize;
+    ArenaScope scratch;
+    uint32_t* bodyRow = scratch.allocate<uint32_t>(bodyCount);
+    uint32_t* rowStart = scratch.allocateFilled<uint32_t>(n + 1, 0);
+    for (size_t i = 0; i < bodyCount; i++) {
+        double wy[3];
+        bodyRow[i] = static_cast<uint32_t>(stencil(posY[i], gridOriginY, wy));
+        rowStart[bodyRow[i] + 1]++;
+    }
+    for (size_t row = 0; row < n; row++) {
+        rowStart[row + 1] += rowStart[row];
+    }
+    uint32_t* cursor = scratch.allocate<uint32_t>(n);
+    std::copy(rowStart, rowStart + n, cursor);
+    uint32_t* rowBodies = scratch.allocate<uint32_t>(bodyCount);
+    for (size_t i = 0; i < bodyCount; i++) {
+        rowBodies[cursor[bodyRow[i]]++] = static_cast<uint32_t>(i);
+    }
+
+    density.assign(n * n, 0.0);
+    ThreadPool::instance().parallelFor(n, rowGrain, [&](size_t begin, size_t end, unsigned) {
+        // Stencils reach two rows past their first one
+        for (size_t baseRow = begin >= 2 ? begin - 2 : 0; baseRow < end; baseRow++) {
+            for (uint32_t p = rowStart[baseRow]; p < rowStart[baseRow + 1]; p++) {
+                uint32_t i = rowBodies[p];
+                double wx[3], wy[3];
+                int bx = stencil(posX[i], gridOriginX, wx);
+                stencil(posY[i], gridOriginY, wy);
+                for (int a = 0; a < 3; a++) {
+                    size_t row = baseRow + a;
+                    if (row < begin || row >= end) {
+                        continue;
+                    }
+                    double* cells = density.data() + row * n;
+                    for (int b = 0; b < 3; b++) {
+                        cells[bx + b] += masses[i] * wy[a] * wx[b];
+                    }
+                }
+            }
+        }
+    });
+}
+
+void ParticleMesh::prepareKernel() {
+    if (kernelCell == cell && kernelGridSize == gridSize && kernelSplit == shortRangeCorrection &&
+        kernelSplitScale == splitScale) {
+        return;
+    }
+    const size_t n = gridSize;
+    const size_t padded = 2 * n;
+    const double splitRadius = splitScale * cell;
+    kernelTransform.assign(padded * padded, Complex(0.0, 0.0));
+    for (size_t row = 0; row < padded; row++) {
+        double dy = (row < n ? double(row) : double(row) - double(padded)) * cell;
+        for (size_t column = 0; column < padded; column++) {
+            double dx = (column < n ? double(column) : double(column) - double(padded)) * cell;
+            double r = std::sqrt(dx * dx + dy * dy);
+            double value;
+            if (shortRangeCorrection) {
+                value = r > 0.0 ? -std::erf(r / (2.0 * splitRadius)) / r : -1.0 / (splitRadius * sqrtPi);
+            } else {
+                // Mean of 1/r over a square cell at the origin: 4 ln(1 + sqrt 2) / h
+                value = r > 0.0 ? -1.0 / r : -3.5254943480781717 / cell;
+            }
+            kernelTransform[row * padded + column] = Complex(value, 0.0);
+        }
+    }
+    fft2d(kernelTransform, padded, false);
+    kernelCell = cell;
+    kernelGridSize = gridSize;
+    kernelSplit = shortRangeCorrection;
+    kernelSplitScale = splitScale;
+}
+
+// Isolated convolution: the padding keeps every image at least one grid
+// width away, so the cyclic transform never wraps mass onto itself
+void ParticleMesh::solve() {
+    const size_t n = gridSize;
+    const size_t padded = 2 * n;
+    workspace.assign(padded * padded, Complex(0.0, 0.0));
+    for (size_t row = 0; row < n; row++) {
+        for (size_t column = 0; column < n; column++) {
+            workspace[row * padded + column] = Complex(density[row * n + column], 0.0);
+        }
+    }
+    fft2d(workspace, padded, false);
+    for (size_t k = 0; k < workspace.size(); k++) {
+        workspace[k] *= kernelTransform[k];
+    }
+    fft2d(workspace, padded, true);
+
+    const double normalization = 1.0 / (double(padded) * double(padded));
+    potential.resize(n * n);
+    for (size_t row = 0; row < n; row++) {
+        for (size_t column = 0; column < n; column++) {
+            potential[row * n + column] = workspace[row * padded + column].real() * normalization;
+        }
+    }
+}
+
+void ParticleMesh::differentiate() {
+    const size_t n = gridSize;
+    gradientX.assign(n * n, 0.0);
+    gradientY.assign(n * n, 0.0);
+    const double inverse12h = 1.0 / (12.0 * cell);
+    // Fourth-order central differences; the margin keeps bodies away from the border rows
+    for (size_t row = 2; row + 2 < n; row++) {
+        for (size_t column = 2; column + 2 < n; column++) {
+            size_t k = row * n + column;
+            gradientX[k] = (8.0 * (potential[k + 1] - potential[k - 1]) - (potential[k + 2] - potential[k - 2])) * inverse12h;
+            gradientY[k] = (8.0 * (potential[k + n] - potential[k - n]) - (potential[k + 2 * n] - potential[k - 2 * n])) * inverse12h;
+        }
+    }
+}
+
+void ParticleMesh::buildCellList() {
+    listCell = cutoffScale * splitScale * cell;
+    double minX = posX[0], maxX = posX[0], minY = posY[0], maxY = posY[0];
+    for (size_t i = 1; i < bodyCount; i++) {
+        minX = std::min(minX, posX[i]);
+        maxX = std::max(maxX, posX[i]);
+        minY = std::min(minY, posY[i]);
+        maxY = std::max(maxY, posY[i]);
+    }
+    listOriginX = minX;
+    listOriginY = minY;
+    listWidth = static_cast<int>((maxX - minX) / listCell) + 1;
+    listHeight = static_cast<int>((maxY - minY) / listCell) + 1;
+
+    // Counting sort of the bodies by cell
+    size_t cells = static_cast<size_t>(listWidth) * listHeight;
+    cellStart.assign(cells + 1, 0);
+    ArenaScope scratch;
+    uint32_t* bodyCell = scratch.allocate<uint32_t>(bodyCount);
+    for (size_t i = 0; i < bodyCount; i++) {
+        int cx = std::min(listWidth - 1, static_cast<int>((posX[i] - listOriginX) / listCell));
+        int cy = std::min(listHeight - 1, static_cast<int>((posY[i] - listOriginY) / listCell));
+        bodyCell[i] = static_cast<uint32_t>(cy * listWidth + cx);
+        cellStart[bodyCell[i] + 1]++;
+    }
+    for (size_t c = 0; c < cells; c++) {
+        cellStart[c + 1] += cellStart[c];
+    }
+    uint32_t* cursor = scratch.allocate<uint32_t>(cells);
+    std::copy(cellStart.begin(), cellStart.end() - 1, cursor);
+    cellBodies.resize(bodyCount);
+    for (size_t i = 0; i < bodyCount; i++) {
+        cellBodies[cursor[bodyCell[i]]++] = static_cast<uint32_t>(i);
+    }
+}
+
+void ParticleMesh::meshField(double px, double py, double& ax, double& ay) const {
+    const int n = static_cast<int>(gridSize);
+    double wx[3], wy[3];
+    int bx = stencil(px, gridOriginX, wx);
+    int by = stencil(py, gridOriginY, wy);
+    if (bx < 2 || by < 2 || bx + 2 >= n - 2 || by + 2 >= n - 2) {
+        // Off the grid: the whole system as a point mass
+        double dx = centerX - px;
+        double dy = centerY - py;
+        double r2 = dx * dx + dy * dy + softening2;
+        double invR3 = r2 > 0.0 ? 1.0 / (r2 * std::sqrt(r2)) : 0.0;
+        ax = totalMass * dx * invR3;
+        ay = totalMass * dy * invR3;
+        return;
+    }
+    double gx = 0.0, gy = 0.0;
+    for (int a = 0; a < 3; a++) {
+        size_t row = static_cast<size_t>(by + a) * gridSize;
+        for (int b = 0; b < 3; b++) {
+            double w = wy[a] * wx[b];
+            gx += w * gradientX[row + bx + b];
+            gy += w * gradientY[row + bx + b];
+        }
+    }
+    ax = -gx;
+    ay = -gy;
+}
+
+void ParticleMesh::shortRangeField(double px, double py, size_t self, double& ax, double& ay) const {
+    const double splitRadius = splitScale * cell;
+    const double cutoff2 = listCell * listCell;
+    const double inverseSplit = 1.0 / (2.0 * splitRadius);
+    const double gaussianFactor = 1.0 / (splitRadius * sqrtPi);
+    int cx = static_cast<int>(std::floor((px - listOriginX) / listCell));
+    int cy = static_cast<int>(std::floor((py - listOriginY) / listCell));
+    double sumX = 0.0, sumY = 0.0;
+    for (int ny = std::max(0, cy - 1); ny <= std::min(listHeight - 1, cy + 1); ny++) {
+        for (int nx = std::max(0, cx - 1); nx <= std::min(listWidth - 1, cx + 1); nx++) {
+            size_t c = static_cast<size_t>(ny) * listWidth + nx;
+            for (uint32_t k = cellStart[c]; k < cellStart[c + 1]; k++) {
+                uint32_t j = cellBodies[k];
+                if (j == self) {
+                    continue;
+                }
+                double dx = posX[j] - px;
+                double dy = posY[j] - py;
+                double r2 = dx * dx + dy * dy;
+                if (r2 >= cutoff2) {
+                    continue;
+                }
+                double softened2 = r2 + softening2;
+                if (softened2 <= 0.0) {
+                    continue;
+                }
+                double r = std::sqrt(r2);
+                double u = r * inverseSplit;
+                double split = std::erfc(u) + r * gaussianFactor * std::exp(-u * u);
+                double w = masses[j] * split / (softened2 * std::sqrt(softened2));
+                sumX += w * dx;
+                sumY += w * dy;
+            }
+        }
+    }
+    ax = sumX;
+    ay = sumY;
+}
+
+void ParticleMesh::accelerations(double gravitationalConstant, double* ax, double* ay) const {
+    PROFILE_SCOPE("physics.force");
+    const double G = gravitationalConstant;
+    ThreadPool::instance().parallelFor(bodyCount, bodyGrain, [&, ax, ay](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++) {
+            double meshX, meshY;
+            meshField(posX[i], posY[i], meshX, meshY);
+            if (shortRangeCorrection) {
+                double nearX, nearY;
+                shortRangeField(posX[i], posY[i], i, nearX, nearY);
+                meshX += nearX;
+                meshY += nearY;
+            }
+            ax[i] = G * meshX;
+            ay[i] = G * meshY;
+        }
+    });
+}
+
+void ParticleMesh::accelerationAtPoint(double px, double py, double& ax, double& ay) const {
+    if (bodyCount == 0) {
+        ax = ay = 0.0;
+        return;
+    }
+    meshField(px, py, ax, ay);
+    if (shortRangeCorrection) {
+        double nearX, nearY;
+        shortRangeField(px, py, SIZE_MAX, nearX, nearY);
+        ax += nearX;
+        ay += nearY;
+    }
+}
+
+double ParticleMesh::potentialAt(double px, double py) const {
+    if (bodyCount == 0) {
+        return 0.0;
+    }
+    const int n = static_cast<int>(gridSize);
+    double wx[3], wy[3];
+    int bx = stencil(px, gridOriginX, wx);
+    int by = stencil(py, gridOriginY, wy);
+    if (bx < 0 || by < 0 || bx + 2 >= n || by + 2 >= n) {
+        double dx = centerX - px;
+        double dy = centerY - py;
+        return -totalMass / std::sqrt(dx * dx + dy * dy + softening2 + cell * cell);
+    }
+    double value = 0.0;
+    for (int a = 0; a < 3; a++) {
+        size_t row = static_cast<size_t>(by + a) * gridSize;
+        for (int b = 0; b < 3; b++) {
+            value += wy[a] * wx[b] * potential[row + bx + b];
+        }
+    }
+    return value;
+}
@@ -0,0 +1,103 @@
+#ifndef PARTICLE_MESH_H
+#define PARTICLE_MESH_H
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Particle-mesh gravity for large, smooth mass distributions.
+//
+// build() assigns the masses to a square grid (cloud-in-cell or triangular-
+// shaped-cloud), convolves the grid with the 1/r kernel by FFT and takes
+// fourth-order finite differences of the resulting potential. Bodies then
+// interpolate the field back with the same assignment weights, which keeps
+// the mesh force free of self-forces and momentum conserving. The grid is
+// zero-padded to twice its size so the convolution sees isolated (not
+// periodic) boundaries.
+//
+// Plain PM smooths everything below a couple of cells. With the P3M
+// correction enabled the mesh only carries the long-range part of a smooth
+// erf/erfc split of 1/r; the short-range remainder is summed exactly over
+// neighbours found with a cell list, so close pairs get their full force.
+class ParticleMesh {
+public:
+    enum class Assignment { CloudInCell, TriangularShapedCloud };
+
+    ParticleMesh();
+
+    unsigned gridSize;            // Cells per side (power of two), before padding
+    Assignment assignment;
+    bool shortRangeCorrection;    // P3M: exact short-range forces on top of the mesh
+    double splitScale;            // Force split radius in cells (P3M only)
+    double cutoffScale;           // Short-range cutoff in units of the split radius
+    bool deterministic;           // Deposit in a fixed order, for results independent of the thread count
+
+    // Deposits, solves and differentiates. The arrays must stay valid (and
+    // unchanged) while the field is queried.
+    void build(const double* x, const double* y, const double* mass, size_t count, double softening);
+
+    // Accelerations (including G) of every built body, excluding itself
+    void accelerations(double gravitationalConstant, double* ax, double* ay) const;
+
+    // Field at an arbitrary point, without the G factor (test particles)
+    void accelerationAtPoint(double px, double py, double& ax, double& ay) const;
+
+    // Potential of the smooth mesh part at a point, without G. Outside the
+    // grid the total mass is treated as a point at the center of mass.
+    double potentialAt(double px, double py) const;
+
+    bool empty() const { return bodyCount == 0; }
+    double cellSize() const { return cell; }
+    double originX() const { return gridOriginX; }
+    double originY() const { return gridOriginY; }
+
+private:
+    using Complex = std::complex<double>;
+
+    void chooseGeometry();
+    void deposit();
+    void depositByRows();
+    void prepareKernel();
+    void solve();
+    void differentiate();
+    void buildCellList();
+    int stencil(double position, double origin, double weights[3]) const;
+    void meshField(double px, double py, double& ax, double& ay) const;
+    void shortRangeField(double px, double py, size_t self, double& ax, double& ay) const;
+
+    const double* posX;
+    const double* posY;
+    const double* masses;
+    size_t bodyCount;
+    double softening2;
+
+    // Geometry of the unpadded grid
+    double cell;
+    double gridOriginX, gridOriginY;
+    double totalMass, centerX, centerY;
+
+    std::vector<double> density;     // gridSize^2 mass per cell
+    std::vector<double> potential;   // gridSize^2, without G
+    std::vector<double> gradientX;   // d(potential)/dx, without G
+    std::vector<double> gradientY;
+    std::vector<Complex> workspace;  // Padded (2 * gridSize)^2 transform buffer
+    std::vector<std::vector<double>> depositPartials;  // Per-thread density grids
+    std::vector<uint8_t> depositUsed;                   // Whether each thread deposited this step
+
+    // Transformed kernel, cached while the geometry that defines it is unchanged
+    std::vector<Complex> kernelTransform;
+    double kernelCell;
+    unsigned kernelGridSize;
+    bool kernelSplit;
+    double kernelSplitScale;
+
+    // Cell list over the bodies for the short-range sum
+    double listCell;
+    double listOriginX, listOriginY;
+    int listWidth, listHeight;
+    std::vector<uint32_t> cellStart;  // listWidth * listHeight + 1 offsets
+    std::vector<uint32_t> cellBodies;
+};
+
+#endif // PARTICLE_MESH_H
@@ -0,0 +1,710 @@
+#include "PhysicsEngine.h"
+#include "HardwareCounters.h"
+#include "KeplerSolver.h"
+#include "Logger.h"
+#include "Profiler.h"
+#include "SpaceFillingCurve.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+namespace {
+const size_t forceGrain = 64;         // Bodies per task in the force kernels
+const size_t integrateGrain = 16384;  // Bodies per task in the kick/drift loops
+const size_t particleGrain = 256;     // Test particles per task in the particle force kernel
+
+// Adds the field of tile-order positions [begin, end) at a point `shift`
+// away from their tile origin to (sumX, sumY). Written so that it vectorizes:
+// the guard for coincident points is a select after an unconditional divide.
+inline void tileRangeField(const FloatTiles& tiles, size_t begin, size_t end, float shiftX, float shiftY, float eps2,
+                           float& sumX, float& sumY) {
+    const float* ox = tiles.offsetX.data();
+    const float* oy = tiles.offsetY.data();
+    const float* m = tiles.mass.data();
+    float rangeX = sumX, rangeY = sumY;
+    for (size_t k = begin; k < end; k++) {
+        float dx = shiftX + ox[k];
+        float dy = shiftY + oy[k];
+        float r2 = dx * dx + dy * dy + eps2;
+        float invR3 = 1.0f / (r2 * std::sqrt(r2));
+        invR3 = r2 > 0.0f ? invR3 : 0.0f;
+        float w = m[k] * invR3;
+        rangeX += w * dx;
+        rangeY += w * dy;
+    }
+    sumX = rangeX;
+    sumY = rangeY;
+}
+
+// Field of the tiled bodies at (px, py) on float lanes, leaving out the body
+// at tile-order position `self` (pass SIZE_MAX for none). Each tile's float
+// partial sum is added in double, so rounding does not build up over the system.
+inline void tiledField(const FloatTiles& tiles, double px, double py, size_t self, float eps2, double& sumX,
+                       double& sumY) {
+    sumX = 0.0;
+    sumY = 0.0;
+    for (size_t tile = 0; tile < tiles.tileCount(); tile++) {
+        // The only rounding of the separation: tile origin to target, once per tile
+        const float shiftX = static_cast<float>(tiles.originX[tile] - px);
+        const float shiftY = static_cast<float>(tiles.originY[tile] - py);
+        const size_t begin = tiles.tileBegin(tile), end = tiles.tileEnd(tile);
+        float tileX = 0.0f, tileY = 0.0f;
+        if (self >= begin && self < end) {
+            tileRangeField(tiles, begin, self, shiftX, shiftY, eps2, tileX, tileY);
+            tileRangeField(tiles, self + 1, end, shiftX, shiftY, eps2, tileX, tileY);
+        } else {
+            tileRangeField(tiles, begin, end, shiftX, shiftY, eps2, tileX, tileY);
+        }
+        sumX += tileX;
+        sumY += tileY;
+    }
+}
+}
+
+PhysicsEngine::PhysicsEngine()
+    : metrics(nullptr), treeCurrent(false), initialized(false), simulationTime(0.0), steps(0), stepsSinceCheck(0), bodiesMerged(false),
+      accelerationCentral(BodyStore::invalidIndex), keplerFailureReported(false), checkpointTime(0.0), checkpointSteps(0),
+      checkpointAccelerationCentral(BodyStore::invalidIndex) {}
+
+void PhysicsEngine::initialize() {
+    treeCurrent = false;
+    computeAccelerations();
+
+    ConservationSample sample = monitor.measure(*this);
+    sample.time = simulationTime;
+    monitor.setReference(sample);
+    monitor.record(sample);
+    publishEnergyDrift();
+    checkpointSample = sample;
+    saveCheckpoint();
+    stepsSinceCheck = 0;
+    initialized = true;
+
+    LOG_INFO("Physics initialized with " << store.size() << " bodies"
+             << (particles.empty() ? "" : " and " + std::to_string(particles.size()) + " test particles") << " ("
+             << (usesParticleMesh() ? (mesh.shortRangeCorrection ? "P3M mesh" : "particle mesh")
+                                    : usesTree() ? "Barnes-Hut tree" : "direct summation")
+             << (accelerationCentral != BodyStore::invalidIndex ? ", Wisdom-Holman" : "") << "), E0 = " << sample.energy);
+}
+
+void PhysicsEngine::advanceTo(double targetTime) {
+    if (!initialized) {
+        initialize();
+    }
+    if (store.empty()) {
+        simulationTime = targetTime;
+        return;
+    }
+
+    // Tolerance so floating point round-off never produces a vanishing last step
+    double epsilon = 1e-12 * std::max(1.0, std::fabs(targetTime));
+    while (simulationTime < targetTime - epsilon) {
+        double dt = std::min(timestepController.dt(), targetTime - simulationTime);
+        step(dt);
+
+        if (bodiesMerged) {
+            // The interval containing a merge is not judged; start a new one from here
+            bodiesMerged = false;
+            ConservationSample sample = monitor.measure(*this);
+            monitor.record(sample);
+            publishEnergyDrift();
+            checkpointSample = sample;
+            saveCheckpoint();
+            stepsSinceCheck = 0;
+        } else if (++stepsSinceCheck >= monitor.interval) {
+            checkConservation();
+        }
+    }
+}
+
+void PhysicsEngine::step(double dt) {
+    double reorderSeconds = 0.0;
+    if (reordering.due(store.size() + particles.size(), settings.deterministic)) {
+        auto reorderStart = std::chrono::steady_clock::now();
+        reorderBodies();
+        reorderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - reorderStart).count();
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    // Phase boundaries for the metrics endpoint; no clock reads without it
+    auto phaseStart = start;
+    auto endPhase = [&](EngineMetrics::Phase phase) {
+        if (metrics) {
+            auto now = std::chrono::steady_clock::now();
+            metrics->addPhaseTime(phase, std::chrono::duration<double>(now - phaseStart).count());
+            phaseStart = now;
+        }
+    };
+
+    // Stored accelerations must match the splitting this step uses
+    uint32_t central = centralBody();
+    bool encountersChanged = updateEncounters(central, dt);
+    endPhase(EngineMetrics::Encounters);
+    if (central != accelerationCentral || encountersChanged) {
+        computeAccelerations();
+        endPhase(EngineMetrics::Forces);
+    }
+
+    kick(0.5 * dt);
+    if (central != BodyStore::invalidIndex) {
+        keplerDrift(dt, central);
+    } else {
+        drift(dt);
+    }
+    endPhase(EngineMetrics::Integration);
+    resolveCollisions(dt);
+    endPhase(EngineMetrics::Collisions);
+    computeAccelerations();
+    endPhase(EngineMetrics::Forces);
+    kick(0.5 * dt);
+    endPhase(EngineMetrics::Integration);
+    simulationTime += dt;
+    steps++;
+
+    double stepSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    reordering.recordStep(stepSeconds, store.size() + particles.size());
+    if (metrics) {
+        metrics->addPhaseTime(EngineMetrics::Reorder, reorderSeconds);
+        metrics->recordSteps(1, reorderSeconds + stepSeconds);
+        metrics->setBodies(store.size(), particles.size());
+        metrics->setSimulationTime(simulationTime);
+    }
+}
+
+// Encounters are regularized only for plain leapfrog steps on unsoftened
+// forces: under Wisdom-Holman every orbit is already a Kepler drift about the
+// central body, softened pairs do not follow Kepler orbits, and the mesh does
+// not resolve the pair force it would have to subtract.
+//
+// Pairs are chosen against the largest step the controller may take, not the
+// current one: every change of the pair set costs an energy error that grows
+// as the switching separation shrinks, so a criterion that followed a
+// shrinking step would make the controller's rejections self-defeating.
+bool PhysicsEngine::updateEncounters(uint32_t central, double dt) {
+    if (central == BodyStore::invalidIndex && settings.softening == 0.0 && !usesParticleMesh()) {
+        double stepScale = std::max(dt, timestepController.enabled ? timestepController.maxDt : timestepController.dt());
+        return encounters.update(store, settings.gravitationalConstant, stepScale);
+    }
+    bool hadPairs = encounters.active();
+    encounters.clear();
+    return hadPairs;
+}
+
+bool PhysicsEngine::usesTree() const {
+    switch (settings.forceMethod) {
+    case ForceMethod::Tree:
+        return true;
+    case ForceMethod::Automatic:
+        return store.size() > settings.treeThreshold;
+    default:
+        return false;
+    }
+}
+
+uint32_t PhysicsEngine::centralBody() const {
+    if (settings.integrator == Integrator::Leapfrog || store.empty() || (store.size() < 2 && particles.empty())) {
+        return BodyStore::invalidIndex;
+    }
+    size_t heaviest = 0;
+    double total = 0.0;
+    for (size_t i = 0; i < store.size(); i++) {
+        total += store.mass[i];
+        if (store.mass[i] > store.mass[heaviest]) {
+            heaviest = i;
+        }
+    }
+    double others = total - store.mass[heaviest];
+    if (settings.integrator == Integrator::Automatic && others * settings.dominanceRatio > store.mass[heaviest]) {
+        return BodyStore::invalidIndex;
+    }
+    return static_cast<uint32_t>(heaviest);
+}
+
+// Drift part of the democratic heliocentric map: half a step of the central
+// body's motion (the total momentum of the others, shared out), a full Kepler
+// step of every other body about the central mass, and the second half of the
+// central motion. Velocities are barycentric, positions heliocentric; the
+// barycenter itself moves uniformly.
+void PhysicsEngine::keplerDrift(double dt, uint32_t central) {
+    PROFILE_SCOPE("physics.integrate");
+    CounterScope counting(HardwareCounters::Phase::Integrate);
+    const size_t n = store.size();
+    double* x = store.x.data();
+    double* y = store.y.data();
+    double* vx = store.vx.data();
+    double* vy = store.vy.data();
+    const double* m = store.mass.data();
+
+    double totalMass = 0.0, comX = 0.0, comY = 0.0, comVx = 0.0, comVy = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        totalMass += m[i];
+        comX += m[i] * x[i];
+        comY += m[i] * y[i];
+        comVx += m[i] * vx[i];
+        comVy += m[i] * vy[i];
+    }
+    comX /= totalMass;
+    comY /= totalMass;
+    comVx /= totalMass;
+    comVy /= totalMass;
+
+    // To heliocentric positions and barycentric velocities
+    const double centerX = x[central], centerY = y[central];
+    const double centralMass = m[central];
+    double momentumX = 0.0, momentumY = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        if (i == central) {
+            continue;
+        }
+        x[i] -= centerX;
+        y[i] -= centerY;
+        vx[i] -= comVx;
+        vy[i] -= comVy;
+        momentumX += m[i] * vx[i];
+        momentumY += m[i] * vy[i];
+    }
+
+    const double shiftX = 0.5 * dt * momentumX / centralMass;
+    const double shiftY = 0.5 * dt * momentumY / centralMass;
+    const double mu = settings.gravitationalConstant * centralMass;
+    std::atomic<size_t> failures(0);
+    ThreadPool::instance().parallelFor(n, forceGrain, [&, x, y, vx, vy](size_t begin, size_t end, unsigned) {
+        size_t localFailures = 0;
+        for (size_t i = begin; i < end; i++) {
+            if (i == central) {
+                continue;
+            }
+            x[i] += shiftX;
+            y[i] += shiftY;
+            if (!KeplerSolver::drift(mu, x[i], y[i], vx[i], vy[i], dt)) {
+                // Only at the central body itself; coast straight through
+                x[i] += vx[i] * dt;
+                y[i] += vy[i] * dt;
+                localFailures++;
+            }
+        }
+        failures += localFailures;
+    });
+    // The second half of the central motion uses the momenta after the Kepler step
+    momentumX = 0.0;
+    momentumY = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        if (i != central) {
+            momentumX += m[i] * vx[i];
+            momentumY += m[i] * vy[i];
+        }
+    }
+    const double secondShiftX = 0.5 * dt * momentumX / centralMass;
+    const double secondShiftY = 0.5 * dt * momentumY / centralMass;
+
+    // Back to inertial coordinates: place the central body so the barycenter
+    // sits where it moved to, and give it the momentum the others lack
+    double weightedX = 0.0, weightedY = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        if (i == central) {
+            continue;
+        }
+        x[i] += secondShiftX;
+        y[i] += secondShiftY;
+        weightedX += m[i] * x[i];
+        weightedY += m[i] * y[i];
+    }
+    const double newCenterX = comX + comVx * dt - weightedX / totalMass;
+    const double newCenterY = comY + comVy * dt - weightedY / totalMass;
+    for (size_t i = 0; i < n; i++) {
+        if (i == central) {
+            continue;
+        }
+        x[i] += newCenterX;
+        y[i] += newCenterY;
+        vx[i] += comVx;
+        vy[i] += comVy;
+    }
+    x[central] = newCenterX;
+    y[central] = newCenterY;
+    vx[central] = comVx - momentumX / centralMass;
+    vy[central] = comVy - momentumY / centralMass;
+
+    // Test particles carry no momentum, so they just ride along with the same shifts
+    double* px = particles.x.data();
+    double* py = particles.y.data();
+    double* pvx = particles.vx.data();
+    double* pvy = particles.vy.data();
+    ThreadPool::instance().parallelFor(particles.size(), particleGrain, [=, &failures](size_t begin, size_t end, unsigned) {
+        size_t localFailures = 0;
+        for (size_t i = begin; i < end; i++) {
+            double qx = px[i] - centerX + shiftX;
+            double qy = py[i] - centerY + shiftY;
+            double ux = pvx[i] - comVx;
+            double uy = pvy[i] - comVy;
+            if (!KeplerSolver::drift(mu, qx, qy, ux, uy, dt)) {
+                qx += ux * dt;
+                qy += uy * dt;
+                localFailures++;
+            }
+            px[i] = qx + secondShiftX + newCenterX;
+            py[i] = qy + secondShiftY + newCenterY;
+            pvx[i] = ux + comVx;
+            pvy[i] = uy + comVy;
+        }
+        failures += localFailures;
+    });
+    if (failures > 0 && !keplerFailureReported) {
+        LOG_WARNING("Kepler drift did not converge for " << failures << " bodies or particles; drifted them linearly");
+        keplerFailureReported = true;
+    }
+    treeCurrent = false;
+}
+
+void PhysicsEngine::kick(double dt) {
+    PROFILE_SCOPE("physics.integrate");
+    CounterScope counting(HardwareCounters::Phase::Integrate);
+    double* vx = store.vx.data();
+    double* vy = store.vy.data();
+    const double* ax = store.ax.data();
+    const double* ay = store.ay.data();
+    ThreadPool::instance().parallelFor(store.size(), integrateGrain, [=](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++) {
+            vx[i] += ax[i] * dt;
+            vy[i] += ay[i] * dt;
+        }
+    });
+
+    double* pvx = particles.vx.data();
+    double* pvy = particles.vy.data();
+    const double* pax = particles.ax.data();
+    const double* pay = particles.ay.data();
+    ThreadPool::instance().parallelFor(particles.size(), integrateGrain, [=](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++) {
+            pvx[i] += pax[i] * dt;
+            pvy[i] += pay[i] * dt;
+        }
+    });
+}
+
+void PhysicsEngine::drift(double dt) {
+    PROFILE_SCOPE("physics.integrate");
+    CounterScope counting(HardwareCounters::Phase::Integrate);
+    if (encounters.active()) {
+        encounters.beginDrift(store, settings.gravitationalConstant, dt);
+    }
+    double* x = store.x.data();
+    double* y = store.y.data();
+    const double* vx = store.vx.data();
+    const double* vy = store.vy.data();
+    ThreadPool::instance().parallelFor(store.size(), integrateGrain, [=](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++) {
+            x[i] += vx[i] * dt;
+            y[i] += vy[i] * dt;
+        }
+    });
+
+    double* px = particles.x.data();
+    double* py = particles.y.data();
+    const double* pvx = particles.vx.data();
+    const double* pvy = particles.vy.data();
+    ThreadPool::instance().parallelFor(particles.size(), integrateGrain, [=](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++) {
+            px[i] += pvx[i] * dt;
+            py[i] += pvy[i] * dt;
+        }
+    });
+    encounters.endDrift(store);
+    treeCurrent = false;
+}
+
+void PhysicsEngine::resolveCollisions(double dt) {
+    if (collisions.detect(store, dt) == 0) {
+        return;
+    }
+
+    // Merging is inelastic by design; account for the energy and angular
+    // momentum it removes so the monitor only reports integration error.
+    ConservationSample before = monitor.measure(*this);
+    size_t removed = collisions.merge(store);
+    treeCurrent = false;
+    ConservationSample after = monitor.measure(*this);
+    monitor.rebase(before, after);
+    bodiesMerged = true;
+
+    LOG_INFO("Merged " << removed << " bodies in collisions, " << store.size() << " remaining");
+}
+
+// Sorts bodies and test particles along the Hilbert curve. Stored
+// accelerations travel with their bodies, so only the tree and the index of
+// the central body need refreshing.
+void PhysicsEngine::reorderBodies() {
+    auto start = std::chrono::steady_clock::now();
+
+    BodyStore::BodyId centralId = accelerationCentral != BodyStore::invalidIndex ? store.id[accelerationCentral] : 0;
+    SpaceFillingCurve::sortedOrder(store.x.data(), store.y.data(), store.size(), reorderScratch);
+    store.reorder(reorderScratch);
+    if (accelerationCentral != BodyStore::invalidIndex) {
+        accelerationCentral = store.indexOf(centralId);
+    }
+    if (particles.size() > 1) {
+        SpaceFillingCurve::sortedOrder(particles.x.data(), particles.y.data(), particles.size(), reorderScratch);
+        particles.reorder(reorderScratch);
+    }
+    treeCurrent = false;
+
+    reordering.recordReorder(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
+
+void PhysicsEngine::computeAccelerations() {
+    // Under Wisdom-Holman the central body's pull is handled exactly by the
+    // Kepler drift, so it is masked out of the sums; the central body itself
+    // gets no acceleration, its motion follows from momentum conservation.
+    CounterScope counting(HardwareCounters::Phase::Force);  // The tree build inside counts as Tree
+    uint32_t central = centralBody();
+    double centralMass = 0.0;
+    if (central != BodyStore::invalidIndex) {
+        centralMass = store.mass[central];
+        store.mass[central] = 0.0;
+    }
+
+    bool particlesUseTree = !particles.empty() && !usesParticleMesh() && store.size() > settings.particleTreeThreshold;
+    if (usesTree() || particlesUseTree) {
+        buildTree();
+    }
+    bool direct = !usesParticleMesh() && (!usesTree() || (!particles.empty() && !particlesUseTree));
+    if (direct && settings.precision == Precision::Mixed) {
+        PROFILE_SCOPE("physics.tiles");
+        floatTiles.update(store.x.data(), store.y.data(), store.mass.data(), store.size());
+    }
+    if (usesParticleMesh()) {
+        computeMeshAccelerations();
+    } else if (usesTree()) {
+        computeTreeAccelerations();
+    } else {
+        computeDirectAccelerations();
+    }
+    if (encounters.active()) {
+        encounters.removePairForces(store, settings.gravitationalConstant);
+    }
+    computeParticleAccelerations(particlesUseTree);
+
+    if (central != BodyStore::invalidIndex) {
+        store.mass[central] = centralMass;
+        store.ax[central] = 0.0;
+        store.ay[central] = 0.0;
+        treeCurrent = false;  // The tree was built without the central mass
+    }
+    accelerationCentral = central;
+}
+
+// Field of the massive bodies at every test particle. Few massive bodies are
+// summed directly in a branch-free loop over the body arrays; many go
+// through the tree.
+void PhysicsEngine::computeParticleAccelerations(bool useTree) {
+    if (particles.empty()) {
+        return;
+    }
+    PROFILE_SCOPE("physics.particles");
+    const size_t n = store.size();
+    const double* x = store.x.data();
+    const double* y = store.y.data();
+    const double* m = store.mass.data();
+    const double* px = particles.x.data();
+    const double* py = particles.y.data();
+    double* ax = particles.ax.data();
+    double* ay = particles.ay.data();
+    const double G = settings.gravitationalConstant;
+    const double eps2 = settings.softening * settings.softening;
+
+    if (usesParticleMesh()) {
+        const ParticleMesh& field = mesh;
+        ThreadPool::instance().parallelFor(particles.size(), particleGrain, [&, ax, ay](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++) {
+                double sumX, sumY;
+                field.accelerationAtPoint(px[i], py[i], sumX, sumY);
+                ax[i] = G * sumX;
+                ay[i] = G * sumY;
+            }
+        });
+        return;
+    }
+
+    if (useTree) {
+        const double theta = settings.theta;
+        const BarnesHutTree& tree = barnesHutTree;
+        ThreadPool::instance().parallelFor(particles.size(), particleGrain, [&, ax, ay](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++) {
+                double sumX, sumY;
+                tree.accelerationAtPoint(px[i], py[i], theta, eps2, sumX, sumY);
+                ax[i] = G * sumX;
+                ay[i] = G * sumY;
+            }
+        });
+        return;
+    }
+
+    if (settings.precision == Precision::Mixed) {
+        const FloatTiles& tiles = floatTiles;
+        const float eps2f = static_cast<float>(eps2);
+        ThreadPool::instance().parallelFor(particles.size(), particleGrain, [&, ax, ay](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++) {
+                double sumX, sumY;
+                tiledField(tiles, px[i], py[i], SIZE_MAX, eps2f, sumX, sumY);
+                ax[i] = G * sumX;
+                ay[i] = G * sumY;
+            }
+        });
+        return;
+    }
+
+    ThreadPool::instance().parallelFor(particles.size(), particleGrain, [=](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++) {
+            const double xi = px[i], yi = py[i];
+            double sumX = 0.0, sumY = 0.0;
+            for (size_t j = 0; j < n; j++) {
+                double dx = x[j] - xi;
+                double dy = y[j] - yi;
+                double r2 = dx * dx + dy * dy + eps2;
+                double w = r2 > 0.0 ? m[j] / (r2 * std::sqrt(r2)) : 0.0;
+                sumX += w * dx;
+                sumY += w * dy;
+            }
+            ax[i] = G * sumX;
+            ay[i] = G * sumY;
+        }
+    });
+}
+
+void PhysicsEngine::ensureTree() {
+    if (!treeCurrent) {
+        buildTree();
+    }
+}
+
+void PhysicsEngine::buildTree() {
+    PROFILE_SCOPE("physics.tree");
+    CounterScope counting(HardwareCounters::Phase::Tree);
+    barnesHutTree.build(store.x.data(), store.y.data(), store.mass.data(), store.size());
+    treeCurrent = true;
+}
+
+void PhysicsEngine::computeDirectAccelerations() {
+    PROFILE_SCOPE("physics.force");
+    const size_t n = store.size();
+    const double* x = store.x.data();
+    const double* y = store.y.data();
+    const double* m = store.mass.data();
+    double* ax = store.ax.data();
+    double* ay = store.ay.data();
+    const double G = settings.gravitationalConstant;
+    const double eps2 = settings.softening * settings.softening;
+
+    if (settings.precision == Precision::Mixed) {
+        const FloatTiles& tiles = floatTiles;
+        const float eps2f = static_cast<float>(eps2);
+        ThreadPool::instance().parallelFor(n, forceGrain, [&, ax, ay](size_t begin, size_t end, unsigned) {
+            for (size_t i = begin; i < end; i++) {
+                double sumX, sumY;
+                tiledField(tiles, x[i], y[i], tiles.position[i], eps2f, sumX, sumY);
+                ax[i] = G * sumX;
+                ay[i] = G * sumY;
+            }
+        });
+        return;
+    }
+
+    ThreadPool::instance().parallelFor(n, forceGrain, [=](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++) {
+            const double xi = x[i], yi = y[i];
+            double sumX = 0.0, sumY = 0.0;
+            // Branch-free inner loop so it vectorizes; the self term has r2 == 0
+            // (without softening) and is masked out by the select.
+            for (size_t j = 0; j < n; j++) {
+                double dx = x[j] - xi;
+                double dy = y[j] - yi;
+                double r2 = dx * dx + dy * dy + eps2;
+                double invR3 = r2 > 0.0 ? 1.0 / (r2 * std::sqrt(r2)) : 0.0;
+                double w = j != i ? m[j] * invR3 : 0.0;
+                sumX += w * dx;
+                sumY += w * dy;
+            }
+            ax[i] = G * sumX;
+            ay[i] = G * sumY;
+        }
+    });
+}
+
+void PhysicsEngine::computeTreeAccelerations() {
+    PROFILE_SCOPE("physics.force");
+    double* ax = store.ax.data();
+    double* ay = store.ay.data();
+    const double G = settings.gravitationalConstant;
+    const double eps2 = settings.softening * settings.softening;
+    const double theta = settings.theta;
+    const BarnesHutTree& tree = barnesHutTree;
+
+    ThreadPool::instance().parallelFor(store.size(), forceGrain, [&, ax, ay](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++) {
+            double sumX, sumY;
+            tree.accelerationAt(i, theta, eps2, sumX, sumY);
+            ax[i] = G * sumX;
+            ay[i] = G * sumY;
+        }
+    });
+}
+
+void PhysicsEngine::computeMeshAccelerations() {
+    mesh.deterministic = settings.deterministic;
+    mesh.build(store.x.data(), store.y.data(), store.mass.data(), store.size(), settings.softening);
+    mesh.accelerations(settings.gravitationalConstant, store.ax.data(), store.ay.data());
+}
+
+void PhysicsEngine::checkConservation() {
+    PROFILE_SCOPE("physics.diagnostics");
+    stepsSinceCheck = 0;
+
+    ConservationSample sample = monitor.measure(*this);
+    sample.time = simulationTime;
+
+    // Error accumulated over this interval only, normalized by the reference energy
+    double scale = std::fabs(monitor.reference().energy);
+    double energyError = scale > 0.0 ? std::fabs(sample.energy - checkpointSample.energy) / scale : 0.0;
+    double angularError = ConservationMonitor::relativeAngularMomentumChange(checkpointSample, sample);
+    double intervalError = std::max(energyError, angularError);
+
+    if (!timestepController.update(intervalError)) {
+        if (metrics) {
+            metrics->recordRejectedSteps(steps - checkpointSteps);
+        }
+        restoreCheckpoint();
+        return;
+    }
+
+    monitor.record(sample);
+    publishEnergyDrift();
+    checkpointSample = sample;
+    saveCheckpoint();
+}
+
+void PhysicsEngine::publishEnergyDrift() {
+    if (metrics) {
+        metrics->setEnergyDrift(monitor.energyDrift());
+    }
+}
+
+void PhysicsEngine::saveCheckpoint() {
+    checkpointStore = store;
+    checkpointTime = simulationTime;
+    checkpointSteps = steps;
+    checkpointParticles = particles;
+    checkpointAccelerationCentral = accelerationCentral;
+    checkpointEncounters = encounters.pairs();
+}
+
+void PhysicsEngine::restoreCheckpoint() {
+    store = checkpointStore;
+    particles = checkpointParticles;
+    simulationTime = checkpointTime;
+    steps = checkpointSteps;
+    accelerationCentral = checkpointAccelerationCentral;
+    encounters.setPairs(checkpointEncounters);
+    treeCurrent = false;
+}
@@ -0,0 +1,167 @@
+#ifndef PHYSICS_ENGINE_H
+#define PHYSICS_ENGINE_H
+
+#include "BodyStore.h"
+#include "BarnesHutTree.h"
+#include "CollisionSystem.h"
+#include "ConservationMonitor.h"
+#include "EncounterSystem.h"
+#include "FloatTiles.h"
+#include "Metrics.h"
+#include "ParticleMesh.h"
+#include "ReorderScheduler.h"
+#include "TestParticles.h"
+#include "TimestepController.h"
+#include <cstdint>
+
+// Headless N-body integrator over a BodyStore.
+//
+// Steps are kick-drift-kick leapfrog. Forces come from the exact pair sum for
+// small systems and from a Barnes-Hut tree above `treeThreshold` bodies, or,
+// when selected, from the particle-mesh solver for very large smooth systems. Every
+// monitor interval the conservation monitor measures the system and the
+// timestep controller decides whether to keep the interval or redo it from the
+// last checkpoint with a smaller step. Bodies that touch during a step are
+// merged by the collision system between the drift and the force evaluation.
+//
+// When one body dominates the mass of the system (a star with planets), steps
+// switch to a Wisdom-Holman map in democratic heliocentric coordinates: every
+// other body follows its Kepler orbit around the central body analytically and
+// only the much weaker mutual interactions are integrated by kicks, so steps
+// can be a sizable fraction of the shortest orbital period.
+//
+// Without softening, close pairs in leapfrog steps are handed to the
+// encounter system, which moves them along their exact two-body orbit and
+// leaves only the rest of the system's pull to the kicks, so a hard binary
+// does not drag the global step down.
+//
+// Test particles are advanced with the same splitting but only ever appear on
+// the receiving end of the force kernels.
+//
+// With Precision::Mixed the direct sums run on single-precision lanes,
+// twice as many per vector as in double. Positions stay double in the store;
+// the kernels see them as float offsets from double tile origins, so
+// separations keep their relative precision however far the system sits from
+// the coordinate origin.
+//
+// Large systems are periodically re-sorted along a Hilbert curve so bodies
+// that are close in space are close in memory; the reorder scheduler picks
+// the interval from measured step times. Indices change when that happens,
+// ids do not.
+class PhysicsEngine {
+public:
+    enum class Integrator {
+        Leapfrog,      // Kick-drift-kick on the full forces
+        WisdomHolman,  // Kepler drifts around the most massive body plus interaction kicks
+        Automatic      // Wisdom-Holman while one body dominates, leapfrog otherwise
+    };
+
+    enum class ForceMethod {
+        Automatic,     // Direct sum up to treeThreshold bodies, tree above
+        Direct,
+        Tree,
+        ParticleMesh   // FFT mesh, optionally with the P3M short-range correction
+    };
+
+    enum class Precision {
+        Double,        // Every kernel in double precision
+        Mixed          // Direct sums on float offsets from double tile origins, see FloatTiles
+    };
+
+    struct Settings {
+        double gravitationalConstant = 1.0;  // Simulation units: AU, solar masses, G = 1
+        double softening = 0.0;              // Plummer softening length
+        double theta = 0.5;                  // Barnes-Hut opening angle
+        size_t treeThreshold = 4096;         // Use the tree above this many bodies
+        ForceMethod forceMethod = ForceMethod::Automatic;
+        Integrator integrator = Integrator::Automatic;
+        double dominanceRatio = 100.0;       // Central mass / all other mass needed for Automatic
+        size_t particleTreeThreshold = 64;   // Test particles use the tree above this many bodies
+        // Bitwise-reproducible results for any thread count: fixed partitions
+        // and summation orders wherever partial results are combined, and
+        // body sorts on a fixed schedule instead of by measured step times
+        bool deterministic = false;
+        Precision precision = Precision::Double;
+    };
+
+    PhysicsEngine();
+
+    Settings settings;
+    ConservationMonitor monitor;
+    TimestepController timestepController;
+    CollisionSystem collisions;
+    EncounterSystem encounters;
+    TestParticles particles;
+    ParticleMesh mesh;  // Grid and assignment settings for ForceMethod::ParticleMesh
+    ReorderScheduler reordering;
+    EngineMetrics* metrics;  // Live counters to publish into, or null; see Metrics.h
+
+    BodyStore& bodies() { return store; }
+    const BodyStore& bodies() const { return store; }
+
+    // Must be called after bodies are added or removed outside of step()
+    void initialize();
+
+    // Advances to an absolute simulation time using steps of at most the
+    // controller's dt, measuring and adapting every monitor interval.
+    void advanceTo(double targetTime);
+    void advanceBy(double duration) { advanceTo(simulationTime + duration); }
+
+    void step(double dt);            // One kick-drift-kick step
+    void computeAccelerations();
+
+    bool usesTree() const;
+    bool usesParticleMesh() const { return settings.forceMethod == ForceMethod::ParticleMesh; }
+
+    // Index of the body the Wisdom-Holman map orbits around, or
+    // BodyStore::invalidIndex when steps use plain leapfrog
+    uint32_t centralBody() const;
+    const BarnesHutTree& tree() const { return barnesHutTree; }
+    void ensureTree();               // Builds the tree for the current positions if needed
+    bool treeIsCurrent() const { return treeCurrent; }
+
+    double time() const { return simulationTime; }
+    uint64_t stepCount() const { return steps; }
+
+private:
+    void buildTree();
+    void computeDirectAccelerations();
+    void computeTreeAccelerations();
+    void kick(double dt);
+    void drift(double dt);
+    void keplerDrift(double dt, uint32_t central);
+    void computeParticleAccelerations(bool useTree);
+    void computeMeshAccelerations();
+    void resolveCollisions(double dt);
+    void reorderBodies();
+    bool updateEncounters(uint32_t central, double dt);
+    void checkConservation();
+    void publishEnergyDrift();
+    void saveCheckpoint();
+    void restoreCheckpoint();
+
+    BodyStore store;
+    BarnesHutTree barnesHutTree;
+    FloatTiles floatTiles;  // Positions for the direct sums under Precision::Mixed
+    bool treeCurrent;
+    bool initialized;
+
+    double simulationTime;
+    uint64_t steps;
+    unsigned stepsSinceCheck;
+    bool bodiesMerged;  // Set by a step that merged bodies; forces a new checkpoint
+    uint32_t accelerationCentral;  // Central body excluded from the stored accelerations, if any
+    bool keplerFailureReported;
+    std::vector<uint32_t> reorderScratch;
+
+    // State at the last accepted conservation check, for rejected intervals
+    BodyStore checkpointStore;
+    TestParticles checkpointParticles;
+    double checkpointTime;
+    uint64_t checkpointSteps;
+    uint32_t checkpointAccelerationCentral;
+    std::vector<EncounterSystem::Pair> checkpointEncounters;
+    ConservationSample checkpointSample;
+};
+
+#endif // PHYSICS_ENGINE_H
@@ -0,0 +1,169 @@
+#include "Profiler.h"
+
+#ifdef GRAVITY_PROFILING
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// Per-thread event ring. Only the owning thread writes; the writer publishes
+// each event by bumping `written` with release ordering. When the ring is full
+// the oldest events are overwritten, so long runs keep the most recent history.
+struct ThreadEventBuffer {
+    static constexpr size_t capacity = 1 << 16;  // Power of two
+    static constexpr size_t mask = capacity - 1;
+
+    std::unique_ptr<Profiler::Event[]> events;
+    std::atomic<uint64_t> written;
+    uint32_t trackId;
+    std::string name;
+
+    ThreadEventBuffer(uint32_t trackId)
+        : events(new Profiler::Event[capacity]), written(0), trackId(trackId) {}
+
+    void push(const char* eventName, uint64_t startNs, uint64_t endNs) {
+        uint64_t index = written.load(std::memory_order_relaxed);
+        events[index & mask] = Profiler::Event{eventName, startNs, endNs};
+        written.store(index + 1, std::memory_order_release);
+    }
+};
+
+// Registry of all buffers ever created. Buffers are owned here and never freed
+// before exit, so a dump can safely read buffers of threads that have finished.
+// The mutex is only taken when a thread records its first event and when dumping.
+struct BufferRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadEventBuffer>> buffers;
+    uint32_t nextTrackId = 1;
+};
+
+BufferRegistry& registry() {
+    static BufferRegistry instance;
+    return instance;
+}
+
+ThreadEventBuffer* createBuffer(uint32_t trackId, bool assignId) {
+    BufferRegistry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    if (assignId) {
+        trackId = reg.nextTrackId++;
+    }
+    reg.buffers.emplace_back(new ThreadEventBuffer(trackId));
+    ThreadEventBuffer* buffer = reg.buffers.back().get();
+    buffer->name = "thread " + std::to_string(trackId);
+    return buffer;
+}
+
+ThreadEventBuffer* threadBuffer() {
+    thread_local ThreadEventBuffer* buffer = createBuffer(0, true);
+    return buffer;
+}
+
+ThreadEventBuffer* trackBuffer(uint32_t trackId) {
+    // Non-thread tracks (the GPU) are only written from the render thread
+    static std::vector<ThreadEventBuffer*> tracks;
+    for (ThreadEventBuffer* buffer : tracks) {
+        if (buffer->trackId == trackId) {
+            return buffer;
+        }
+    }
+    ThreadEventBuffer* buffer = createBuffer(trackId, false);
+    if (trackId == Profiler::gpuTrackId) {
+        buffer->name = "GPU";
+    }
+    tracks.push_back(buffer);
+    return buffer;
+}
+
+void writeEscaped(FILE* file, const char* text) {
+    for (const char* c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            std::fputc('\\', file);
+        }
+        std::fputc(*c, file);
+    }
+}
+
+} // namespace
+
+uint64_t Profiler::now() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void Profiler::record(const char* name, uint64_t startNs, uint64_t endNs) {
+    threadBuffer()->push(name, startNs, endNs);
+}
+
+void Profiler::recordOnTrack(uint32_t trackId, const char* name, uint64_t startNs, uint64_t endNs) {
+    trackBuffer(trackId)->push(name, startNs, endNs);
+}
+
+void Profiler::setThreadName(const char* name) {
+    ThreadEventBuffer* buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    buffer->name = name;
+}
+
+bool Profiler::writeChromeTrace(const char* path) {
+    FILE* file = std::fopen(path, "w");
+    if (!file) {
+        std::cerr << "Failed to open trace file: " << path << std::endl;
+        return false;
+    }
+
+    BufferRegistry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    // Timestamps are relative to the earliest buffered event
+    uint64_t origin = UINT64_MAX;
+    for (const auto& buffer : reg.buffers) {
+        uint64_t written = buffer->written.load(std::memory_order_acquire);
+        uint64_t first = written > ThreadEventBuffer::capacity ? written - ThreadEventBuffer::capacity : 0;
+        for (uint64_t i = first; i < written; i++) {
+            const Event& event = buffer->events[i & ThreadEventBuffer::mask];
+            if (event.startNs < origin) {
+                origin = event.startNs;
+            }
+        }
+    }
+    if (origin == UINT64_MAX) {
+        origin = 0;
+    }
+
+    size_t eventCount = 0;
+    bool first = true;
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (const auto& buffer : reg.buffers) {
+        std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"",
+                     first ? "" : ",\n", buffer->trackId);
+        writeEscaped(file, buffer->name.c_str());
+        std::fprintf(file, "\"}}");
+        first = false;
+
+        uint64_t written = buffer->written.load(std::memory_order_acquire);
+        uint64_t start = written > ThreadEventBuffer::capacity ? written - ThreadEventBuffer::capacity : 0;
+        for (uint64_t i = start; i < written; i++) {
+            const Event& event = buffer->events[i & ThreadEventBuffer::mask];
+            std::fprintf(file, ",\n{\"name\":\"");
+            writeEscaped(file, event.name);
+            std::fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                         buffer->trackId,
+                         (event.startNs - origin) / 1000.0,
+                         (event.endNs - event.startNs) / 1000.0);
+            eventCount++;
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+    bool ok = std::ferror(file) == 0;
+    std::fclose(file);
+
+    std::cout << "Wrote " << eventCount << " profiler events to " << path << std::endl;
+    return ok;
+}
+
+#endif // GRAVITY_PROFILING
@@ -0,0 +1,73 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+// Scoped-timer instrumentation for frames and simulation steps.
+//
+// Every thread records complete events (name, start, end) into its own ring
+// buffer without taking locks; the buffers are only walked when a Chrome trace
+// (chrome://tracing / Perfetto) is written. Build with GRAVITY_PROFILING
+// defined (CMake option GRAVITY_ENABLE_PROFILER) to enable it; otherwise every
+// PROFILE_* macro expands to nothing and none of this code is compiled in.
+
+#ifdef GRAVITY_PROFILING
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class Profiler {
+public:
+    // A single complete event. Names must be string literals (or otherwise
+    // outlive the profiler) since only the pointer is stored.
+    struct Event {
+        const char* name;
+        uint64_t startNs;
+        uint64_t endNs;
+    };
+
+    // Track id used for events that do not belong to a CPU thread (GPU timings)
+    static constexpr uint32_t gpuTrackId = 1000;
+
+    static uint64_t now();  // Nanoseconds on the steady clock
+
+    static void record(const char* name, uint64_t startNs, uint64_t endNs);
+    static void recordOnTrack(uint32_t trackId, const char* name, uint64_t startNs, uint64_t endNs);
+    static void setThreadName(const char* name);
+
+    // Writes every buffered event as Chrome trace JSON. Intended to be called
+    // from the main thread between frames, while worker threads are idle.
+    static bool writeChromeTrace(const char* path);
+};
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(const char* name) : name(name), startNs(Profiler::now()) {}
+    ~ScopedTimer() { Profiler::record(name, startNs, Profiler::now()); }
+
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    const char* name;
+    uint64_t startNs;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ScopedTimer PROFILE_CONCAT(profileScope_, __LINE__)(name)
+#define PROFILE_THREAD_NAME(name) Profiler::setThreadName(name)
+#define PROFILE_DUMP(path) Profiler::writeChromeTrace(path)
+
+#else
+
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_THREAD_NAME(name) ((void)0)
+#define PROFILE_DUMP(path) ((void)0)
+
+#endif // GRAVITY_PROFILING
+
+// Default location of the trace written at exit
+#define PROFILE_TRACE_FILE "gravity_trace.json"
+
+#endif // PROFILER_H
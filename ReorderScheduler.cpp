@@ -0,0 +1,46 @@
+#include "ReorderScheduler.h"
+#include <algorithm>
+
+ReorderScheduler::ReorderScheduler()
+    : enabled(true), minBodies(8192), minInterval(8), maxInterval(1024), baselineSteps(4), sinceReorder(0),
+      baselineSamples(0), baselineBodies(0), baseline(0.0), excess(0.0), reorderCost(0.0), reorders(0) {}
+
+bool ReorderScheduler::due(size_t bodyCount, bool fixedSchedule) const {
+    if (!enabled || bodyCount < minBodies) {
+        return false;
+    }
+    if (reorders == 0) {
+        return true;  // Whatever order the bodies were created in, sort them once
+    }
+    if (fixedSchedule) {
+        return sinceReorder >= maxInterval;
+    }
+    if (sinceReorder < minInterval) {
+        return false;
+    }
+    return sinceReorder >= maxInterval || excess > reorderCost;
+}
+
+void ReorderScheduler::recordStep(double seconds, size_t bodyCount) {
+    sinceReorder++;
+    if (bodyCount != baselineBodies) {
+        baselineBodies = bodyCount;
+        baselineSamples = 0;
+        excess = 0.0;
+    }
+    if (baselineSamples < baselineSteps) {
+        baselineSamples++;
+        baseline += (seconds - baseline) / baselineSamples;
+        return;
+    }
+    // Signed so timing noise around the baseline cancels instead of adding up
+    excess = std::max(0.0, excess + seconds - baseline);
+}
+
+void ReorderScheduler::recordReorder(double seconds) {
+    reorderCost = seconds;
+    reorders++;
+    sinceReorder = 0;
+    baselineSamples = 0;
+    excess = 0.0;
+}
@@ -0,0 +1,50 @@
+#ifndef REORDER_SCHEDULER_H
+#define REORDER_SCHEDULER_H
+
+#include <cstddef>
+
+// Decides when the engine should re-sort its bodies along the space-filling
+// curve.
+//
+// Right after a sort the step time is at its best; as bodies wander the
+// memory layout decays and steps slow down. The scheduler takes the average
+// of the first few steps after a sort as the baseline, accumulates how much
+// later steps exceed it and asks for a new sort once that accumulated loss
+// has paid for the last sort. Fast-mixing systems are therefore re-sorted
+// often and quiet ones rarely, within [minInterval, maxInterval] steps.
+class ReorderScheduler {
+public:
+    ReorderScheduler();
+
+    bool enabled;
+    size_t minBodies;       // Bodies plus test particles; smaller systems stay in cache and are never sorted
+    unsigned minInterval;   // Steps between sorts, whatever the timings say
+    unsigned maxInterval;
+    unsigned baselineSteps; // Steps after a sort used to measure the baseline
+
+    // With a fixed schedule the sorts come every maxInterval steps whatever
+    // the timings say, so the body order (and with it the order of every sum
+    // over the bodies) is the same on every run
+    bool due(size_t bodyCount, bool fixedSchedule = false) const;
+
+    // Wall time of one step over `bodyCount` bodies. A change in the count
+    // (merges) restarts the baseline, since the step cost changed for
+    // reasons unrelated to memory layout.
+    void recordStep(double seconds, size_t bodyCount);
+    void recordReorder(double seconds);
+
+    unsigned stepsSinceReorder() const { return sinceReorder; }
+    unsigned long long reorderCount() const { return reorders; }
+    double lastReorderSeconds() const { return reorderCost; }
+
+private:
+    unsigned sinceReorder;
+    unsigned baselineSamples;
+    size_t baselineBodies;
+    double baseline;      // Mean step time right after the last sort (or count change)
+    double excess;        // Accumulated step time above the baseline
+    double reorderCost;
+    unsigned long long reorders;
+};
+
+#endif // REORDER_SCHEDULER_H
@@ -0,0 +1,106 @@
+#include "Scenarios.h"
+#include <cmath>
+#include <random>
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+
+// Sun and Earth on a circular orbit, as in the viewer
+void loadSunEarth(BodyStore& store) {
+    store.addBody(0.0, 0.0, 0.0, 0.0, 1.0, 0.5, BodyStore::packColor(1.0f, 0.9f, 0.0f));
+    store.addBody(1.0, 0.0, 0.0, 1.0, 0.000003, 0.15, BodyStore::packColor(0.0f, 0.7f, 1.0f));
+}
+
+// Sun, Earth and Jupiter on circular orbits
+void loadSolar(BodyStore& store) {
+    loadSunEarth(store);
+    double jupiterRadius = 5.2;
+    store.addBody(0.0, jupiterRadius, -std::sqrt(1.0 / jupiterRadius), 0.0, 0.000954, 0.3,
+                  BodyStore::packColor(0.9f, 0.6f, 0.4f));
+}
+
+// Central star with a thin disk of light bodies on circular orbits
+void loadDisk(size_t count, unsigned seed, BodyStore& store) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    double starMass = 1.0;
+    store.addBody(0.0, 0.0, 0.0, 0.0, starMass, 0.5, BodyStore::packColor(1.0f, 0.9f, 0.0f));
+    if (count < 2) {
+        return;
+    }
+    size_t orbiters = count - 1;
+    double diskMass = 0.01;
+    for (size_t i = 0; i < orbiters; i++) {
+        // Uniform surface density between 1 and 10 AU
+        double r = std::sqrt(1.0 + 99.0 * unit(random));
+        double angle = 2.0 * pi * unit(random);
+        double enclosed = starMass + diskMass * (r * r - 1.0) / 99.0;
+        double speed = std::sqrt(enclosed / r);
+        store.addBody(r * std::cos(angle), r * std::sin(angle),
+                      -speed * std::sin(angle), speed * std::cos(angle),
+                      diskMass / orbiters, 0.002, BodyStore::packColor(0.7f, 0.8f, 1.0f));
+    }
+}
+
+// Uniform disk of equal masses with small random velocities; collapses
+void loadCloud(size_t count, unsigned seed, BodyStore& store) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::normal_distribution<double> velocity(0.0, 0.05);
+    for (size_t i = 0; i < count; i++) {
+        double r = 10.0 * std::sqrt(unit(random));
+        double angle = 2.0 * pi * unit(random);
+        store.addBody(r * std::cos(angle), r * std::sin(angle), velocity(random), velocity(random),
+                      1.0 / count, 0.005, BodyStore::packColor(1.0f, 0.8f, 0.6f));
+    }
+}
+
+// The solar system with a main asteroid belt of test particles between 2.2
+// and 3.2 AU on slightly eccentric, randomly phased orbits
+void loadBelt(size_t count, unsigned seed, BodyStore& store, TestParticles* particles) {
+    loadSolar(store);
+    if (!particles) {
+        return;
+    }
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    particles->reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        double r = 2.2 + unit(random);
+        double angle = 2.0 * pi * unit(random);
+        double speed = std::sqrt(1.0 / r) * (1.0 + 0.05 * (unit(random) - 0.5));
+        particles->add(r * std::cos(angle), r * std::sin(angle), -speed * std::sin(angle), speed * std::cos(angle));
+    }
+}
+
+} // namespace
+
+namespace Scenarios {
+
+std::vector<std::string> names() {
+    return {"solar", "sun-earth", "disk", "cloud", "belt"};
+}
+
+bool load(const std::string& name, size_t count, unsigned seed, BodyStore& store, TestParticles* particles) {
+    store.clear();
+    if (particles) {
+        particles->clear();
+    }
+    if (name == "solar") {
+        loadSolar(store);
+    } else if (name == "sun-earth") {
+        loadSunEarth(store);
+    } else if (name == "disk") {
+        loadDisk(count, seed, store);
+    } else if (name == "cloud") {
+        loadCloud(count, seed, store);
+    } else if (name == "belt") {
+        loadBelt(count, seed, store, particles);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+} // namespace Scenarios
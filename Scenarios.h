@@ -0,0 +1,24 @@
+#ifndef SCENARIOS_H
+#define SCENARIOS_H
+
+#include "BodyStore.h"
+#include "TestParticles.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Named initial conditions for the headless front ends, in simulation units
+// (AU, solar masses, G = 1). `count` is the number of bodies (or test
+// particles, for belt scenarios) of the generated scenarios and is ignored by
+// the fixed ones; `seed` makes generated scenarios reproducible.
+namespace Scenarios {
+
+std::vector<std::string> names();
+
+// Replaces the contents of `store` and `particles`; returns false for an
+// unknown name. Without a particle set, belt scenarios load only their bodies.
+bool load(const std::string& name, size_t count, unsigned seed, BodyStore& store, TestParticles* particles = nullptr);
+
+} // namespace Scenarios
+
+#endif // SCENARIOS_H
@@ -1,7 +1,14 @@
 #include "Shader.h"
+#include "Logger.h"
 #include <fstream>
 #include <sstream>
-#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+const char* Shader::cacheDirectory = "shader_cache";
 
 Shader::Shader(const char* vertexPath, const char* fragmentPath) : ID(0) {
     std::string vertexCode, fragmentCode;
@@ -30,26 +37,61 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) : ID(0) {
         fragmentCode = fShaderStream.str();
     }
     catch (std::ifstream::failure& e) {
-        std::cerr << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+        LOG_ERROR("ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what());
         if (!vShaderFile.is_open()) {
-            std::cerr << "Could not open vertex shader file: " << vertexPath << std::endl;
+            LOG_ERROR("Could not open vertex shader file: " << vertexPath);
         }
         if (!fShaderFile.is_open()) {
-            std::cerr << "Could not open fragment shader file: " << fragmentPath << std::endl;
+            LOG_ERROR("Could not open fragment shader file: " << fragmentPath);
         }
         throw;
     }
 
+    LOG_INFO("Loaded shader sources: " << vertexPath << " (" << vertexCode.size() << " bytes), "
+             << fragmentPath << " (" << fragmentCode.size() << " bytes)");
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    // Try the program binary cache first; fall back to a full compile and link
+    uint64_t cacheKey = 0;
+    bool useCache = programBinarySupported();
+    if (useCache) {
+        cacheKey = computeCacheKey(vertexCode, fragmentCode);
+        if (loadCachedBinary(cacheKey)) {
+            double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+            LOG_INFO("Shader program loaded from binary cache in " << elapsed << " ms. Program ID: " << ID);
+            return;
+        }
+    }
+
+    compileAndLink(vertexCode, fragmentCode);
+
+    if (useCache) {
+        saveCachedBinary(cacheKey);
+    }
+
+    // Verify program is valid
+    int success;
+    char infoLog[512];
+    glValidateProgram(ID);
+    glGetProgramiv(ID, GL_VALIDATE_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(ID, 512, NULL, infoLog);
+        LOG_WARNING("WARNING::SHADER::PROGRAM_VALIDATION_FAILED:\n" << infoLog);
+    }
+}
+
+void Shader::compileAndLink(const std::string& vertexCode, const std::string& fragmentCode) {
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
 
-    std::cout << "Vertex Shader Code:\n" << vertexCode << std::endl;
-    std::cout << "Fragment Shader Code:\n" << fragmentCode << std::endl;
-
     GLuint vertex = 0, fragment = 0;
     int success;
     char infoLog[512];
 
+    auto compileStart = std::chrono::steady_clock::now();
+    decltype(compileStart) linkStart;
+
     try {
         // Compile vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
@@ -64,7 +106,7 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) : ID(0) {
             glGetShaderInfoLog(vertex, 512, NULL, infoLog);
             throw std::runtime_error(std::string("Vertex shader compilation failed:\n") + infoLog);
         }
-        std::cout << "Vertex shader compiled successfully!" << std::endl;
+        LOG_INFO("Vertex shader compiled successfully!");
 
         // Compile fragment shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
@@ -79,9 +121,10 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) : ID(0) {
             glGetShaderInfoLog(fragment, 512, NULL, infoLog);
             throw std::runtime_error(std::string("Fragment shader compilation failed:\n") + infoLog);
         }
-        std::cout << "Fragment shader compiled successfully!" << std::endl;
+        LOG_INFO("Fragment shader compiled successfully!");
 
         // Create and link shader program
+        linkStart = std::chrono::steady_clock::now();
         ID = glCreateProgram();
         if (ID == 0) {
             throw std::runtime_error("Failed to create shader program");
@@ -89,13 +132,17 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) : ID(0) {
         
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
+        if (programBinarySupported()) {
+            // Ask the driver to keep the linked binary around so it can be cached
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
         glLinkProgram(ID);
         glGetProgramiv(ID, GL_LINK_STATUS, &success);
         if (!success) {
             glGetProgramInfoLog(ID, 512, NULL, infoLog);
             throw std::runtime_error(std::string("Shader program linking failed:\n") + infoLog);
         }
-        std::cout << "Shader program linked successfully! Program ID: " << ID << std::endl;
+        LOG_INFO("Shader program linked successfully! Program ID: " << ID);
     }
     catch (const std::exception& e) {
         // Clean up on error
@@ -109,21 +156,168 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath) : ID(0) {
             glDeleteProgram(ID);
             ID = 0;
         }
-        std::cerr << "ERROR::SHADER::INITIALIZATION_FAILED: " << e.what() << std::endl;
+        LOG_ERROR("ERROR::SHADER::INITIALIZATION_FAILED: " << e.what());
         throw;
     }
 
     // Clean up shaders after successful linking
+    glDetachShader(ID, vertex);
+    glDetachShader(ID, fragment);
     glDeleteShader(vertex);
     glDeleteShader(fragment);
 
-    // Verify program is valid
-    glValidateProgram(ID);
-    glGetProgramiv(ID, GL_VALIDATE_STATUS, &success);
+    auto linkEnd = std::chrono::steady_clock::now();
+    double compileMs = std::chrono::duration<double, std::milli>(linkStart - compileStart).count();
+    double linkMs = std::chrono::duration<double, std::milli>(linkEnd - linkStart).count();
+    LOG_INFO("Shader compile took " << compileMs << " ms, link took " << linkMs << " ms");
+}
+
+bool Shader::programBinarySupported() {
+    if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary) {
+        return false;
+    }
+    // Some drivers expose the entry points but no binary formats at all
+    GLint numFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+    return numFormats > 0;
+}
+
+uint64_t Shader::computeCacheKey(const std::string& vertexCode, const std::string& fragmentCode) {
+    // 64-bit FNV-1a over the sources and the driver identification strings
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const char* data, size_t length) {
+        for (size_t i = 0; i < length; i++) {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= 1099511628211ull;
+        }
+        // Separator so that ("ab", "c") and ("a", "bc") hash differently
+        hash ^= 0xff;
+        hash *= 1099511628211ull;
+    };
+    auto mixGLString = [&mix](GLenum name) {
+        const char* value = reinterpret_cast<const char*>(glGetString(name));
+        if (value) {
+            mix(value, std::strlen(value));
+        }
+    };
+
+    mix(vertexCode.data(), vertexCode.size());
+    mix(fragmentCode.data(), fragmentCode.size());
+    mixGLString(GL_VENDOR);
+    mixGLString(GL_RENDERER);
+    mixGLString(GL_VERSION);
+    return hash;
+}
+
+std::string Shader::cachePath(uint64_t key) {
+    char fileName[32];
+    std::snprintf(fileName, sizeof(fileName), "%016llx.bin", static_cast<unsigned long long>(key));
+    return std::string(cacheDirectory) + "/" + fileName;
+}
+
+namespace {
+// On-disk header in front of every cached program binary
+struct ProgramBinaryHeader {
+    char magic[8];
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+};
+
+const char programBinaryMagic[8] = {'G', 'S', 'P', 'R', 'O', 'G', '0', '1'};
+}
+
+bool Shader::loadCachedBinary(uint64_t key) {
+    std::string path = cachePath(key);
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        LOG_INFO("Shader binary cache miss: " << path);
+        return false;
+    }
+
+    ProgramBinaryHeader header;
+    std::vector<char> binary;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (file && std::memcmp(header.magic, programBinaryMagic, sizeof(programBinaryMagic)) == 0 && header.key == key) {
+        binary.resize(header.length);
+        file.read(binary.data(), header.length);
+    }
+    if (!file || binary.empty()) {
+        LOG_WARNING("Ignoring corrupt shader binary cache entry: " << path);
+        return false;
+    }
+
+    ID = glCreateProgram();
+    if (ID == 0) {
+        return false;
+    }
+    glProgramBinary(ID, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+    // The driver rejects binaries it no longer understands; treat that as a stale entry
+    GLint success = GL_FALSE;
+    glGetProgramiv(ID, GL_LINK_STATUS, &success);
     if (!success) {
-        glGetProgramInfoLog(ID, 512, NULL, infoLog);
-        std::cerr << "WARNING::SHADER::PROGRAM_VALIDATION_FAILED:\n" << infoLog << std::endl;
+        LOG_INFO("Shader binary cache entry is stale, recompiling: " << path);
+        glDeleteProgram(ID);
+        ID = 0;
+        // Clear the error glProgramBinary raises for an unsupported format
+        while (glGetError() != GL_NO_ERROR) {}
+        return false;
     }
+    return true;
+}
+
+void Shader::saveCachedBinary(uint64_t key) const {
+    GLint length = 0;
+    glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        LOG_WARNING("Driver returned no program binary, shader will not be cached");
+        return;
+    }
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(ID, length, &written, &format, binary.data());
+    if (written <= 0) {
+        LOG_WARNING("Failed to retrieve program binary, shader will not be cached");
+        return;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(cacheDirectory, ec);
+    if (ec) {
+        LOG_WARNING("Could not create shader cache directory '" << cacheDirectory << "': " << ec.message());
+        return;
+    }
+
+    // Write to a temporary file first so a crash never leaves a truncated entry behind
+    std::string path = cachePath(key);
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        ProgramBinaryHeader header;
+        std::memcpy(header.magic, programBinaryMagic, sizeof(programBinaryMagic));
+        header.key = key;
+        header.format = format;
+        header.length = static_cast<uint32_t>(written);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), written);
+        file.close();
+        if (!file) {
+            LOG_WARNING("Failed to write shader binary cache entry: " << tempPath);
+            std::filesystem::remove(tempPath, ec);
+            return;
+        }
+    }
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec) {
+        LOG_WARNING("Failed to store shader binary cache entry: " << ec.message());
+        std::error_code removeError;
+        std::filesystem::remove(tempPath, removeError);
+        return;
+    }
+    LOG_INFO("Stored shader program binary (" << written << " bytes) in " << path);
 }
 
 Shader::~Shader() {
@@ -137,44 +331,70 @@ void Shader::use() const {
     if (ID != 0) {
         glUseProgram(ID);
     } else {
-        std::cerr << "ERROR::SHADER::INVALID_PROGRAM_ID" << std::endl;
+        LOG_ERROR("ERROR::SHADER::INVALID_PROGRAM_ID");
+    }
+}
+
+void Shader::setInt(const char* name, int value) const {
+    if (ID == 0) {
+        LOG_ERROR("ERROR::SHADER::INVALID_PROGRAM_ID");
+        return;
+    }
+    GLint location = glGetUniformLocation(ID, name);
+    if (location == -1) {
+        LOG_WARNING("Uniform '" << name << "' not found in shader");
+        return;
     }
+    glUniform1i(location, value);
 }
 
-void Shader::setFloat(const std::string& name, float value) const {
+void Shader::setFloat(const char* name, float value) const {
     if (ID == 0) {
-        std::cerr << "ERROR::SHADER::INVALID_PROGRAM_ID" << std::endl;
+        LOG_ERROR("ERROR::SHADER::INVALID_PROGRAM_ID");
         return;
     }
-    GLint location = glGetUniformLocation(ID, name.c_str());
+    GLint location = glGetUniformLocation(ID, name);
     if (location == -1) {
-        std::cerr << "Warning: Uniform '" << name << "' not found in shader" << std::endl;
+        LOG_WARNING("Uniform '" << name << "' not found in shader");
         return;
     }
     glUniform1f(location, value);
 }
 
-void Shader::setVec3(const std::string& name, float x, float y, float z) const {
+void Shader::setVec3(const char* name, float x, float y, float z) const {
     if (ID == 0) {
-        std::cerr << "ERROR::SHADER::INVALID_PROGRAM_ID" << std::endl;
+        LOG_ERROR("ERROR::SHADER::INVALID_PROGRAM_ID");
         return;
     }
-    GLint location = glGetUniformLocation(ID, name.c_str());
+    GLint location = glGetUniformLocation(ID, name);
     if (location == -1) {
-        std::cerr << "Warning: Uniform '" << name << "' not found in shader" << std::endl;
+        LOG_WARNING("Uniform '" << name << "' not found in shader");
         return;
     }
     glUniform3f(location, x, y, z);
 }
 
-void Shader::setMat4(const std::string& name, const glm::mat4& matrix) const {
+void Shader::setVec4(const char* name, float x, float y, float z, float w) const {
+    if (ID == 0) {
+        LOG_ERROR("ERROR::SHADER::INVALID_PROGRAM_ID");
+        return;
+    }
+    GLint location = glGetUniformLocation(ID, name);
+    if (location == -1) {
+        LOG_WARNING("Uniform '" << name << "' not found in shader");
+        return;
+    }
+    glUniform4f(location, x, y, z, w);
+}
+
+void Shader::setMat4(const char* name, const glm::mat4& matrix) const {
     if (ID == 0) {
-        std::cerr << "ERROR::SHADER::INVALID_PROGRAM_ID" << std::endl;
+        LOG_ERROR("ERROR::SHADER::INVALID_PROGRAM_ID");
         return;
     }
-    GLint location = glGetUniformLocation(ID, name.c_str());
+    GLint location = glGetUniformLocation(ID, name);
     if (location == -1) {
-        std::cerr << "Warning: Uniform '" << name << "' not found in shader" << std::endl;
+        LOG_WARNING("Uniform '" << name << "' not found in shader");
         return;
     }
     glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
@@ -2,6 +2,7 @@
 #define SHADER_H
 
 #include <string>
+#include <cstdint>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -15,9 +16,28 @@ public:
 
     void use() const;
 
-    void setFloat(const std::string& name, float value) const;
-    void setVec3(const std::string& name, float x, float y, float z) const;
-    void setMat4(const std::string& name, const glm::mat4& matrix) const;
+    // Names are plain C strings so per-frame calls with literals never build
+    // a std::string
+    void setInt(const char* name, int value) const;
+    void setFloat(const char* name, float value) const;
+    void setVec3(const char* name, float x, float y, float z) const;
+    void setVec4(const char* name, float x, float y, float z, float w) const;
+    void setMat4(const char* name, const glm::mat4& matrix) const;
+
+    // Directory used for cached program binaries (relative to the working directory)
+    static const char* cacheDirectory;
+
+private:
+    void compileAndLink(const std::string& vertexCode, const std::string& fragmentCode);
+
+    // Program binary cache. The key hashes both shader sources together with the
+    // driver identification strings, so a driver update or an edited shader
+    // simply misses the cache instead of loading an incompatible binary.
+    static bool programBinarySupported();
+    static uint64_t computeCacheKey(const std::string& vertexCode, const std::string& fragmentCode);
+    static std::string cachePath(uint64_t key);
+    bool loadCachedBinary(uint64_t key);
+    void saveCachedBinary(uint64_t key) const;
 };
 
-#endif // SHADER_H
\ No newline at end of file
+#endif // SHADER_H
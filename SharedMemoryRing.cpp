@@ -0,0 +1,195 @@
+#include "SharedMemoryRing.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory counters must be lock-free");
+
+SharedMemoryRing::SharedMemoryRing() : header(nullptr), data(nullptr), mappedSize(0) {}
+
+SharedMemoryRing::SharedMemoryRing(SharedMemoryRing&& other) noexcept
+    : header(other.header), data(other.data), mappedSize(other.mappedSize), segmentName(std::move(other.segmentName)) {
+    other.header = nullptr;
+    other.data = nullptr;
+    other.mappedSize = 0;
+}
+
+SharedMemoryRing& SharedMemoryRing::operator=(SharedMemoryRing&& other) noexcept {
+    if (this != &other) {
+        release();
+        header = other.header;
+        data = other.data;
+        mappedSize = other.mappedSize;
+        segmentName = std::move(other.segmentName);
+        other.header = nullptr;
+        other.data = nullptr;
+        other.mappedSize = 0;
+    }
+    return *this;
+}
+
+SharedMemoryRing::~SharedMemoryRing() {
+    release();
+}
+
+void SharedMemoryRing::release() {
+    if (header) {
+        munmap(header, mappedSize);
+        header = nullptr;
+        data = nullptr;
+        mappedSize = 0;
+    }
+}
+
+SharedMemoryRing SharedMemoryRing::create(const std::string& name, size_t capacity) {
+    size_t roundedCapacity = 4096;
+    while (roundedCapacity < capacity) {
+        roundedCapacity <<= 1;
+    }
+
+    shm_unlink(name.c_str());  // Leftover from a crashed run
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("shm_open failed for " + name + ": " + std::strerror(errno));
+    }
+    size_t totalSize = sizeof(Header) + roundedCapacity;
+    if (ftruncate(fd, static_cast<off_t>(totalSize)) != 0) {
+        close(fd);
+        shm_unlink(name.c_str());
+        throw std::runtime_error("ftruncate failed for " + name + ": " + std::strerror(errno));
+    }
+
+    SharedMemoryRing ring;
+    ring.map(fd, totalSize);
+    ring.segmentName = name;
+    new (ring.header) Header();
+    ring.header->writeCount.store(0, std::memory_order_relaxed);
+    ring.header->readCount.store(0, std::memory_order_relaxed);
+    ring.header->capacity = roundedCapacity;
+    std::atomic_thread_fence(std::memory_order_release);
+    return ring;
+}
+
+SharedMemoryRing SharedMemoryRing::open(const std::string& name) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("shm_open failed for " + name + ": " + std::strerror(errno));
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) <= sizeof(Header)) {
+        close(fd);
+        throw std::runtime_error("Shared memory segment " + name + " is not a ring");
+    }
+    SharedMemoryRing ring;
+    ring.map(fd, static_cast<size_t>(info.st_size));
+    ring.segmentName = name;
+    return ring;
+}
+
+void SharedMemoryRing::map(int fd, size_t totalSize) {
+    void* address = mmap(nullptr, totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error(std::string("mmap failed: ") + std::strerror(errno));
+    }
+    header = static_cast<Header*>(address);
+    data = static_cast<char*>(address) + sizeof(Header);
+    mappedSize = totalSize;
+}
+
+void SharedMemoryRing::unlink() {
+    if (!segmentName.empty()) {
+        shm_unlink(segmentName.c_str());
+        segmentName.clear();
+    }
+}
+
+size_t SharedMemoryRing::capacity() const {
+    return header ? header->capacity : 0;
+}
+
+size_t SharedMemoryRing::readable() const {
+    return static_cast<size_t>(header->writeCount.load(std::memory_order_acquire) -
+                               header->readCount.load(std::memory_order_relaxed));
+}
+
+size_t SharedMemoryRing::tryWrite(const void* source, size_t size) {
+    const uint64_t cap = header->capacity;
+    uint64_t written = header->writeCount.load(std::memory_order_relaxed);
+    uint64_t consumed = header->readCount.load(std::memory_order_acquire);
+    size_t count = std::min<size_t>(size, cap - (written - consumed));
+    if (count == 0) {
+        return 0;
+    }
+    size_t offset = static_cast<size_t>(written & (cap - 1));
+    size_t firstPart = std::min<size_t>(count, cap - offset);
+    std::memcpy(data + offset, source, firstPart);
+    std::memcpy(data, static_cast<const char*>(source) + firstPart, count - firstPart);
+    header->writeCount.store(written + count, std::memory_order_release);
+    return count;
+}
+
+size_t SharedMemoryRing::tryRead(void* destination, size_t size) {
+    const uint64_t cap = header->capacity;
+    uint64_t consumed = header->readCount.load(std::memory_order_relaxed);
+    uint64_t written = header->writeCount.load(std::memory_order_acquire);
+    size_t count = std::min<size_t>(size, static_cast<size_t>(written - consumed));
+    if (count == 0) {
+        return 0;
+    }
+    size_t offset = static_cast<size_t>(consumed & (cap - 1));
+    size_t firstPart = std::min<size_t>(count, cap - offset);
+    std::memcpy(destination, data + offset, firstPart);
+    std::memcpy(static_cast<char*>(destination) + firstPart, data, count - firstPart);
+    header->readCount.store(consumed + count, std::memory_order_release);
+    return count;
+}
+
+void SharedMemoryRing::write(const void* source, size_t size) {
+    const char* bytes = static_cast<const char*>(source);
+    PollBackoff backoff;
+    while (size > 0) {
+        size_t count = tryWrite(bytes, size);
+        if (count == 0) {
+            backoff.wait();
+            continue;
+        }
+        backoff.reset();
+        bytes += count;
+        size -= count;
+    }
+}
+
+void SharedMemoryRing::read(void* destination, size_t size) {
+    char* bytes = static_cast<char*>(destination);
+    PollBackoff backoff;
+    while (size > 0) {
+        size_t count = tryRead(bytes, size);
+        if (count == 0) {
+            backoff.wait();
+            continue;
+        }
+        backoff.reset();
+        bytes += count;
+        size -= count;
+    }
+}
+
+void PollBackoff::wait() {
+    attempts++;
+    if (attempts < 64) {
+        return;  // Busy spin; the other side is usually only microseconds away
+    }
+    if (attempts < 256) {
+        std::this_thread::yield();
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
@@ -0,0 +1,73 @@
+#ifndef SHARED_MEMORY_RING_H
+#define SHARED_MEMORY_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Single-producer/single-consumer byte ring in POSIX shared memory.
+//
+// The ring is a shm_open'ed segment holding a header with the read and write
+// counters followed by the data area. Producer and consumer may live in
+// different processes: a ring mapped before fork() is shared by parent and
+// child, and open() attaches to a ring created by an unrelated process.
+// Transfers are plain byte streams; callers add their own framing.
+class SharedMemoryRing {
+public:
+    SharedMemoryRing();
+    SharedMemoryRing(SharedMemoryRing&& other) noexcept;
+    SharedMemoryRing& operator=(SharedMemoryRing&& other) noexcept;
+    ~SharedMemoryRing();
+
+    SharedMemoryRing(const SharedMemoryRing&) = delete;
+    SharedMemoryRing& operator=(const SharedMemoryRing&) = delete;
+
+    // Creates (replacing any stale segment of the same name) a ring whose data
+    // area is `capacity` bytes rounded up to a power of two.
+    static SharedMemoryRing create(const std::string& name, size_t capacity);
+    static SharedMemoryRing open(const std::string& name);
+
+    // Removes the name; existing mappings, including inherited ones, stay valid
+    void unlink();
+
+    // Non-blocking; return the number of bytes actually transferred
+    size_t tryWrite(const void* data, size_t size);
+    size_t tryRead(void* data, size_t size);
+
+    // Blocking, with spin-then-sleep backoff while the ring is full/empty
+    void write(const void* data, size_t size);
+    void read(void* data, size_t size);
+
+    size_t readable() const;
+    size_t capacity() const;
+    bool valid() const { return header != nullptr; }
+
+private:
+    struct Header {
+        alignas(64) std::atomic<uint64_t> writeCount;  // Total bytes ever written
+        alignas(64) std::atomic<uint64_t> readCount;   // Total bytes ever read
+        alignas(64) uint64_t capacity;
+    };
+
+    void map(int fd, size_t totalSize);
+    void release();
+
+    Header* header;
+    char* data;
+    size_t mappedSize;
+    std::string segmentName;
+};
+
+// Backoff for polling loops: spins first, then yields, then sleeps briefly
+class PollBackoff {
+public:
+    PollBackoff() : attempts(0) {}
+    void reset() { attempts = 0; }
+    void wait();
+
+private:
+    unsigned attempts;
+};
+
+#endif // SHARED_MEMORY_RING_H
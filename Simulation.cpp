@@ -1,14 +1,33 @@
 #include "Simulation.h"
+#include "Profiler.h"
+#include "GpuProfiler.h"
+#include "HardwareCounters.h"
+#include "Logger.h"
+#include "AllocationCounter.h"
+#include "Arena.h"
+#ifdef GRAVITY_SNAPSHOT_STREAMING
+#include "SnapshotStream.h"
+#endif
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <iostream>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <utility>
 
 Simulation* Simulation::instance = nullptr;
 
+namespace {
+const unsigned allocationWarmupFrames = 240;  // Clean frames before any allocation counts as a leak into steady state
+}
+
 void GLAPIENTRY MessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam) {
     std::cerr << "GL CALLBACK: " << (type == GL_DEBUG_TYPE_ERROR ? "** GL ERROR **" : "") 
               << " type = " << type 
@@ -16,10 +35,18 @@ void GLAPIENTRY MessageCallback(GLenum source, GLenum type, GLuint id, GLenum se
               << ", message = " << message << std::endl;
 }
 
-Simulation::Simulation() : window(nullptr), gridShader(nullptr), bodyShader(nullptr), textShader(nullptr),
-                         grid(nullptr), timeAcceleration(1.0f), zoom(1.0f), rotation(0.0f),
-                         maxTimeAcceleration(100.0f) {
+Simulation::Simulation(const BenchmarkCase* benchmark, SnapshotSubscriber* remote)
+    : window(nullptr), physics(nullptr), bodyRenderer(nullptr), densityRenderer(nullptr), instanceStream(nullptr),
+      gridShader(nullptr),
+      bodyShader(nullptr), textShader(nullptr), splatShader(nullptr), toneMapShader(nullptr),
+      grid(nullptr), zoom(1.0f), rotation(0.0f), animationTime(0.0), redrawRequested(true), benchmark(benchmark),
+      renderMode(RenderMode::Spheres),
+      remote(remote), shownParticleOrder(0), lastArrival(0.0), arrivalInterval(0.0), remoteConnected(remote != nullptr),
+      spatialIndexTime(-1.0), selectedBody(SpatialIndex::invalidId), counterRefreshTime(0.0), hudVAO(0), hudVBO(0) {
     instance = this;  // Set singleton instance
+    for (char* line : counterLines) {
+        line[0] = '\0';
+    }
     std::cout << "Starting simulation initialization..." << std::endl;
 
     // Initialize GLFW
@@ -34,6 +61,9 @@ Simulation::Simulation() : window(nullptr), gridShader(nullptr), bodyShader(null
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     glfwWindowHint(GLFW_COCOA_RETINA_FRAMEBUFFER, GLFW_TRUE);  // Enable retina display support
+    if (benchmark) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);  // Render offscreen into the hidden window's framebuffer
+    }
 
     // Create window
     window = glfwCreateWindow(1600, 1600, "Gravity Simulator", nullptr, nullptr);
@@ -45,7 +75,7 @@ Simulation::Simulation() : window(nullptr), gridShader(nullptr), bodyShader(null
 
     // Make OpenGL context current
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);  // Enable vsync
+    glfwSwapInterval(benchmark ? 0 : 1);  // Enable vsync, except when measuring frame times
     std::cout << "OpenGL context made current" << std::endl;
 
     // Initialize GLAD
@@ -113,6 +143,13 @@ Simulation::Simulation() : window(nullptr), gridShader(nullptr), bodyShader(null
             throw std::runtime_error("Failed to create text shader");
         }
         std::cout << "Text shader initialized successfully with ID: " << textShader->ID << std::endl;
+
+        // Create density shaders
+        std::cout << "Creating density shaders..." << std::endl;
+        splatShader = new Shader("density_splat_vertex_shader.glsl", "density_splat_fragment_shader.glsl");
+        toneMapShader = new Shader("density_tonemap_vertex_shader.glsl", "density_tonemap_fragment_shader.glsl");
+        std::cout << "Density shaders initialized successfully with IDs: " << splatShader->ID << ", "
+                  << toneMapShader->ID << std::endl;
         
     } catch (const std::exception& e) {
         std::cerr << "Failed to initialize text shader: " << e.what() << std::endl;
@@ -120,6 +157,9 @@ Simulation::Simulation() : window(nullptr), gridShader(nullptr), bodyShader(null
         throw;
     }
 
+    // GPU pass timing (no-op unless built with the profiler)
+    PROFILE_GPU_INIT();
+
     // Set up camera
     updateCameraMatrices();
     
@@ -128,34 +168,74 @@ Simulation::Simulation() : window(nullptr), gridShader(nullptr), bodyShader(null
     
     // Set up keyboard callback
     glfwSetKeyCallback(window, keyCallback);
-
-    // Create celestial bodies
-    // Sun at center with mass 1.0 (normalized units)
-    bodies.emplace_back(
-        0.0f, 0.0f,                // x, y position
-        0.0f, 0.0f,                // vx, vy velocity
-        1.0f,                      // mass
-        0.5f,                      // radius (increased from 0.2f)
-        1.0f, 0.9f, 0.0f          // r, g, b color
-    );
+    glfwSetMouseButtonCallback(window, mouseButtonCallback);
+
+    physics = new PhysicsEngine();
+    if (benchmark) {
+        Benchmark::prepare(*benchmark, *physics);
+        // Frame the scenario: generated disks and clouds reach 10 AU
+        zoom = benchmark->bodies > 0 ? 0.2f : 1.0f;
+    } else if (remote) {
+        // The engine stays empty until the first snapshot arrives
+        remoteInfo.energyDrift = std::nan("");
+    } else {
+        // Create celestial bodies
+        // Sun at center with mass 1.0 (normalized units)
+        bodies.emplace_back(
+            0.0f, 0.0f,                // x, y position
+            0.0f, 0.0f,                // vx, vy velocity
+            1.0f,                      // mass
+            0.5f,                      // radius (increased from 0.2f)
+            1.0f, 0.9f, 0.0f          // r, g, b color
+        );
     
-    // Earth with elliptical orbit
-    // Semi-major axis = 1.0 AU (normalized)
-    // Eccentricity = 0.0167 (Earth's actual eccentricity)
-    bodies.emplace_back(
-        1.0f, 0.0f,                // x, y position (start at (1,0))
-        0.0f, 1.0f,                // vx, vy velocity (circular orbit)
-        0.000003f,                 // mass (relative to Sun)
-        0.15f,                     // visible radius
-        0.0f, 0.7f, 1.0f          // r, g, b color
-    );
+        // Earth with elliptical orbit
+        // Semi-major axis = 1.0 AU (normalized)
+        // Eccentricity = 0.0167 (Earth's actual eccentricity)
+        bodies.emplace_back(
+            1.0f, 0.0f,                // x, y position (start at (1,0))
+            0.0f, 1.0f,                // vx, vy velocity (circular orbit)
+            0.000003f,                 // mass (relative to Sun)
+            0.15f,                     // visible radius
+            0.0f, 0.7f, 1.0f          // r, g, b color
+        );
     
+        // Hand the bodies to the physics engine; body ids follow the order of `bodies`
+        for (const auto& body : bodies) {
+            physics->bodies().addBody(body.x, body.y, body.vx, body.vy, body.mass, body.radius,
+                                      BodyStore::packColor(body.color[0], body.color[1], body.color[2]));
+        }
+        // Main asteroid belt as massless test particles between 2.2 and 3.2 AU
+        std::mt19937 random(42);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        for (int i = 0; i < 5000; i++) {
+            double r = 2.2 + unit(random);
+            double angle = 6.283185307179586 * unit(random);
+            double speed = std::sqrt(1.0 / r);
+            physics->particles.add(r * std::cos(angle), r * std::sin(angle), -speed * std::sin(angle), speed * std::cos(angle));
+        }
+
+        // The Sun dominates, so planets follow analytic Kepler orbits between
+        // interaction kicks and the step can grow well past the leapfrog limit
+        physics->timestepController.maxDt = 0.5;
+        physics->initialize();
+    }
+    bodyRenderer = new BodyRenderer();
+    densityRenderer = new DensityRenderer();
+    instanceStream = new InstanceStream();
+    chooseRenderMode();
+
     // Create grid
     grid = new SpacetimeGrid();
+    gridField.gridSize = 64;
+    gridField.assignment = ParticleMesh::Assignment::CloudInCell;
 
     // Register window resize callback
     glfwSetFramebufferSizeCallback(window, [](GLFWwindow* w, int width, int height) {
         glViewport(0, 0, width, height);
+        if (instance) {
+            instance->redrawRequested = true;
+        }
     });
     std::cout << "Window resize callback registered" << std::endl;
 
@@ -170,7 +250,36 @@ Simulation::Simulation() : window(nullptr), gridShader(nullptr), bodyShader(null
 
 void Simulation::cleanup() {
     std::cout << "Starting cleanup..." << std::endl;
+
+    // Write whatever the profiler captured before tearing down the context
+    PROFILE_DUMP(PROFILE_TRACE_FILE);
+    if (window) {
+        PROFILE_GPU_SHUTDOWN();
+    }
     
+    if (bodyRenderer) {
+        delete bodyRenderer;
+        bodyRenderer = nullptr;
+        std::cout << "Body renderer cleaned up" << std::endl;
+    }
+
+    if (densityRenderer) {
+        delete densityRenderer;
+        densityRenderer = nullptr;
+        std::cout << "Density renderer cleaned up" << std::endl;
+    }
+
+    if (instanceStream) {
+        delete instanceStream;
+        instanceStream = nullptr;
+    }
+
+    if (physics) {
+        delete physics;
+        physics = nullptr;
+        std::cout << "Physics engine cleaned up" << std::endl;
+    }
+
     if (grid) {
         delete grid;
         grid = nullptr;
@@ -188,7 +297,23 @@ void Simulation::cleanup() {
         bodyShader = nullptr;
         std::cout << "Body shader cleaned up" << std::endl;
     }
+
+    if (splatShader) {
+        delete splatShader;
+        splatShader = nullptr;
+    }
+    if (toneMapShader) {
+        delete toneMapShader;
+        toneMapShader = nullptr;
+        std::cout << "Density shaders cleaned up" << std::endl;
+    }
     
+    if (hudVAO) {
+        glDeleteVertexArrays(1, &hudVAO);
+        glDeleteBuffers(1, &hudVBO);
+        hudVAO = hudVBO = 0;
+    }
+
     if (textShader) {
         delete textShader;
         textShader = nullptr;
@@ -211,79 +336,335 @@ Simulation::~Simulation() {
 
 void Simulation::run() {
     std::cout << "Starting simulation loop..." << std::endl;
-    float lastTime = glfwGetTime();
+    PROFILE_THREAD_NAME("main");
+    double lastTime = glfwGetTime();
+    unsigned steadyFrames = 0;
+    uint64_t allocations = AllocationCounter::count();
     
     while (!glfwWindowShouldClose(window)) {
-        float currentTime = glfwGetTime();
-        float deltaTime = (currentTime - lastTime) * timeAcceleration;
-        lastTime = currentTime;
+        // A paused view only changes on input; sleep until there is some
+        if (clock.paused && !redrawRequested) {
+            glfwWaitEvents();
+            lastTime = glfwGetTime();
+            continue;
+        }
+        redrawRequested = false;
+
+        ArenaScope frameScratch;  // Per-frame scratch on the main thread's arena
+        PROFILE_SCOPE("frame");
+        PROFILE_GPU_FRAME();
+        double now = glfwGetTime();
+        double frameSeconds = now - lastTime;
+        lastTime = now;
+        if (!clock.paused) {
+            animationTime += frameSeconds;
+        }
+        float currentTime = static_cast<float>(animationTime);
+
+        // Advance by whole ticks. All but the last are batched into one engine
+        // call; the state before the last is kept for interpolation.
+        if (remote) {
+            receiveSnapshot(now);
+        } else {
+            PROFILE_SCOPE("physics.step");
+            unsigned ticks = clock.advance(frameSeconds);
+            if (ticks > 0) {
+                double start = glfwGetTime();
+                if (ticks > 1) {
+                    physics->advanceBy((ticks - 1) * clock.tickDuration);
+                }
+                interpolator.capture(*physics);
+                physics->advanceBy(clock.tickDuration);
+                clock.reportSimulationCost(ticks, glfwGetTime() - start);
+            }
+            interpolator.update(*physics, clock.alpha());
+        }
+
+        renderFrame(currentTime);
+
+        {
+            PROFILE_SCOPE("swap");
+            glfwSwapBuffers(window);
+        }
+        glfwPollEvents();
+
+        // Once warmed up, a frame must not touch the heap. Frames that handled
+        // input (picking, resizing buffers for a new view) start the count over.
+        if (AllocationCounter::enabled) {
+            uint64_t now = AllocationCounter::count();
+            if (redrawRequested || now != allocations) {
+                if (steadyFrames >= allocationWarmupFrames && !redrawRequested) {
+                    LOG_ERROR(now - allocations << " heap allocations in a steady-state frame");
+                    Logger::flush();
+                    std::abort();
+                }
+                steadyFrames = 0;
+            } else {
+                steadyFrames++;
+            }
+            allocations = now;
+        }
+    }
+    std::cout << "\nSimulation loop ended" << std::endl;
+}
+
+void Simulation::receiveSnapshot(double now) {
+#ifdef GRAVITY_SNAPSHOT_STREAMING
+    PROFILE_SCOPE("stream.receive");
+    if (remote->poll(remoteBodies, remoteParticles, remoteInfo)) {
+        bool firstSnapshot = lastArrival == 0.0;
+        // Blend from the snapshot on screen to the new one, except for test
+        // particles the engine has just re-sorted: they have no ids to match
+        bool particlesReordered = remoteInfo.particleOrder != shownParticleOrder;
+        if (!particlesReordered) {
+            interpolator.capture(*physics);
+        }
+        std::swap(physics->bodies(), remoteBodies);
+        std::swap(physics->particles, remoteParticles);
+        culler.storeReplaced();
+        if (particlesReordered || firstSnapshot) {
+            interpolator.capture(*physics);
+        }
+        shownParticleOrder = remoteInfo.particleOrder;
+        spatialIndexTime = -1.0;  // Engine time stands still in client mode; force a rebuild on the next pick
+
+        if (firstSnapshot) {
+            // Frame whatever the engine is simulating
+            double extent = 0.0;
+            const BodyStore& store = physics->bodies();
+            for (size_t i = 0; i < store.size(); i++) {
+                extent = std::max(extent, std::max(std::abs(store.x[i]), std::abs(store.y[i])));
+            }
+            if (extent > 0.0) {
+                zoom = static_cast<float>(2.0 / (1.1 * extent));
+            }
+            chooseRenderMode();
+        } else {
+            double interval = now - lastArrival;
+            arrivalInterval = arrivalInterval > 0.0 ? 0.9 * arrivalInterval + 0.1 * interval : interval;
+        }
+        lastArrival = now;
+    }
+    remoteConnected = remote->connected();
+
+    // Rendering trails the stream by one snapshot so there is always a state to blend towards
+    double alpha = arrivalInterval > 0.0 ? (now - lastArrival) / arrivalInterval : 1.0;
+    interpolator.update(*physics, alpha);
+#else
+    (void)now;
+#endif
+}
+
+void Simulation::chooseRenderMode() {
+    size_t count = physics->bodies().size() + physics->particles.size();
+    renderMode = count >= densityThreshold ? RenderMode::Density : RenderMode::Spheres;
+}
+
+BenchmarkResult Simulation::runBenchmark() {
+    if (!benchmark) {
+        throw std::runtime_error("Simulation was not created for a benchmark");
+    }
+    std::cout << "Running benchmark " << benchmark->name << " offscreen..." << std::endl;
+    PROFILE_THREAD_NAME("main");
+
+    // One physics step and one full render per frame; glFinish keeps queued
+    // GPU work inside the frame it belongs to
+    FrameTimes frames;
+    frames.reserve(benchmark->steps);
+    double start = 0.0;
+    double last = 0.0;
+    for (unsigned frame = 0; frame < Benchmark::warmupSteps + benchmark->steps; frame++) {
+        if (frame == Benchmark::warmupSteps) {
+            start = last = glfwGetTime();
+            HardwareCounters::reset();
+        }
+        PROFILE_SCOPE("frame");
+        PROFILE_GPU_FRAME();
+        interpolator.capture(*physics);
+        physics->step(benchmark->dt);
+        interpolator.update(*physics, 1.0);
+        renderFrame(static_cast<float>(physics->time()));
+        glfwSwapBuffers(window);
+        glFinish();
+        glfwPollEvents();
+        if (frame >= Benchmark::warmupSteps) {
+            double now = glfwGetTime();
+            frames.record(now - last);
+            last = now;
+        }
+    }
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    BenchmarkResult result;
+    result.name = benchmark->name;
+    result.mode = "render";
+    result.bodies = physics->bodies().size();
+    result.particles = physics->particles.size();
+    Benchmark::summarize(frames, last - start, result);
+    Benchmark::collectCounters(result);
+    return result;
+}
 
-        // Update camera matrices
-        updateCameraMatrices();
+void Simulation::renderFrame(float currentTime) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Draw the warped spacetime grid
+    // Update camera matrices
+    updateCameraMatrices();
+
+    // Draw the warped spacetime grid
+    {
+        PROFILE_SCOPE("render.grid");
+        PROFILE_GPU_SCOPE("render.grid");
         gridShader->use();
         gridShader->setFloat("time", currentTime);
         gridShader->setMat4("view", viewMatrix);
         gridShader->setMat4("projection", projectionMatrix);
         gridShader->setFloat("zoom", zoom);
         gridShader->setFloat("rotation", rotation);
-        
-        grid->drawGrid(*gridShader, currentTime);
 
-        // Update and render celestial bodies with accelerated time
-        bodyShader->use();
-        bodyShader->setMat4("view", viewMatrix);
-        bodyShader->setMat4("projection", projectionMatrix);
-        
-        // Update Earth's position using Kepler's equations
-        float simulationTime = currentTime * timeAcceleration;
-        for (size_t i = 1; i < bodies.size(); i++) {  // Skip Sun (index 0)
-            bodies[i].updatePosition(deltaTime);
+        // Reuse the physics mesh when it holds the full potential. It does not
+        // under Wisdom-Holman, where it is built without the central body, or
+        // under P3M, where it only holds the long-range part
+        {
+            CounterScope counting(HardwareCounters::Phase::GridWarp);
+            const ParticleMesh* field = &gridField;
+            if (physics->usesParticleMesh() && physics->centralBody() == BodyStore::invalidIndex &&
+                !physics->mesh.shortRangeCorrection) {
+                field = &physics->mesh;
+            } else {
+                const BodyStore& store = physics->bodies();
+                gridField.build(store.x.data(), store.y.data(), store.mass.data(), store.size(), physics->settings.softening);
+            }
+            grid->updatePotential(*field, 2.0f * 1.4142f * zoom);  // Covers the grid at any rotation
         }
 
-        // Draw all celestial bodies
-        for (const auto& body : bodies) {
-            body.draw(*bodyShader);
+        grid->drawGrid(*gridShader, currentTime);
+    }
+
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+
+    // Draw the celestial bodies that intersect the view, as spheres or as one density field
+    {
+        PROFILE_SCOPE("render.bodies");
+        PROFILE_GPU_SCOPE("render.bodies");
+        CounterScope counting(HardwareCounters::Phase::Upload);  // Culling, packing and the buffer upload
+        culler.setViewProjection(projectionMatrix * viewMatrix);
+        culler.cull(*physics, visible, &interpolator);
+        instanceStream->pack(*physics, visible, culler, &interpolator);
+        if (renderMode == RenderMode::Density) {
+            splatShader->use();
+            splatShader->setMat4("view", viewMatrix);
+            splatShader->setMat4("projection", projectionMatrix);
+            densityRenderer->draw(*splatShader, *toneMapShader, *instanceStream, width, height);
+        } else {
+            bodyShader->use();
+            bodyShader->setMat4("view", viewMatrix);
+            bodyShader->setMat4("projection", projectionMatrix);
+            bodyRenderer->draw(*bodyShader, *instanceStream);
         }
+    }
 
-        // Draw time acceleration text
-        int width, height;
-        glfwGetFramebufferSize(window, &width, &height);
-        
+    // Draw time acceleration text
+    {
+        PROFILE_SCOPE("render.hud");
+        PROFILE_GPU_SCOPE("render.hud");
         // Create text projection matrix for screen space
         glm::mat4 textProjection = glm::ortho(0.0f, (float)width, 0.0f, (float)height);
-        
+    
         textShader->use();
         textShader->setMat4("projection", textProjection);
-        
+    
         // Draw text in top-right corner
-        float quadWidth = 200.0f;
+        float quadWidth = 300.0f;
         float quadHeight = 50.0f;
         float x = width - quadWidth - 10.0f;
         float y = height - quadHeight - 10.0f;
-        
+    
         // Draw text background
         glUniform4f(glGetUniformLocation(textShader->ID, "color"), 0.0f, 0.0f, 0.0f, 0.3f);
         drawTextBackground(x, y, quadWidth, quadHeight);
-        
+    
         // Draw text
         glUniform4f(glGetUniformLocation(textShader->ID, "color"), 1.0f, 1.0f, 1.0f, 1.0f);
-        std::string text = "Time: " + std::to_string((int)timeAcceleration) + "x";
+        char text[96];
+        if (remote) {
+            const char* state = clock.paused ? " paused" : remoteConnected ? "" : " (disconnected)";
+            std::snprintf(text, sizeof(text), "Remote t: %.3g dE: %.1e%s", remoteInfo.time, remoteInfo.energyDrift,
+                          state);
+        } else {
+            const char* state = clock.paused ? " paused" : clock.lagging() ? " (lagging)" : "";
+            std::snprintf(text, sizeof(text), "Time: %dx dE: %.1e%s", (int)clock.timeAcceleration(),
+                          physics->monitor.energyDrift(), state);
+        }
         drawText(text, x + 10.0f, y + 10.0f, 0.5f);
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        // Per-phase counters in a second box below
+        if (HardwareCounters::enabled()) {
+            updateCounterReadout(glfwGetTime());
+            const float lineHeight = 20.0f;
+            float boxWidth = 480.0f;
+            float boxHeight = HardwareCounters::phaseCount * lineHeight + 10.0f;
+            float boxX = width - boxWidth - 10.0f;
+            float boxY = y - boxHeight - 10.0f;
+            glUniform4f(glGetUniformLocation(textShader->ID, "color"), 0.0f, 0.0f, 0.0f, 0.3f);
+            drawTextBackground(boxX, boxY, boxWidth, boxHeight);
+            glUniform4f(glGetUniformLocation(textShader->ID, "color"), 1.0f, 1.0f, 1.0f, 1.0f);
+            float lineY = boxY + boxHeight - lineHeight;
+            for (const char* line : counterLines) {
+                if (line[0] != '\0') {
+                    drawText(line, boxX + 10.0f, lineY, 0.5f);
+                    lineY -= lineHeight;
+                }
+            }
+        }
+    }
+}
+
+// Formats what each phase counted since the last refresh: its share of the
+// counted cycles, instructions per cycle, and cache misses, branch misses and
+// vector instructions per thousand instructions
+void Simulation::updateCounterReadout(double now) {
+    if (now - counterRefreshTime < counterRefreshSeconds) {
+        return;
+    }
+    counterRefreshTime = now;
+
+    using Counters = HardwareCounters;
+    using Event = Counters::Event;
+    Counters::Counts interval[Counters::phaseCount];
+    int64_t allCycles = 0;
+    for (size_t p = 0; p < Counters::phaseCount; p++) {
+        Counters::Counts total = Counters::total(static_cast<Counters::Phase>(p));
+        for (size_t e = 0; e < Counters::eventCount; e++) {
+            interval[p].value[e] = total.value[e] >= 0 ? total.value[e] - std::max<int64_t>(counterBase[p].value[e], 0) : -1;
+        }
+        counterBase[p] = total;
+        allCycles += std::max<int64_t>(interval[p][Event::Cycles], 0);
+    }
+
+    for (size_t p = 0; p < Counters::phaseCount; p++) {
+        const Counters::Counts& counts = interval[p];
+        if (counts.empty() || allCycles == 0) {
+            counterLines[p][0] = '\0';
+            continue;
+        }
+        int length = std::snprintf(counterLines[p], sizeof(counterLines[p]), "%-9s %3.0f%% IPC %.2f LLC %.1f br %.1f",
+                                   Counters::name(static_cast<Counters::Phase>(p)),
+                                   100.0 * counts[Event::Cycles] / allCycles, counts.instructionsPerCycle(),
+                                   counts.perKiloInstruction(Event::CacheMisses),
+                                   counts.perKiloInstruction(Event::BranchMisses));
+        if (counts.has(Event::VectorOps) && length > 0 && static_cast<size_t>(length) < sizeof(counterLines[p])) {
+            std::snprintf(counterLines[p] + length, sizeof(counterLines[p]) - length, " vec %.0f",
+                          counts.perKiloInstruction(Event::VectorOps));
+        }
     }
-    std::cout << "\nSimulation loop ended" << std::endl;
 }
 
 void Simulation::keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     if (instance == nullptr) return;
 
     if (action == GLFW_PRESS || action == GLFW_REPEAT) {
+        instance->redrawRequested = true;
         switch (key) {
             case GLFW_KEY_LEFT:
                 instance->rotation -= 0.1f;
@@ -298,13 +679,107 @@ void Simulation::keyCallback(GLFWwindow* window, int key, int scancode, int acti
                 instance->zoom /= 1.1f;
                 break;
             case GLFW_KEY_LEFT_BRACKET:  // '[' key to decrease time speed
-                instance->timeAcceleration = std::max(1.0f, instance->timeAcceleration / 2.0f);
+                instance->clock.setTimeAcceleration(instance->clock.timeAcceleration() / 2.0);
                 break;
             case GLFW_KEY_RIGHT_BRACKET:  // ']' key to increase time speed
-                instance->timeAcceleration = std::min(instance->maxTimeAcceleration, instance->timeAcceleration * 2.0f);
+                instance->clock.setTimeAcceleration(instance->clock.timeAcceleration() * 2.0);
+                break;
+            case GLFW_KEY_SPACE:  // Space pauses and resumes the simulation
+                if (action == GLFW_PRESS) {
+                    instance->clock.paused = !instance->clock.paused;
+                }
+                break;
+            case GLFW_KEY_D:  // D switches between spheres and the density field
+                if (action == GLFW_PRESS) {
+                    instance->renderMode = instance->renderMode == RenderMode::Density ? RenderMode::Spheres
+                                                                                       : RenderMode::Density;
+                }
+                break;
+            case GLFW_KEY_COMMA:  // ',' and '.' lower and raise the density drawn at full brightness
+                instance->densityRenderer->saturation = std::max(1.0f, instance->densityRenderer->saturation / 2.0f);
+                break;
+            case GLFW_KEY_PERIOD:
+                instance->densityRenderer->saturation *= 2.0f;
                 break;
+            case GLFW_KEY_F9:  // F9 writes the profiler trace captured so far
+                if (action == GLFW_PRESS) {
+                    PROFILE_DUMP(PROFILE_TRACE_FILE);
+                }
+                break;
+        }
+    }
+}
+
+void Simulation::mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+    (void)mods;
+    if (instance == nullptr || button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS) return;
+    double cursorX, cursorY;
+    glfwGetCursorPos(window, &cursorX, &cursorY);
+    instance->pickBody(cursorX, cursorY);
+    instance->redrawRequested = true;
+}
+
+bool Simulation::cursorToWorld(double cursorX, double cursorY, double& worldX, double& worldY) const {
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);  // Cursor positions are in window, not framebuffer, units
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+    float ndcX = static_cast<float>(2.0 * cursorX / width - 1.0);
+    float ndcY = static_cast<float>(1.0 - 2.0 * cursorY / height);
+
+    // Cast the cursor ray through the inverse of updateCameraMatrices and
+    // intersect it with the orbital plane z = 0
+    glm::mat4 inverse = glm::inverse(projectionMatrix * viewMatrix);
+    glm::vec4 nearPoint = inverse * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverse * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+    nearPoint = nearPoint / nearPoint.w;
+    farPoint = farPoint / farPoint.w;
+    float dz = farPoint.z - nearPoint.z;
+    if (std::abs(dz) < 1e-12f) {
+        return false;  // Looking along the plane
+    }
+    float t = -nearPoint.z / dz;
+    worldX = nearPoint.x + t * (farPoint.x - nearPoint.x);
+    worldY = nearPoint.y + t * (farPoint.y - nearPoint.y);
+    return true;
+}
+
+void Simulation::pickBody(double cursorX, double cursorY) {
+    const double pickPixels = 8.0;  // How far from a body a click still selects it
+    double worldX, worldY, edgeX, edgeY;
+    if (!cursorToWorld(cursorX, cursorY, worldX, worldY) ||
+        !cursorToWorld(cursorX + pickPixels, cursorY, edgeX, edgeY)) {
+        return;
+    }
+
+    const BodyStore& store = physics->bodies();
+    if (physics->time() != spatialIndexTime || spatialIndex.size() != store.size()) {
+        spatialIndex.update(store);
+        spatialIndexTime = physics->time();
+    }
+
+    // Accept clicks on the drawn sphere of a large body as well as near a small one
+    double tolerance = std::hypot(edgeX - worldX, edgeY - worldY);
+    spatialIndex.nearest(worldX, worldY, 8, pickCandidates);
+    selectedBody = SpatialIndex::invalidId;
+    for (const SpatialIndex::Neighbor& candidate : pickCandidates) {
+        uint32_t index = store.indexOf(candidate.id);
+        double drawnRadius = store.radius[index] * culler.radiusScale * BodyRenderer::meshRadius;
+        if (candidate.distance <= std::max(tolerance, drawnRadius)) {
+            selectedBody = candidate.id;
+            break;
         }
     }
+
+    if (selectedBody == SpatialIndex::invalidId) {
+        LOG_INFO("No body at (" << worldX << ", " << worldY << ")");
+        return;
+    }
+    uint32_t index = store.indexOf(selectedBody);
+    LOG_INFO("Selected body " << selectedBody << ": mass " << store.mass[index] << ", position ("
+             << store.x[index] << ", " << store.y[index] << "), velocity (" << store.vx[index] << ", "
+             << store.vy[index] << ")");
 }
 
 void Simulation::updateCameraMatrices() {
@@ -322,7 +797,7 @@ void Simulation::updateCameraMatrices() {
     viewMatrix = glm::translate(viewMatrix, glm::vec3(panX, panY, 0.0f));
 }
 
-void Simulation::drawTextBackground(float x, float y, float width, float height) {
+void Simulation::drawQuad(float x, float y, float width, float height) {
     // Create vertices for a quad
     float vertices[] = {
         x, y, 0.0f, 0.0f, 0.0f,
@@ -330,67 +805,36 @@ void Simulation::drawTextBackground(float x, float y, float width, float height)
         x, y + height, 0.0f, 0.0f, 1.0f,
         x + width, y + height, 0.0f, 1.0f, 1.0f
     };
-    
-    // Create and bind VAO
-    unsigned int VAO;
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-    
-    // Create and bind VBO
-    unsigned int VBO;
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    
-    // Set vertex attributes
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    
+
+    // The buffers are created on first use and only refilled afterwards
+    if (!hudVAO) {
+        glGenVertexArrays(1, &hudVAO);
+        glGenBuffers(1, &hudVBO);
+        glBindVertexArray(hudVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, hudVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), nullptr, GL_DYNAMIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+    }
+    glBindVertexArray(hudVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, hudVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+
     // Draw the quad
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    
-    // Cleanup
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    glBindVertexArray(0);
 }
 
-void Simulation::drawText(const std::string& text, float x, float y, float scale) {
+void Simulation::drawTextBackground(float x, float y, float width, float height) {
+    drawQuad(x, y, width, height);
+}
+
+void Simulation::drawText(const char* text, float x, float y, float scale) {
     // For now, we'll just draw a simple quad as placeholder text
     // In a real implementation, you would use a font texture atlas and render actual text
-    float width = text.length() * 20.0f * scale;  // Approximate width based on text length
+    float width = std::strlen(text) * 20.0f * scale;  // Approximate width based on text length
     float height = 30.0f * scale;  // Fixed height
-    
-    // Create vertices for a quad
-    float vertices[] = {
-        x, y, 0.0f, 0.0f, 0.0f,
-        x + width, y, 0.0f, 1.0f, 0.0f,
-        x, y + height, 0.0f, 0.0f, 1.0f,
-        x + width, y + height, 0.0f, 1.0f, 1.0f
-    };
-    
-    // Create and bind VAO
-    unsigned int VAO;
-    glGenVertexArrays(1, &VAO);
-    glBindVertexArray(VAO);
-    
-    // Create and bind VBO
-    unsigned int VBO;
-    glGenBuffers(1, &VBO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    
-    // Set vertex attributes
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    
-    // Draw the quad
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    
-    // Cleanup
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    drawQuad(x, y, width, height);
 }
\ No newline at end of file
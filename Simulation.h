@@ -4,20 +4,42 @@
 #include "CelestialBody.h"
 #include "SpacetimeGrid.h"
 #include "Shader.h"
+#include "PhysicsEngine.h"
+#include "BodyRenderer.h"
+#include "DensityRenderer.h"
+#include "InstanceStream.h"
+#include "FrustumCuller.h"
+#include "FrameInterpolator.h"
+#include "SimulationClock.h"
+#include "Benchmark.h"
+#include "SpatialIndex.h"
+#include "SnapshotCodec.h"
+#include "HardwareCounters.h"
 #include <vector>
 #include <string>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+class SnapshotSubscriber;
+
 class Simulation {
 private:
     GLFWwindow* window;
     std::vector<CelestialBody> bodies;
+    PhysicsEngine* physics;  // Owns the simulated state; bodies only seeds it
+    BodyRenderer* bodyRenderer;
+    DensityRenderer* densityRenderer;
+    InstanceStream* instanceStream;  // Packed instances and palette shared by both renderers
+    FrustumCuller culler;
+    ParticleMesh gridField;  // Coarse full potential for the grid when the physics mesh does not hold one
+    VisibleSet visible;      // Reused every frame
     SpacetimeGrid* grid;  // Changed to pointer
     Shader* gridShader;    // Shader for grid
     Shader* bodyShader;    // Shader for celestial bodies
     Shader* textShader;    // Shader for text rendering
+    Shader* splatShader;   // Density mode: accumulates point sprites
+    Shader* toneMapShader; // Density mode: maps the accumulated density to the screen
     float zoom;           // Zoom level
     float rotation;       // Rotation angle
     
@@ -30,22 +52,65 @@ private:
     glm::mat4 viewMatrix;
     
     // Time control
-    float timeAcceleration;  // Current time acceleration factor
-    const float maxTimeAcceleration;  // Maximum allowed time acceleration
+    SimulationClock clock;            // Fixed ticks, time acceleration and pause
+    FrameInterpolator interpolator;   // Draws bodies between the last two ticks
+    double animationTime;             // Wall time while running; drives the grid animation
+    bool redrawRequested;             // While paused, frames are only drawn on demand
+    const BenchmarkCase* benchmark;   // Offscreen benchmark run instead of the interactive view
+
+    // Spheres for systems small enough to tell bodies apart, a density field beyond
+    enum class RenderMode { Spheres, Density };
+    RenderMode renderMode;
+    static constexpr size_t densityThreshold = 100000;  // Bodies and particles that switch to density on load
+
+    // Client mode: the state comes from a headless engine instead of `physics` stepping
+    SnapshotSubscriber* remote;       // Null when simulating locally
+    BodyStore remoteBodies;           // Arriving snapshot, swapped with the engine's state
+    TestParticles remoteParticles;
+    SnapshotInfo remoteInfo;          // Of the snapshot on screen
+    uint64_t shownParticleOrder;      // Particle sort generation of the snapshot on screen
+    double lastArrival;               // Wall time the snapshot on screen arrived
+    double arrivalInterval;           // Smoothed time between snapshots
+    bool remoteConnected;
+
+    // Picking
+    SpatialIndex spatialIndex;        // Refreshed lazily, only when a query needs it
+    double spatialIndexTime;          // Simulation time of the last refresh
+    BodyStore::BodyId selectedBody;   // SpatialIndex::invalidId when nothing is selected
+    std::vector<SpatialIndex::Neighbor> pickCandidates;  // Reused between clicks
     
+    void renderFrame(float currentTime);  // Grid, bodies and HUD for the current state
+    void receiveSnapshot(double now);     // Client mode: takes the newest snapshot and sets the blend
+    void chooseRenderMode();              // Picks the mode that suits the loaded system
     void cleanup();        // Helper method to clean up resources
     void updateCameraMatrices();  // New method to update view/projection matrices
     static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
+    static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+    bool cursorToWorld(double cursorX, double cursorY, double& worldX, double& worldY) const;
+    void pickBody(double cursorX, double cursorY);  // Selects the body under the cursor, if any
     static Simulation* instance;  // Singleton instance for callbacks
     
+    // Hardware counter readout under the HUD while counting, over roughly the last second
+    static constexpr double counterRefreshSeconds = 1.0;
+    HardwareCounters::Counts counterBase[HardwareCounters::phaseCount];  // Totals at the last refresh
+    char counterLines[HardwareCounters::phaseCount][96];                // Empty for idle phases
+    double counterRefreshTime;
+    void updateCounterReadout(double now);
+
     // Text rendering functions
+    GLuint hudVAO, hudVBO;  // One quad, refilled for every HUD element
+    void drawQuad(float x, float y, float width, float height);
     void drawTextBackground(float x, float y, float width, float height);
-    void drawText(const std::string& text, float x, float y, float scale);
+    void drawText(const char* text, float x, float y, float scale);
 
 public:
-    Simulation();          // Constructor
+    // With a benchmark case the window stays hidden and the case's scenario
+    // replaces the default solar system. With a subscriber the viewer only
+    // draws what a headless engine streams to it and never steps itself.
+    explicit Simulation(const BenchmarkCase* benchmark = nullptr, SnapshotSubscriber* remote = nullptr);
     ~Simulation();         // Destructor
     void run();           // Runs the simulation loop
+    BenchmarkResult runBenchmark();  // Steps and renders the benchmark case once per frame
     void handleKeyPress(int key, int action);  // Handles keyboard input
 };
 
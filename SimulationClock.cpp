@@ -0,0 +1,52 @@
+#include "SimulationClock.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+const double costSmoothing = 0.2;  // Weight of the newest measurement in the per-tick cost
+}
+
+SimulationClock::SimulationClock(double tickDuration)
+    : tickDuration(tickDuration), maxTimeAcceleration(100000.0), maxFrameSeconds(0.25), frameBudget(0.012),
+      maxTicksPerFrame(1u << 20), paused(false), acceleration(1.0), accumulator(0.0), secondsPerTick(0.0),
+      dropped(0.0), ticks(0), droppedThisFrame(false) {}
+
+void SimulationClock::setTimeAcceleration(double value) {
+    acceleration = std::clamp(value, 1.0, maxTimeAcceleration);
+}
+
+unsigned SimulationClock::advance(double wallSeconds) {
+    droppedThisFrame = false;
+    if (paused || !(wallSeconds > 0.0)) {
+        return 0;
+    }
+
+    accumulator += std::min(wallSeconds, maxFrameSeconds) * acceleration;
+    double due = std::floor(accumulator / tickDuration);
+
+    double affordable = maxTicksPerFrame;
+    if (secondsPerTick > 0.0) {
+        affordable = std::clamp(std::floor(frameBudget / secondsPerTick), 1.0, affordable);
+    }
+    if (due > affordable) {
+        // Keep the fraction of a tick so interpolation stays continuous
+        double excess = (due - affordable) * tickDuration;
+        accumulator -= excess;
+        dropped += excess;
+        droppedThisFrame = true;
+        due = affordable;
+    }
+
+    accumulator = std::max(0.0, accumulator - due * tickDuration);
+    unsigned count = static_cast<unsigned>(due);
+    ticks += count;
+    return count;
+}
+
+void SimulationClock::reportSimulationCost(unsigned tickCount, double wallSeconds) {
+    if (tickCount == 0 || !(wallSeconds >= 0.0)) {
+        return;
+    }
+    double perTick = wallSeconds / tickCount;
+    secondsPerTick = secondsPerTick > 0.0 ? secondsPerTick + costSmoothing * (perTick - secondsPerTick) : perTick;
+}
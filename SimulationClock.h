@@ -0,0 +1,52 @@
+#ifndef SIMULATION_CLOCK_H
+#define SIMULATION_CLOCK_H
+
+// Fixed-tick simulation clock for an interactive loop.
+//
+// Every frame adds its wall-clock duration times the time acceleration to an
+// accumulator, and the simulation advances by whole ticks of `tickDuration`.
+// The simulation rate therefore does not depend on the frame rate, and a
+// hitch is spread over ticks instead of turning into one huge step.
+// The fraction of a tick left in the accumulator is the interpolation
+// factor for rendering between the last two ticks.
+//
+// High time accelerations simply mean many ticks per frame, which the caller
+// batches into one engine advance. To keep a slow machine out of the
+// catch-up spiral, the clock learns the wall time a tick costs and only
+// hands out as many ticks as fit the frame budget; simulation time beyond
+// that is dropped (the simulation runs slower than requested) and reported.
+class SimulationClock {
+public:
+    explicit SimulationClock(double tickDuration = 1.0 / 120.0);
+
+    double tickDuration;         // Simulation time per tick
+    double maxTimeAcceleration;
+    double maxFrameSeconds;      // Longer frames (hitches, a stopped debugger) count as this long
+    double frameBudget;          // Wall seconds per frame the ticks may use
+    unsigned maxTicksPerFrame;   // Hard cap whatever the measured cost
+    bool paused;
+
+    // Adds a frame's wall-clock time and returns the ticks to simulate now
+    unsigned advance(double wallSeconds);
+
+    // Wall time the caller spent simulating `ticks` ticks; feeds the budget
+    void reportSimulationCost(unsigned ticks, double wallSeconds);
+
+    double timeAcceleration() const { return acceleration; }
+    void setTimeAcceleration(double value);
+
+    double alpha() const { return accumulator / tickDuration; }  // In [0, 1)
+    double time() const { return ticks * tickDuration; }         // Simulated time so far
+    bool lagging() const { return droppedThisFrame; }           // The last frame dropped time
+    double droppedTime() const { return dropped; }
+
+private:
+    double acceleration;
+    double accumulator;
+    double secondsPerTick;  // Smoothed measured cost of one tick
+    double dropped;
+    unsigned long long ticks;
+    bool droppedThisFrame;
+};
+
+#endif // SIMULATION_CLOCK_H
@@ -0,0 +1,299 @@
+#include "SnapshotCodec.h"
+#include "Arena.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const uint32_t frameMagic = 0x504E5347;  // "GSNP"
+const uint32_t keyframeFlag = 1;
+const size_t maxVarintBytes = 10;
+const int64_t maxQuantized = int64_t(1) << 62;  // Far beyond any useful position; keeps zigzag exact
+
+// Bytes of one body in a keyframe: id, x, y, mass, radius, color
+const size_t maxBodyBytes = 5 + 2 * maxVarintBytes + sizeof(double) + sizeof(float) + sizeof(uint32_t);
+const size_t maxParticleBytes = 2 * maxVarintBytes;
+
+int64_t quantize(double value, double quantum) {
+    double cells = value / quantum;
+    if (!(cells > -static_cast<double>(maxQuantized))) {  // Also catches NaN
+        return std::isnan(cells) ? 0 : -maxQuantized;
+    }
+    return cells < static_cast<double>(maxQuantized) ? std::llround(cells) : maxQuantized;
+}
+
+// Smallest power of two that spreads the largest coordinate over
+// 2^positionBits cells
+double chooseQuantum(const BodyStore& bodies, const TestParticles& particles) {
+    double extent = 0.0;
+    auto widen = [&extent](const std::vector<double>& values) {
+        for (double value : values) {
+            if (std::isfinite(value)) {
+                extent = std::max(extent, std::fabs(value));
+            }
+        }
+    };
+    widen(bodies.x);
+    widen(bodies.y);
+    widen(particles.x);
+    widen(particles.y);
+    int exponent = 0;
+    std::frexp(extent > 0.0 ? extent : 1.0, &exponent);
+    return std::ldexp(1.0, exponent - SnapshotEncoder::positionBits);
+}
+
+class Writer {
+public:
+    explicit Writer(char* out) : out(out), size(0) {}
+
+    template <typename T>
+    void raw(T value) {
+        std::memcpy(out + size, &value, sizeof(T));
+        size += sizeof(T);
+    }
+
+    void varint(uint64_t value) {
+        while (value >= 0x80) {
+            out[size++] = static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out[size++] = static_cast<char>(value);
+    }
+
+    void signedVarint(int64_t value) {
+        varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    char* out;
+    size_t size;
+};
+
+// Every read is checked against the end of the frame; after the first
+// failure `ok` stays false and reads return zero
+class Reader {
+public:
+    Reader(const char* data, size_t size) : data(data), size(size), offset(0), ok(true) {}
+
+    template <typename T>
+    T raw() {
+        T value{};
+        if (size - offset < sizeof(T)) {
+            ok = false;
+            return value;
+        }
+        std::memcpy(&value, data + offset, sizeof(T));
+        offset += sizeof(T);
+        return value;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (offset == size) {
+                break;
+            }
+            uint8_t byte = static_cast<uint8_t>(data[offset++]);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        ok = false;
+        return 0;
+    }
+
+    int64_t signedVarint() {
+        uint64_t value = varint();
+        return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+    const char* data;
+    size_t size;
+    size_t offset;
+    bool ok;
+};
+
+} // namespace
+
+SnapshotEncoder::SnapshotEncoder()
+    : keyframeInterval(64), sequence(0), sinceKeyframe(0), quantum(1.0), particleOrder(0) {}
+
+size_t SnapshotEncoder::maxFrameBytes(size_t bodyCount, size_t particleCount) {
+    return headerBytes + bodyCount * maxBodyBytes + particleCount * maxParticleBytes;
+}
+
+size_t SnapshotEncoder::encode(const BodyStore& bodies, const TestParticles& particles, SnapshotInfo info, char* out,
+                               size_t capacity, bool forceKeyframe) {
+    if (capacity < maxFrameBytes(bodies.size(), particles.size())) {
+        return 0;
+    }
+
+    bool keyframe = forceKeyframe || sequence == 0 || sinceKeyframe + 1 >= keyframeInterval ||
+                    particles.size() != particleX.size() || info.particleOrder != particleOrder ||
+                    bodies.id != ids;
+    uint64_t baseSequence = keyframe ? 0 : sequence;
+    if (keyframe) {
+        quantum = chooseQuantum(bodies, particles);
+        ids = bodies.id;
+        bodyX.assign(bodies.size(), 0);
+        bodyY.assign(bodies.size(), 0);
+        particleX.assign(particles.size(), 0);
+        particleY.assign(particles.size(), 0);
+        particleOrder = info.particleOrder;
+        sinceKeyframe = 0;
+    } else {
+        sinceKeyframe++;
+    }
+    sequence++;
+
+    Writer writer(out);
+    writer.raw(frameMagic);
+    writer.raw(keyframe ? keyframeFlag : 0u);
+    writer.raw(sequence);
+    writer.raw(baseSequence);
+    writer.raw(info.time);
+    writer.raw(info.steps);
+    writer.raw(info.particleOrder);
+    writer.raw(info.energyDrift);
+    writer.raw(quantum);
+    writer.raw(static_cast<uint32_t>(bodies.size()));
+    writer.raw(static_cast<uint32_t>(particles.size()));
+
+    // Keyframes start every coordinate from zero, so both cases write the
+    // change since the value held for the previous frame
+    for (size_t i = 0; i < bodies.size(); i++) {
+        int64_t qx = quantize(bodies.x[i], quantum);
+        int64_t qy = quantize(bodies.y[i], quantum);
+        if (keyframe) {
+            writer.varint(bodies.id[i]);
+        }
+        writer.signedVarint(qx - bodyX[i]);
+        writer.signedVarint(qy - bodyY[i]);
+        if (keyframe) {
+            writer.raw(bodies.mass[i]);
+            writer.raw(static_cast<float>(bodies.radius[i]));
+            writer.raw(bodies.color[i]);
+        }
+        bodyX[i] = qx;
+        bodyY[i] = qy;
+    }
+    for (size_t i = 0; i < particles.size(); i++) {
+        int64_t qx = quantize(particles.x[i], quantum);
+        int64_t qy = quantize(particles.y[i], quantum);
+        writer.signedVarint(qx - particleX[i]);
+        writer.signedVarint(qy - particleY[i]);
+        particleX[i] = qx;
+        particleY[i] = qy;
+    }
+    return writer.size;
+}
+
+SnapshotDecoder::SnapshotDecoder() : sequence(0), quantum(1.0) {}
+
+bool SnapshotDecoder::decode(const char* data, size_t size, BodyStore& bodies, TestParticles& particles,
+                             SnapshotInfo& info) {
+    Reader reader(data, size);
+    if (reader.raw<uint32_t>() != frameMagic) {
+        return false;
+    }
+    bool keyframe = (reader.raw<uint32_t>() & keyframeFlag) != 0;
+    uint64_t frameSequence = reader.raw<uint64_t>();
+    uint64_t baseSequence = reader.raw<uint64_t>();
+    SnapshotInfo frameInfo;
+    frameInfo.time = reader.raw<double>();
+    frameInfo.steps = reader.raw<uint64_t>();
+    frameInfo.particleOrder = reader.raw<uint64_t>();
+    frameInfo.energyDrift = reader.raw<double>();
+    double frameQuantum = reader.raw<double>();
+    size_t bodyCount = reader.raw<uint32_t>();
+    size_t particleCount = reader.raw<uint32_t>();
+    if (!reader.ok || !(frameQuantum > 0.0)) {
+        return false;
+    }
+    if (!keyframe && (sequence == 0 || baseSequence != sequence || bodyCount != ids.size() ||
+                      particleCount != particleX.size())) {
+        return false;
+    }
+    // Even the smallest encoding of a body or particle takes two bytes
+    if ((bodyCount + particleCount) * 2 > size - reader.offset) {
+        return false;
+    }
+
+    if (keyframe) {
+        nextIds.resize(bodyCount);
+        nextBodyX.assign(bodyCount, 0);
+        nextBodyY.assign(bodyCount, 0);
+        nextMass.resize(bodyCount);
+        nextRadius.resize(bodyCount);
+        nextColor.resize(bodyCount);
+        nextParticleX.assign(particleCount, 0);
+        nextParticleY.assign(particleCount, 0);
+    } else {
+        nextIds = ids;
+        nextBodyX = bodyX;
+        nextBodyY = bodyY;
+        nextMass = mass;
+        nextRadius = radius;
+        nextColor = color;
+        nextParticleX = particleX;
+        nextParticleY = particleY;
+    }
+    for (size_t i = 0; i < bodyCount; i++) {
+        if (keyframe) {
+            nextIds[i] = static_cast<BodyStore::BodyId>(reader.varint());
+        }
+        nextBodyX[i] += reader.signedVarint();
+        nextBodyY[i] += reader.signedVarint();
+        if (keyframe) {
+            nextMass[i] = reader.raw<double>();
+            nextRadius[i] = reader.raw<float>();
+            nextColor[i] = reader.raw<uint32_t>();
+        }
+    }
+    for (size_t i = 0; i < particleCount; i++) {
+        nextParticleX[i] += reader.signedVarint();
+        nextParticleY[i] += reader.signedVarint();
+    }
+    if (!reader.ok || reader.offset != size) {
+        return false;
+    }
+    // Ids must be unique for the store to accept them
+    if (keyframe && bodyCount > 0) {
+        ArenaScope scratch;
+        BodyStore::BodyId* sorted = scratch.allocate<BodyStore::BodyId>(bodyCount);
+        std::copy(nextIds.begin(), nextIds.end(), sorted);
+        std::sort(sorted, sorted + bodyCount);
+        if (std::adjacent_find(sorted, sorted + bodyCount) != sorted + bodyCount ||
+            sorted[bodyCount - 1] == BodyStore::invalidIndex) {
+            return false;
+        }
+    }
+
+    ids.swap(nextIds);
+    bodyX.swap(nextBodyX);
+    bodyY.swap(nextBodyY);
+    mass.swap(nextMass);
+    radius.swap(nextRadius);
+    color.swap(nextColor);
+    particleX.swap(nextParticleX);
+    particleY.swap(nextParticleY);
+    sequence = frameSequence;
+    quantum = frameQuantum;
+
+    bodies.clear();
+    bodies.reserve(bodyCount);
+    for (size_t i = 0; i < bodyCount; i++) {
+        bodies.addBodyWithId(ids[i], bodyX[i] * quantum, bodyY[i] * quantum, 0.0, 0.0, mass[i], radius[i], color[i]);
+    }
+    particles.clear();
+    particles.reserve(particleCount);
+    for (size_t i = 0; i < particleCount; i++) {
+        particles.add(particleX[i] * quantum, particleY[i] * quantum, 0.0, 0.0);
+    }
+
+    frameInfo.sequence = frameSequence;
+    frameInfo.keyframe = keyframe;
+    info = frameInfo;
+    return true;
+}
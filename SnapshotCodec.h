@@ -0,0 +1,96 @@
+#ifndef SNAPSHOT_CODEC_H
+#define SNAPSHOT_CODEC_H
+
+#include "BodyStore.h"
+#include "TestParticles.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Wire format for the body snapshots a headless engine streams to viewers.
+//
+// A frame is a fixed header followed by the bodies and then the test
+// particles. Positions are quantized to a grid whose cell size (`quantum`, a
+// power of two) is chosen at every keyframe so the system spans about
+// 2^positionBits cells, and are written as zigzag varints: absolute in
+// keyframes, as the change since the previous frame in delta frames, which
+// costs a slowly moving body a byte or two per coordinate. Keyframes also
+// carry each body's id, mass, radius and color.
+//
+// A delta frame applies only on top of the frame it was encoded against
+// (baseSequence). The encoder falls back to a keyframe whenever that would
+// not describe the new state: bodies merged or were reordered, the particle
+// count changed, or the engine re-sorted its particles. Multi-byte fields
+// are in host byte order; both ends are assumed to share it.
+struct SnapshotInfo {
+    double time = 0.0;            // Simulation time of the state
+    uint64_t steps = 0;           // Engine steps taken
+    uint64_t particleOrder = 0;   // Changes whenever the particles were re-sorted
+    double energyDrift = 0.0;     // Relative energy change reported by the engine
+    uint64_t sequence = 0;        // Frame number, from 1
+    bool keyframe = false;
+};
+
+class SnapshotEncoder {
+public:
+    static constexpr int positionBits = 20;
+    static constexpr size_t headerBytes = 72;
+
+    SnapshotEncoder();
+
+    unsigned keyframeInterval;  // Frames between keyframes even when deltas would do
+
+    // Upper bound on the size of any frame holding this many bodies and particles
+    static size_t maxFrameBytes(size_t bodyCount, size_t particleCount);
+
+    // Encodes one frame into `out`, which must hold `capacity` bytes, and
+    // returns its size; 0 if it does not fit. `info.sequence` and
+    // `info.keyframe` are set by the encoder.
+    size_t encode(const BodyStore& bodies, const TestParticles& particles, SnapshotInfo info, char* out,
+                  size_t capacity, bool forceKeyframe = false);
+
+    // Makes the next frame a keyframe (a receiver missed frames)
+    void reset() { sequence = 0; }
+
+private:
+    uint64_t sequence;        // Of the last frame encoded; 0 = none yet
+    unsigned sinceKeyframe;
+    double quantum;
+    uint64_t particleOrder;
+    std::vector<BodyStore::BodyId> ids;  // Body order of the last frame
+    std::vector<int64_t> bodyX, bodyY;   // Quantized positions of the last frame
+    std::vector<int64_t> particleX, particleY;
+};
+
+class SnapshotDecoder {
+public:
+    SnapshotDecoder();
+
+    // Rebuilds `bodies` and `particles` from a frame; velocities are not
+    // transmitted and come out as zero. Returns false, leaving the outputs
+    // untouched, for a malformed frame or a delta frame whose base was not
+    // the last frame decoded; decoding resumes with the next keyframe.
+    bool decode(const char* data, size_t size, BodyStore& bodies, TestParticles& particles, SnapshotInfo& info);
+
+    uint64_t lastSequence() const { return sequence; }
+
+private:
+    uint64_t sequence;  // Of the last frame decoded; 0 = none
+    double quantum;
+    std::vector<BodyStore::BodyId> ids;
+    std::vector<int64_t> bodyX, bodyY;
+    std::vector<double> mass;
+    std::vector<float> radius;
+    std::vector<uint32_t> color;
+    std::vector<int64_t> particleX, particleY;
+
+    // Staging for a frame being decoded, so a bad frame changes nothing
+    std::vector<BodyStore::BodyId> nextIds;
+    std::vector<int64_t> nextBodyX, nextBodyY;
+    std::vector<double> nextMass;
+    std::vector<float> nextRadius;
+    std::vector<uint32_t> nextColor;
+    std::vector<int64_t> nextParticleX, nextParticleY;
+};
+
+#endif // SNAPSHOT_CODEC_H
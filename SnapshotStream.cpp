@@ -0,0 +1,406 @@
+#include "SnapshotStream.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const uint32_t segmentMagic = 0x4D534753;  // "SGSM"
+const unsigned slotCount = 3;              // Latest, previous, and one being written
+const uint32_t maxTcpFrameBytes = 1u << 30;
+
+#ifdef MSG_NOSIGNAL
+const int sendFlags = MSG_NOSIGNAL;  // A viewer hanging up must not kill the run
+#else
+const int sendFlags = 0;             // macOS: SO_NOSIGPIPE is set on the socket instead
+#endif
+
+struct SegmentHeader {
+    uint32_t magic;
+    uint32_t slots;
+    uint64_t slotCapacity;                // Frame bytes each slot holds
+    uint64_t slotStride;                  // Distance between slots
+    alignas(64) std::atomic<uint64_t> latest;  // (frames published << 2) | slot; 0 before the first
+};
+
+struct SlotHeader {
+    alignas(64) std::atomic<uint64_t> version;  // Odd while the slot is being written
+    uint64_t size;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory counters must be lock-free");
+
+size_t slotOffset(unsigned slot, size_t stride) {
+    return sizeof(SegmentHeader) + slot * stride;
+}
+
+std::string segmentPath(const std::string& name) {
+    return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+void setNonBlocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+}
+
+void configureStreamSocket(int fd) {
+    setNonBlocking(fd);
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+#endif
+}
+
+} // namespace
+
+SnapshotPublisher::SnapshotPublisher()
+    : segment(nullptr), mappedSize(0), slotStride(0), nextSlot(0), published(0), listener(-1), boundPort(0),
+      dropped(0) {}
+
+SnapshotPublisher::~SnapshotPublisher() {
+    for (const std::unique_ptr<Client>& client : clients) {
+        close(client->socket);
+    }
+    if (listener >= 0) {
+        close(listener);
+    }
+    if (segment) {
+        munmap(segment, mappedSize);
+        shm_unlink(segmentName.c_str());
+    }
+}
+
+void SnapshotPublisher::openSharedMemory(const std::string& name, size_t bodyCount, size_t particleCount) {
+    if (segment) {
+        throw std::runtime_error("Snapshot publisher already has a shared memory segment");
+    }
+    std::string path = segmentPath(name);
+    size_t capacity = SnapshotEncoder::maxFrameBytes(bodyCount, particleCount);
+    size_t stride = (sizeof(SlotHeader) + capacity + 63) & ~size_t(63);
+    size_t totalSize = sizeof(SegmentHeader) + slotCount * stride;
+
+    shm_unlink(path.c_str());  // Leftover from a crashed run
+    int fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        throw std::runtime_error("shm_open failed for " + path + ": " + std::strerror(errno));
+    }
+    if (ftruncate(fd, static_cast<off_t>(totalSize)) != 0) {
+        std::string error = std::strerror(errno);
+        close(fd);
+        shm_unlink(path.c_str());
+        throw std::runtime_error("ftruncate failed for " + path + ": " + error);
+    }
+    void* address = mmap(nullptr, totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        shm_unlink(path.c_str());
+        throw std::runtime_error(std::string("mmap failed: ") + std::strerror(errno));
+    }
+
+    segment = static_cast<char*>(address);
+    mappedSize = totalSize;
+    slotStride = stride;
+    segmentName = path;
+    SegmentHeader* header = new (segment) SegmentHeader();
+    header->magic = segmentMagic;
+    header->slots = slotCount;
+    header->slotCapacity = capacity;
+    header->slotStride = stride;
+    header->latest.store(0, std::memory_order_relaxed);
+    for (unsigned slot = 0; slot < slotCount; slot++) {
+        SlotHeader* slotHeader = new (segment + slotOffset(slot, stride)) SlotHeader();
+        slotHeader->version.store(0, std::memory_order_relaxed);
+        slotHeader->size = 0;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void SnapshotPublisher::listen(uint16_t requestedPort) {
+    if (listener >= 0) {
+        throw std::runtime_error("Snapshot publisher is already listening");
+    }
+    listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw std::runtime_error(std::string("Snapshot stream: socket failed: ") + std::strerror(errno));
+    }
+    int yes = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(requestedPort);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listener, 8) != 0) {
+        std::string error = std::strerror(errno);
+        close(listener);
+        listener = -1;
+        throw std::runtime_error("Snapshot stream: cannot listen on port " + std::to_string(requestedPort) + ": " +
+                                 error);
+    }
+    socklen_t length = sizeof(address);
+    getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+    boundPort = ntohs(address.sin_port);
+    setNonBlocking(listener);
+}
+
+void SnapshotPublisher::publish(const BodyStore& bodies, const TestParticles& particles, const SnapshotInfo& info) {
+    if (segment) {
+        publishSharedMemory(bodies, particles, info);
+    }
+    if (listener < 0) {
+        return;
+    }
+    acceptClients();
+
+    size_t frameBytes = SnapshotEncoder::maxFrameBytes(bodies.size(), particles.size());
+    for (size_t c = 0; c < clients.size();) {
+        Client& client = *clients[c];
+        bool alive = flush(client);
+        if (alive && client.pending > client.sent) {
+            // Still busy with the last frame; the next one it gets must stand alone
+            client.encoder.reset();
+            dropped++;
+        } else if (alive) {
+            if (client.outgoing.size() < sizeof(uint32_t) + frameBytes) {
+                client.outgoing.resize(sizeof(uint32_t) + frameBytes);
+            }
+            size_t size = client.encoder.encode(bodies, particles, info, client.outgoing.data() + sizeof(uint32_t),
+                                                client.outgoing.size() - sizeof(uint32_t));
+            uint32_t length = static_cast<uint32_t>(size);
+            std::memcpy(client.outgoing.data(), &length, sizeof(length));
+            client.sent = 0;
+            client.pending = sizeof(length) + size;
+            alive = flush(client);
+        }
+        if (!alive) {
+            close(client.socket);
+            clients.erase(clients.begin() + static_cast<std::ptrdiff_t>(c));
+            continue;
+        }
+        c++;
+    }
+}
+
+void SnapshotPublisher::publishSharedMemory(const BodyStore& bodies, const TestParticles& particles,
+                                            const SnapshotInfo& info) {
+    SegmentHeader* header = reinterpret_cast<SegmentHeader*>(segment);
+    unsigned slot = nextSlot;
+    nextSlot = (nextSlot + 1) % slotCount;
+    SlotHeader* slotHeader = reinterpret_cast<SlotHeader*>(segment + slotOffset(slot, slotStride));
+    char* frame = segment + slotOffset(slot, slotStride) + sizeof(SlotHeader);
+
+    uint64_t version = slotHeader->version.load(std::memory_order_relaxed);
+    slotHeader->version.store(version + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    size_t size = sharedEncoder.encode(bodies, particles, info, frame, header->slotCapacity, true);
+    slotHeader->size = size;
+    slotHeader->version.store(version + 2, std::memory_order_release);
+    if (size == 0) {
+        dropped++;  // More bodies than the segment was sized for
+        return;
+    }
+    published++;
+    header->latest.store((published << 2) | slot, std::memory_order_release);
+}
+
+void SnapshotPublisher::acceptClients() {
+    while (true) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            return;  // EAGAIN: nobody else waiting
+        }
+        configureStreamSocket(fd);
+        std::unique_ptr<Client> client(new Client());
+        client->socket = fd;
+        client->sent = 0;
+        client->pending = 0;
+        clients.push_back(std::move(client));
+    }
+}
+
+bool SnapshotPublisher::flush(Client& client) {
+    while (client.sent < client.pending) {
+        ssize_t n = send(client.socket, client.outgoing.data() + client.sent, client.pending - client.sent, sendFlags);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        client.sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+SnapshotSubscriber::SnapshotSubscriber(const std::string& address)
+    : source(address), segment(nullptr), mappedSize(0), lastPublished(0), socket(-1), incomingSize(0) {
+    if (address.compare(0, 4, "shm:") == 0) {
+        std::string path = segmentPath(address.substr(4));
+        int fd = shm_open(path.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            throw std::runtime_error("shm_open failed for " + path + ": " + std::strerror(errno));
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SegmentHeader)) {
+            close(fd);
+            throw std::runtime_error("Shared memory segment " + path + " is not a snapshot stream");
+        }
+        void* mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            throw std::runtime_error(std::string("mmap failed: ") + std::strerror(errno));
+        }
+        const SegmentHeader* header = static_cast<const SegmentHeader*>(mapped);
+        size_t size = static_cast<size_t>(info.st_size);
+        if (header->magic != segmentMagic || header->slots != slotCount ||
+            slotOffset(slotCount, header->slotStride) > size ||
+            header->slotCapacity + sizeof(SlotHeader) > header->slotStride) {
+            munmap(mapped, size);
+            throw std::runtime_error("Shared memory segment " + path + " is not a snapshot stream");
+        }
+        segment = static_cast<const char*>(mapped);
+        mappedSize = size;
+        return;
+    }
+
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos || colon + 1 == address.size()) {
+        throw std::runtime_error("Snapshot source " + address + " is neither shm:NAME nor HOST:PORT");
+    }
+    std::string host = address.substr(0, colon);
+    std::string service = address.substr(colon + 1);
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* results = nullptr;
+    int status = getaddrinfo(host.empty() ? "127.0.0.1" : host.c_str(), service.c_str(), &hints, &results);
+    if (status != 0) {
+        throw std::runtime_error("Cannot resolve " + address + ": " + gai_strerror(status));
+    }
+    std::string error = "no address";
+    for (addrinfo* candidate = results; candidate && socket < 0; candidate = candidate->ai_next) {
+        int fd = ::socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+        if (fd < 0) {
+            error = std::strerror(errno);
+            continue;
+        }
+        if (connect(fd, candidate->ai_addr, candidate->ai_addrlen) != 0) {
+            error = std::strerror(errno);
+            close(fd);
+            continue;
+        }
+        socket = fd;
+    }
+    freeaddrinfo(results);
+    if (socket < 0) {
+        throw std::runtime_error("Cannot connect to " + address + ": " + error);
+    }
+    configureStreamSocket(socket);
+    incoming.resize(1 << 16);
+}
+
+SnapshotSubscriber::~SnapshotSubscriber() {
+    if (segment) {
+        munmap(const_cast<char*>(segment), mappedSize);
+    }
+    if (socket >= 0) {
+        close(socket);
+    }
+}
+
+bool SnapshotSubscriber::poll(BodyStore& bodies, TestParticles& particles, SnapshotInfo& info) {
+    bool received = segment ? pollSharedMemory() : socket >= 0 && pollSocket();
+    if (received) {
+        std::swap(bodies, stagedBodies);
+        std::swap(particles, stagedParticles);
+        info = stagedInfo;
+    }
+    return received;
+}
+
+bool SnapshotSubscriber::pollSharedMemory() {
+    const SegmentHeader* header = reinterpret_cast<const SegmentHeader*>(segment);
+    uint64_t latest = header->latest.load(std::memory_order_acquire);
+    if (latest == 0 || (latest >> 2) == lastPublished) {
+        return false;
+    }
+    unsigned slot = static_cast<unsigned>(latest & 3);
+    if (slot >= slotCount) {
+        return false;
+    }
+    const char* slotStart = segment + slotOffset(slot, header->slotStride);
+    const SlotHeader* slotHeader = reinterpret_cast<const SlotHeader*>(slotStart);
+    uint64_t version = slotHeader->version.load(std::memory_order_acquire);
+    if (version & 1) {
+        return false;  // Caught mid-write; the next poll sees a newer frame
+    }
+    size_t size = std::min<size_t>(slotHeader->size, header->slotCapacity);
+    bool decoded = decoder.decode(slotStart + sizeof(SlotHeader), size, stagedBodies, stagedParticles, stagedInfo);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slotHeader->version.load(std::memory_order_relaxed) != version) {
+        return false;  // Overwritten while decoding; the frame may be torn
+    }
+    lastPublished = latest >> 2;
+    return decoded;
+}
+
+bool SnapshotSubscriber::pollSocket() {
+    // Drain the socket, decoding every complete frame so the delta chain stays intact
+    bool received = false;
+    while (true) {
+        if (incomingSize == incoming.size()) {
+            incoming.resize(incoming.size() * 2);
+        }
+        ssize_t n = recv(socket, incoming.data() + incomingSize, incoming.size() - incomingSize, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (n <= 0) {
+            close(socket);
+            socket = -1;
+            break;
+        }
+        incomingSize += static_cast<size_t>(n);
+
+        size_t offset = 0;
+        while (incomingSize - offset >= sizeof(uint32_t)) {
+            uint32_t length = 0;
+            std::memcpy(&length, incoming.data() + offset, sizeof(length));
+            if (length > maxTcpFrameBytes) {
+                close(socket);  // Not a snapshot stream
+                socket = -1;
+                return received;
+            }
+            if (incomingSize - offset - sizeof(length) < length) {
+                if (incoming.size() < sizeof(length) + length) {
+                    incoming.resize(sizeof(length) + length);
+                }
+                break;
+            }
+            received |= decoder.decode(incoming.data() + offset + sizeof(length), length, stagedBodies,
+                                       stagedParticles, stagedInfo);
+            offset += sizeof(length) + length;
+        }
+        std::memmove(incoming.data(), incoming.data() + offset, incomingSize - offset);
+        incomingSize -= offset;
+    }
+    return received;
+}
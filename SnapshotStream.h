@@ -0,0 +1,124 @@
+#ifndef SNAPSHOT_STREAM_H
+#define SNAPSHOT_STREAM_H
+
+#include "SnapshotCodec.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Transports for the snapshots a headless engine streams to viewers.
+//
+// Shared memory ("shm:NAME") is for a viewer on the same machine. The
+// segment is a latest-wins triple buffer: the publisher encodes each frame
+// straight into the slot it last touched longest ago and then marks it the
+// latest, so it never waits for a reader, and a reader decodes straight out
+// of the mapping. Each slot carries a sequence counter that is odd while the
+// slot is being written; a reader compares it before and after decoding and
+// drops a frame that was overwritten underneath it. Readers may attach at
+// any time and skip any number of frames, so every frame is a keyframe.
+//
+// TCP ("HOST:PORT") is the fallback for everything else and carries delta
+// frames, each preceded by its length as a 32-bit integer. The publisher
+// keeps a separate encoder per client. A client that has not taken the
+// previous frame yet misses the current one and gets a keyframe next, so a
+// slow viewer costs the engine nothing but frames it would not have drawn.
+//
+// Both ends run on the caller's thread and never block; the publisher is
+// meant to be called between steps, the subscriber once per rendered frame.
+class SnapshotPublisher {
+public:
+    SnapshotPublisher();
+    ~SnapshotPublisher();
+
+    SnapshotPublisher(const SnapshotPublisher&) = delete;
+    SnapshotPublisher& operator=(const SnapshotPublisher&) = delete;
+
+    // Creates the shared memory segment, replacing a stale one of the same
+    // name, with room for frames of this many bodies and particles. Throws
+    // std::runtime_error on failure.
+    void openSharedMemory(const std::string& name, size_t bodyCount, size_t particleCount);
+
+    // Listens on 127.0.0.1:port (0 picks a free port). Throws
+    // std::runtime_error when the port cannot be bound.
+    void listen(uint16_t port);
+    uint16_t port() const { return boundPort; }
+
+    // Accepts waiting clients and hands the state to every transport
+    void publish(const BodyStore& bodies, const TestParticles& particles, const SnapshotInfo& info);
+
+    size_t clientCount() const { return clients.size(); }
+    uint64_t droppedFrames() const { return dropped; }  // Frames a client was too slow for, or that did not fit
+
+private:
+    struct Client {
+        int socket;
+        SnapshotEncoder encoder;
+        std::vector<char> outgoing;
+        size_t sent;     // Bytes of `outgoing` already sent
+        size_t pending;  // Bytes of `outgoing` to send
+    };
+
+    void publishSharedMemory(const BodyStore& bodies, const TestParticles& particles, const SnapshotInfo& info);
+    void acceptClients();
+    bool flush(Client& client);  // False once the client has gone away
+
+    // Shared memory
+    char* segment;
+    size_t mappedSize;
+    size_t slotStride;
+    std::string segmentName;
+    SnapshotEncoder sharedEncoder;
+    unsigned nextSlot;
+    uint64_t published;
+
+    // TCP
+    int listener;
+    uint16_t boundPort;
+    std::vector<std::unique_ptr<Client>> clients;
+
+    uint64_t dropped;
+};
+
+class SnapshotSubscriber {
+public:
+    // Attaches to "shm:NAME" or connects to "HOST:PORT". Throws
+    // std::runtime_error when the source does not exist or refuses.
+    explicit SnapshotSubscriber(const std::string& address);
+    ~SnapshotSubscriber();
+
+    SnapshotSubscriber(const SnapshotSubscriber&) = delete;
+    SnapshotSubscriber& operator=(const SnapshotSubscriber&) = delete;
+
+    // Swaps the newest snapshot that arrived since the last call into
+    // `bodies` and `particles`; returns false, leaving them alone, when
+    // nothing new arrived. Velocities are not transmitted and are zero.
+    bool poll(BodyStore& bodies, TestParticles& particles, SnapshotInfo& info);
+
+    // False once a TCP publisher has hung up
+    bool connected() const { return socket >= 0 || segment != nullptr; }
+    const std::string& address() const { return source; }
+
+private:
+    bool pollSharedMemory();
+    bool pollSocket();
+
+    std::string source;
+    SnapshotDecoder decoder;
+    BodyStore stagedBodies;
+    TestParticles stagedParticles;
+    SnapshotInfo stagedInfo;
+
+    // Shared memory
+    const char* segment;
+    size_t mappedSize;
+    uint64_t lastPublished;
+
+    // TCP
+    int socket;
+    std::vector<char> incoming;
+    size_t incomingSize;
+};
+
+#endif // SNAPSHOT_STREAM_H
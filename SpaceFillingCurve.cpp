@@ -0,0 +1,164 @@
+#include "SpaceFillingCurve.h"
+#include "Arena.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <limits>
+
+namespace {
+const unsigned radixBits = 8;
+const size_t bucketCount = size_t(1) << radixBits;
+const size_t minBlockSize = 16384;  // Keys per radix block; smaller blocks cost more in histograms than they gain
+const size_t keyGrain = 8192;       // Points per task when computing keys
+
+// Grid cell of a coordinate; anything outside the box (or not a number) lands on an edge cell
+uint32_t quantize(double value, double origin, double scale) {
+    const double cells = double(1u << SpaceFillingCurve::bitsPerAxis);
+    double cell = (value - origin) * scale;
+    if (!(cell >= 0.0)) {
+        return 0;
+    }
+    return cell >= cells - 1.0 ? (1u << SpaceFillingCurve::bitsPerAxis) - 1 : static_cast<uint32_t>(cell);
+}
+}
+
+uint32_t SpaceFillingCurve::hilbertKey(uint32_t cellX, uint32_t cellY) {
+    const uint32_t side = 1u << bitsPerAxis;
+    uint32_t key = 0;
+    for (uint32_t s = side >> 1; s > 0; s >>= 1) {
+        uint32_t rx = (cellX & s) ? 1 : 0;
+        uint32_t ry = (cellY & s) ? 1 : 0;
+        key += s * s * ((3 * rx) ^ ry);
+
+        // Rotate the quadrant so the sub-curve inside it starts and ends where the parent expects
+        if (ry == 0) {
+            if (rx == 1) {
+                cellX = side - 1 - cellX;
+                cellY = side - 1 - cellY;
+            }
+            std::swap(cellX, cellY);
+        }
+    }
+    return key;
+}
+
+void SpaceFillingCurve::sortedOrder(const double* x, const double* y, size_t count, std::vector<uint32_t>& order) {
+    PROFILE_SCOPE("physics.reorder");
+    order.resize(count);
+    if (count == 0) {
+        return;
+    }
+
+    ThreadPool& pool = ThreadPool::instance();
+    const double inf = std::numeric_limits<double>::infinity();
+    ArenaScope scratch;
+    double* threadMin = scratch.allocateFilled(2 * pool.threadCount(), inf);
+    double* threadMax = scratch.allocateFilled(2 * pool.threadCount(), -inf);
+    pool.parallelFor(count, keyGrain, [&](size_t begin, size_t end, unsigned thread) {
+        double minX = threadMin[2 * thread], minY = threadMin[2 * thread + 1];
+        double maxX = threadMax[2 * thread], maxY = threadMax[2 * thread + 1];
+        for (size_t i = begin; i < end; i++) {
+            minX = std::min(minX, x[i]);
+            maxX = std::max(maxX, x[i]);
+            minY = std::min(minY, y[i]);
+            maxY = std::max(maxY, y[i]);
+        }
+        threadMin[2 * thread] = minX;
+        threadMin[2 * thread + 1] = minY;
+        threadMax[2 * thread] = maxX;
+        threadMax[2 * thread + 1] = maxY;
+    });
+    double minX = inf, minY = inf, maxX = -inf, maxY = -inf;
+    for (unsigned t = 0; t < pool.threadCount(); t++) {
+        minX = std::min(minX, threadMin[2 * t]);
+        minY = std::min(minY, threadMin[2 * t + 1]);
+        maxX = std::max(maxX, threadMax[2 * t]);
+        maxY = std::max(maxY, threadMax[2 * t + 1]);
+    }
+
+    // Square box so both axes share one scale and the curve keeps its shape
+    double extent = std::max(maxX - minX, maxY - minY);
+    double scale = extent > 0.0 ? double(1u << bitsPerAxis) / extent : 0.0;
+
+    uint32_t* keyData = scratch.allocate<uint32_t>(count);
+    uint32_t* orderData = order.data();
+    pool.parallelFor(count, keyGrain, [=](size_t begin, size_t end, unsigned) {
+        for (size_t i = begin; i < end; i++) {
+            keyData[i] = hilbertKey(quantize(x[i], minX, scale), quantize(y[i], minY, scale));
+            orderData[i] = static_cast<uint32_t>(i);
+        }
+    });
+    radixSort(keyData, orderData, count);
+}
+
+// Each pass histograms fixed blocks of keys in parallel, turns the histograms
+// into per-block write offsets (digit-major, block-minor, which keeps the sort
+// stable) and scatters every block independently. Digits on which all keys
+// agree are skipped, which for clustered bodies removes the top pass or two.
+void SpaceFillingCurve::radixSort(uint32_t* keys, uint32_t* values, size_t count) {
+    const size_t n = count;
+    if (n < 2) {
+        return;
+    }
+
+    ThreadPool& pool = ThreadPool::instance();
+    size_t blockCount = std::clamp<size_t>((n + minBlockSize - 1) / minBlockSize, 1, 4 * pool.threadCount());
+    size_t blockSize = (n + blockCount - 1) / blockCount;
+    blockCount = (n + blockSize - 1) / blockSize;
+
+    uint32_t differing = 0;
+    for (size_t i = 1; i < n; i++) {
+        differing |= keys[i] ^ keys[0];
+    }
+
+    ArenaScope scratch;
+    uint32_t* keyScratch = scratch.allocate<uint32_t>(n);
+    uint32_t* valueScratch = scratch.allocate<uint32_t>(n);
+    size_t* offsets = scratch.allocate<size_t>(blockCount * bucketCount);
+    uint32_t* const outputKeys = keys;
+    uint32_t* const outputValues = values;
+    for (unsigned shift = 0; shift < 32; shift += radixBits) {
+        if (((differing >> shift) & (bucketCount - 1)) == 0) {
+            continue;
+        }
+
+        pool.parallelFor(blockCount, 1, [&](size_t firstBlock, size_t lastBlock, unsigned) {
+            for (size_t block = firstBlock; block < lastBlock; block++) {
+                size_t* histogram = &offsets[block * bucketCount];
+                std::fill(histogram, histogram + bucketCount, 0);
+                size_t end = std::min(n, (block + 1) * blockSize);
+                for (size_t i = block * blockSize; i < end; i++) {
+                    histogram[(keys[i] >> shift) & (bucketCount - 1)]++;
+                }
+            }
+        });
+
+        size_t running = 0;
+        for (size_t digit = 0; digit < bucketCount; digit++) {
+            for (size_t block = 0; block < blockCount; block++) {
+                size_t blockTotal = offsets[block * bucketCount + digit];
+                offsets[block * bucketCount + digit] = running;
+                running += blockTotal;
+            }
+        }
+
+        pool.parallelFor(blockCount, 1, [&](size_t firstBlock, size_t lastBlock, unsigned) {
+            for (size_t block = firstBlock; block < lastBlock; block++) {
+                size_t* next = &offsets[block * bucketCount];
+                size_t end = std::min(n, (block + 1) * blockSize);
+                for (size_t i = block * blockSize; i < end; i++) {
+                    size_t position = next[(keys[i] >> shift) & (bucketCount - 1)]++;
+                    keyScratch[position] = keys[i];
+                    valueScratch[position] = values[i];
+                }
+            }
+        });
+        std::swap(keys, keyScratch);
+        std::swap(values, valueScratch);
+    }
+    // An odd number of passes leaves the result in the scratch buffers
+    if (keys != outputKeys) {
+        std::copy(keys, keys + n, outputKeys);
+        std::copy(values, values + n, outputValues);
+    }
+}
@@ -0,0 +1,32 @@
+#ifndef SPACE_FILLING_CURVE_H
+#define SPACE_FILLING_CURVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hilbert-curve ordering of points in the plane.
+//
+// Points are quantized onto a 65536 x 65536 grid over their square bounding
+// box and keyed by their distance along the Hilbert curve through that grid.
+// Points that are close along the curve are close in space, and unlike the
+// Morton (Z) order the curve never jumps across the box, so storing bodies in
+// key order keeps spatial neighbours in neighbouring cache lines.
+class SpaceFillingCurve {
+public:
+    static constexpr unsigned bitsPerAxis = 16;
+
+    // Position along the curve of grid cell (cellX, cellY), both < 2^bitsPerAxis
+    static uint32_t hilbertKey(uint32_t cellX, uint32_t cellY);
+
+    // Fills `order` with the indices [0, count) sorted by Hilbert key, so
+    // order[newIndex] is the old index of the point that should go there.
+    // Equal keys keep their original relative order.
+    static void sortedOrder(const double* x, const double* y, size_t count, std::vector<uint32_t>& order);
+
+    // Stable parallel LSD radix sort of `values` by `keys`, `count` of each
+    // (both reordered in place)
+    static void radixSort(uint32_t* keys, uint32_t* values, size_t count);
+};
+
+#endif // SPACE_FILLING_CURVE_H
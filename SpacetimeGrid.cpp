@@ -1,88 +1,96 @@
 #include "SpacetimeGrid.h"
+#include "Logger.h"
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <cmath>
-#include <iostream>
 
-SpacetimeGrid::SpacetimeGrid() : VAO(0), VBO(0), timeLoc(-1) {
-    std::cout << "Starting SpacetimeGrid initialization..." << std::endl;
+SpacetimeGrid::SpacetimeGrid() : VAO(0), VBO(0), potentialTexture(0), potentialHalfExtent(1.0f), timeLoc(-1) {
+    LOG_INFO("Starting SpacetimeGrid initialization...");
     
     // Check if we have a valid OpenGL context
     if (glGetString(GL_VERSION) == nullptr) {
-        std::cerr << "No valid OpenGL context found!" << std::endl;
+        LOG_ERROR("No valid OpenGL context found!");
         throw std::runtime_error("No valid OpenGL context");
     }
     
-    std::cout << "OpenGL Context Version: " << glGetString(GL_VERSION) << std::endl;
+    LOG_INFO("OpenGL Context Version: " << glGetString(GL_VERSION));
     
     try {
         // Generate grid vertices
         const int gridSize = 150;  // More grid lines for better warping visualization
         const float step = 2.0f / gridSize;  // Step size to cover -1 to 1
         
-        // Pre-calculate the number of vertices needed
+        // Pre-calculate the number of vertices needed; every line is split
+        // into one segment per cell so the potential can bend it
         int numVerticalLines = gridSize + 1;
         int numHorizontalLines = gridSize + 1;
-        int totalVertices = (numVerticalLines + numHorizontalLines) * 2;  // 2 points per line
+        int totalVertices = (numVerticalLines + numHorizontalLines) * gridSize * 2;  // 2 points per segment
         vertices.reserve(totalVertices * 2);  // 2 floats per vertex
         
-        std::cout << "Generating grid with " << numVerticalLines << " vertical and " 
-                  << numHorizontalLines << " horizontal lines..." << std::endl;
+        LOG_INFO("Generating grid with " << numVerticalLines << " vertical and "
+                 << numHorizontalLines << " horizontal lines...");
 
         // Vertical lines
         for (int i = 0; i <= gridSize; i++) {
             float x = -1.0f + i * step;
-            vertices.push_back(x);      // Start point x
-            vertices.push_back(-1.0f);  // Start point y
-            vertices.push_back(x);      // End point x
-            vertices.push_back(1.0f);   // End point y
+            for (int j = 0; j < gridSize; j++) {
+                vertices.push_back(x);                       // Segment start x
+                vertices.push_back(-1.0f + j * step);        // Segment start y
+                vertices.push_back(x);                       // Segment end x
+                vertices.push_back(-1.0f + (j + 1) * step);  // Segment end y
+            }
         }
 
         // Horizontal lines
         for (int i = 0; i <= gridSize; i++) {
             float y = -1.0f + i * step;
-            vertices.push_back(-1.0f);  // Start point x
-            vertices.push_back(y);      // Start point y
-            vertices.push_back(1.0f);   // End point x
-            vertices.push_back(y);      // End point y
+            for (int j = 0; j < gridSize; j++) {
+                vertices.push_back(-1.0f + j * step);        // Segment start x
+                vertices.push_back(y);                       // Segment start y
+                vertices.push_back(-1.0f + (j + 1) * step);  // Segment end x
+                vertices.push_back(y);                       // Segment end y
+            }
         }
 
-        std::cout << "Grid vertices generated: " << vertices.size() / 2 << " vertices" << std::endl;
+        LOG_INFO("Grid vertices generated: " << vertices.size() / 2 << " vertices");
         
         initializeBuffers();
-        std::cout << "SpacetimeGrid initialization completed successfully" << std::endl;
+        LOG_INFO("SpacetimeGrid initialization completed successfully");
     } catch (const std::exception& e) {
-        std::cerr << "Error in SpacetimeGrid initialization: " << e.what() << std::endl;
+        LOG_ERROR("Error in SpacetimeGrid initialization: " << e.what());
         throw;
     }
 }
 
 SpacetimeGrid::~SpacetimeGrid() {
-    std::cout << "SpacetimeGrid cleanup starting..." << std::endl;
+    LOG_INFO("SpacetimeGrid cleanup starting...");
     if (VAO != 0) {
         glDeleteVertexArrays(1, &VAO);
-        std::cout << "VAO deleted" << std::endl;
+        LOG_INFO("VAO deleted");
     }
     if (VBO != 0) {
         glDeleteBuffers(1, &VBO);
-        std::cout << "VBO deleted" << std::endl;
+        LOG_INFO("VBO deleted");
     }
-    std::cout << "SpacetimeGrid cleanup completed" << std::endl;
+    if (potentialTexture != 0) {
+        glDeleteTextures(1, &potentialTexture);
+    }
+    LOG_INFO("SpacetimeGrid cleanup completed");
 }
 
 void SpacetimeGrid::initializeBuffers() {
-    std::cout << "Initializing SpacetimeGrid buffers..." << std::endl;
+    LOG_INFO("Initializing SpacetimeGrid buffers...");
     
     // Check if we have a valid OpenGL context
     if (glGetString(GL_VERSION) == nullptr) {
-        std::cerr << "No valid OpenGL context found during buffer initialization!" << std::endl;
+        LOG_ERROR("No valid OpenGL context found during buffer initialization!");
         throw std::runtime_error("No valid OpenGL context");
     }
     
     // Get max vertex attribs
     GLint maxAttribs;
     glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &maxAttribs);
-    std::cout << "Max vertex attributes supported: " << maxAttribs << std::endl;
+    LOG_INFO("Max vertex attributes supported: " << maxAttribs);
     
     // Store current VAO binding to restore later
     GLint previousVAO;
@@ -94,7 +102,7 @@ void SpacetimeGrid::initializeBuffers() {
         VAO = 0;
         GLenum err = glGetError();
         if (err != GL_NO_ERROR) {
-            std::cerr << "Error deleting VAO: 0x" << std::hex << err << std::dec << std::endl;
+            LOG_ERROR("Error deleting VAO: 0x" << std::hex << err);
         }
     }
     if (VBO != 0) {
@@ -102,7 +110,7 @@ void SpacetimeGrid::initializeBuffers() {
         VBO = 0;
         GLenum err = glGetError();
         if (err != GL_NO_ERROR) {
-            std::cerr << "Error deleting VBO: 0x" << std::hex << err << std::dec << std::endl;
+            LOG_ERROR("Error deleting VBO: 0x" << std::hex << err);
         }
     }
 
@@ -113,7 +121,7 @@ void SpacetimeGrid::initializeBuffers() {
     glGenVertexArrays(1, &VAO);
     GLenum err = glGetError();
     if (err != GL_NO_ERROR) {
-        std::cerr << "Error generating VAO: 0x" << std::hex << err << std::dec << std::endl;
+        LOG_ERROR("Error generating VAO: 0x" << std::hex << err);
         throw std::runtime_error("Failed to generate VAO");
     }
     
@@ -121,12 +129,12 @@ void SpacetimeGrid::initializeBuffers() {
         throw std::runtime_error("Failed to generate VAO - invalid ID returned");
     }
     
-    std::cout << "Generated VAO ID: " << VAO << std::endl;
+    LOG_INFO("Generated VAO ID: " << VAO);
     
     glBindVertexArray(VAO);
     err = glGetError();
     if (err != GL_NO_ERROR) {
-        std::cerr << "Error binding VAO: 0x" << std::hex << err << std::dec << std::endl;
+        LOG_ERROR("Error binding VAO: 0x" << std::hex << err);
         glDeleteVertexArrays(1, &VAO);
         VAO = 0;
         throw std::runtime_error("Failed to bind VAO");
@@ -136,7 +144,7 @@ void SpacetimeGrid::initializeBuffers() {
     glGenBuffers(1, &VBO);
     err = glGetError();
     if (err != GL_NO_ERROR) {
-        std::cerr << "Error generating VBO: 0x" << std::hex << err << std::dec << std::endl;
+        LOG_ERROR("Error generating VBO: 0x" << std::hex << err);
         cleanup();
         throw std::runtime_error("Failed to generate VBO");
     }
@@ -148,7 +156,7 @@ void SpacetimeGrid::initializeBuffers() {
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     err = glGetError();
     if (err != GL_NO_ERROR) {
-        std::cerr << "Error binding VBO: 0x" << std::hex << err << std::dec << std::endl;
+        LOG_ERROR("Error binding VBO: 0x" << std::hex << err);
         cleanup();
         throw std::runtime_error("Failed to bind VBO");
     }
@@ -160,13 +168,13 @@ void SpacetimeGrid::initializeBuffers() {
     }
     
     size_t bufferSize = vertices.size() * sizeof(float);
-    std::cout << "Uploading " << vertices.size() << " floats (" << vertices.size()/2 
-              << " vertices) to VBO, total size: " << bufferSize << " bytes" << std::endl;
+    LOG_INFO("Uploading " << vertices.size() << " floats (" << vertices.size()/2
+             << " vertices) to VBO, total size: " << bufferSize << " bytes");
     
     glBufferData(GL_ARRAY_BUFFER, bufferSize, vertices.data(), GL_STATIC_DRAW);
     err = glGetError();
     if (err != GL_NO_ERROR) {
-        std::cerr << "Error uploading vertex data: 0x" << std::hex << err << std::dec << std::endl;
+        LOG_ERROR("Error uploading vertex data: 0x" << std::hex << err);
         cleanup();
         throw std::runtime_error("Failed to upload vertex data");
     }
@@ -175,7 +183,7 @@ void SpacetimeGrid::initializeBuffers() {
     glEnableVertexAttribArray(0);
     err = glGetError();
     if (err != GL_NO_ERROR) {
-        std::cerr << "Error enabling vertex attrib array: 0x" << std::hex << err << std::dec << std::endl;
+        LOG_ERROR("Error enabling vertex attrib array: 0x" << std::hex << err);
         cleanup();
         throw std::runtime_error("Failed to enable vertex attribute array");
     }
@@ -184,7 +192,7 @@ void SpacetimeGrid::initializeBuffers() {
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
     err = glGetError();
     if (err != GL_NO_ERROR) {
-        std::cerr << "Error setting vertex attrib pointer: 0x" << std::hex << err << std::dec << std::endl;
+        LOG_ERROR("Error setting vertex attrib pointer: 0x" << std::hex << err);
         cleanup();
         throw std::runtime_error("Failed to set vertex attribute pointer");
     }
@@ -194,20 +202,32 @@ void SpacetimeGrid::initializeBuffers() {
     glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
     err = glGetError();
     if (err != GL_NO_ERROR || !enabled) {
-        std::cerr << "Vertex attribute array 0 is not enabled after setup" << std::endl;
+        LOG_ERROR("Vertex attribute array 0 is not enabled after setup");
         cleanup();
         throw std::runtime_error("Vertex attribute array verification failed");
     }
     
     // Unbind VBO but keep VAO bound
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Flat potential until the first update
+    potentialSamples.assign(potentialResolution * potentialResolution, 0.0f);
+    glGenTextures(1, &potentialTexture);
+    glBindTexture(GL_TEXTURE_2D, potentialTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, potentialResolution, potentialResolution, 0, GL_RED, GL_FLOAT,
+                 potentialSamples.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
     
     // Restore previous VAO binding
     glBindVertexArray(previousVAO);
     
-    std::cout << "Buffer initialization completed successfully with " 
-              << vertices.size() / 2 << " vertices (" 
-              << vertices.size() / 4 << " lines)" << std::endl;
+    LOG_INFO("Buffer initialization completed successfully with "
+             << vertices.size() / 2 << " vertices ("
+             << vertices.size() / 4 << " lines)");
 }
 
 void SpacetimeGrid::cleanup() {
@@ -219,13 +239,17 @@ void SpacetimeGrid::cleanup() {
         glDeleteBuffers(1, &VBO);
         VBO = 0;
     }
+    if (potentialTexture != 0) {
+        glDeleteTextures(1, &potentialTexture);
+        potentialTexture = 0;
+    }
 }
 
 void SpacetimeGrid::setupShaderUniforms(const Shader& shader) {
     // Store current VAO binding to restore later
     GLint previousVAO;
     glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
-    std::cout << "Previous VAO binding in setupShaderUniforms: " << previousVAO << std::endl;
+    LOG_DEBUG("Previous VAO binding in setupShaderUniforms: " << previousVAO);
 
     // Ensure shader is active first
     shader.use();
@@ -233,12 +257,12 @@ void SpacetimeGrid::setupShaderUniforms(const Shader& shader) {
     // Get uniform locations
     timeLoc = glGetUniformLocation(shader.ID, "time");
     if (timeLoc == -1) {
-        std::cerr << "Warning: 'time' uniform not found in grid shader" << std::endl;
+        LOG_WARNING("'time' uniform not found in grid shader");
     }
 
     // Bind our VAO
     glBindVertexArray(VAO);
-    std::cout << "Binding grid VAO in setupShaderUniforms: " << VAO << std::endl;
+    LOG_DEBUG("Binding grid VAO in setupShaderUniforms: " << VAO);
 
     // Set temporary uniform for validation
     if (timeLoc != -1) {
@@ -249,7 +273,7 @@ void SpacetimeGrid::setupShaderUniforms(const Shader& shader) {
     GLint currentVAO;
     glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &currentVAO);
     if (currentVAO != VAO) {
-        std::cerr << "Error: VAO binding mismatch in setupShaderUniforms. Expected: " << VAO << ", Got: " << currentVAO << std::endl;
+        LOG_ERROR("VAO binding mismatch in setupShaderUniforms. Expected: " << VAO << ", Got: " << currentVAO);
         glBindVertexArray(VAO);  // Try to rebind
     }
     
@@ -260,62 +284,68 @@ void SpacetimeGrid::setupShaderUniforms(const Shader& shader) {
     if (validateStatus == GL_FALSE) {
         GLchar infoLog[512];
         glGetProgramInfoLog(shader.ID, 512, NULL, infoLog);
-        std::cerr << "Shader validation failed: " << infoLog << std::endl;
+        LOG_ERROR("Shader validation failed: " << infoLog);
     } else {
-        std::cout << "Shader validation successful" << std::endl;
+        LOG_INFO("Shader validation successful");
     }
 
     // Check for OpenGL errors
     GLenum err;
     while ((err = glGetError()) != GL_NO_ERROR) {
-        std::cerr << "OpenGL error in setupShaderUniforms: 0x" << std::hex << err << std::dec << std::endl;
+        LOG_ERROR("OpenGL error in setupShaderUniforms: 0x" << std::hex << err);
     }
 
     // Restore previous VAO binding
     glBindVertexArray(previousVAO);
-    std::cout << "Restored VAO binding in setupShaderUniforms to: " << previousVAO << std::endl;
+    LOG_DEBUG("Restored VAO binding in setupShaderUniforms to: " << previousVAO);
 }
 
 void SpacetimeGrid::drawGrid(const Shader& shader, float time) {
     if (VAO == 0 || VBO == 0) {
-        std::cerr << "Warning: Attempting to draw grid with invalid buffers" << std::endl;
+        LOG_WARNING("Attempting to draw grid with invalid buffers");
         return;
     }
 
     // Store current VAO binding to restore later
     GLint previousVAO;
     glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVAO);
-    std::cout << "Previous VAO binding before draw: " << previousVAO << std::endl;
+    LOG_DEBUG("Previous VAO binding before draw: " << previousVAO);
 
     // Ensure shader is active first
     shader.use();
     
     // Bind our VAO
     glBindVertexArray(VAO);
-    std::cout << "Binding grid VAO for drawing: " << VAO << std::endl;
+    LOG_DEBUG("Binding grid VAO for drawing: " << VAO);
     
     // Set time uniform if location is valid
     if (timeLoc != -1) {
         glUniform1f(timeLoc, time);
     }
+
+    // Potential texture on unit 0
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, potentialTexture);
+    glUniform1i(glGetUniformLocation(shader.ID, "potentialMap"), 0);
+    shader.setFloat("potentialHalfExtent", potentialHalfExtent);
     
     // Check for OpenGL errors after setting uniforms
     GLenum err;
     while ((err = glGetError()) != GL_NO_ERROR) {
-        std::cerr << "OpenGL error after setting uniforms: 0x" << std::hex << err << std::dec << std::endl;
+        LOG_ERROR("OpenGL error after setting uniforms: 0x" << std::hex << err);
     }
     
     // Verify VAO is still bound correctly
     GLint currentVAO;
     glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &currentVAO);
     if (currentVAO != VAO) {
-        std::cerr << "Error: VAO not bound correctly in drawGrid. Expected: " << VAO << ", Got: " << currentVAO << std::endl;
+        LOG_ERROR("VAO not bound correctly in drawGrid. Expected: " << VAO << ", Got: " << currentVAO);
         glBindVertexArray(VAO);  // Rebind if necessary
         
         // Verify the rebind worked
         glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &currentVAO);
         if (currentVAO != VAO) {
-            std::cerr << "Error: Failed to rebind VAO. Still got: " << currentVAO << std::endl;
+            LOG_ERROR("Failed to rebind VAO. Still got: " << currentVAO);
             return;  // Abort the draw if we can't get the correct VAO bound
         }
     }
@@ -324,7 +354,7 @@ void SpacetimeGrid::drawGrid(const Shader& shader, float time) {
     GLint enabled;
     glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &enabled);
     if (!enabled) {
-        std::cerr << "Warning: Vertex attribute array 0 is not enabled" << std::endl;
+        LOG_WARNING("Vertex attribute array 0 is not enabled");
         glEnableVertexAttribArray(0);  // Re-enable if necessary
     }
     
@@ -334,24 +364,30 @@ void SpacetimeGrid::drawGrid(const Shader& shader, float time) {
     
     // Check for OpenGL errors
     while ((err = glGetError()) != GL_NO_ERROR) {
-        std::cerr << "OpenGL error in drawGrid: 0x" << std::hex << err << std::dec 
-                  << " (drawing " << numLines << " lines)" << std::endl;
+        LOG_ERROR("OpenGL error in drawGrid: 0x" << std::hex << err << std::dec
+                  << " (drawing " << numLines << " lines)");
     }
     
     // Restore previous VAO binding
     glBindVertexArray(previousVAO);
-    std::cout << "Restored VAO binding after draw to: " << previousVAO << std::endl;
+    LOG_DEBUG("Restored VAO binding after draw to: " << previousVAO);
 }
 
-float SpacetimeGrid::calculateWarp(float x, float y, const std::vector<CelestialBody>& bodies) {
-    float warp = 0.0f;
-    for (const auto& body : bodies) {
-        float dx = x - body.x;
-        float dy = y - body.y;
-        float r = sqrt(dx*dx + dy*dy);
-        if (r > 0.05f) {  // Avoid division by zero or singularities
-            warp += -0.02f * (body.mass) / (r); // Simplified warp calculation
+void SpacetimeGrid::updatePotential(const ParticleMesh& field, float halfExtent) {
+    if (potentialTexture == 0) {
+        return;
+    }
+    potentialHalfExtent = halfExtent;
+    const float step = 2.0f * halfExtent / potentialResolution;
+    for (int row = 0; row < potentialResolution; row++) {
+        double y = -halfExtent + (row + 0.5f) * step;
+        for (int column = 0; column < potentialResolution; column++) {
+            double x = -halfExtent + (column + 0.5f) * step;
+            potentialSamples[row * potentialResolution + column] = static_cast<float>(field.potentialAt(x, y));
         }
     }
-    return warp;
-}
\ No newline at end of file
+    glBindTexture(GL_TEXTURE_2D, potentialTexture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, potentialResolution, potentialResolution, GL_RED, GL_FLOAT,
+                    potentialSamples.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
@@ -1,7 +1,7 @@
 #ifndef SPACETIMEGRID_H
 #define SPACETIMEGRID_H
 
-#include "CelestialBody.h"
+#include "ParticleMesh.h"
 #include "Shader.h"
 #include <vector>
 #include <glad/glad.h>
@@ -9,7 +9,10 @@
 class SpacetimeGrid {
 private:
     unsigned int VAO, VBO;
+    unsigned int potentialTexture;  // Gravitational potential sampled by the vertex shader
     std::vector<float> vertices;
+    std::vector<float> potentialSamples;
+    float potentialHalfExtent;
     GLint timeLoc;  // Cache the time uniform location
     void initializeBuffers();
     void setupShaderUniforms(const Shader& shader);  // New method to setup uniforms
@@ -23,9 +26,12 @@ public:
     // Now takes a Shader reference for rendering and a time value for dynamic effects.
     void drawGrid(const Shader& shader, float time);
 
-    // Calculates the warp (vertical displacement) at a grid point (x, y)
-    // based on the gravitational effect of the provided bodies.
-    float calculateWarp(float x, float y, const std::vector<CelestialBody>& bodies);
+    // Samples the potential of a solved particle mesh over the square
+    // [-halfExtent, halfExtent]^2 into the texture that displaces the grid.
+    // Cost follows the texture size, not the number of bodies or vertices.
+    void updatePotential(const ParticleMesh& field, float halfExtent);
+
+    static constexpr int potentialResolution = 128;
 };
 
 #endif // SPACETIMEGRID_H
\ No newline at end of file
@@ -0,0 +1,278 @@
+#include "SpatialIndex.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+namespace {
+const size_t gatherGrain = 16384;  // Items per parallel task when refitting
+}
+
+SpatialIndex::SpatialIndex()
+    : rebuildGrowth(2.0), liveCount(0), builtPerimeter(0.0), rebuilds(0) {}
+
+void SpatialIndex::update(const BodyStore& store) {
+    PROFILE_SCOPE("spatial.update");
+    if (nodes.empty() || store.size() > itemIds.size()) {
+        rebuild(store);
+        return;
+    }
+    refit(store);
+    // New bodies are not in the tree; removed ones leave holes worth compacting
+    bool added = store.size() > liveCount;
+    bool sparse = liveCount < itemIds.size() - itemIds.size() / 8;
+    if (added || sparse || leafPerimeterSum() > rebuildGrowth * builtPerimeter) {
+        rebuild(store);
+    }
+}
+
+void SpatialIndex::rebuild(const BodyStore& store) {
+    PROFILE_SCOPE("spatial.rebuild");
+    rebuilds++;
+    nodes.clear();
+    leaves.clear();
+    size_t count = store.size();
+    std::vector<uint32_t> order(count);
+    for (uint32_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    itemIds.resize(count);
+    itemX.resize(count);
+    itemY.resize(count);
+    liveCount = count;
+    if (count == 0) {
+        builtPerimeter = 0.0;
+        return;
+    }
+    nodes.reserve(2 * (count / leafSize + 1));
+    build(order, store, 0, static_cast<uint32_t>(count));
+    for (size_t k = 0; k < count; k++) {
+        itemIds[k] = store.id[order[k]];
+        itemX[k] = store.x[order[k]];
+        itemY[k] = store.y[order[k]];
+    }
+    builtPerimeter = leafPerimeterSum();
+}
+
+uint32_t SpatialIndex::build(std::vector<uint32_t>& order, const BodyStore& store, uint32_t begin, uint32_t end) {
+    uint32_t index = static_cast<uint32_t>(nodes.size());
+    nodes.push_back(Node{});
+    Node node;
+    node.begin = begin;
+    node.end = end;
+    node.right = 0;
+    node.minX = node.minY = std::numeric_limits<double>::infinity();
+    node.maxX = node.maxY = -std::numeric_limits<double>::infinity();
+    for (uint32_t k = begin; k < end; k++) {
+        node.minX = std::min(node.minX, store.x[order[k]]);
+        node.maxX = std::max(node.maxX, store.x[order[k]]);
+        node.minY = std::min(node.minY, store.y[order[k]]);
+        node.maxY = std::max(node.maxY, store.y[order[k]]);
+    }
+
+    if (end - begin > leafSize) {
+        // Median split across the wider side
+        uint32_t middle = begin + (end - begin) / 2;
+        const std::vector<double>& axis = node.maxX - node.minX >= node.maxY - node.minY ? store.x : store.y;
+        std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                         [&axis](uint32_t a, uint32_t b) { return axis[a] < axis[b]; });
+        build(order, store, begin, middle);
+        node.right = build(order, store, middle, end);
+    } else {
+        leaves.push_back(index);
+    }
+    nodes[index] = node;
+    return index;
+}
+
+void SpatialIndex::refit(const BodyStore& store) {
+    // Gather the current positions into tree order; bodies that are gone
+    // become NaN and drop out of every box and query
+    size_t count = itemIds.size();
+    std::vector<size_t> found(ThreadPool::instance().threadCount(), 0);
+    ThreadPool::instance().parallelFor(count, gatherGrain, [&](size_t begin, size_t end, unsigned thread) {
+        size_t live = 0;
+        for (size_t k = begin; k < end; k++) {
+            uint32_t i = store.indexOf(itemIds[k]);
+            if (i == BodyStore::invalidIndex) {
+                itemX[k] = itemY[k] = std::numeric_limits<double>::quiet_NaN();
+            } else {
+                itemX[k] = store.x[i];
+                itemY[k] = store.y[i];
+                live++;
+            }
+        }
+        found[thread] += live;
+    });
+    liveCount = 0;
+    for (size_t live : found) {
+        liveCount += live;
+    }
+
+    ThreadPool::instance().parallelFor(leaves.size(), gatherGrain / leafSize, [&](size_t begin, size_t end, unsigned) {
+        for (size_t l = begin; l < end; l++) {
+            Node& node = nodes[leaves[l]];
+            node.minX = node.minY = std::numeric_limits<double>::infinity();
+            node.maxX = node.maxY = -std::numeric_limits<double>::infinity();
+            for (uint32_t k = node.begin; k < node.end; k++) {
+                if (std::isnan(itemX[k])) {
+                    continue;
+                }
+                node.minX = std::min(node.minX, itemX[k]);
+                node.maxX = std::max(node.maxX, itemX[k]);
+                node.minY = std::min(node.minY, itemY[k]);
+                node.maxY = std::max(node.maxY, itemY[k]);
+            }
+        }
+    });
+
+    // Children follow their parent, so walking backwards sees them first
+    for (size_t n = nodes.size(); n-- > 0;) {
+        Node& node = nodes[n];
+        if (node.right == 0) {
+            continue;
+        }
+        const Node& left = nodes[n + 1];
+        const Node& right = nodes[node.right];
+        node.minX = std::min(left.minX, right.minX);
+        node.minY = std::min(left.minY, right.minY);
+        node.maxX = std::max(left.maxX, right.maxX);
+        node.maxY = std::max(left.maxY, right.maxY);
+    }
+}
+
+double SpatialIndex::leafPerimeterSum() const {
+    double sum = 0.0;
+    for (uint32_t leaf : leaves) {
+        const Node& node = nodes[leaf];
+        if (node.maxX >= node.minX) {
+            sum += (node.maxX - node.minX) + (node.maxY - node.minY);
+        }
+    }
+    return sum;
+}
+
+double SpatialIndex::boxDistanceSquared(const Node& node, double x, double y) {
+    double dx = std::max({node.minX - x, 0.0, x - node.maxX});
+    double dy = std::max({node.minY - y, 0.0, y - node.maxY});
+    return dx * dx + dy * dy;  // Infinite for empty boxes
+}
+
+BodyStore::BodyId SpatialIndex::nearest(double x, double y, double maxDistance) const {
+    std::vector<Neighbor> result;
+    nearest(x, y, 1, result);
+    if (result.empty() || result.front().distance > maxDistance) {
+        return invalidId;
+    }
+    return result.front().id;
+}
+
+void SpatialIndex::nearest(double x, double y, size_t count, std::vector<Neighbor>& result) const {
+    result.clear();
+    if (nodes.empty() || count == 0) {
+        return;
+    }
+
+    // Max-heap of the best candidates so far, by squared distance
+    auto farther = [](const Neighbor& a, const Neighbor& b) { return a.distance < b.distance; };
+    std::priority_queue<Neighbor, std::vector<Neighbor>, decltype(farther)> best(farther);
+    auto bound = [&]() {
+        return best.size() < count ? std::numeric_limits<double>::infinity() : best.top().distance;
+    };
+
+    uint32_t stack[64];
+    int depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        const Node& node = nodes[stack[--depth]];
+        if (boxDistanceSquared(node, x, y) > bound()) {
+            continue;
+        }
+        if (node.right == 0) {
+            for (uint32_t k = node.begin; k < node.end; k++) {
+                double dx = itemX[k] - x, dy = itemY[k] - y;
+                double d2 = dx * dx + dy * dy;
+                if (d2 < bound()) {  // False for removed (NaN) items
+                    best.push(Neighbor{itemIds[k], d2});
+                    if (best.size() > count) {
+                        best.pop();
+                    }
+                }
+            }
+            continue;
+        }
+        // Visit the nearer child first: push it last
+        uint32_t left = static_cast<uint32_t>(&node - nodes.data()) + 1;
+        uint32_t right = node.right;
+        if (boxDistanceSquared(nodes[left], x, y) < boxDistanceSquared(nodes[right], x, y)) {
+            std::swap(left, right);
+        }
+        stack[depth++] = left;
+        stack[depth++] = right;
+    }
+
+    result.resize(best.size());
+    for (size_t i = result.size(); i-- > 0;) {
+        result[i] = Neighbor{best.top().id, std::sqrt(best.top().distance)};
+        best.pop();
+    }
+}
+
+void SpatialIndex::withinRadius(double x, double y, double radius, std::vector<BodyStore::BodyId>& result) const {
+    result.clear();
+    if (nodes.empty()) {
+        return;
+    }
+    double radius2 = radius * radius;
+    uint32_t stack[64];
+    int depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        uint32_t index = stack[--depth];
+        const Node& node = nodes[index];
+        if (boxDistanceSquared(node, x, y) > radius2) {
+            continue;
+        }
+        if (node.right == 0) {
+            for (uint32_t k = node.begin; k < node.end; k++) {
+                double dx = itemX[k] - x, dy = itemY[k] - y;
+                if (dx * dx + dy * dy <= radius2) {
+                    result.push_back(itemIds[k]);
+                }
+            }
+            continue;
+        }
+        stack[depth++] = index + 1;
+        stack[depth++] = node.right;
+    }
+}
+
+void SpatialIndex::withinBox(double minX, double minY, double maxX, double maxY,
+                             std::vector<BodyStore::BodyId>& result) const {
+    result.clear();
+    if (nodes.empty()) {
+        return;
+    }
+    uint32_t stack[64];
+    int depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+        uint32_t index = stack[--depth];
+        const Node& node = nodes[index];
+        if (node.minX > maxX || node.maxX < minX || node.minY > maxY || node.maxY < minY) {
+            continue;
+        }
+        bool contained = node.minX >= minX && node.maxX <= maxX && node.minY >= minY && node.maxY <= maxY;
+        if (node.right == 0 || contained) {
+            for (uint32_t k = node.begin; k < node.end; k++) {
+                if (itemX[k] >= minX && itemX[k] <= maxX && itemY[k] >= minY && itemY[k] <= maxY) {
+                    result.push_back(itemIds[k]);
+                }
+            }
+            continue;
+        }
+        stack[depth++] = index + 1;
+        stack[depth++] = node.right;
+    }
+}
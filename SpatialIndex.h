@@ -0,0 +1,75 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include "BodyStore.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Point queries over the bodies for picking and inspection: nearest
+// neighbours, everything within a radius and everything inside a box.
+//
+// A k-d tree over body ids with a bounding box per node. update() keeps the
+// partition and refits the boxes to the current positions in linear time,
+// copying the positions into tree order so queries touch only the index;
+// the tree is rebuilt once refitted boxes have grown too loose, bodies were
+// added, or many have been removed. Results are ids and reflect the state at
+// the last update().
+class SpatialIndex {
+public:
+    static constexpr uint32_t leafSize = 8;
+    static constexpr BodyStore::BodyId invalidId = UINT32_MAX;
+
+    struct Neighbor {
+        BodyStore::BodyId id;
+        double distance;
+    };
+
+    SpatialIndex();
+
+    double rebuildGrowth;  // Refitted leaf perimeter sum, relative to the last build, that triggers a rebuild
+
+    void update(const BodyStore& store);
+    void rebuild(const BodyStore& store);
+
+    // Closest body to (x, y) no further than maxDistance, or invalidId
+    BodyStore::BodyId nearest(double x, double y,
+                              double maxDistance = std::numeric_limits<double>::infinity()) const;
+
+    // Up to `count` closest bodies, nearest first
+    void nearest(double x, double y, size_t count, std::vector<Neighbor>& result) const;
+
+    // Bodies within `radius` of (x, y), and inside the box; unordered
+    void withinRadius(double x, double y, double radius, std::vector<BodyStore::BodyId>& result) const;
+    void withinBox(double minX, double minY, double maxX, double maxY, std::vector<BodyStore::BodyId>& result) const;
+
+    size_t size() const { return liveCount; }
+    bool empty() const { return liveCount == 0; }
+    unsigned long long rebuildCount() const { return rebuilds; }
+
+private:
+    // Pre-order layout: an inner node's left child follows it directly,
+    // `right` is the index of the right child (0 for leaves)
+    struct Node {
+        double minX, minY, maxX, maxY;
+        uint32_t begin, end;  // Item range
+        uint32_t right;
+    };
+
+    uint32_t build(std::vector<uint32_t>& order, const BodyStore& store, uint32_t begin, uint32_t end);
+    void refit(const BodyStore& store);
+    double leafPerimeterSum() const;
+
+    static double boxDistanceSquared(const Node& node, double x, double y);
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> leaves;                  // Node indices of all leaves
+    std::vector<BodyStore::BodyId> itemIds;        // Tree order
+    std::vector<double> itemX, itemY;              // Positions at the last update; NaN once removed
+    size_t liveCount;
+    double builtPerimeter;
+    unsigned long long rebuilds;
+};
+
+#endif // SPATIAL_INDEX_H
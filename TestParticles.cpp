@@ -0,0 +1,50 @@
+#include "TestParticles.h"
+#include "Arena.h"
+#include <algorithm>
+
+namespace {
+void permute(std::vector<double>& values, const std::vector<uint32_t>& order) {
+    ArenaScope scratch;
+    double* original = scratch.allocate<double>(values.size());
+    std::copy(values.begin(), values.end(), original);
+    for (size_t i = 0; i < order.size(); i++) {
+        values[i] = original[order[i]];
+    }
+}
+}
+
+void TestParticles::add(double px, double py, double pvx, double pvy) {
+    x.push_back(px);
+    y.push_back(py);
+    vx.push_back(pvx);
+    vy.push_back(pvy);
+    ax.push_back(0.0);
+    ay.push_back(0.0);
+}
+
+void TestParticles::reserve(size_t count) {
+    x.reserve(count);
+    y.reserve(count);
+    vx.reserve(count);
+    vy.reserve(count);
+    ax.reserve(count);
+    ay.reserve(count);
+}
+
+void TestParticles::reorder(const std::vector<uint32_t>& order) {
+    permute(x, order);
+    permute(y, order);
+    permute(vx, order);
+    permute(vy, order);
+    permute(ax, order);
+    permute(ay, order);
+}
+
+void TestParticles::clear() {
+    x.clear();
+    y.clear();
+    vx.clear();
+    vy.clear();
+    ax.clear();
+    ay.clear();
+}
@@ -0,0 +1,29 @@
+#ifndef TEST_PARTICLES_H
+#define TEST_PARTICLES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Massless particles (asteroid belts, debris) that feel the massive bodies
+// but exert no force themselves.
+//
+// They are stored apart from the BodyStore so they never enter the massive
+// force sum or the conservation measurements; the engine integrates them with
+// the same splitting as the massive bodies at a cost linear in their count.
+class TestParticles {
+public:
+    std::vector<double> x, y;
+    std::vector<double> vx, vy;
+    std::vector<double> ax, ay;
+
+    void add(double x, double y, double vx, double vy);
+    void reserve(size_t count);
+    void reorder(const std::vector<uint32_t>& order);  // Particle at old index order[i] moves to i
+    void clear();
+
+    size_t size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+};
+
+#endif // TEST_PARTICLES_H
@@ -0,0 +1,126 @@
+#include "ThreadPool.h"
+#include "HardwareCounters.h"
+#include "Profiler.h"
+#include <algorithm>
+
+namespace {
+thread_local bool insideWorker = false;
+}
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::ThreadPool(unsigned threadCount)
+    : job(nullptr), jobCount(0), jobGrain(1), nextChunk(0), busyWorkers(0), generation(0), stopping(false) {
+    start(threadCount);
+}
+
+ThreadPool::~ThreadPool() {
+    stop();
+}
+
+void ThreadPool::setThreadCount(unsigned threadCount) {
+    stop();
+    start(threadCount);
+}
+
+void ThreadPool::start(unsigned threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    unsigned long long currentGeneration;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = false;
+        currentGeneration = generation;
+    }
+    // Workers started by setThreadCount begin at the current generation, so
+    // they wait for the next job instead of waking for one that has finished
+    for (unsigned i = 1; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i, currentGeneration);
+    }
+}
+
+void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void ThreadPool::run(size_t count, size_t grain, const RangeFunction& body) {
+    if (count == 0) {
+        return;
+    }
+    grain = std::max<size_t>(1, grain);
+
+    // Small jobs, nested calls and single-threaded pools run on the caller
+    if (workers.empty() || count <= grain || insideWorker) {
+        body(0, count, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &body;
+        jobCount = count;
+        jobGrain = grain;
+        nextChunk.store(0, std::memory_order_relaxed);
+        busyWorkers = static_cast<unsigned>(workers.size());
+        generation++;
+    }
+    wakeCondition.notify_all();
+
+    insideWorker = true;
+    runChunks(0);
+    insideWorker = false;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this] { return busyWorkers == 0; });
+    job = nullptr;
+}
+
+void ThreadPool::runChunks(unsigned threadIndex) {
+    size_t chunkCount = (jobCount + jobGrain - 1) / jobGrain;
+    for (;;) {
+        size_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+        if (chunk >= chunkCount) {
+            break;
+        }
+        size_t begin = chunk * jobGrain;
+        size_t end = std::min(jobCount, begin + jobGrain);
+        (*job)(begin, end, threadIndex);
+    }
+}
+
+void ThreadPool::workerLoop(unsigned threadIndex, unsigned long long seenGeneration) {
+    insideWorker = true;
+    PROFILE_THREAD_NAME("physics worker");
+    HardwareCounters::registerThread(threadIndex);
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+            if (stopping) {
+                lock.unlock();
+                HardwareCounters::unregisterThread(threadIndex);
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        runChunks(threadIndex);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busyWorkers == 0) {
+            doneCondition.notify_one();
+        }
+    }
+}
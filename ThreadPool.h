@@ -0,0 +1,85 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads used by the physics kernels. parallelFor splits
+// [0, count) into chunks of `grain` items which threads claim from a shared
+// counter; the calling thread works on chunks too. Calls made from inside a
+// worker run inline, so kernels can be composed without deadlocking.
+class ThreadPool {
+public:
+    // Non-owning reference to a chunk body: [begin, end) plus the index of
+    // the executing thread in [0, threadCount()), usable to address
+    // per-thread partial results. Unlike std::function it never allocates,
+    // however much the lambda captures.
+    struct RangeFunction {
+        const void* body;
+        void (*invoke)(const void* body, size_t begin, size_t end, unsigned threadIndex);
+
+        void operator()(size_t begin, size_t end, unsigned threadIndex) const { invoke(body, begin, end, threadIndex); }
+    };
+
+    static ThreadPool& instance();
+
+    explicit ThreadPool(unsigned threadCount = 0);  // 0 = hardware concurrency
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned threadCount() const { return static_cast<unsigned>(workers.size()) + 1; }
+    void setThreadCount(unsigned threadCount);  // Must not be called while a job runs
+
+    template <typename Body>
+    void parallelFor(size_t count, size_t grain, const Body& body) {
+        RangeFunction function{&body, [](const void* target, size_t begin, size_t end, unsigned threadIndex) {
+            (*static_cast<const Body*>(target))(begin, end, threadIndex);
+        }};
+        run(count, grain, function);
+    }
+
+    // Like parallelFor, but the body always sees exactly the fixed chunks
+    // [k * grain, (k + 1) * grain) with their index k, also when the job runs
+    // inline. Partial results kept per chunk instead of per thread therefore
+    // do not depend on the thread count or on which thread took which chunk.
+    template <typename Body>
+    void parallelForChunks(size_t count, size_t grain, const Body& body) {
+        grain = grain > 0 ? grain : 1;
+        parallelFor(count, grain, [&body, grain](size_t begin, size_t end, unsigned) {
+            for (size_t chunkBegin = begin; chunkBegin < end; chunkBegin += grain) {
+                size_t chunkEnd = chunkBegin + grain < end ? chunkBegin + grain : end;
+                body(chunkBegin / grain, chunkBegin, chunkEnd);
+            }
+        });
+    }
+
+    static size_t chunkCount(size_t count, size_t grain) { return grain > 0 ? (count + grain - 1) / grain : count; }
+
+private:
+    void run(size_t count, size_t grain, const RangeFunction& body);
+    void start(unsigned threadCount);
+    void stop();
+    void workerLoop(unsigned threadIndex, unsigned long long seenGeneration);
+    void runChunks(unsigned threadIndex);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wakeCondition;
+    std::condition_variable doneCondition;
+
+    const RangeFunction* job;
+    size_t jobCount;
+    size_t jobGrain;
+    std::atomic<size_t> nextChunk;
+    unsigned busyWorkers;
+    unsigned long long generation;
+    bool stopping;
+};
+
+#endif // THREAD_POOL_H
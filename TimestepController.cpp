@@ -0,0 +1,61 @@
+#include "TimestepController.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+const double floorDecay = 0.95;  // Per accepted interval, so a transient floor is forgotten
+}
+
+TimestepController::TimestepController(double initialDt, double minDt, double maxDt, double driftBudget)
+    : enabled(true), minDt(minDt), maxDt(maxDt), driftBudget(driftBudget),
+      growthLimit(1.25), shrinkLimit(0.25), safety(0.9), currentDt(initialDt), dtBeforeShrink(initialDt),
+      lastRejectedError(0.0), noiseFloor(0.0), accepted(0), rejected(0) {
+    setDt(initialDt);
+}
+
+void TimestepController::setDt(double dt) {
+    currentDt = std::clamp(dt, minDt, maxDt);
+}
+
+double TimestepController::effectiveBudget() const {
+    return std::max(driftBudget, 2.0 * noiseFloor);
+}
+
+bool TimestepController::update(double intervalError) {
+    if (!enabled) {
+        accepted++;
+        return true;
+    }
+
+    double budget = effectiveBudget();
+    // Second-order integrator: error ~ dt^2, so the ideal factor is sqrt(budget/error)
+    double factor = intervalError > 0.0 ? safety * std::sqrt(budget / intervalError) : growthLimit;
+
+    if (intervalError > budget && currentDt > minDt) {
+        if (lastRejectedError == 0.0) {
+            dtBeforeShrink = currentDt;
+        }
+        // A smaller step that leaves the error at least half as large is not helping
+        bool unresponsive = lastRejectedError > 0.0 && intervalError > 0.5 * lastRejectedError;
+        if (!unresponsive) {
+            rejected++;
+            lastRejectedError = intervalError;
+            setDt(currentDt * std::clamp(factor, shrinkLimit, 1.0));
+            return false;
+        }
+        noiseFloor = std::max(noiseFloor, intervalError);
+        lastRejectedError = 0.0;
+        setDt(dtBeforeShrink);
+        accepted++;
+        return true;
+    }
+
+    lastRejectedError = 0.0;
+    noiseFloor *= floorDecay;
+    accepted++;
+    // Only grow when there is clear headroom, to avoid oscillating around the budget
+    if (intervalError < 0.5 * budget) {
+        setDt(currentDt * std::clamp(factor, 1.0, growthLimit));
+    }
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef TIMESTEP_CONTROLLER_H
+#define TIMESTEP_CONTROLLER_H
+
+// Chooses the largest step that keeps conservation errors inside a budget.
+//
+// After every monitor interval the engine reports the relative energy (and
+// angular momentum) change over that interval. Intervals over budget are
+// rejected and retried with a smaller step; intervals comfortably under budget
+// let the step grow. Leapfrog error scales with dt^2, which sets the exponent.
+//
+// If shrinking the step does not shrink the error, the error is dominated by
+// something dt cannot fix (tree force and potential approximation noise). The
+// controller then remembers that error floor, goes back to the larger step and
+// only judges later intervals against errors above the floor.
+class TimestepController {
+public:
+    TimestepController(double initialDt = 1.0e-3, double minDt = 1.0e-8, double maxDt = 0.05, double driftBudget = 1.0e-7);
+
+    bool enabled;
+    double minDt, maxDt;
+    double driftBudget;   // Allowed relative error per monitor interval
+    double growthLimit;   // Largest factor the step may grow by per interval
+    double shrinkLimit;   // Smallest factor the step may shrink by on rejection
+    double safety;
+
+    double dt() const { return currentDt; }
+    void setDt(double dt);
+
+    // Returns false if the interval must be redone with the new (smaller) step
+    bool update(double intervalError);
+
+    double effectiveBudget() const;
+    double errorFloor() const { return noiseFloor; }
+    unsigned long long acceptedIntervals() const { return accepted; }
+    unsigned long long rejectedIntervals() const { return rejected; }
+
+private:
+    double currentDt;
+    double dtBeforeShrink;     // Step in use before the current run of rejections
+    double lastRejectedError;  // Error of the previous interval if it was rejected, else 0
+    double noiseFloor;         // Learned error level that does not respond to dt
+    unsigned long long accepted;
+    unsigned long long rejected;
+};
+
+#endif // TIMESTEP_CONTROLLER_H
@@ -0,0 +1,240 @@
+#include "Benchmark.h"
+#include "HardwareCounters.h"
+#include "Logger.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+// Runs the canonical benchmark cases headless, each in its own process so
+// peak RSS is per case, and writes steps/s, frame-time percentiles and peak
+// RSS as JSON. With --baseline it exits non-zero when a case got slower than
+// the recorded results by more than the tolerance. --counters adds hardware
+// counter totals per phase and thread where the machine provides them.
+
+namespace {
+
+struct Options {
+    std::vector<std::string> cases;  // Empty = all
+    std::string output;              // JSON file; empty = stdout only
+    std::string baseline;
+    double tolerance = 0.10;         // Allowed fractional loss of steps/s
+    unsigned threads = 0;
+    bool counters = false;
+};
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --case NAME       Run only this case (repeatable):";
+    for (const BenchmarkCase& benchmark : Benchmark::cases()) {
+        std::cout << " " << benchmark.name;
+    }
+    std::cout << "\n"
+              << "  --output FILE     Write results as JSON to FILE\n"
+              << "  --baseline FILE   Fail when steps/s drops below results in FILE\n"
+              << "  --tolerance F     Allowed fractional slowdown against the baseline (default 0.1)\n"
+              << "  --threads N       Threads (default: all hardware threads)\n"
+              << "  --counters        Record hardware performance counters per phase" << std::endl;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            return false;
+        }
+        if (arg == "--counters") {
+            options.counters = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--case") {
+            if (!Benchmark::find(value)) {
+                std::cerr << "Unknown case " << value << std::endl;
+                return false;
+            }
+            options.cases.push_back(value);
+        } else if (arg == "--output") {
+            options.output = value;
+        } else if (arg == "--baseline") {
+            options.baseline = value;
+        } else if (arg == "--tolerance") {
+            options.tolerance = std::strtod(value, nullptr);
+        } else if (arg == "--threads") {
+            options.threads = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Runs one case in a forked child and reads its result back through a pipe.
+// The child starts from the parent's small footprint, so its peak RSS
+// belongs to the case alone. The thread pool is only ever started in the
+// children, since threads do not survive fork().
+BenchmarkResult runIsolated(const BenchmarkCase& benchmark, const Options& options) {
+    int channel[2];
+    if (pipe(channel) != 0) {
+        throw std::runtime_error(std::string("pipe failed: ") + std::strerror(errno));
+    }
+    pid_t child = fork();
+    if (child < 0) {
+        throw std::runtime_error(std::string("fork failed: ") + std::strerror(errno));
+    }
+    if (child == 0) {
+        close(channel[0]);
+        int status = 0;
+        try {
+            if (options.threads > 0) {
+                ThreadPool::instance().setThreadCount(options.threads);
+            }
+            if (options.counters) {
+                ThreadPool::instance();  // Workers register before the counters open
+                if (!HardwareCounters::enable()) {
+                    std::cerr << "Hardware counters unavailable: " << HardwareCounters::reason() << std::endl;
+                }
+            }
+            std::ostringstream line;
+            Benchmark::writeJsonObject(line, Benchmark::runHeadless(benchmark));
+            line << "\n";
+            std::string text = line.str();
+            if (write(channel[1], text.data(), text.size()) != static_cast<ssize_t>(text.size())) {
+                status = 1;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error in " << benchmark.name << ": " << e.what() << std::endl;
+            status = 1;
+        }
+        close(channel[1]);
+        Logger::flush();  // _exit skips the sink's own final drain
+        _exit(status);
+    }
+
+    close(channel[1]);
+    std::string text;
+    char buffer[512];
+    ssize_t count;
+    while ((count = read(channel[0], buffer, sizeof(buffer))) > 0) {
+        text.append(buffer, static_cast<size_t>(count));
+    }
+    close(channel[0]);
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        throw std::runtime_error("Benchmark " + benchmark.name + " failed");
+    }
+    std::istringstream in(text);
+    std::vector<BenchmarkResult> results = Benchmark::readJson(in);
+    if (results.size() != 1) {
+        throw std::runtime_error("Benchmark " + benchmark.name + " returned no result");
+    }
+    return results.front();
+}
+
+// One line per phase that was counted, summed over threads; the JSON keeps
+// the per-thread counts
+void printCounters(const BenchmarkResult& result) {
+    using Event = HardwareCounters::Event;
+    for (size_t p = 0; p < HardwareCounters::phaseCount; p++) {
+        const char* phase = HardwareCounters::name(static_cast<HardwareCounters::Phase>(p));
+        HardwareCounters::Counts counts = Benchmark::counterTotal(result, phase);
+        if (counts.empty()) {
+            continue;
+        }
+        std::cout << "  " << phase << ": " << counts[Event::Cycles] << " cycles, IPC " << counts.instructionsPerCycle();
+        if (counts.has(Event::CacheMisses)) {
+            std::cout << ", " << counts.perKiloInstruction(Event::CacheMisses) << " cache misses";
+        }
+        if (counts.has(Event::BranchMisses)) {
+            std::cout << ", " << counts.perKiloInstruction(Event::BranchMisses) << " branch misses";
+        }
+        if (counts.has(Event::VectorOps)) {
+            std::cout << ", " << counts.perKiloInstruction(Event::VectorOps) << " vector ops";
+        }
+        std::cout << " per 1000 instructions" << std::endl;
+    }
+}
+
+// Cases slower than the baseline by more than the tolerance
+int compareWithBaseline(const std::vector<BenchmarkResult>& results, const Options& options) {
+    std::ifstream file(options.baseline);
+    if (!file) {
+        throw std::runtime_error("Cannot read baseline " + options.baseline);
+    }
+    std::vector<BenchmarkResult> baseline = Benchmark::readJson(file);
+    int regressions = 0;
+    for (const BenchmarkResult& result : results) {
+        for (const BenchmarkResult& reference : baseline) {
+            if (reference.name != result.name || reference.mode != result.mode) {
+                continue;
+            }
+            double ratio = reference.stepsPerSecond > 0.0 ? result.stepsPerSecond / reference.stepsPerSecond : 1.0;
+            if (ratio < 1.0 - options.tolerance) {
+                std::cout << "Regression in " << result.name << ": " << result.stepsPerSecond << " steps/s against "
+                          << reference.stepsPerSecond << " in the baseline" << std::endl;
+                regressions++;
+            }
+        }
+    }
+    return regressions;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    try {
+        std::vector<BenchmarkResult> results;
+        for (const BenchmarkCase& benchmark : Benchmark::cases()) {
+            if (!options.cases.empty() &&
+                std::find(options.cases.begin(), options.cases.end(), benchmark.name) == options.cases.end()) {
+                continue;
+            }
+            BenchmarkResult result = runIsolated(benchmark, options);
+            std::cout << result.name << ": " << result.stepsPerSecond << " steps/s, frame p50/p95/p99 "
+                      << result.p50 << "/" << result.p95 << "/" << result.p99 << " ms, peak RSS "
+                      << result.peakResidentBytes / (1024 * 1024) << " MiB" << std::endl;
+            printCounters(result);
+            results.push_back(result);
+        }
+
+        if (!options.output.empty()) {
+            std::ofstream out(options.output);
+            if (!out) {
+                throw std::runtime_error("Cannot write " + options.output);
+            }
+            Benchmark::writeJson(out, results);
+            std::cout << "Wrote " << options.output << std::endl;
+        } else {
+            Benchmark::writeJson(std::cout, results);
+        }
+
+        if (!options.baseline.empty() && compareWithBaseline(results, options) > 0) {
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -3,8 +3,7 @@ out vec4 FragColor;
 
 in vec3 Normal;
 in vec3 FragPos;
-
-uniform vec3 color;
+in vec3 BodyColor;
 
 void main() {
     // Light properties
@@ -30,6 +29,6 @@ void main() {
     vec3 specular = specularStrength * spec * lightColor;
     
     // Final color
-    vec3 result = (ambient + diffuse + specular) * color;
+    vec3 result = (ambient + diffuse + specular) * BodyColor;
     FragColor = vec4(result, 1.0);
 } 
\ No newline at end of file
@@ -1,20 +1,34 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 instancePos;    // Quantized position, 0 to 1 across the bounds
+layout (location = 2) in uint instanceScale;  // Log-encoded mesh scale
+layout (location = 3) in uint instanceColor;  // Palette index
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform vec4 bounds;        // xy: corner of the quantization box, zw: its size
+uniform sampler2D palette;  // One texel per color
 
 out vec3 Normal;
 out vec3 FragPos;
+out vec3 BodyColor;
+
+// Inverse of InstanceStream::encodeScale: octave above 2^-16 in the top 5
+// bits, mantissa in the low 11
+float decodeScale(uint code) {
+    float mantissa = 1.0 + float(code & 2047u) / 2048.0;
+    return mantissa * exp2(float(code >> 11u) - 16.0);
+}
 
 void main() {
-    // Calculate normal (for a sphere, normal is the same as position for unit sphere)
-    Normal = normalize(mat3(model) * aPos);
+    // Normal of a sphere centered at the origin is its normalized position
+    Normal = normalize(aPos);
     
-    // Calculate fragment position in world space
-    FragPos = vec3(model * vec4(aPos, 1.0));
+    // Place the shared unit sphere at this instance's position and size
+    vec2 center = bounds.xy + instancePos * bounds.zw;
+    FragPos = vec3(center, 0.0) + aPos * decodeScale(instanceScale);
+    BodyColor = texelFetch(palette, ivec2(int(instanceColor), 0), 0).rgb;
     
     // Final position
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-} 
\ No newline at end of file
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -0,0 +1,15 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec3 SplatColor;
+
+void main() {
+    // Gaussian with sigma a third of the sprite radius, cut off at the edge
+    vec2 offset = gl_PointCoord * 2.0 - 1.0;
+    float r2 = dot(offset, offset);
+    if (r2 > 1.0) {
+        discard;
+    }
+    float weight = exp(-4.5 * r2);
+    FragColor = vec4(SplatColor * weight, weight);
+}
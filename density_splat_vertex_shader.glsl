@@ -0,0 +1,17 @@
+#version 330 core
+layout (location = 0) in vec2 instancePos;    // Quantized position, 0 to 1 across the bounds
+layout (location = 1) in uint instanceColor;  // Palette index
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float pointSize;    // Sprite width in framebuffer pixels
+uniform vec4 bounds;        // xy: corner of the quantization box, zw: its size
+uniform sampler2D palette;  // One texel per color
+
+out vec3 SplatColor;
+
+void main() {
+    SplatColor = texelFetch(palette, ivec2(int(instanceColor), 0), 0).rgb;
+    gl_Position = projection * view * vec4(bounds.xy + instancePos * bounds.zw, 0.0, 1.0);
+    gl_PointSize = pointSize;
+}
@@ -0,0 +1,17 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoord;
+
+uniform sampler2D density;  // RGB: weight * color, A: weight
+uniform float softening;    // Linear below, logarithmic above
+uniform float saturation;   // Full brightness
+
+void main() {
+    vec4 sum = texture(density, TexCoord);
+    if (sum.a <= 0.0) {
+        discard;
+    }
+    float level = clamp(asinh(sum.a / softening) / asinh(saturation / softening), 0.0, 1.0);
+    FragColor = vec4(sum.rgb / sum.a, level);
+}
@@ -7,6 +7,11 @@ uniform mat4 projection;
 uniform float zoom = 1.0;
 uniform float rotation = 0.0;
 
+// Gravitational potential (-sum m/r in simulation units, G = 1) sampled from
+// the particle mesh over [-potentialHalfExtent, potentialHalfExtent]^2
+uniform sampler2D potentialMap;
+uniform float potentialHalfExtent = 1.0;
+
 void main() {
     // Scale grid to match astronomical units (1 AU = Earth-Sun distance)
     vec3 pos = vec3(aPos.x * 2.0, aPos.y * 2.0, 0.0);  // Smaller grid scale for visibility
@@ -23,25 +28,21 @@ void main() {
     // Apply zoom
     rotatedPos *= zoom;
     
-    // Calculate distance from center (Sun's position)
-    float dist = length(rotatedPos);
-    
     // Constants for gravitational warping
-    float G = 6.67430e-11;  // Gravitational constant
-    float M = 1.989e30;     // Solar mass in kg
-    float scale = 1.0e-9;   // Scale factor to make warping visible
-    float minDist = 0.1;    // Minimum distance to prevent extreme warping
+    float scale = 0.3;           // Depth per unit of potential to make warping visible
+    float minPotential = -10.0;  // Same depth limit as a solar mass at 0.1 AU
     
-    // Calculate gravitational potential (φ = -GM/r)
-    float potential = G * M / (max(dist, minDist));
+    // Potential of every body at this point, looked up instead of summed
+    vec2 uv = rotatedPos.xy / (2.0 * potentialHalfExtent) + 0.5;
+    float potential = max(textureLod(potentialMap, uv, 0.0).r, minPotential);
     
     // Add time-based oscillation to the warping
     float timeScale = 0.5;  // Controls the speed of oscillation
     float oscillation = sin(time * timeScale) * 0.1;  // Small oscillation factor
     
     // Apply warping based on gravitational potential with time-based oscillation
-    rotatedPos.z = -potential * scale * (1.0 + oscillation);
+    rotatedPos.z = potential * scale * (1.0 + oscillation);
     
     // Apply view and projection transformations
     gl_Position = projection * view * vec4(rotatedPos, 1.0);
-} 
\ No newline at end of file
+} 
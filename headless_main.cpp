@@ -0,0 +1,459 @@
+#include "AllocationCounter.h"
+#include "DistributedEngine.h"
+#include "EnsembleRunner.h"
+#include "HardwareCounters.h"
+#include "Logger.h"
+#include "Metrics.h"
+#include "MetricsServer.h"
+#include "PhysicsEngine.h"
+#include "Scenarios.h"
+#include "SnapshotStream.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Runs a scenario without a window, either in-process on the PhysicsEngine or
+// spread over worker processes with --workers, and reports throughput and
+// energy conservation. With --ensemble it instead sweeps many perturbed copies
+// of a small system and summarizes how they end up.
+
+namespace {
+
+struct Options {
+    std::string scenario = "disk";
+    size_t bodies = 20000;
+    unsigned steps = 200;
+    double dt = 0.001;
+    unsigned workers = 0;  // 0 = in-process engine
+    unsigned threads = 0;
+    double theta = 0.5;
+    double softening = 0.01;
+    unsigned seed = 1;
+    std::string force = "auto";
+    std::string precision = "double";
+    unsigned grid = 256;
+    std::string ensemble;  // Spec file; empty = single run
+    std::string csv;       // Per-member ensemble results
+    int metricsPort = -1;  // Serve live metrics on this port; -1 = off
+    std::string streamShm; // Shared memory segment for viewers; empty = off
+    int streamPort = -1;   // TCP port for viewers; -1 = off
+    double streamRate = 30.0;
+    bool deterministic = false;
+    bool counters = false;  // Hardware counters per phase, reported at the end
+
+    bool streaming() const { return !streamShm.empty() || streamPort >= 0; }
+};
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --scenario NAME   Initial conditions:";
+    for (const std::string& name : Scenarios::names()) {
+        std::cout << " " << name;
+    }
+    std::cout << "\n"
+              << "  --bodies N        Body or belt particle count for generated scenarios (default 20000)\n"
+              << "  --steps N         Steps to run (default 200)\n"
+              << "  --dt DT           Step size (default 0.001)\n"
+              << "  --workers N       Split the domain over N worker processes\n"
+              << "  --threads N       Threads per process (default: all hardware threads)\n"
+              << "  --theta T         Barnes-Hut opening angle (default 0.5)\n"
+              << "  --softening S     Softening length (default 0.01)\n"
+              << "  --seed N          Random seed for generated scenarios\n"
+              << "  --force METHOD    auto, direct, tree, pm or p3m (in-process only)\n"
+              << "  --grid N          Mesh cells per side for pm/p3m (default 256)\n"
+              << "  --precision P     double, or mixed for float direct sums (in-process only)\n"
+              << "  --deterministic   Same results bit for bit whatever the thread count (in-process only)\n"
+              << "  --counters        Report hardware performance counters per phase and thread (in-process only)\n"
+              << "  --ensemble SPEC   Run the parameter sweep described in SPEC instead\n"
+              << "  --csv FILE        Write per-member ensemble results to FILE\n"
+              << "  --metrics-port N  Serve live Prometheus metrics on 127.0.0.1:N/metrics while running\n"
+              << "  --stream-shm NAME Stream snapshots to viewers through shared memory segment NAME\n"
+              << "  --stream-port N   Stream snapshots to viewers over TCP on 127.0.0.1:N\n"
+              << "  --stream-rate HZ  Snapshots per second of wall time (default 30)" << std::endl;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            return false;
+        }
+        if (arg == "--deterministic") {
+            options.deterministic = true;
+            continue;
+        }
+        if (arg == "--counters") {
+            options.counters = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        const char* value = argv[++i];
+        if (arg == "--scenario") {
+            options.scenario = value;
+        } else if (arg == "--bodies") {
+            options.bodies = std::strtoull(value, nullptr, 10);
+        } else if (arg == "--steps") {
+            options.steps = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--dt") {
+            options.dt = std::strtod(value, nullptr);
+        } else if (arg == "--workers") {
+            options.workers = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--threads") {
+            options.threads = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--theta") {
+            options.theta = std::strtod(value, nullptr);
+        } else if (arg == "--softening") {
+            options.softening = std::strtod(value, nullptr);
+        } else if (arg == "--seed") {
+            options.seed = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--force") {
+            options.force = value;
+            if (options.force != "auto" && options.force != "direct" && options.force != "tree" &&
+                options.force != "pm" && options.force != "p3m") {
+                std::cerr << "Unknown force method " << value << std::endl;
+                return false;
+            }
+        } else if (arg == "--precision") {
+            options.precision = value;
+            if (options.precision != "double" && options.precision != "mixed") {
+                std::cerr << "Unknown precision " << value << std::endl;
+                return false;
+            }
+        } else if (arg == "--grid") {
+            options.grid = static_cast<unsigned>(std::strtoul(value, nullptr, 10));
+        } else if (arg == "--ensemble") {
+            options.ensemble = value;
+        } else if (arg == "--csv") {
+            options.csv = value;
+        } else if (arg == "--metrics-port") {
+            options.metricsPort = std::atoi(value);
+            if (options.metricsPort < 0 || options.metricsPort > 65535) {
+                std::cerr << "Invalid metrics port " << value << std::endl;
+                return false;
+            }
+        } else if (arg == "--stream-shm") {
+            options.streamShm = value;
+        } else if (arg == "--stream-port") {
+            options.streamPort = std::atoi(value);
+            if (options.streamPort < 0 || options.streamPort > 65535) {
+                std::cerr << "Invalid stream port " << value << std::endl;
+                return false;
+            }
+        } else if (arg == "--stream-rate") {
+            options.streamRate = std::strtod(value, nullptr);
+            if (!(options.streamRate > 0.0)) {
+                std::cerr << "Invalid stream rate " << value << std::endl;
+                return false;
+            }
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Engine settings from the command line, shared by the in-process run and
+// the energy check of --workers runs
+void configureEngine(PhysicsEngine& engine, const Options& options) {
+    engine.settings.theta = options.theta;
+    engine.settings.softening = options.softening;
+    engine.settings.deterministic = options.deterministic;
+    if (options.precision == "mixed") {
+        engine.settings.precision = PhysicsEngine::Precision::Mixed;
+    }
+    if (options.force == "direct") {
+        engine.settings.forceMethod = PhysicsEngine::ForceMethod::Direct;
+    } else if (options.force == "tree") {
+        engine.settings.forceMethod = PhysicsEngine::ForceMethod::Tree;
+    } else if (options.force == "pm" || options.force == "p3m") {
+        engine.settings.forceMethod = PhysicsEngine::ForceMethod::ParticleMesh;
+        engine.mesh.gridSize = options.grid;
+        engine.mesh.shortRangeCorrection = options.force == "p3m";
+    }
+}
+
+// Energy of a snapshot gathered from worker processes, measured on a scratch
+// in-process engine
+double measureEnergy(const BodyStore& bodies, const Options& options) {
+    PhysicsEngine engine;
+    configureEngine(engine, options);
+    engine.bodies() = bodies;
+    engine.initialize();
+    return engine.monitor.reference().energy;
+}
+
+// FNV-1a over the bits of every body's position, velocity, mass and id and
+// every test particle's position and velocity, to compare runs exactly
+uint64_t stateHash(const PhysicsEngine& engine) {
+    uint64_t hash = 1469598103934665603ull;
+    auto mixBytes = [&hash](uint64_t bits, int bytes) {
+        for (int byte = 0; byte < bytes; byte++) {
+            hash = (hash ^ ((bits >> (8 * byte)) & 0xFF)) * 1099511628211ull;
+        }
+    };
+    auto mix = [&mixBytes](const std::vector<double>& values) {
+        for (double value : values) {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            mixBytes(bits, 8);
+        }
+    };
+    const BodyStore& bodies = engine.bodies();
+    mix(bodies.x);
+    mix(bodies.y);
+    mix(bodies.vx);
+    mix(bodies.vy);
+    mix(bodies.mass);
+    for (BodyStore::BodyId id : bodies.id) {
+        mixBytes(id, sizeof(id));
+    }
+    mix(engine.particles.x);
+    mix(engine.particles.y);
+    mix(engine.particles.vx);
+    mix(engine.particles.vy);
+    return hash;
+}
+
+double percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    size_t index = static_cast<size_t>(fraction * (values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+int runEnsemble(const Options& options) {
+    try {
+        EnsembleSpec spec = EnsembleSpec::load(options.ensemble);
+        if (options.threads > 0) {
+            ThreadPool::instance().setThreadCount(options.threads);
+        }
+        EnsembleRunner runner(spec);
+        runner.run();
+
+        const std::vector<EnsembleMemberSummary>& summaries = runner.summaries();
+        std::vector<double> energyErrors, separations;
+        for (const EnsembleMemberSummary& summary : summaries) {
+            energyErrors.push_back(std::abs(summary.energyError));
+            separations.push_back(summary.minSeparation);
+        }
+        std::cout << spec.members << " systems of " << spec.base.size() << " bodies, " << spec.steps
+                  << " steps in " << runner.seconds() << " s (" << runner.systemStepsPerSecond()
+                  << " system-steps/s)" << std::endl;
+        std::cout << "|Energy change|: median " << percentile(energyErrors, 0.5) << ", 99th percentile "
+                  << percentile(energyErrors, 0.99) << ", max " << percentile(energyErrors, 1.0) << std::endl;
+        std::cout << "Closest approach: min " << percentile(separations, 0.0) << ", median "
+                  << percentile(separations, 0.5) << std::endl;
+
+        if (!options.csv.empty()) {
+            std::ofstream out(options.csv);
+            if (!out) {
+                throw std::runtime_error("Cannot write " + options.csv);
+            }
+            runner.writeCsv(out);
+            std::cout << "Wrote " << options.csv << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (!options.ensemble.empty()) {
+        return runEnsemble(options);
+    }
+
+    BodyStore initial;
+    TestParticles particles;
+    if (!Scenarios::load(options.scenario, options.bodies, options.seed, initial, &particles)) {
+        std::cerr << "Unknown scenario " << options.scenario << std::endl;
+        return 1;
+    }
+
+    try {
+        EngineMetrics metrics;
+        MetricsServer metricsServer(metrics);
+        auto startMetrics = [&]() {
+            if (options.metricsPort >= 0) {
+                metricsServer.start(static_cast<uint16_t>(options.metricsPort));
+                std::cout << "Serving metrics at http://127.0.0.1:" << metricsServer.port() << "/metrics" << std::endl;
+            }
+        };
+
+        // Snapshots for viewers, throttled to the stream rate in wall time so
+        // the engine never waits for a viewer
+        SnapshotPublisher publisher;
+        const auto streamInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / options.streamRate));
+        auto nextSnapshot = std::chrono::steady_clock::now();
+        auto startStreaming = [&]() {
+            if (!options.streamShm.empty()) {
+                publisher.openSharedMemory(options.streamShm, initial.size(), options.workers > 0 ? 0 : particles.size());
+                std::cout << "Streaming snapshots to shm:" << options.streamShm << std::endl;
+            }
+            if (options.streamPort >= 0) {
+                publisher.listen(static_cast<uint16_t>(options.streamPort));
+                std::cout << "Streaming snapshots to 127.0.0.1:" << publisher.port() << std::endl;
+            }
+        };
+        auto snapshotDue = [&]() {
+            auto now = std::chrono::steady_clock::now();
+            if (now < nextSnapshot) {
+                return false;
+            }
+            nextSnapshot = std::max(nextSnapshot + streamInterval, now);
+            return true;
+        };
+
+        BodyStore final;
+        double initialEnergy = 0.0, finalEnergy = 0.0;
+        uint64_t finalHash = 0;  // Of the in-process engine, with --deterministic
+        auto start = std::chrono::steady_clock::now();
+        if (options.workers > 0) {
+            if (!particles.empty()) {
+                std::cout << "Test particles are not supported with --workers; ignoring " << particles.size() << std::endl;
+            }
+            if (options.deterministic) {
+                std::cout << "--deterministic is not supported with --workers; ignoring it" << std::endl;
+            }
+            if (options.counters) {
+                std::cout << "--counters is not supported with --workers; ignoring it" << std::endl;
+            }
+            DistributedEngine engine;
+            engine.settings.workers = options.workers;
+            engine.settings.threadsPerWorker = options.threads;
+            engine.settings.theta = options.theta;
+            engine.settings.softening = options.softening;
+            engine.metrics = &metrics;
+            engine.start(initial);
+            startMetrics();  // After the workers are forked
+            if (options.streaming()) {
+                startStreaming();
+                // Step in short runs so snapshots can be gathered in between
+                const TestParticles noParticles;
+                SnapshotInfo info;
+                info.energyDrift = std::nan("");
+                BodyStore snapshot;
+                for (unsigned s = 0; s < options.steps; s++) {
+                    engine.step(1, options.dt);
+                    if (snapshotDue()) {
+                        engine.gather(snapshot);
+                        info.time = engine.time();
+                        info.steps = s + 1;
+                        publisher.publish(snapshot, noParticles, info);
+                    }
+                }
+            } else {
+                engine.step(options.steps, options.dt);
+            }
+            engine.gather(final);
+            for (size_t rank = 0; rank < engine.domainStats().size(); rank++) {
+                const DistributedEngine::DomainStats& domain = engine.domainStats()[rank];
+                std::cout << "Domain " << rank << ": " << domain.bodies << " bodies, "
+                          << domain.importedParticles << " imported particles" << std::endl;
+            }
+            std::cout << "Rebalanced " << engine.rebalanceCount() << " times" << std::endl;
+            engine.stop();
+        } else {
+            if (options.threads > 0) {
+                ThreadPool::instance().setThreadCount(options.threads);
+            }
+            if (options.counters && !HardwareCounters::enable()) {
+                std::cout << "Hardware counters unavailable: " << HardwareCounters::reason() << std::endl;
+            }
+            PhysicsEngine engine;
+            configureEngine(engine, options);
+            engine.bodies() = initial;
+            engine.particles = particles;
+            engine.metrics = &metrics;
+            engine.initialize();
+            Logger::flush();  // Setup lines ahead of the run's own output
+            initialEnergy = engine.monitor.reference().energy;
+            startMetrics();
+            if (options.streaming()) {
+                startStreaming();
+            }
+            const bool measureDrift = options.metricsPort >= 0 || options.streaming();
+            const unsigned warmupSteps = std::min(options.steps, 10u);
+            uint64_t warmAllocations = 0;
+            for (unsigned s = 0; s < options.steps; s++) {
+                if (s == warmupSteps) {
+                    warmAllocations = AllocationCounter::count();
+                }
+                engine.step(options.dt);
+                // Stepping directly skips the engine's own checks; measure for the drift gauge
+                if (measureDrift && (s + 1) % engine.monitor.interval == 0) {
+                    engine.monitor.record(engine.monitor.measure(engine));
+                    metrics.setEnergyDrift(engine.monitor.energyDrift());
+                }
+                if (options.streaming() && snapshotDue()) {
+                    SnapshotInfo info;
+                    info.time = engine.time();
+                    info.steps = s + 1;
+                    info.particleOrder = engine.reordering.reorderCount();
+                    info.energyDrift = engine.monitor.energyDrift();
+                    publisher.publish(engine.bodies(), engine.particles, info);
+                }
+            }
+            if (AllocationCounter::enabled && options.steps > warmupSteps) {
+                uint64_t allocations = AllocationCounter::count() - warmAllocations;
+                std::cout << "Heap allocations after warm-up: " << allocations << " in "
+                          << options.steps - warmupSteps << " steps" << std::endl;
+            }
+            if (HardwareCounters::enabled()) {
+                HardwareCounters::writeReport(std::cout);
+            }
+            // Measured on the live engine, outside the timed run
+            auto measureStart = std::chrono::steady_clock::now();
+            finalEnergy = engine.monitor.measure(engine).energy;
+            start += std::chrono::steady_clock::now() - measureStart;
+            final = engine.bodies();
+            if (options.deterministic) {
+                finalHash = stateHash(engine);
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (options.workers > 0) {
+            initialEnergy = measureEnergy(initial, options);
+            finalEnergy = measureEnergy(final, options);
+            Logger::flush();  // The scratch engines' setup lines ahead of the results
+        }
+
+        std::cout << options.steps << " steps of " << initial.size() << " bodies";
+        if (!particles.empty() && options.workers == 0) {
+            std::cout << " and " << particles.size() << " test particles";
+        }
+        std::cout << " in " << seconds << " s ("
+                  << options.steps / seconds << " steps/s)" << std::endl;
+        std::cout << "Relative energy change: " << (finalEnergy - initialEnergy) / std::abs(initialEnergy) << std::endl;
+        if (options.deterministic && options.workers == 0) {
+            std::cout << "State hash: " << std::hex << finalHash << std::dec << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,7 +1,94 @@
+#include "HardwareCounters.h"
 #include "Simulation.h"
+#ifdef GRAVITY_SNAPSHOT_STREAMING
+#include "SnapshotStream.h"
+#endif
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 
-int main() {
-    Simulation sim;
-    sim.run();
+// Without arguments, opens the interactive viewer. With --benchmark NAME (or
+// all) it renders the benchmark cases offscreen and writes the same JSON as
+// gravity_bench, to stdout or --output FILE. With --connect shm:NAME or
+// HOST:PORT it shows what a gravity_headless run streams instead of
+// simulating itself. --counters shows hardware counters per phase under the
+// HUD and adds them to benchmark results.
+int main(int argc, char** argv) {
+    std::string benchmarkName;
+    std::string output;
+    std::string connect;
+    bool counters = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--counters") == 0) {
+            counters = true;
+        } else if (i + 1 < argc && std::strcmp(argv[i], "--benchmark") == 0) {
+            benchmarkName = argv[++i];
+        } else if (i + 1 < argc && std::strcmp(argv[i], "--output") == 0) {
+            output = argv[++i];
+        } else if (i + 1 < argc && std::strcmp(argv[i], "--connect") == 0) {
+            connect = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--benchmark NAME|all [--output FILE]] [--connect shm:NAME|HOST:PORT] [--counters]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (counters && !HardwareCounters::enable()) {
+        std::cerr << "Hardware counters unavailable: " << HardwareCounters::reason() << std::endl;
+    }
+
+    if (!connect.empty()) {
+#ifdef GRAVITY_SNAPSHOT_STREAMING
+        std::unique_ptr<SnapshotSubscriber> subscriber;
+        try {
+            subscriber.reset(new SnapshotSubscriber(connect));
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        Simulation sim(nullptr, subscriber.get());
+        sim.run();
+        return 0;
+#else
+        std::cerr << "This build has no snapshot streaming support" << std::endl;
+        return 1;
+#endif
+    }
+
+    if (benchmarkName.empty()) {
+        Simulation sim;
+        sim.run();
+        return 0;
+    }
+
+    // Cases run in one process, smallest first, so peak RSS is the largest
+    // footprint up to and including each case
+    std::vector<BenchmarkResult> results;
+    for (const BenchmarkCase& benchmark : Benchmark::cases()) {
+        if (benchmarkName != "all" && benchmark.name != benchmarkName) {
+            continue;
+        }
+        Simulation sim(&benchmark);
+        results.push_back(sim.runBenchmark());
+    }
+    if (results.empty()) {
+        std::cerr << "Unknown benchmark " << benchmarkName << std::endl;
+        return 1;
+    }
+
+    if (output.empty()) {
+        Benchmark::writeJson(std::cout, results);
+    } else {
+        std::ofstream out(output);
+        if (!out) {
+            std::cerr << "Cannot write " << output << std::endl;
+            return 1;
+        }
+        Benchmark::writeJson(out, results);
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,551 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "PhysicsEngine.h"
+#include "Scenarios.h"
+#include "ThreadPool.h"
+#include <exception>
+#include <mutex>
+#include <string>
+
+// The `gravity` Python module: the in-process PhysicsEngine with step and run
+// control, for scripting parameter studies from the analysis stack.
+//
+// State is exposed without copying. Engine.x, .vx, .mass and friends return
+// NumPy arrays (memoryviews when NumPy is not installed) that look straight
+// into the engine's structure-of-arrays buffers. They are read-only, and they
+// follow the state as the engine steps: sorts and merges rearrange bodies in
+// place, so the arrays stay valid but index i may hold another body
+// afterwards (compare `ids`), and after a merge only the first body_count
+// entries are meaningful. Adding bodies may move the buffers, so it raises
+// BufferError while any array is alive.
+//
+// step, run and measure release the GIL, so other Python threads keep
+// running meanwhile. All engines share the process's worker pool, though,
+// which takes one job at a time: engine work started from several Python
+// threads runs one call after another, never concurrently, and set_threads
+// waits for the call in progress. Using one engine from a second thread
+// while it steps raises RuntimeError.
+
+namespace {
+
+struct EngineObject {
+    PyObject_HEAD
+    PhysicsEngine* engine;
+    Py_ssize_t exports;  // Buffers handed out and not yet released
+    bool stepping;       // Set while a step runs without the GIL
+    bool dirty;          // Bodies were added since the last initialize()
+};
+
+enum class Field { X, Y, VX, VY, Mass, Id, ParticleX, ParticleY, ParticleVX, ParticleVY };
+
+// One exported buffer over an engine array. Each array access makes a new
+// view, so the shape stored here belongs to exactly one export.
+struct StateViewObject {
+    PyObject_HEAD
+    EngineObject* owner;
+    Field field;
+    Py_ssize_t shape;
+    Py_ssize_t stride;
+};
+
+PyTypeObject EngineType;
+PyTypeObject StateViewType;
+
+// Runs `body`, turning C++ exceptions into Python exceptions. Returns false
+// when an exception was raised.
+template <typename Body>
+bool guarded(Body&& body) {
+    try {
+        body();
+        return true;
+    } catch (const std::exception& e) {
+        PyErr_SetString(PyExc_RuntimeError, e.what());
+    } catch (...) {
+        PyErr_SetString(PyExc_RuntimeError, "Unknown error in the physics engine");
+    }
+    return false;
+}
+
+// Held, without the GIL, by every call that runs on the shared thread pool
+std::mutex& poolMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+bool checkIdle(EngineObject* self) {
+    if (self->stepping) {
+        PyErr_SetString(PyExc_RuntimeError, "The engine is stepping in another thread");
+        return false;
+    }
+    return true;
+}
+
+// Runs `body` on the engine without the GIL and with the pool to itself,
+// first initializing the engine if bodies were added since the last run
+template <typename Body>
+bool runUnlocked(EngineObject* self, Body&& body) {
+    if (!checkIdle(self)) {
+        return false;
+    }
+    self->stepping = true;
+    bool dirty = self->dirty;
+    std::string error;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        std::lock_guard<std::mutex> lock(poolMutex());
+        if (dirty) {
+            self->engine->initialize();
+        }
+        body(*self->engine);
+    } catch (const std::exception& e) {
+        error = e.what();
+    } catch (...) {
+        error = "Unknown error in the physics engine";
+    }
+    Py_END_ALLOW_THREADS
+    self->stepping = false;
+    self->dirty = false;
+    if (!error.empty()) {
+        PyErr_SetString(PyExc_RuntimeError, error.c_str());
+        return false;
+    }
+    return true;
+}
+
+// ---- StateView ----
+
+int stateViewGetBuffer(PyObject* object, Py_buffer* view, int flags) {
+    StateViewObject* self = reinterpret_cast<StateViewObject*>(object);
+    if (flags & PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "Engine state is read-only");
+        view->obj = nullptr;
+        return -1;
+    }
+    PhysicsEngine& engine = *self->owner->engine;
+    BodyStore& store = engine.bodies();
+    void* data = nullptr;
+    size_t count = 0;
+    bool ids = false;
+    switch (self->field) {
+        case Field::X: data = store.x.data(); count = store.x.size(); break;
+        case Field::Y: data = store.y.data(); count = store.y.size(); break;
+        case Field::VX: data = store.vx.data(); count = store.vx.size(); break;
+        case Field::VY: data = store.vy.data(); count = store.vy.size(); break;
+        case Field::Mass: data = store.mass.data(); count = store.mass.size(); break;
+        case Field::Id: data = store.id.data(); count = store.id.size(); ids = true; break;
+        case Field::ParticleX: data = engine.particles.x.data(); count = engine.particles.x.size(); break;
+        case Field::ParticleY: data = engine.particles.y.data(); count = engine.particles.y.size(); break;
+        case Field::ParticleVX: data = engine.particles.vx.data(); count = engine.particles.vx.size(); break;
+        case Field::ParticleVY: data = engine.particles.vy.data(); count = engine.particles.vy.size(); break;
+    }
+    Py_ssize_t itemSize = ids ? static_cast<Py_ssize_t>(sizeof(BodyStore::BodyId)) : static_cast<Py_ssize_t>(sizeof(double));
+    self->shape = static_cast<Py_ssize_t>(count);
+    self->stride = itemSize;
+
+    view->obj = object;
+    Py_INCREF(object);
+    view->buf = data;
+    view->len = self->shape * itemSize;
+    view->readonly = 1;
+    view->itemsize = itemSize;
+    view->format = (flags & PyBUF_FORMAT) ? const_cast<char*>(ids ? "I" : "d") : nullptr;
+    view->ndim = 1;
+    view->shape = (flags & PyBUF_ND) == PyBUF_ND ? &self->shape : nullptr;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &self->stride : nullptr;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    self->owner->exports++;
+    return 0;
+}
+
+void stateViewReleaseBuffer(PyObject* object, Py_buffer*) {
+    reinterpret_cast<StateViewObject*>(object)->owner->exports--;
+}
+
+void stateViewDealloc(PyObject* object) {
+    Py_XDECREF(reinterpret_cast<StateViewObject*>(object)->owner);
+    PyObject_Free(object);
+}
+
+PyBufferProcs stateViewBuffer = {stateViewGetBuffer, stateViewReleaseBuffer};
+
+// numpy.asarray, imported on first use; null when NumPy is not installed
+PyObject* numpyAsArray() {
+    static PyObject* asArray = nullptr;
+    static bool attempted = false;
+    if (!attempted) {
+        attempted = true;
+        PyObject* numpy = PyImport_ImportModule("numpy");
+        if (numpy) {
+            asArray = PyObject_GetAttrString(numpy, "asarray");
+            Py_DECREF(numpy);
+        }
+        PyErr_Clear();
+    }
+    return asArray;
+}
+
+PyObject* stateArray(EngineObject* self, Field field) {
+    if (!checkIdle(self)) {
+        return nullptr;
+    }
+    StateViewObject* view = PyObject_New(StateViewObject, &StateViewType);
+    if (!view) {
+        return nullptr;
+    }
+    Py_INCREF(self);
+    view->owner = self;
+    view->field = field;
+    view->shape = 0;
+    view->stride = 0;
+
+    // The array (or memoryview) holds the view, which holds the engine
+    PyObject* asArray = numpyAsArray();
+    PyObject* result = asArray ? PyObject_CallFunctionObjArgs(asArray, reinterpret_cast<PyObject*>(view), nullptr)
+                               : PyMemoryView_FromObject(reinterpret_cast<PyObject*>(view));
+    Py_DECREF(view);
+    return result;
+}
+
+// ---- Engine ----
+
+PyObject* engineNew(PyTypeObject* type, PyObject*, PyObject*) {
+    EngineObject* self = reinterpret_cast<EngineObject*>(type->tp_alloc(type, 0));
+    if (!self) {
+        return nullptr;
+    }
+    self->engine = nullptr;
+    self->exports = 0;
+    self->stepping = false;
+    self->dirty = true;
+    if (!guarded([&] { self->engine = new PhysicsEngine(); })) {
+        Py_DECREF(self);
+        return nullptr;
+    }
+    return reinterpret_cast<PyObject*>(self);
+}
+
+int engineInit(PyObject* object, PyObject* args, PyObject* kwargs) {
+    EngineObject* self = reinterpret_cast<EngineObject*>(object);
+    static const char* keywords[] = {"scenario", "bodies", "seed", "softening", "theta", "force", "grid",
+                                     "precision", "deterministic", nullptr};
+    const char* scenario = nullptr;
+    Py_ssize_t bodies = 20000;
+    unsigned int seed = 1;
+    double softening = 0.01;
+    double theta = 0.5;
+    const char* force = "auto";
+    unsigned int grid = 256;
+    const char* precision = "double";
+    int deterministic = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|znIddsIsp", const_cast<char**>(keywords), &scenario, &bodies,
+                                     &seed, &softening, &theta, &force, &grid, &precision, &deterministic)) {
+        return -1;
+    }
+    if (!checkIdle(self)) {
+        return -1;
+    }
+    if (self->exports > 0) {
+        PyErr_SetString(PyExc_BufferError, "Cannot reset the engine while state arrays are in use");
+        return -1;
+    }
+    if (bodies < 0) {
+        PyErr_SetString(PyExc_ValueError, "bodies must not be negative");
+        return -1;
+    }
+
+    std::string forceName = force;
+    PhysicsEngine::Settings settings;
+    settings.softening = softening;
+    settings.theta = theta;
+    settings.deterministic = deterministic != 0;
+    if (forceName == "direct") {
+        settings.forceMethod = PhysicsEngine::ForceMethod::Direct;
+    } else if (forceName == "tree") {
+        settings.forceMethod = PhysicsEngine::ForceMethod::Tree;
+    } else if (forceName == "pm" || forceName == "p3m") {
+        settings.forceMethod = PhysicsEngine::ForceMethod::ParticleMesh;
+    } else if (forceName != "auto") {
+        PyErr_Format(PyExc_ValueError, "Unknown force method %s", force);
+        return -1;
+    }
+    std::string precisionName = precision;
+    if (precisionName == "mixed") {
+        settings.precision = PhysicsEngine::Precision::Mixed;
+    } else if (precisionName != "double") {
+        PyErr_Format(PyExc_ValueError, "Unknown precision %s", precision);
+        return -1;
+    }
+
+    bool loaded = true;
+    bool ok = guarded([&] {
+        PhysicsEngine* engine = new PhysicsEngine();
+        engine->settings = settings;
+        engine->mesh.gridSize = grid;
+        engine->mesh.shortRangeCorrection = forceName == "p3m";
+        if (scenario) {
+            loaded = Scenarios::load(scenario, static_cast<size_t>(bodies), seed, engine->bodies(), &engine->particles);
+        }
+        delete self->engine;
+        self->engine = engine;
+    });
+    if (!ok) {
+        return -1;
+    }
+    self->dirty = true;
+    if (!loaded) {
+        PyErr_Format(PyExc_ValueError, "Unknown scenario %s", scenario);
+        return -1;
+    }
+    return 0;
+}
+
+void engineDealloc(PyObject* object) {
+    EngineObject* self = reinterpret_cast<EngineObject*>(object);
+    delete self->engine;
+    Py_TYPE(object)->tp_free(object);
+}
+
+PyObject* engineAddBody(PyObject* object, PyObject* args, PyObject* kwargs) {
+    EngineObject* self = reinterpret_cast<EngineObject*>(object);
+    static const char* keywords[] = {"x", "y", "vx", "vy", "mass", "radius", nullptr};
+    double x, y, vx, vy, mass, radius = 0.0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ddddd|d", const_cast<char**>(keywords), &x, &y, &vx, &vy, &mass,
+                                     &radius)) {
+        return nullptr;
+    }
+    if (!checkIdle(self)) {
+        return nullptr;
+    }
+    if (self->exports > 0) {
+        PyErr_SetString(PyExc_BufferError, "Cannot add bodies while state arrays are in use");
+        return nullptr;
+    }
+    BodyStore::BodyId id = 0;
+    if (!guarded([&] { id = self->engine->bodies().addBody(x, y, vx, vy, mass, radius, BodyStore::packColor(1.0f, 1.0f, 1.0f)); })) {
+        return nullptr;
+    }
+    self->dirty = true;
+    return PyLong_FromUnsignedLong(id);
+}
+
+PyObject* engineAddParticle(PyObject* object, PyObject* args, PyObject* kwargs) {
+    EngineObject* self = reinterpret_cast<EngineObject*>(object);
+    static const char* keywords[] = {"x", "y", "vx", "vy", nullptr};
+    double x, y, vx, vy;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "dddd", const_cast<char**>(keywords), &x, &y, &vx, &vy)) {
+        return nullptr;
+    }
+    if (!checkIdle(self)) {
+        return nullptr;
+    }
+    if (self->exports > 0) {
+        PyErr_SetString(PyExc_BufferError, "Cannot add particles while state arrays are in use");
+        return nullptr;
+    }
+    if (!guarded([&] { self->engine->particles.add(x, y, vx, vy); })) {
+        return nullptr;
+    }
+    self->dirty = true;
+    Py_RETURN_NONE;
+}
+
+PyObject* engineStep(PyObject* object, PyObject* args, PyObject* kwargs) {
+    EngineObject* self = reinterpret_cast<EngineObject*>(object);
+    static const char* keywords[] = {"dt", "count", nullptr};
+    double dt;
+    unsigned int count = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "d|I", const_cast<char**>(keywords), &dt, &count)) {
+        return nullptr;
+    }
+    if (!(dt > 0.0)) {
+        PyErr_SetString(PyExc_ValueError, "dt must be positive");
+        return nullptr;
+    }
+    if (!runUnlocked(self, [dt, count](PhysicsEngine& engine) {
+            for (unsigned int s = 0; s < count; s++) {
+                engine.step(dt);
+            }
+        })) {
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject* engineRun(PyObject* object, PyObject* args, PyObject* kwargs) {
+    EngineObject* self = reinterpret_cast<EngineObject*>(object);
+    static const char* keywords[] = {"until", nullptr};
+    double until;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "d", const_cast<char**>(keywords), &until)) {
+        return nullptr;
+    }
+    if (!runUnlocked(self, [until](PhysicsEngine& engine) { engine.advanceTo(until); })) {
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+PyObject* engineMeasure(PyObject* object, PyObject*) {
+    EngineObject* self = reinterpret_cast<EngineObject*>(object);
+    ConservationSample sample;
+    double drift = 0.0;
+    if (!runUnlocked(self, [&](PhysicsEngine& engine) {
+            sample = engine.monitor.measure(engine);
+            sample.time = engine.time();
+            engine.monitor.record(sample);
+            drift = engine.monitor.energyDrift();
+        })) {
+        return nullptr;
+    }
+    return Py_BuildValue("{s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d,s:d}", "time", sample.time, "kinetic", sample.kinetic,
+                         "potential", sample.potential, "energy", sample.energy, "momentum_x", sample.momentumX,
+                         "momentum_y", sample.momentumY, "angular_momentum", sample.angularMomentum, "virial_ratio",
+                         sample.virialRatio, "energy_drift", drift);
+}
+
+PyObject* engineTime(PyObject* object, void*) {
+    return PyFloat_FromDouble(reinterpret_cast<EngineObject*>(object)->engine->time());
+}
+
+PyObject* engineStepCount(PyObject* object, void*) {
+    return PyLong_FromUnsignedLongLong(reinterpret_cast<EngineObject*>(object)->engine->stepCount());
+}
+
+PyObject* engineBodyCount(PyObject* object, void*) {
+    return PyLong_FromSize_t(reinterpret_cast<EngineObject*>(object)->engine->bodies().size());
+}
+
+PyObject* engineParticleCount(PyObject* object, void*) {
+    return PyLong_FromSize_t(reinterpret_cast<EngineObject*>(object)->engine->particles.size());
+}
+
+PyObject* engineEnergyDrift(PyObject* object, void*) {
+    return PyFloat_FromDouble(reinterpret_cast<EngineObject*>(object)->engine->monitor.energyDrift());
+}
+
+template <Field field>
+PyObject* engineArray(PyObject* object, void*) {
+    return stateArray(reinterpret_cast<EngineObject*>(object), field);
+}
+
+PyMethodDef engineMethods[] = {
+    {"add_body", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(engineAddBody)), METH_VARARGS | METH_KEYWORDS,
+     "add_body(x, y, vx, vy, mass, radius=0.0) -> id\n\nAdds a massive body and returns its stable id."},
+    {"add_particle", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(engineAddParticle)), METH_VARARGS | METH_KEYWORDS,
+     "add_particle(x, y, vx, vy)\n\nAdds a massless test particle."},
+    {"step", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(engineStep)), METH_VARARGS | METH_KEYWORDS,
+     "step(dt, count=1)\n\nTakes `count` fixed steps of `dt` without the GIL, after any other engine's step."},
+    {"run", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(engineRun)), METH_VARARGS | METH_KEYWORDS,
+     "run(until)\n\nAdvances to simulation time `until` with the adaptive step, without the GIL, after any other engine's step."},
+    {"measure", engineMeasure, METH_NOARGS,
+     "measure() -> dict\n\nMeasures energy, momentum and the virial ratio now and updates energy_drift."},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyGetSetDef engineGetSet[] = {
+    {"time", engineTime, nullptr, "Simulation time", nullptr},
+    {"step_count", engineStepCount, nullptr, "Steps taken", nullptr},
+    {"body_count", engineBodyCount, nullptr, "Massive bodies; merges reduce it", nullptr},
+    {"particle_count", engineParticleCount, nullptr, "Test particles", nullptr},
+    {"energy_drift", engineEnergyDrift, nullptr, "Relative energy change at the last measurement", nullptr},
+    {"x", engineArray<Field::X>, nullptr, "Body x positions (read-only view)", nullptr},
+    {"y", engineArray<Field::Y>, nullptr, "Body y positions (read-only view)", nullptr},
+    {"vx", engineArray<Field::VX>, nullptr, "Body x velocities (read-only view)", nullptr},
+    {"vy", engineArray<Field::VY>, nullptr, "Body y velocities (read-only view)", nullptr},
+    {"mass", engineArray<Field::Mass>, nullptr, "Body masses (read-only view)", nullptr},
+    {"ids", engineArray<Field::Id>, nullptr, "Stable id of the body at each index (read-only view)", nullptr},
+    {"particle_x", engineArray<Field::ParticleX>, nullptr, "Test particle x positions (read-only view)", nullptr},
+    {"particle_y", engineArray<Field::ParticleY>, nullptr, "Test particle y positions (read-only view)", nullptr},
+    {"particle_vx", engineArray<Field::ParticleVX>, nullptr, "Test particle x velocities (read-only view)", nullptr},
+    {"particle_vy", engineArray<Field::ParticleVY>, nullptr, "Test particle y velocities (read-only view)", nullptr},
+    {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+// ---- Module ----
+
+PyObject* moduleScenarios(PyObject*, PyObject*) {
+    std::vector<std::string> names = Scenarios::names();
+    PyObject* list = PyList_New(static_cast<Py_ssize_t>(names.size()));
+    if (!list) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < names.size(); i++) {
+        PyObject* name = PyUnicode_FromString(names[i].c_str());
+        if (!name) {
+            Py_DECREF(list);
+            return nullptr;
+        }
+        PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), name);
+    }
+    return list;
+}
+
+PyObject* moduleSetThreads(PyObject*, PyObject* args) {
+    unsigned int count;
+    if (!PyArg_ParseTuple(args, "I", &count)) {
+        return nullptr;
+    }
+    // Waits for a step in another thread to finish with the pool
+    std::string error;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        std::lock_guard<std::mutex> lock(poolMutex());
+        ThreadPool::instance().setThreadCount(count);
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    Py_END_ALLOW_THREADS
+    if (!error.empty()) {
+        PyErr_SetString(PyExc_RuntimeError, error.c_str());
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+PyMethodDef moduleMethods[] = {
+    {"scenarios", moduleScenarios, METH_NOARGS, "scenarios() -> list of the scenario names Engine accepts"},
+    {"set_threads", moduleSetThreads, METH_VARARGS, "set_threads(n)\n\nSets the worker threads shared by all engines, once no engine is stepping."},
+    {nullptr, nullptr, 0, nullptr}};
+
+PyModuleDef moduleDefinition = {PyModuleDef_HEAD_INIT, "gravity",
+                                "In-process gravity simulation engine with zero-copy NumPy views of its state.", -1,
+                                moduleMethods, nullptr, nullptr, nullptr, nullptr};
+
+} // namespace
+
+PyMODINIT_FUNC PyInit_gravity() {
+    StateViewType.tp_name = "gravity._StateView";
+    StateViewType.tp_basicsize = sizeof(StateViewObject);
+    StateViewType.tp_dealloc = stateViewDealloc;
+    StateViewType.tp_as_buffer = &stateViewBuffer;
+    StateViewType.tp_flags = Py_TPFLAGS_DEFAULT;
+    StateViewType.tp_doc = "Buffer over one engine array";
+
+    EngineType.tp_name = "gravity.Engine";
+    EngineType.tp_basicsize = sizeof(EngineObject);
+    EngineType.tp_dealloc = engineDealloc;
+    EngineType.tp_flags = Py_TPFLAGS_DEFAULT;
+    EngineType.tp_doc =
+        "Engine(scenario=None, bodies=20000, seed=1, softening=0.01, theta=0.5, force='auto', grid=256,\n"
+        "       precision='double', deterministic=False)\n\n"
+        "A physics engine, empty or loaded with a named scenario (see scenarios()). force is auto, direct,\n"
+        "tree, pm or p3m; precision is double or mixed.";
+    EngineType.tp_methods = engineMethods;
+    EngineType.tp_getset = engineGetSet;
+    EngineType.tp_new = engineNew;
+    EngineType.tp_init = engineInit;
+
+    if (PyType_Ready(&StateViewType) < 0 || PyType_Ready(&EngineType) < 0) {
+        return nullptr;
+    }
+    PyObject* module = PyModule_Create(&moduleDefinition);
+    if (!module) {
+        return nullptr;
+    }
+    Py_INCREF(&EngineType);
+    if (PyModule_AddObject(module, "Engine", reinterpret_cast<PyObject*>(&EngineType)) < 0) {
+        Py_DECREF(&EngineType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
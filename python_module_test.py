@@ -0,0 +1,71 @@
+"""Checks that engines stepped from several Python threads at once end where
+they would have stepping one after another. All engines share one worker
+pool; run by CTest with the build directory on PYTHONPATH."""
+
+import sys
+import threading
+
+import gravity
+
+ENGINES = 4
+STEPS = 20
+
+
+def make_engine(seed):
+    return gravity.Engine(scenario="disk", bodies=500, seed=seed, deterministic=True)
+
+
+def final_state(engine):
+    return bytes(memoryview(engine.x)) + bytes(memoryview(engine.vx))
+
+
+def main():
+    gravity.set_threads(4)
+
+    expected = []
+    for seed in range(ENGINES):
+        engine = make_engine(seed + 1)
+        engine.step(0.001, count=STEPS)
+        expected.append(final_state(engine))
+
+    engines = [make_engine(seed + 1) for seed in range(ENGINES)]
+    errors = []
+
+    def step(engine):
+        try:
+            for _ in range(STEPS):
+                engine.step(0.001)
+        except Exception as error:  # Reported below; threads swallow exceptions
+            errors.append(error)
+
+    def resize():
+        # The pool is resized between steps, never underneath one
+        try:
+            for count in (2, 3, 4, 2, 4):
+                gravity.set_threads(count)
+        except Exception as error:
+            errors.append(error)
+
+    threads = [threading.Thread(target=step, args=(engine,)) for engine in engines]
+    threads.append(threading.Thread(target=resize))
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join(timeout=120)
+        if thread.is_alive():
+            print("A thread did not finish; the pool is stuck")
+            return 1
+
+    if errors:
+        print("Stepping failed: %s" % errors[0])
+        return 1
+    for index, engine in enumerate(engines):
+        if final_state(engine) != expected[index]:
+            print("Engine %d differs from its sequential run" % index)
+            return 1
+    print("%d engines stepped from %d threads match their sequential runs" % (ENGINES, ENGINES))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())